@@ -0,0 +1,425 @@
+#include "BmpWriter.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define BMP_WRITER_X86
+# include <immintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
+#endif
+
+// target attributes allow us to use SSSE3 and AVX2 intrinsics
+// without compiling the whole file for these instruction sets
+// (MSVC does not need them)
+#if defined(__GNUC__) || defined(__clang__)
+# define TARGET_SSSE3 __attribute__((target("ssse3")))
+# define TARGET_AVX2  __attribute__((target("avx2")))
+#else
+# define TARGET_SSSE3
+# define TARGET_AVX2
+#endif
+
+using namespace std;
+
+
+// bmp headers
+struct BitmapFileHeader {
+	uint16_t type = 0x4d42;
+	uint16_t sizeLo;
+	uint16_t sizeHi;
+	uint16_t reserved1 = 0;
+	uint16_t reserved2 = 0;
+	uint16_t offsetLo;
+	uint16_t offsetHi;
+};
+static_assert(sizeof(BitmapFileHeader)==14, "Wrong alignment of BitmapFileHeader members.");
+
+struct BitmapInfoHeader {
+	uint32_t size = 40;
+	int32_t  width;
+	int32_t  height;
+	uint16_t numPlanes = 1;
+	uint16_t bpp = 32;
+	uint32_t compression = 0;  // 0 - no compression
+	uint32_t imageDataSize;
+	int32_t  xPixelsPerMeter;
+	int32_t  yPixelsPerMeter;
+	uint32_t numColorsInPalette = 0;  // no colors in color palette
+	uint32_t numImportantColors = 0;  // all colors are important
+};
+static_assert(sizeof(BitmapInfoHeader)==40, "Wrong size of BitmapInfoHeader.");
+
+// block buffer parameters
+static constexpr const size_t minBlockSize = 4 * 1024 * 1024;
+static constexpr const size_t blockAlignment = 4096;
+static constexpr const size_t maxBandSize = 256 * 1024 * 1024;
+
+
+static void convertRowScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+	// swap R and B component of each pixel
+	// (we process the whole pixel as uint32_t; the code works on little-endian machines only)
+	for(size_t i=0; i<numPixels; i++) {
+		uint32_t p;
+		memcpy(&p, src+i*4, 4);
+		p = (p & 0xff00ff00) | ((p >> 16) & 0xff) | ((p & 0xff) << 16);
+		memcpy(dst+i*4, &p, 4);
+	}
+}
+
+
+#if defined(BMP_WRITER_X86)
+
+TARGET_SSSE3 static void convertRowSSSE3(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+	// swap R and B component of 4 pixels at once
+	const __m128i mask = _mm_setr_epi8(2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15);
+	size_t i = 0;
+	for(size_t e=numPixels&~size_t(3); i<e; i+=4) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i*4));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst+i*4), _mm_shuffle_epi8(v, mask));
+	}
+	convertRowScalar(src+i*4, dst+i*4, numPixels-i);
+}
+
+
+TARGET_AVX2 static void convertRowAVX2(const uint8_t* src, uint8_t* dst, size_t numPixels)
+{
+	// swap R and B component of 16 pixels per iteration
+	// (_mm256_shuffle_epi8() shuffles within 128-bit lanes, so the mask is repeated for each lane)
+	const __m256i mask = _mm256_setr_epi8(2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15,
+	                                      2,1,0,3, 6,5,4,7, 10,9,8,11, 14,13,12,15);
+	size_t i = 0;
+	for(size_t e=numPixels&~size_t(15); i<e; i+=16) {
+		__m256i v1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src+i*4));
+		__m256i v2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src+i*4+32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i*4),    _mm256_shuffle_epi8(v1, mask));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+i*4+32), _mm256_shuffle_epi8(v2, mask));
+	}
+	convertRowSSSE3(src+i*4, dst+i*4, numPixels-i);
+}
+
+
+static bool isAVX2Supported()
+{
+#if defined(_MSC_VER)
+	// AVX2 requires CPU support (CPUID.7.0:EBX.AVX2[bit 5]),
+	// and OS support for saving of ymm registers (OSXSAVE and XCR0 bits 1 and 2)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	if((info[2] & (1<<27)) == 0 || (info[2] & (1<<28)) == 0)
+		return false;
+	if((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1<<5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+
+static bool isSSSE3Supported()
+{
+#if defined(_MSC_VER)
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1<<9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+#endif
+
+
+BmpWriter::Method BmpWriter::bestMethod()
+{
+#if defined(BMP_WRITER_X86)
+	static const Method m =
+		isAVX2Supported() ? Method::AVX2 : isSSSE3Supported() ? Method::SSSE3 : Method::Scalar;
+	return m;
+#else
+	return Method::Scalar;
+#endif
+}
+
+
+const char* BmpWriter::methodName(Method method)
+{
+	switch(method) {
+	case Method::Auto:     return "auto";
+	case Method::PerPixel: return "per-pixel";
+	case Method::Scalar:   return "scalar";
+	case Method::SSSE3:    return "ssse3";
+	case Method::AVX2:     return "avx2";
+	}
+	return "unknown";
+}
+
+
+BmpWriter::Method BmpWriter::methodFromName(const char* name)
+{
+	for(Method m : { Method::Auto, Method::PerPixel, Method::Scalar, Method::SSSE3, Method::AVX2 })
+		if(strcmp(name, methodName(m)) == 0)
+			return m;
+	throw invalid_argument(string("Unknown bmp writer method: ") + name + ".");
+}
+
+
+void BmpWriter::convertRow(const void* src, void* dst, size_t numPixels, Method method)
+{
+	switch(method) {
+#if defined(BMP_WRITER_X86)
+	case Method::AVX2:
+		convertRowAVX2(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), numPixels);
+		break;
+	case Method::SSSE3:
+		convertRowSSSE3(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), numPixels);
+		break;
+#endif
+	default:
+		convertRowScalar(reinterpret_cast<const uint8_t*>(src), reinterpret_cast<uint8_t*>(dst), numPixels);
+	}
+}
+
+
+void BmpWriter::storeHeaders(void* dst, uint32_t width, uint32_t height)
+{
+	// image data size and file size
+	// (the size fields of bmp headers are only 32-bit; for bigger images,
+	// we set them to zero which is allowed for uncompressed images)
+	uint64_t imageDataSize = uint64_t(width)*height*4;
+	uint64_t fileSize = imageDataSize+imageDataOffset;
+	if(fileSize > UINT32_MAX) {
+		imageDataSize = 0;
+		fileSize = 0;
+	}
+
+	// store BitmapFileHeader
+	BitmapFileHeader bitmapFileHeader = {
+		0x4d42,
+		uint16_t(fileSize&0xffff),
+		uint16_t(fileSize>>16),
+		0, 0,
+		imageDataOffset,
+		0
+	};
+	memcpy(dst, &bitmapFileHeader, sizeof(BitmapFileHeader));
+
+	// store BitmapInfoHeader and two bytes of alignment
+	BitmapInfoHeader bitmapInfoHeader = {
+		40,
+		int32_t(width),
+		-int32_t(height),
+		1, 32, 0,
+		uint32_t(imageDataSize),
+		2835, 2835,  // roughly 72 DPI
+		0, 0
+	};
+	uint8_t* p = reinterpret_cast<uint8_t*>(dst) + sizeof(BitmapFileHeader);
+	memcpy(p, &bitmapInfoHeader, sizeof(BitmapInfoHeader));
+	memset(p + sizeof(BitmapInfoHeader), 0, 2);
+}
+
+
+void BmpWriter::open(const string& fileName, uint32_t width, uint32_t height, Method method, PixelOrder pixelOrder)
+{
+	if(_stream.is_open())
+		close();
+
+	// select method
+	if(method == Method::Auto)
+		method = bestMethod();
+#if !defined(BMP_WRITER_X86)
+	if(method == Method::SSSE3 || method == Method::AVX2)
+		throw runtime_error(string("Bmp writer method ") + methodName(method) + " is not supported on this platform.");
+#endif
+
+	_fileName = fileName;
+	_width = width;
+	_height = height;
+	_method = method;
+	_pixelOrder = pixelOrder;
+	_bytesWritten = 0;
+	_writeTime = 0.;
+
+	// allocate block buffer
+	// (it is aligned to page size and it is at least one row long)
+	_blockCapacity = max(minBlockSize, (size_t(width)*4 + blockAlignment - 1) & ~(blockAlignment - 1));
+	_blockStorage.resize(_blockCapacity + blockAlignment);
+	_block = reinterpret_cast<uint8_t*>(
+		(reinterpret_cast<uintptr_t>(_blockStorage.data()) + blockAlignment - 1) & ~uintptr_t(blockAlignment - 1));
+	_blockSize = 0;
+	_band = false;
+	_bandBytesStaged = 0;
+
+	// open the output file
+	_stream.open(fileName, fstream::out | fstream::binary | fstream::trunc);
+	if(!_stream)
+		throw runtime_error("Failed to open \"" + fileName + "\".");
+
+	// write headers
+	array<char,imageDataOffset> headers;
+	storeHeaders(headers.data(), width, height);
+	_stream.write(headers.data(), headers.size());
+	_filePos = imageDataOffset;
+	_blockFilePos = imageDataOffset;
+}
+
+
+void BmpWriter::writeRect(const void* data, size_t rowPitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	auto startTime = chrono::steady_clock::now();
+
+	const uint8_t* rowPtr = reinterpret_cast<const uint8_t*>(data);
+	size_t rowSize = size_t(width)*4;
+
+	if(_pixelOrder == PixelOrder::BGRA && x == 0 && width == _width && rowPitch == rowSize) {
+
+		// write all the rows at once
+		// (the data are already in bmp byte order and they are continuous both in the memory and in the file)
+		flushBlock();
+		uint64_t pos = imageDataOffset + uint64_t(y) * _width * 4;
+		if(pos != _filePos)
+			_stream.seekp(streamoff(pos));
+		_stream.write(reinterpret_cast<const char*>(rowPtr), streamsize(rowSize) * height);
+		_filePos = pos + uint64_t(rowSize) * height;
+		_blockFilePos = _filePos;
+
+	}
+	else if(_method == Method::PerPixel && _pixelOrder == PixelOrder::RGBA) {
+
+		// write pixel by pixel
+		// (this is the simplest approach, kept for the comparison)
+		flushBlock();
+		char b[4];
+		for(uint32_t r=0; r<height; r++) {
+			uint64_t pos = imageDataOffset + ((uint64_t(y)+r) * _width + x) * 4;
+			if(pos != _filePos)
+				_stream.seekp(streamoff(pos));
+			for(size_t i=0; i<rowSize; i+=4) {
+				b[0] = rowPtr[i+2];
+				b[1] = rowPtr[i+1];
+				b[2] = rowPtr[i+0];
+				b[3] = rowPtr[i+3];
+				_stream.write(b, 4);
+			}
+			_filePos = pos + rowSize;
+			rowPtr += rowPitch;
+		}
+		_blockFilePos = _filePos;
+
+	}
+	else if(width < _width && uint64_t(_width) * height * 4 <= maxBandSize) {
+
+		// stage the rectangle in the band of whole image rows
+		// (the rectangles of one tile row cover the band and the band is continuous in the file,
+		// so it is written at once when all the rectangles are staged; the band is started again
+		// when the rectangle does not fit into the current one)
+		size_t bandRowSize = size_t(_width)*4;
+		uint64_t pos = imageDataOffset + uint64_t(y) * bandRowSize;
+		if(!_band || pos < _blockFilePos || pos + uint64_t(height) * bandRowSize > _blockFilePos+_blockSize) {
+			flushBlock();
+			reserveBlock(size_t(height) * bandRowSize);
+			_blockFilePos = pos;
+			_blockSize = size_t(height) * bandRowSize;
+			_band = true;
+		}
+		uint8_t* dstPtr = _block + size_t(pos - _blockFilePos) + size_t(x)*4;
+		for(uint32_t r=0; r<height; r++) {
+			if(_pixelOrder == PixelOrder::BGRA)
+				memcpy(dstPtr, rowPtr, rowSize);
+			else
+				convertRow(rowPtr, dstPtr, width, _method);
+			dstPtr += bandRowSize;
+			rowPtr += rowPitch;
+		}
+		_bandBytesStaged += rowSize * height;
+		if(_bandBytesStaged >= _blockSize)
+			flushBlock();
+
+	}
+	else {
+
+		// convert rows into the block buffer
+		// (the block is flushed when it is full or when the next row does not follow
+		// the block data in the file)
+		if(_band)
+			flushBlock();
+		for(uint32_t r=0; r<height; r++) {
+			uint64_t pos = imageDataOffset + ((uint64_t(y)+r) * _width + x) * 4;
+			if(pos != _blockFilePos+_blockSize || _blockSize+rowSize > _blockCapacity) {
+				flushBlock();
+				_blockFilePos = pos;
+			}
+			if(_pixelOrder == PixelOrder::BGRA)
+				memcpy(_block+_blockSize, rowPtr, rowSize);
+			else
+				convertRow(rowPtr, _block+_blockSize, width, _method);
+			_blockSize += rowSize;
+			rowPtr += rowPitch;
+		}
+
+	}
+
+	if(!_stream)
+		throw runtime_error("Failed to write \"" + _fileName + "\".");
+	_bytesWritten += uint64_t(rowSize) * height;
+	_writeTime += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+}
+
+
+void BmpWriter::reserveBlock(size_t size)
+{
+	if(size <= _blockCapacity)
+		return;
+
+	// enlarge block buffer
+	// (the block must be empty, so no data are copied)
+	_blockCapacity = (size + blockAlignment - 1) & ~(blockAlignment - 1);
+	_blockStorage.clear();
+	_blockStorage.resize(_blockCapacity + blockAlignment);
+	_block = reinterpret_cast<uint8_t*>(
+		(reinterpret_cast<uintptr_t>(_blockStorage.data()) + blockAlignment - 1) & ~uintptr_t(blockAlignment - 1));
+}
+
+
+void BmpWriter::flushBlock()
+{
+	_band = false;
+	_bandBytesStaged = 0;
+	if(_blockSize == 0)
+		return;
+
+	if(_blockFilePos != _filePos)
+		_stream.seekp(streamoff(_blockFilePos));
+	_stream.write(reinterpret_cast<char*>(_block), streamsize(_blockSize));
+	_filePos = _blockFilePos + _blockSize;
+	_blockFilePos = _filePos;
+	_blockSize = 0;
+}
+
+
+void BmpWriter::close()
+{
+	if(!_stream.is_open())
+		return;
+
+	auto startTime = chrono::steady_clock::now();
+	flushBlock();
+	_stream.close();
+	_writeTime += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	_blockStorage.clear();
+	_blockStorage.shrink_to_fit();
+	_block = nullptr;
+	if(!_stream)
+		throw runtime_error("Failed to write \"" + _fileName + "\".");
+}
@@ -1,13 +1,39 @@
+#include "BmpWriter.h"
 #include <vulkan/vulkan.hpp>
 #include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <iostream>
-#include <memory>
+#include <limits>
+#include <sstream>
 
 using namespace std;
 
 // constants
-static const vk::Extent2D imageExtent(128, 128);
+constexpr const char* appName = "06-simpleImage";
+constexpr const char* calibrationCacheFileName = "06-simpleImage-calibration.txt";
+constexpr const int numCalibrationRuns = 5;
+
+// image size and method used to write the image data
+// (they can be changed by command-line arguments)
+static vk::Extent2D imageExtent(128, 128);
+static BmpWriter::Method writerMethod = BmpWriter::Method::Auto;
+
+// framebuffer format
+// (B8G8R8A8 format is used when supported, so the rendered data are already
+// in bmp byte order and no swizzle is needed on the host)
+static vk::Format framebufferFormat = vk::Format::eR8G8B8A8Unorm;
+static BmpWriter::PixelOrder pixelOrder = BmpWriter::PixelOrder::RGBA;
+
+// render path
+// (Linear path renders directly into linear-tiled host-visible image,
+// Optimal path renders into optimal-tiled image and copies it into host-visible buffer,
+// Auto uses the faster one; it is found by calibration and cached on the disk)
+enum class RenderPath { Auto, Linear, Optimal };
+static RenderPath renderPath = RenderPath::Auto;
+static bool forceCalibration = false;
 
 
 // Vulkan instance
@@ -22,38 +48,384 @@ static uint32_t graphicsQueueFamily;
 static vk::UniqueDevice device;
 static vk::Queue graphicsQueue;
 static vk::UniqueRenderPass renderPass;
+static vk::UniqueCommandPool commandPool;
+static vk::UniqueFence renderingFinishedFence;
 static vk::UniqueImage framebufferImage;
 static vk::UniqueDeviceMemory framebufferImageMemory;
+static vk::UniqueBuffer readbackBuffer;
+static vk::UniqueDeviceMemory readbackBufferMemory;
 static vk::UniqueImageView frameImageView;
 static vk::UniqueFramebuffer framebuffer;
-static vk::UniqueCommandPool commandPool;
 static vk::UniqueCommandBuffer commandBuffer;
-static vk::UniqueFence renderingFinishedFence;
+
+// mapped memory and its layout
+// (it points either to the linear framebufferImage or to the readbackBuffer)
+static const char* mappedMemory = nullptr;
+static vk::SubresourceLayout mappedLayout;
+
+
+static const char* renderPathName(RenderPath path)
+{
+	switch(path) {
+	case RenderPath::Auto:    return "auto";
+	case RenderPath::Linear:  return "linear";
+	case RenderPath::Optimal: return "optimal";
+	}
+	return "unknown";
+}
+
+
+static vk::UniqueDeviceMemory allocateMemory(vk::MemoryRequirements memoryRequirements, vk::MemoryPropertyFlags requiredFlags)
+{
+	vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+	for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+		if(memoryRequirements.memoryTypeBits & (1<<i))
+			if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
+				return
+					device->allocateMemoryUnique(
+						vk::MemoryAllocateInfo(
+							memoryRequirements.size,  // allocationSize
+							i                         // memoryTypeIndex
+						)
+					);
+	throw std::runtime_error("No suitable memory type found.");
+}
+
+
+/// creates the framebuffer and readback resources of the given path and records the command buffer
+static void createResources(RenderPath path)
+{
+	// release previous resources
+	commandBuffer.reset();
+	framebuffer.reset();
+	frameImageView.reset();
+	readbackBufferMemory.reset();
+	readbackBuffer.reset();
+	framebufferImageMemory.reset();
+	framebufferImage.reset();
+	mappedMemory = nullptr;
+
+	// framebuffer image
+	// (linear path renders directly into linear host-visible image)
+	bool linear = (path == RenderPath::Linear);
+	framebufferImage =
+		device->createImageUnique(
+			vk::ImageCreateInfo(
+				vk::ImageCreateFlags(),       // flags
+				vk::ImageType::e2D,           // imageType
+				framebufferFormat,            // format
+				vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
+				1,                            // mipLevels
+				1,                            // arrayLayers
+				vk::SampleCountFlagBits::e1,  // samples
+				linear ? vk::ImageTiling::eLinear : vk::ImageTiling::eOptimal,  // tiling
+				linear ? vk::ImageUsageFlags(vk::ImageUsageFlagBits::eColorAttachment)
+				       : vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
+				vk::SharingMode::eExclusive,  // sharingMode
+				0,                            // queueFamilyIndexCount
+				nullptr,                      // pQueueFamilyIndices
+				vk::ImageLayout::eUndefined   // initialLayout
+			)
+		);
+	framebufferImageMemory =
+		allocateMemory(device->getImageMemoryRequirements(framebufferImage.get()),
+		               linear ? vk::MemoryPropertyFlagBits::eHostVisible : vk::MemoryPropertyFlagBits::eDeviceLocal);
+	device->bindImageMemory(
+		framebufferImage.get(),        // image
+		framebufferImageMemory.get(),  // memory
+		0                              // memoryOffset
+	);
+
+	if(linear) {
+
+		// map image memory
+		// (the memory stays mapped until it is freed)
+		mappedMemory = reinterpret_cast<const char*>(
+			device->mapMemory(framebufferImageMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+
+		// get image memory layout
+		mappedLayout =
+			device->getImageSubresourceLayout(
+				framebufferImage.get(),  // image
+				vk::ImageSubresource{    // subresource
+					vk::ImageAspectFlagBits::eColor,  // aspectMask
+					0,  // mipLevel
+					0   // arrayLayer
+				}
+			);
+
+	}
+	else {
+
+		// readback buffer
+		// (optimal path copies the image into the buffer with tightly packed rows)
+		vk::DeviceSize size = vk::DeviceSize(imageExtent.width) * imageExtent.height * 4;
+		readbackBuffer =
+			device->createBufferUnique(
+				vk::BufferCreateInfo(
+					vk::BufferCreateFlags(),  // flags
+					size,                     // size
+					vk::BufferUsageFlagBits::eTransferDst,  // usage
+					vk::SharingMode::eExclusive,  // sharingMode
+					0,        // queueFamilyIndexCount
+					nullptr   // pQueueFamilyIndices
+				)
+			);
+		readbackBufferMemory =
+			allocateMemory(device->getBufferMemoryRequirements(readbackBuffer.get()), vk::MemoryPropertyFlagBits::eHostVisible);
+		device->bindBufferMemory(
+			readbackBuffer.get(),        // buffer
+			readbackBufferMemory.get(),  // memory
+			0                            // memoryOffset
+		);
+
+		// map buffer memory
+		// (the memory stays mapped until it is freed)
+		mappedMemory = reinterpret_cast<const char*>(
+			device->mapMemory(readbackBufferMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+		mappedLayout = vk::SubresourceLayout(0, size, vk::DeviceSize(imageExtent.width) * 4, 0, 0);
+
+	}
+
+	// image view
+	frameImageView =
+		device->createImageViewUnique(
+			vk::ImageViewCreateInfo(
+				vk::ImageViewCreateFlags(),  // flags
+				framebufferImage.get(),      // image
+				vk::ImageViewType::e2D,      // viewType
+				framebufferFormat,           // format
+				vk::ComponentMapping(),      // components
+				vk::ImageSubresourceRange(   // subresourceRange
+					vk::ImageAspectFlagBits::eColor,  // aspectMask
+					0,  // baseMipLevel
+					1,  // levelCount
+					0,  // baseArrayLayer
+					1   // layerCount
+				)
+			)
+		);
+
+	// framebuffers
+	framebuffer =
+		device->createFramebufferUnique(
+			vk::FramebufferCreateInfo(
+				vk::FramebufferCreateFlags(),  // flags
+				renderPass.get(),              // renderPass
+				1,&frameImageView.get(),       // attachmentCount, pAttachments
+				imageExtent.width,             // width
+				imageExtent.height,            // height
+				1  // layers
+			)
+		);
+
+	// allocate command buffer
+	commandBuffer = std::move(
+		device->allocateCommandBuffersUnique(
+			vk::CommandBufferAllocateInfo(
+				commandPool.get(),                 // commandPool
+				vk::CommandBufferLevel::ePrimary,  // level
+				1                                  // commandBufferCount
+			)
+		)[0]);
+
+	// begin command buffer
+	// (the command buffer is submitted repeatedly during the calibration)
+	commandBuffer->begin(
+		vk::CommandBufferBeginInfo(
+			vk::CommandBufferUsageFlags(),  // flags
+			nullptr  // pInheritanceInfo
+		)
+	);
+
+	// begin render pass
+	commandBuffer->beginRenderPass(
+		vk::RenderPassBeginInfo(
+			renderPass.get(),   // renderPass
+			framebuffer.get(),  // framebuffer
+			vk::Rect2D(vk::Offset2D(0,0), imageExtent),  // renderArea
+			1,      // clearValueCount
+			array{  // pClearValues
+				vk::ClearValue(array<float,4>{0.f,1.f,0.f,1.f}),
+			}.data()
+		),
+		vk::SubpassContents::eInline
+	);
+
+	// end render pass
+	commandBuffer->endRenderPass();
+
+	// copy framebufferImage to readbackBuffer
+	if(!linear)
+		commandBuffer->copyImageToBuffer(
+			framebufferImage.get(), vk::ImageLayout::eGeneral,  // srcImage, srcImageLayout
+			readbackBuffer.get(),  // dstBuffer
+			vk::BufferImageCopy(  // regions
+				0,  // bufferOffset
+				0,  // bufferRowLength
+				0,  // bufferImageHeight
+				vk::ImageSubresourceLayers(  // imageSubresource
+					vk::ImageAspectFlagBits::eColor,  // aspectMask
+					0,  // mipLevel
+					0,  // baseArrayLayer
+					1   // layerCount
+				),
+				vk::Offset3D(0,0,0),  // imageOffset
+				vk::Extent3D(imageExtent.width, imageExtent.height, 1)  // imageExtent
+			)
+		);
+
+	// make the data available to the host
+	commandBuffer->pipelineBarrier(
+		vk::PipelineStageFlagBits::eColorAttachmentOutput | vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+		vk::PipelineStageFlagBits::eHost,  // dstStageMask
+		vk::DependencyFlags(),  // dependencyFlags
+		vk::MemoryBarrier(  // memoryBarriers
+			vk::AccessFlagBits::eColorAttachmentWrite | vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+			vk::AccessFlagBits::eHostRead  // dstAccessMask
+		),
+		nullptr,  // bufferMemoryBarriers
+		nullptr   // imageMemoryBarriers
+	);
+
+	// end command buffer
+	commandBuffer->end();
+}
+
+
+/// submits the command buffer and waits for its completion
+static void renderImage()
+{
+	// submit work
+	graphicsQueue.submit(
+		vk::SubmitInfo(  // submits
+			0, nullptr, nullptr,       // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
+			1, &commandBuffer.get(),   // commandBufferCount, pCommandBuffers
+			0, nullptr                 // signalSemaphoreCount, pSignalSemaphores
+		),
+		renderingFinishedFence.get()  // fence
+	);
+
+	// wait for the work
+	vk::Result r = device->waitForFences(
+		renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
+		VK_TRUE,       // waitAll
+		uint64_t(3e9)  // timeout (3s)
+	);
+	if(r == vk::Result::eTimeout)
+		throw std::runtime_error("GPU timeout. Task is probably hanging.");
+	device->resetFences(renderingFinishedFence.get());
+
+	// invalidate caches to fetch a new content
+	// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
+	device->invalidateMappedMemoryRanges(
+		vk::MappedMemoryRange(
+			readbackBufferMemory ? readbackBufferMemory.get() : framebufferImageMemory.get(),  // memory
+			0,  // offset
+			VK_WHOLE_SIZE  // size
+		)
+	);
+}
+
+
+/// measures the time of rendering and reading the image by the given path
+static double measureRenderPath(RenderPath path)
+{
+	createResources(path);
+
+	// render the image several times and take the best time
+	// (the time includes the host read of the data, as reading from uncached memory might be slow)
+	vector<char> hostCopy(size_t(imageExtent.width) * imageExtent.height * 4);
+	size_t rowSize = size_t(imageExtent.width) * 4;
+	double bestTime = numeric_limits<double>::max();
+	for(int i=0; i<numCalibrationRuns; i++) {
+		auto startTime = chrono::steady_clock::now();
+		renderImage();
+		for(uint32_t y=0; y<imageExtent.height; y++)
+			memcpy(hostCopy.data() + y*rowSize, mappedMemory + mappedLayout.offset + y*mappedLayout.rowPitch, rowSize);
+		bestTime = min(bestTime, chrono::duration<double>(chrono::steady_clock::now() - startTime).count());
+	}
+	return bestTime;
+}
 
 
 /// main function of the application
-int main(int, char**)
+int main(int argc, char* argv[])
 {
 	// catch exceptions
 	// (vulkan.hpp functions throw if they fail)
 	try {
 
+		// process command-line arguments
+		for(int i=1; i<argc; i++)
+			if(strcmp(argv[i], "--size") == 0 && i+1 < argc &&
+			   sscanf(argv[i+1], "%ux%u", &imageExtent.width, &imageExtent.height) == 2 &&
+			   imageExtent.width != 0 && imageExtent.height != 0)
+				i++;
+			else if(strcmp(argv[i], "--path") == 0 && i+1 < argc &&
+			        (strcmp(argv[i+1], "auto") == 0 || strcmp(argv[i+1], "linear") == 0 ||
+			         strcmp(argv[i+1], "optimal") == 0)) {
+				renderPath = (strcmp(argv[i+1], "auto") == 0) ? RenderPath::Auto :
+				             (strcmp(argv[i+1], "linear") == 0) ? RenderPath::Linear : RenderPath::Optimal;
+				i++;
+			}
+			else if(strcmp(argv[i], "--calibrate") == 0)
+				forceCalibration = true;
+			else if(strcmp(argv[i], "--writer") == 0 && i+1 < argc) {
+				writerMethod = BmpWriter::methodFromName(argv[i+1]);
+				i++;
+			}
+			else {
+				if(strcmp(argv[i], "--help") != 0 && strcmp(argv[i], "-h") != 0)
+					cout << "Unrecognized option: " << argv[i] << endl;
+				cout << appName << " usage:\n"
+				        "   --help or -h:  usage information\n"
+				        "   --size <width>x<height>:  size of the output image,\n"
+				        "                             default: 128x128\n"
+				        "   --path <path>:  linear - render directly into linear image,\n"
+				        "                   optimal - render into optimal image and copy it,\n"
+				        "                   auto - use the faster path found by calibration,\n"
+				        "                   default: auto\n"
+				        "   --calibrate:  perform calibration even if its result is cached\n"
+				        "   --writer <method>:  method used to write the image data,\n"
+				        "                       auto, per-pixel, scalar, ssse3 or avx2,\n"
+				        "                       default: auto\n" << endl;
+				exit(99);
+			}
+
+		// instance extensions
+		// (they are used to get device UUID)
+		vector<const char*> instanceExtensions;
+		auto extensionList = vk::enumerateInstanceExtensionProperties();
+		for(const char* name : { "VK_KHR_get_physical_device_properties2", "VK_KHR_external_memory_capabilities" })
+			for(vk::ExtensionProperties& e : extensionList)
+				if(strcmp(e.extensionName, name) == 0) {
+					instanceExtensions.push_back(name);
+					break;
+				}
+		bool deviceUuidSupported = (instanceExtensions.size() == 2);
+
 		// Vulkan instance
 		instance =
 			vk::createInstanceUnique(
 				vk::InstanceCreateInfo{
 					vk::InstanceCreateFlags(),  // flags
 					&(const vk::ApplicationInfo&)vk::ApplicationInfo{
-						"06-simpleImage",        // application name
+						appName,                 // application name
 						VK_MAKE_VERSION(0,0,0),  // application version
 						nullptr,                 // engine name
 						VK_MAKE_VERSION(0,0,0),  // engine version
 						VK_API_VERSION_1_0,      // api version
 					},
 					0, nullptr,  // no layers
-					0, nullptr,  // no extensions
+					uint32_t(deviceUuidSupported ? 2 : 0),  // enabledExtensionCount
+					instanceExtensions.data(),  // ppEnabledExtensionNames
 				});
 
+		struct InstanceFuncs : vk::DispatchLoaderBase {
+			PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR = PFN_vkGetPhysicalDeviceProperties2KHR(instance->getProcAddr("vkGetPhysicalDeviceProperties2KHR"));
+		} vkFuncs;
+
 		// find compatible devices
 		// (the device must have a queue supporting graphics operations and support for linear tiling)
 		vector<vk::PhysicalDevice> deviceList = instance->enumeratePhysicalDevices();
@@ -117,7 +489,21 @@ int main(int, char**)
 		graphicsQueue = device->getQueue(graphicsQueueFamily, 0);
 
 
+		// framebuffer format
+		// (B8G8R8A8 must support color attachment in both linear and optimal tiling,
+		// as the same render pass is used by both render paths)
+		vk::FormatProperties bgraProperties = physicalDevice.getFormatProperties(vk::Format::eB8G8R8A8Unorm);
+		if((bgraProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment) &&
+		   (bgraProperties.linearTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment))
+		{
+			framebufferFormat = vk::Format::eB8G8R8A8Unorm;
+			pixelOrder = BmpWriter::PixelOrder::BGRA;
+		}
+		cout << "Framebuffer format: " << vk::to_string(framebufferFormat) << endl;
+
 		// render pass
+		// (the image stays in eGeneral layout that is used by both paths,
+		// by host access to linear image and by the copy from optimal image)
 		renderPass =
 			device->createRenderPassUnique(
 				vk::RenderPassCreateInfo(
@@ -126,7 +512,7 @@ int main(int, char**)
 					array{  // pAttachments
 						vk::AttachmentDescription(
 							vk::AttachmentDescriptionFlags(),  // flags
-							vk::Format::eR8G8B8A8Unorm,        // format
+							framebufferFormat,                 // format
 							vk::SampleCountFlagBits::e1,       // samples
 							vk::AttachmentLoadOp::eClear,      // loadOp
 							vk::AttachmentStoreOp::eStore,     // storeOp
@@ -156,88 +542,21 @@ int main(int, char**)
 							nullptr   // pPreserveAttachments
 						),
 					}.data(),
-					0,  // dependencyCount
-					nullptr  // pDependencies
-				)
-			);
-
-		// images
-		framebufferImage =
-			device->createImageUnique(
-				vk::ImageCreateInfo(
-					vk::ImageCreateFlags(),       // flags
-					vk::ImageType::e2D,           // imageType
-					vk::Format::eR8G8B8A8Unorm,   // format
-					vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
-					1,                            // mipLevels
-					1,                            // arrayLayers
-					vk::SampleCountFlagBits::e1,  // samples
-					vk::ImageTiling::eLinear,     // tiling
-					vk::ImageUsageFlagBits::eColorAttachment,  // usage
-					vk::SharingMode::eExclusive,  // sharingMode
-					0,                            // queueFamilyIndexCount
-					nullptr,                      // pQueueFamilyIndices
-					vk::ImageLayout::eUndefined   // initialLayout
-				)
-			);
-
-		// memory for images
-		auto allocateMemory =
-			[](vk::Image image, vk::MemoryPropertyFlags requiredFlags) -> vk::UniqueDeviceMemory{
-				vk::MemoryRequirements memoryRequirements = device->getImageMemoryRequirements(image);
-				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
-				for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
-					if(memoryRequirements.memoryTypeBits & (1<<i))
-						if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
-							return
-								device->allocateMemoryUnique(
-									vk::MemoryAllocateInfo(
-										memoryRequirements.size,  // allocationSize
-										i                         // memoryTypeIndex
-									)
-								);
-				throw std::runtime_error("No suitable memory type found for image.");
-			};
-		framebufferImageMemory = allocateMemory(framebufferImage.get(), vk::MemoryPropertyFlagBits::eHostVisible);
-		device->bindImageMemory(
-			framebufferImage.get(),        // image
-			framebufferImageMemory.get(),  // memory
-			0                              // memoryOffset
-		);
-
-		// image view
-		frameImageView =
-			device->createImageViewUnique(
-				vk::ImageViewCreateInfo(
-					vk::ImageViewCreateFlags(),  // flags
-					framebufferImage.get(),      // image
-					vk::ImageViewType::e2D,      // viewType
-					vk::Format::eR8G8B8A8Unorm,  // format
-					vk::ComponentMapping(),      // components
-					vk::ImageSubresourceRange(   // subresourceRange
-						vk::ImageAspectFlagBits::eColor,  // aspectMask
-						0,  // baseMipLevel
-						1,  // levelCount
-						0,  // baseArrayLayer
-						1   // layerCount
-					)
-				)
-			);
-
-		// framebuffers
-		framebuffer =
-			device->createFramebufferUnique(
-				vk::FramebufferCreateInfo(
-					vk::FramebufferCreateFlags(),  // flags
-					renderPass.get(),              // renderPass
-					1,&frameImageView.get(),       // attachmentCount, pAttachments
-					imageExtent.width,             // width
-					imageExtent.height,            // height
-					1  // layers
+					1,  // dependencyCount
+					array{  // pDependencies
+						vk::SubpassDependency(
+							0,  // srcSubpass
+							VK_SUBPASS_EXTERNAL,  // dstSubpass
+							vk::PipelineStageFlagBits::eColorAttachmentOutput,  // srcStageMask
+							vk::PipelineStageFlagBits::eTransfer,  // dstStageMask
+							vk::AccessFlagBits::eColorAttachmentWrite,  // srcAccessMask
+							vk::AccessFlagBits::eTransferRead,  // dstAccessMask
+							vk::DependencyFlags()  // dependencyFlags
+						),
+					}.data()
 				)
 			);
 
-
 		// command pool
 		commandPool =
 			device->createCommandPoolUnique(
@@ -247,45 +566,6 @@ int main(int, char**)
 				)
 			);
 
-		// allocate command buffer
-		commandBuffer = std::move(
-			device->allocateCommandBuffersUnique(
-				vk::CommandBufferAllocateInfo(
-					commandPool.get(),                 // commandPool
-					vk::CommandBufferLevel::ePrimary,  // level
-					1                                  // commandBufferCount
-				)
-			)[0]);
-
-		// begin command buffer
-		commandBuffer->begin(
-			vk::CommandBufferBeginInfo(
-				vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
-				nullptr  // pInheritanceInfo
-			)
-		);
-
-		// begin render pass
-		commandBuffer->beginRenderPass(
-			vk::RenderPassBeginInfo(
-				renderPass.get(),   // renderPass
-				framebuffer.get(),  // framebuffer
-				vk::Rect2D(vk::Offset2D(0,0), imageExtent),  // renderArea
-				1,      // clearValueCount
-				array{  // pClearValues
-					vk::ClearValue(array<float,4>{0.f,1.f,0.f,1.f}),
-				}.data()
-			),
-			vk::SubpassContents::eInline
-		);
-
-		// end render pass
-		commandBuffer->endRenderPass();
-
-		// end command buffer
-		commandBuffer->end();
-
-
 		// fence
 		renderingFinishedFence =
 			device->createFenceUnique(
@@ -294,126 +574,115 @@ int main(int, char**)
 				}
 			);
 
-		// submit work
-		graphicsQueue.submit(
-			vk::SubmitInfo(  // submits
-				0, nullptr, nullptr,       // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
-				1, &commandBuffer.get(),   // commandBufferCount, pCommandBuffers
-				0, nullptr                 // signalSemaphoreCount, pSignalSemaphores
-			),
-			renderingFinishedFence.get()  // fence
-		);
-
-		// wait for the work
-		vk::Result r = device->waitForFences(
-			renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
-			VK_TRUE,       // waitAll
-			uint64_t(3e9)  // timeout (3s)
-		);
-		if(r == vk::Result::eTimeout)
-			throw std::runtime_error("GPU timeout. Task is probably hanging.");
 
+		// linear path support
+		// (linear tiling must support color attachment and the image size)
+		bool linearSupported =
+			bool(physicalDevice.getFormatProperties(framebufferFormat).linearTilingFeatures &
+			     vk::FormatFeatureFlagBits::eColorAttachment);
+		if(linearSupported) {
+			vk::ImageFormatProperties ifp;
+			vk::Result r = physicalDevice.getImageFormatProperties(
+				framebufferFormat, vk::ImageType::e2D, vk::ImageTiling::eLinear,
+				vk::ImageUsageFlagBits::eColorAttachment, vk::ImageCreateFlags(), &ifp);
+			linearSupported = r == vk::Result::eSuccess &&
+			                  imageExtent.width <= ifp.maxExtent.width && imageExtent.height <= ifp.maxExtent.height;
+		}
+		if(renderPath == RenderPath::Linear && !linearSupported)
+			throw runtime_error("Linear path is not supported by the device for the given image size.");
 
-		// map memory
-		struct MappedMemoryDeleter { void operator()(void*) { device->unmapMemory(framebufferImageMemory.get()); } } mappedMemoryDeleter;
-		unique_ptr<void, MappedMemoryDeleter> m(
-			device->mapMemory(framebufferImageMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()),  // pointer
-			mappedMemoryDeleter  // deleter
-		);
+		// select render path
+		if(renderPath == RenderPath::Auto) {
 
-		// invalidate caches to fetch a new content
-		// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
-		device->invalidateMappedMemoryRanges(
-			vk::MappedMemoryRange(
-				framebufferImageMemory.get(),  // memory
-				0,  // offset
-				VK_WHOLE_SIZE  // size
-			)
-		);
+			if(!linearSupported) {
+				renderPath = RenderPath::Optimal;
+				cout << "Linear path not supported. Using optimal path." << endl;
+			}
+			else {
+
+				// calibration key
+				// (device UUID, driver version and image size;
+				// pipelineCacheUUID is used as device UUID if VkPhysicalDeviceIDProperties is not available)
+				vk::PhysicalDeviceProperties properties = physicalDevice.getProperties();
+				const uint8_t* uuid = properties.pipelineCacheUUID;
+				vk::PhysicalDeviceIDPropertiesKHR idProperties;
+				if(deviceUuidSupported && vkFuncs.vkGetPhysicalDeviceProperties2KHR) {
+					vk::PhysicalDeviceProperties2KHR properties2;
+					properties2.pNext = &idProperties;
+					physicalDevice.getProperties2KHR(&properties2, vkFuncs);
+					uuid = idProperties.deviceUUID;
+				}
+				stringstream keyStream;
+				keyStream << hex;
+				for(size_t i=0; i<VK_UUID_SIZE; i++)
+					keyStream << (uuid[i] >> 4) << (uuid[i] & 0x0f);
+				keyStream << " " << properties.driverVersion << dec << " " << imageExtent.width << "x" << imageExtent.height;
+				string key = keyStream.str();
+
+				// read the calibration cache
+				// (each line contains the key followed by the name of the faster path)
+				vector<string> cacheLines;
+				{
+					ifstream f(calibrationCacheFileName);
+					string line;
+					while(getline(f, line)) {
+						if(line.compare(0, key.size()+1, key + " ") == 0) {
+							string name = line.substr(key.size()+1);
+							if(name == "linear" && !forceCalibration)
+								renderPath = RenderPath::Linear;
+							else if(name == "optimal" && !forceCalibration)
+								renderPath = RenderPath::Optimal;
+							continue;
+						}
+						cacheLines.push_back(line);
+					}
+				}
 
-		// get image memory layout
-		vk::SubresourceLayout framebufferImageLayout=
-			device->getImageSubresourceLayout(
-				framebufferImage.get(),  // image
-				vk::ImageSubresource{    // subresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0   // arrayLayer
+				if(renderPath != RenderPath::Auto)
+					cout << "Using cached calibration result: " << renderPathName(renderPath) << " path" << endl;
+				else {
+
+					// calibrate
+					cout << "Calibrating..." << endl;
+					double linearTime = measureRenderPath(RenderPath::Linear);
+					double optimalTime = measureRenderPath(RenderPath::Optimal);
+					renderPath = (linearTime <= optimalTime) ? RenderPath::Linear : RenderPath::Optimal;
+					cout << "   Linear path:   " << linearTime*1000 << " ms\n"
+					        "   Optimal path:  " << optimalTime*1000 << " ms\n"
+					        "   Selected:      " << renderPathName(renderPath) << " path" << endl;
+
+					// write the calibration cache
+					cacheLines.push_back(key + " " + renderPathName(renderPath));
+					ofstream f(calibrationCacheFileName, ios::out | ios::trunc);
+					for(const string& line : cacheLines)
+						f << line << '\n';
+					if(!f)
+						cout << "Warning: Failed to write \"" << calibrationCacheFileName << "\"." << endl;
 				}
-			);
+			}
+		}
+		else
+			cout << "Using " << renderPathName(renderPath) << " path" << endl;
+
+		// render the image
+		createResources(renderPath);
+		renderImage();
 
 
-		// open the output file
+		// write the image
 		cout << "Writing \"image.bmp\"..." << endl;
-		fstream s("image.bmp", fstream::out | fstream::binary);
-
-		// write BitmapFileHeader
-		struct BitmapFileHeader {
-			uint16_t type = 0x4d42;
-			uint16_t sizeLo;
-			uint16_t sizeHi;
-			uint16_t reserved1 = 0;
-			uint16_t reserved2 = 0;
-			uint16_t offsetLo;
-			uint16_t offsetHi;
-		};
-		static_assert(sizeof(BitmapFileHeader)==14, "Wrong alignment of BitmapFileHeader members.");
-
-		uint32_t imageDataSize = imageExtent.width*imageExtent.height*4;
-		uint32_t fileSize = imageDataSize+14+40+2;
-		BitmapFileHeader bitmapFileHeader = {
-			0x4d42,
-			uint16_t(fileSize&0xffff),
-			uint16_t(fileSize>>16),
-			0, 0,
-			14+40+2,  // equal to sum of sizeof(BitmapFileHeader), sizeof(BitmapInfoHeader) and 2 (as alignment)
-			0
-		};
-		s.write(reinterpret_cast<char*>(&bitmapFileHeader), sizeof(BitmapFileHeader));
-
-		// write BitmapInfoHeader
-		struct BitmapInfoHeader {
-			uint32_t size = 40;
-			int32_t  width;
-			int32_t  height;
-			uint16_t numPlanes = 1;
-			uint16_t bpp = 32;
-			uint32_t compression = 0;  // 0 - no compression
-			uint32_t imageDataSize;
-			int32_t  xPixelsPerMeter;
-			int32_t  yPixelsPerMeter;
-			uint32_t numColorsInPalette = 0;  // no colors in color palette
-			uint32_t numImportantColors = 0;  // all colors are important
-		};
-		static_assert(sizeof(BitmapInfoHeader)==40, "Wrong size of BitmapInfoHeader.");
-
-		BitmapInfoHeader bitmapInfoHeader = {
-			40,
-			int32_t(imageExtent.width),
-			-int32_t(imageExtent.height),
-			1, 32, 0,
-			imageDataSize,
-			2835, 2835,  // roughly 72 DPI
-			0, 0
-		};
-		s.write(reinterpret_cast<char*>(&bitmapInfoHeader), sizeof(BitmapInfoHeader));
-		s.write(array<char,2>{'\0','\0'}.data(), 2);
-
-		// write image data,
-		// line by line
-		const char* linePtr = reinterpret_cast<char*>(m.get());
-		char b[4];
-		for(auto y=imageExtent.height; y>0; y--) {
-			for(size_t i=0, e=imageExtent.width*4; i<e; i+=4) {
-				b[0] = linePtr[i+2];
-				b[1] = linePtr[i+1];
-				b[2] = linePtr[i+0];
-				b[3] = linePtr[i+3];
-				s.write(b, 4);
-			}
-			linePtr += framebufferImageLayout.rowPitch;
-		}
-		cout << "Done." << endl;
+		BmpWriter writer;
+		writer.open("image.bmp", imageExtent.width, imageExtent.height, writerMethod, pixelOrder);
+		writer.writeRows(
+			mappedMemory + mappedLayout.offset,  // data
+			size_t(mappedLayout.rowPitch),  // rowPitch
+			0,  // y
+			imageExtent.height  // numRows
+		);
+		writer.close();
+		cout << "Done. Written " << double(writer.bytesWritten())/(1024*1024) << " MiB in "
+		     << writer.writeTime()*1000 << " ms (" << writer.throughput() << " MB/s, "
+		     << writer.conversionName() << " writer)." << endl;
 
 	// catch exceptions
 	} catch(vk::Error& e) {
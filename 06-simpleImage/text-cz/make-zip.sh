@@ -10,12 +10,12 @@ if test -f $NAME-text.zip; then
 fi
 zip $NAME-text.zip text.html image.bmp
 mkdir tmp
-cp ../main.cpp tmp/
+cp ../main.cpp ../BmpWriter.h ../BmpWriter.cpp tmp/
 echo "cmake_minimum_required(VERSION 3.10.2)" > tmp/CMakeLists.txt
 echo >> tmp/CMakeLists.txt
 cat < ../CMakeLists.txt >> tmp/CMakeLists.txt
 cd tmp
-zip $NAME.zip main.cpp CMakeLists.txt
+zip $NAME.zip main.cpp BmpWriter.h BmpWriter.cpp CMakeLists.txt
 mv $NAME.zip ..
 cmake .
 make
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "BmpWriter.h"
+
+
+/** CompressedWriter is the base class of the writers of compressed image formats.
+ *  The image data are collected into bands of whole rows. The rows might be given in any order
+ *  and by parts, e.g. tile by tile. Each completed band is passed to the pool of worker threads
+ *  that encode the bands in parallel, and the encoded bands are appended to the file in order
+ *  as soon as they are finished. The number of bands in flight is limited,
+ *  so writeRect() blocks when the workers do not keep up. The workers are kept running
+ *  between close() and the next open(), so the writer can be reused for a sequence of images. */
+class CompressedWriter {
+public:
+
+	enum class Format { Qoi, Png };
+	using PixelOrder = BmpWriter::PixelOrder;
+
+protected:
+
+	struct Row {
+		std::vector<uint8_t> data;  // RGBA row
+		uint32_t numPixelsFilled = 0;
+	};
+
+	struct Band {
+		size_t index;
+		uint32_t y;
+		uint32_t numRows;
+		bool last;
+		std::vector<uint8_t> pixels;  // RGBA rows of the band
+		std::vector<uint8_t> context;  // encoder state at the start of the band, provided by prepareBand()
+		std::vector<uint8_t> output;  // encoded data, provided by encodeBand()
+		uint32_t checksum = 0;
+	};
+
+	std::ofstream _stream;
+	std::string _fileName;
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	PixelOrder _pixelOrder = PixelOrder::RGBA;
+
+	// band assembly
+	// (rows are kept in _rows until all their pixels are written;
+	// bands are dispatched in order, starting at row _nextBandRow)
+	std::map<uint32_t, Row> _rows;
+	uint32_t _bandHeight = 0;
+	uint32_t _nextBandRow = 0;
+	size_t _numBandsDispatched = 0;
+
+	// worker pool
+	std::vector<std::thread> _workers;
+	std::mutex _mutex;
+	std::condition_variable _workCondition;
+	std::condition_variable _doneCondition;
+	std::deque<std::unique_ptr<Band>> _pendingBands;
+	std::map<size_t, std::unique_ptr<Band>> _finishedBands;
+	size_t _numBandsInFlight = 0;
+	size_t _maxBandsInFlight = 0;
+	size_t _nextBandToWrite = 0;
+	bool _exitWorkers = false;
+	std::exception_ptr _workerException;
+	std::mutex _writeMutex;
+
+	// statistics
+	uint64_t _bytesEncoded = 0;
+	uint64_t _bytesWritten = 0;
+	double _encodeTime = 0.;
+	double _wallTime = 0.;
+	std::chrono::steady_clock::time_point _openTime;
+
+	// format specific parts
+	// (writeHeader(), prepareBand() and writeTrailer() are called by the thread using the writer,
+	// encodeBand() is called by the workers in parallel and writeBand() is called by one worker at a time
+	// in the band order)
+	virtual void writeHeader() = 0;
+	virtual void prepareBand(Band& band) = 0;
+	virtual void encodeBand(Band& band) = 0;
+	virtual void writeBand(Band& band) = 0;
+	virtual void writeTrailer() = 0;
+
+	void dispatchBands();
+	void writeFinishedBands();
+	void workerMain();
+	void waitForBands(size_t maxBandsInFlight);
+	void stopWorkers();
+	void rethrowWorkerException();
+	void writeData(const void* data, size_t size);
+
+public:
+
+	CompressedWriter() = default;
+	virtual ~CompressedWriter();
+
+	void open(const std::string& fileName, uint32_t width, uint32_t height, PixelOrder pixelOrder = PixelOrder::RGBA,
+	          unsigned numThreads = 0);
+	void writeRows(const void* data, size_t rowPitch, uint32_t y, uint32_t numRows);
+	void writeRect(const void* data, size_t rowPitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+	void close();
+
+	// getters
+	virtual Format format() const = 0;
+	unsigned numThreads() const;
+	uint32_t bandHeight() const;
+	uint64_t bytesEncoded() const;  // size of the raw image data
+	uint64_t bytesWritten() const;  // size of the file
+	double encodeTime() const;  // sum of the encoding times of all the bands, in seconds
+	double wallTime() const;  // from open() to the end of close(), in seconds
+	double compressionRatio() const;
+
+	// formats
+	static std::unique_ptr<CompressedWriter> create(Format format);
+	static bool isSupported(Format format);
+	static const char* formatName(Format format);  // also used as file extension
+	static Format formatFromName(const char* name);
+
+};
+
+
+/** QoiWriter writes files in "Quite OK Image" format.
+ *  QOI encoding is sequential by its nature, because each pixel is encoded
+ *  relative to the previous pixel and to the index of recently seen pixels.
+ *  Both are cheap to compute, so the state at the start of each band is computed
+ *  by prepareBand() while the expensive encoding is done by the workers.
+ *  Pixel runs are terminated at the band ends. */
+class QoiWriter : public CompressedWriter {
+protected:
+	uint32_t _index[64];
+	uint32_t _prevPixel;
+	void writeHeader() override;
+	void prepareBand(Band& band) override;
+	void encodeBand(Band& band) override;
+	void writeBand(Band& band) override;
+	void writeTrailer() override;
+public:
+	~QoiWriter() override;
+	Format format() const override;
+};
+
+
+/** PngWriter writes 32-bit png files.
+ *  The bands are filtered and deflated independently, each band
+ *  ending on byte boundary by sync flush, so the compressed bands can be simply
+ *  concatenated into a single zlib stream (the approach used by pigz).
+ *  Adler-32 checksums of the bands are combined in the band order.
+ *  Zlib is needed; without it, the writer is not supported. */
+class PngWriter : public CompressedWriter {
+protected:
+	std::vector<uint8_t> _prevRow;
+	uint32_t _adler;
+	void writeHeader() override;
+	void prepareBand(Band& band) override;
+	void encodeBand(Band& band) override;
+	void writeBand(Band& band) override;
+	void writeTrailer() override;
+	void writeChunk(const char* type, const void* data, size_t size);
+public:
+	~PngWriter() override;
+	Format format() const override;
+};
+
+
+// inline methods
+inline CompressedWriter::~CompressedWriter()  { stopWorkers(); }
+inline void CompressedWriter::writeRows(const void* data, size_t rowPitch, uint32_t y, uint32_t numRows)  { writeRect(data, rowPitch, 0, y, _width, numRows); }
+inline unsigned CompressedWriter::numThreads() const  { return unsigned(_workers.size()); }
+inline uint32_t CompressedWriter::bandHeight() const  { return _bandHeight; }
+inline uint64_t CompressedWriter::bytesEncoded() const  { return _bytesEncoded; }
+inline uint64_t CompressedWriter::bytesWritten() const  { return _bytesWritten; }
+inline double CompressedWriter::encodeTime() const  { return _encodeTime; }
+inline double CompressedWriter::wallTime() const  { return _wallTime; }
+inline double CompressedWriter::compressionRatio() const  { return _bytesWritten>0 ? double(_bytesEncoded)/_bytesWritten : 0.; }
+inline QoiWriter::~QoiWriter()  { if(_stream.is_open()) { try { close(); } catch(...) {} } stopWorkers(); }
+inline CompressedWriter::Format QoiWriter::format() const  { return Format::Qoi; }
+inline PngWriter::~PngWriter()  { if(_stream.is_open()) { try { close(); } catch(...) {} } stopWorkers(); }
+inline CompressedWriter::Format PngWriter::format() const  { return Format::Png; }
@@ -1,13 +1,47 @@
+#include "BmpWriter.h"
+#include "CompressedWriter.h"
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <array>
-#include <fstream>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
 using namespace std;
 
 // constants
-static const vk::Extent2D imageExtent(128, 128);
+constexpr const char* appName = "07-robustImage";
+constexpr const size_t numTileSlots = 2;  // number of tiles being processed simultaneously
+
+// image size and the maximum tile size
+// (they can be changed by command-line arguments)
+static vk::Extent2D imageExtent(128, 128);
+static uint32_t maxTileSize = 4096;
+static BmpWriter::Method writerMethod = BmpWriter::Method::Auto;
+
+// output format
+// (bmp is written by BmpWriter or directly by the GPU in zero-copy path,
+// qoi and png are encoded by CompressedWriter on all the cores)
+static bool compressedOutput = false;
+static CompressedWriter::Format compressedFormat = CompressedWriter::Format::Qoi;
+
+// framebuffer format
+// (B8G8R8A8 format is used when supported, so the rendered data are already
+// in bmp byte order and no swizzle is needed on the host)
+static vk::Format framebufferFormat = vk::Format::eR8G8B8A8Unorm;
+static BmpWriter::PixelOrder pixelOrder = BmpWriter::PixelOrder::RGBA;
+
+// readback path
+// (Image path copies the rendered image into linear host-visible image,
+// Buffer path copies it into host-visible buffer with tightly packed rows,
+// ZeroCopy path copies it directly into the memory mapped output file
+// imported using VK_EXT_external_memory_host;
+// compare mode renders the image by Image and by Buffer path and reports both)
+enum class ReadbackPath { Image, Buffer, ZeroCopy };
+static ReadbackPath readbackPath = ReadbackPath::Image;
+static bool compareReadbackPaths = false;
 
 
 // Vulkan instance
@@ -19,42 +53,147 @@ static vk::UniqueInstance instance;
 // because they are destructed from the last one to the first one)
 static vk::PhysicalDevice physicalDevice;
 static uint32_t graphicsQueueFamily;
+static BmpFileMapping outputMapping;
 static vk::UniqueDevice device;
 static vk::Queue graphicsQueue;
 static vk::UniqueRenderPass renderPass;
-static vk::UniqueImage framebufferImage;
-static vk::UniqueImage hostVisibleImage;
-static vk::UniqueDeviceMemory framebufferImageMemory;
-static vk::UniqueDeviceMemory hostVisibleImageMemory;
-static vk::UniqueImageView frameImageView;
-static vk::UniqueFramebuffer framebuffer;
 static vk::UniqueCommandPool commandPool;
-static vk::UniqueCommandBuffer commandBuffer;
-static vk::UniqueFence renderingFinishedFence;
+static vk::UniqueQueryPool timestampPool;
+static vk::UniqueDeviceMemory zeroCopyMemory;
+static vk::UniqueBuffer zeroCopyBuffer;
+
+// extension functions
+static struct VkFuncs : vk::DispatchLoaderBase {
+	PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR = nullptr;
+	PFN_vkGetMemoryHostPointerPropertiesEXT vkGetMemoryHostPointerPropertiesEXT = nullptr;
+} vkFuncs;
+
+// resources of a single tile
+// (the image is rendered by tiles; each tile is rendered into the framebufferImage,
+// copied into the hostVisibleImage or hostVisibleBuffer and streamed into the output file;
+// numTileSlots of them are used, so the next tile is rendered
+// while the previous one is being written into the file)
+struct TileSlot {
+	vk::UniqueImage framebufferImage;
+	vk::UniqueImage hostVisibleImage;
+	vk::UniqueBuffer hostVisibleBuffer;
+	vk::UniqueDeviceMemory framebufferImageMemory;
+	vk::UniqueDeviceMemory hostVisibleMemory;
+	vk::UniqueImageView frameImageView;
+	vk::UniqueFramebuffer framebuffer;
+	vk::UniqueCommandBuffer commandBuffer;
+	vk::UniqueFence renderingFinishedFence;
+	const char* mappedMemory = nullptr;
+	vk::SubresourceLayout hostLayout;
+	vk::Rect2D tile;
+	bool pending = false;
+};
+static array<TileSlot, numTileSlots> tileSlots;
 
 
 /// main function of the application
-int main(int, char**)
+int main(int argc, char* argv[])
 {
 	// catch exceptions
 	// (vulkan.hpp functions throw if they fail)
 	try {
 
+		// process command-line arguments
+		auto selectFormat =
+			[](const char* name) {
+				compressedOutput = (strcmp(name, "bmp") != 0);
+				if(compressedOutput)
+					compressedFormat = CompressedWriter::formatFromName(name);
+			};
+		for(int i=1; i<argc; i++)
+			if(strcmp(argv[i], "--size") == 0 && i+1 < argc &&
+			   sscanf(argv[i+1], "%ux%u", &imageExtent.width, &imageExtent.height) == 2 &&
+			   imageExtent.width != 0 && imageExtent.height != 0)
+				i++;
+			else if(strcmp(argv[i], "--tile-size") == 0 && i+1 < argc &&
+			        sscanf(argv[i+1], "%u", &maxTileSize) == 1 && maxTileSize != 0)
+				i++;
+			else if(strcmp(argv[i], "--readback") == 0 && i+1 < argc &&
+			        (strcmp(argv[i+1], "image") == 0 || strcmp(argv[i+1], "buffer") == 0 ||
+			         strcmp(argv[i+1], "zero-copy") == 0 || strcmp(argv[i+1], "compare") == 0)) {
+				readbackPath = (strcmp(argv[i+1], "buffer") == 0) ? ReadbackPath::Buffer :
+				               (strcmp(argv[i+1], "zero-copy") == 0) ? ReadbackPath::ZeroCopy : ReadbackPath::Image;
+				compareReadbackPaths = (strcmp(argv[i+1], "compare") == 0);
+				i++;
+			}
+			else if(strcmp(argv[i], "--writer") == 0 && i+1 < argc) {
+				writerMethod = BmpWriter::methodFromName(argv[i+1]);
+				i++;
+			}
+			else if(strcmp(argv[i], "--format") == 0 && i+1 < argc) {
+				selectFormat(argv[i+1]);
+				i++;
+			}
+			else if(strncmp(argv[i], "--format=", 9) == 0)
+				selectFormat(argv[i]+9);
+			else {
+				if(strcmp(argv[i], "--help") != 0 && strcmp(argv[i], "-h") != 0)
+					cout << "Unrecognized option: " << argv[i] << endl;
+				cout << appName << " usage:\n"
+				        "   --help or -h:  usage information\n"
+				        "   --size <width>x<height>:  size of the output image,\n"
+				        "                             default: 128x128\n"
+				        "   --tile-size <n>:  maximum width and height of the tile,\n"
+				        "                     the image bigger than the tile is rendered\n"
+				        "                     tile by tile, default: 4096\n"
+				        "   --readback <path>:  image - copy the rendered image into linear image,\n"
+				        "                       buffer - copy the rendered image into buffer,\n"
+				        "                       zero-copy - copy the rendered image directly\n"
+				        "                       into memory mapped output file,\n"
+				        "                       compare - render the image twice, using image\n"
+				        "                       and buffer path, and report both timings,\n"
+				        "                       default: image\n"
+				        "   --writer <method>:  method used to write the image data,\n"
+				        "                       auto, per-pixel, scalar, ssse3 or avx2,\n"
+				        "                       default: auto\n"
+				        "   --format <format>:  format of the output image, bmp, qoi or png,\n"
+				        "                       qoi and png are encoded in parallel,\n"
+				        "                       default: bmp\n" << endl;
+				exit(99);
+			}
+
+		// compressed formats cannot be written by the GPU
+		if(compressedOutput && readbackPath == ReadbackPath::ZeroCopy) {
+			cout << "Zero-copy readback supports bmp format only. Using buffer readback path." << endl;
+			readbackPath = ReadbackPath::Buffer;
+		}
+
+		// instance extensions
+		// (they are needed by zero-copy path only)
+		vector<const char*> instanceExtensions;
+		if(readbackPath == ReadbackPath::ZeroCopy) {
+			auto extensionList = vk::enumerateInstanceExtensionProperties();
+			for(const char* name : { "VK_KHR_get_physical_device_properties2", "VK_KHR_external_memory_capabilities" })
+				for(vk::ExtensionProperties& e : extensionList)
+					if(strcmp(e.extensionName, name) == 0) {
+						instanceExtensions.push_back(name);
+						break;
+					}
+		}
+
 		// Vulkan instance
 		instance =
 			vk::createInstanceUnique(
 				vk::InstanceCreateInfo{
 					vk::InstanceCreateFlags(),  // flags
 					&(const vk::ApplicationInfo&)vk::ApplicationInfo{
-						"07-robustImage",        // application name
+						appName,                 // application name
 						VK_MAKE_VERSION(0,0,0),  // application version
 						nullptr,                 // engine name
 						VK_MAKE_VERSION(0,0,0),  // engine version
 						VK_API_VERSION_1_0,      // api version
 					},
 					0, nullptr,  // no layers
-					0, nullptr,  // no extensions
+					uint32_t(instanceExtensions.size()),  // enabledExtensionCount
+					instanceExtensions.data(),  // ppEnabledExtensionNames
 				});
+		vkFuncs.vkGetPhysicalDeviceProperties2KHR =
+			PFN_vkGetPhysicalDeviceProperties2KHR(instance->getProcAddr("vkGetPhysicalDeviceProperties2KHR"));
 
 		// find compatible devices
 		// (the device must have a queue supporting graphics operations)
@@ -88,6 +227,49 @@ int main(int, char**)
 		cout << "Using device:\n"
 		        "   " << physicalDevice.getProperties().deviceName << endl;
 
+		// tile size
+		// (the tile must fit into the image and framebuffer limits of the device)
+		vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+		uint32_t tileLimit = min({ maxTileSize, limits.maxImageDimension2D,
+		                           limits.maxFramebufferWidth, limits.maxFramebufferHeight });
+		vk::Extent2D tileExtent(min(imageExtent.width, tileLimit), min(imageExtent.height, tileLimit));
+		uint32_t numTilesX = (imageExtent.width + tileExtent.width - 1) / tileExtent.width;
+		uint32_t numTilesY = (imageExtent.height + tileExtent.height - 1) / tileExtent.height;
+		cout << "Image size: " << imageExtent.width << "x" << imageExtent.height
+		     << ", tile size: " << tileExtent.width << "x" << tileExtent.height
+		     << ", number of tiles: " << numTilesX << "x" << numTilesY << endl;
+
+		// zero-copy support
+		// (it requires VK_EXT_external_memory_host and the import alignment that the file mapping can satisfy;
+		// otherwise, we fall back to the buffer path)
+		vector<const char*> deviceExtensions;
+		vk::DeviceSize importAlignment = 0;
+		if(readbackPath == ReadbackPath::ZeroCopy) {
+			bool externalMemorySupported = false;
+			bool externalMemoryHostSupported = false;
+			auto extensionList = physicalDevice.enumerateDeviceExtensionProperties();
+			for(vk::ExtensionProperties& e : extensionList) {
+				if(strcmp(e.extensionName, "VK_KHR_external_memory") == 0)
+					externalMemorySupported = true;
+				if(strcmp(e.extensionName, "VK_EXT_external_memory_host") == 0)
+					externalMemoryHostSupported = true;
+			}
+			if(externalMemorySupported && externalMemoryHostSupported && instanceExtensions.size() == 2 &&
+			   vkFuncs.vkGetPhysicalDeviceProperties2KHR)
+			{
+				vk::PhysicalDeviceExternalMemoryHostPropertiesEXT externalMemoryHostProperties;
+				vk::PhysicalDeviceProperties2KHR properties2;
+				properties2.pNext = &externalMemoryHostProperties;
+				physicalDevice.getProperties2KHR(&properties2, vkFuncs);
+				importAlignment = externalMemoryHostProperties.minImportedHostPointerAlignment;
+				deviceExtensions = { "VK_KHR_external_memory", "VK_EXT_external_memory_host" };
+			}
+			else {
+				cout << "VK_EXT_external_memory_host not supported. Falling back to buffer readback path." << endl;
+				readbackPath = ReadbackPath::Buffer;
+			}
+		}
+
 		// create device
 		device =
 			physicalDevice.createDeviceUnique(
@@ -103,15 +285,38 @@ int main(int, char**)
 						},
 					}.data(),
 					0, nullptr,  // no layers
-					0, nullptr,  // number of enabled extensions, enabled extension names
+					uint32_t(deviceExtensions.size()),  // enabledExtensionCount
+					deviceExtensions.data(),  // ppEnabledExtensionNames
 					nullptr,     // enabled features
 				}
 			);
+		if(readbackPath == ReadbackPath::ZeroCopy)
+			vkFuncs.vkGetMemoryHostPointerPropertiesEXT =
+				PFN_vkGetMemoryHostPointerPropertiesEXT(device->getProcAddr("vkGetMemoryHostPointerPropertiesEXT"));
 
 		// get queues
 		graphicsQueue = device->getQueue(graphicsQueueFamily, 0);
 
 
+		// framebuffer format
+		// (B8G8R8A8 must support color attachment and, for the image readback path,
+		// linear image of the host visible image usage and the tile size)
+		vk::FormatProperties bgraProperties = physicalDevice.getFormatProperties(vk::Format::eB8G8R8A8Unorm);
+		bool bgraSupported = bool(bgraProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment);
+		if(bgraSupported && readbackPath == ReadbackPath::Image) {
+			vk::ImageFormatProperties ifp;
+			vk::Result r = physicalDevice.getImageFormatProperties(
+				vk::Format::eB8G8R8A8Unorm, vk::ImageType::e2D, vk::ImageTiling::eLinear,
+				vk::ImageUsageFlagBits::eTransferDst, vk::ImageCreateFlags(), &ifp);
+			bgraSupported = r == vk::Result::eSuccess &&
+			                tileExtent.width <= ifp.maxExtent.width && tileExtent.height <= ifp.maxExtent.height;
+		}
+		if(bgraSupported) {
+			framebufferFormat = vk::Format::eB8G8R8A8Unorm;
+			pixelOrder = BmpWriter::PixelOrder::BGRA;
+		}
+		cout << "Framebuffer format: " << vk::to_string(framebufferFormat) << endl;
+
 		// render pass
 		renderPass =
 			device->createRenderPassUnique(
@@ -121,7 +326,7 @@ int main(int, char**)
 					array{  // pAttachments
 						vk::AttachmentDescription(
 							vk::AttachmentDescriptionFlags(),  // flags
-							vk::Format::eR8G8B8A8Unorm,        // format
+							framebufferFormat,                 // format
 							vk::SampleCountFlagBits::e1,       // samples
 							vk::AttachmentLoadOp::eClear,      // loadOp
 							vk::AttachmentStoreOp::eStore,     // storeOp
@@ -166,45 +371,7 @@ int main(int, char**)
 				)
 			);
 
-		// images
-		framebufferImage =
-			device->createImageUnique(
-				vk::ImageCreateInfo(
-					vk::ImageCreateFlags(),       // flags
-					vk::ImageType::e2D,           // imageType
-					vk::Format::eR8G8B8A8Unorm,   // format
-					vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
-					1,                            // mipLevels
-					1,                            // arrayLayers
-					vk::SampleCountFlagBits::e1,  // samples
-					vk::ImageTiling::eOptimal,    // tiling
-					vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
-					vk::SharingMode::eExclusive,  // sharingMode
-					0,                            // queueFamilyIndexCount
-					nullptr,                      // pQueueFamilyIndices
-					vk::ImageLayout::eUndefined   // initialLayout
-				)
-			);
-		hostVisibleImage =
-			device->createImageUnique(
-				vk::ImageCreateInfo(
-					vk::ImageCreateFlags(),       // flags
-					vk::ImageType::e2D,           // imageType
-					vk::Format::eR8G8B8A8Unorm,   // format
-					vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
-					1,                            // mipLevels
-					1,                            // arrayLayers
-					vk::SampleCountFlagBits::e1,  // samples
-					vk::ImageTiling::eLinear,     // tiling
-					vk::ImageUsageFlagBits::eTransferDst,  // usage
-					vk::SharingMode::eExclusive,  // sharingMode
-					0,                            // queueFamilyIndexCount
-					nullptr,                      // pQueueFamilyIndices
-					vk::ImageLayout::eUndefined   // initialLayout
-				)
-			);
-
-		// memory for images
+		// memory allocation function
 		auto allocateMemory =
 			[](vk::Image image, vk::MemoryPropertyFlags requiredFlags) -> vk::UniqueDeviceMemory{
 				vk::MemoryRequirements memoryRequirements = device->getImageMemoryRequirements(image);
@@ -221,278 +388,686 @@ int main(int, char**)
 								);
 				throw std::runtime_error("No suitable memory type found for image.");
 			};
-		framebufferImageMemory = allocateMemory(framebufferImage.get(), vk::MemoryPropertyFlagBits::eDeviceLocal);
-		hostVisibleImageMemory = allocateMemory(hostVisibleImage.get(), vk::MemoryPropertyFlagBits::eHostVisible |
-		                                                                vk::MemoryPropertyFlagBits::eHostCached);
-		device->bindImageMemory(
-			framebufferImage.get(),        // image
-			framebufferImageMemory.get(),  // memory
-			0                              // memoryOffset
-		);
-		device->bindImageMemory(
-			hostVisibleImage.get(),        // image
-			hostVisibleImageMemory.get(),  // memory
-			0                              // memoryOffset
-		);
-
-		// image view
-		frameImageView =
-			device->createImageViewUnique(
-				vk::ImageViewCreateInfo(
-					vk::ImageViewCreateFlags(),  // flags
-					framebufferImage.get(),      // image
-					vk::ImageViewType::e2D,      // viewType
-					vk::Format::eR8G8B8A8Unorm,  // format
-					vk::ComponentMapping(),      // components
-					vk::ImageSubresourceRange(   // subresourceRange
-						vk::ImageAspectFlagBits::eColor,  // aspectMask
-						0,  // baseMipLevel
-						1,  // levelCount
-						0,  // baseArrayLayer
-						1   // layerCount
-					)
-				)
-			);
-
-		// framebuffers
-		framebuffer =
-			device->createFramebufferUnique(
-				vk::FramebufferCreateInfo(
-					vk::FramebufferCreateFlags(),  // flags
-					renderPass.get(),              // renderPass
-					1, &frameImageView.get(),      // attachmentCount, pAttachments
-					imageExtent.width,             // width
-					imageExtent.height,            // height
-					1  // layers
-				)
-			);
-
+		auto allocateBufferMemory =
+			[](vk::Buffer buffer, initializer_list<vk::MemoryPropertyFlags> flagCandidates) -> vk::UniqueDeviceMemory{
+				vk::MemoryRequirements memoryRequirements = device->getBufferMemoryRequirements(buffer);
+				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+				for(vk::MemoryPropertyFlags requiredFlags : flagCandidates)
+					for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+						if(memoryRequirements.memoryTypeBits & (1<<i))
+							if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
+								return
+									device->allocateMemoryUnique(
+										vk::MemoryAllocateInfo(
+											memoryRequirements.size,  // allocationSize
+											i                         // memoryTypeIndex
+										)
+									);
+				throw std::runtime_error("No suitable memory type found for buffer.");
+			};
 
 		// command pool
 		commandPool =
 			device->createCommandPoolUnique(
 				vk::CommandPoolCreateInfo(
-					vk::CommandPoolCreateFlags(),  // flags
-					graphicsQueueFamily            // queueFamilyIndex
+					vk::CommandPoolCreateFlagBits::eResetCommandBuffer,  // flags
+					graphicsQueueFamily  // queueFamilyIndex
 				)
 			);
 
-		// allocate command buffer
-		commandBuffer = std::move(
+		// allocate command buffers
+		vector<vk::UniqueCommandBuffer> commandBuffers =
 			device->allocateCommandBuffersUnique(
 				vk::CommandBufferAllocateInfo(
 					commandPool.get(),                 // commandPool
 					vk::CommandBufferLevel::ePrimary,  // level
-					1                                  // commandBufferCount
+					uint32_t(numTileSlots)             // commandBufferCount
 				)
-			)[0]);
-
-		// begin command buffer
-		commandBuffer->begin(
-			vk::CommandBufferBeginInfo(
-				vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
-				nullptr  // pInheritanceInfo
-			)
-		);
-
-		// begin render pass
-		commandBuffer->beginRenderPass(
-			vk::RenderPassBeginInfo(
-				renderPass.get(),   // renderPass
-				framebuffer.get(),  // framebuffer
-				vk::Rect2D(vk::Offset2D(0,0), imageExtent),  // renderArea
-				1,      // clearValueCount
-				array{  // pClearValues
-					vk::ClearValue(array<float,4>{0.f,1.f,0.f,1.f}),
-				}.data()
-			),
-			vk::SubpassContents::eInline
-		);
-
-		// end render pass
-		commandBuffer->endRenderPass();
-
-
-		// hostVisibleImage layout to eGeneral
-		commandBuffer->pipelineBarrier(
-			vk::PipelineStageFlagBits::eTopOfPipe,  // srcStageMask
-			vk::PipelineStageFlagBits::eTransfer,   // dstStageMask
-			vk::DependencyFlags(),  // dependencyFlags
-			nullptr,  // memoryBarriers
-			nullptr,  // bufferMemoryBarriers
-			vk::ImageMemoryBarrier{  // imageMemoryBarriers
-				vk::AccessFlags(),                   // srcAccessMask
-				vk::AccessFlagBits::eTransferWrite,  // dstAccessMask
-				vk::ImageLayout::eUndefined,         // oldLayout
-				vk::ImageLayout::eGeneral,           // newLayout
-				0,                          // srcQueueFamilyIndex
-				0,                          // dstQueueFamilyIndex
-				hostVisibleImage.get(),     // image
-				vk::ImageSubresourceRange{  // subresourceRange
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // baseMipLevel
-					1,  // levelCount
-					0,  // baseArrayLayer
-					1   // layerCount
-				}
+			);
+
+		// import the memory mapped output file
+		// (the whole file is imported as a single buffer and each tile is copied directly
+		// to its position in the file; if the import fails, we fall back to the buffer path)
+		if(readbackPath == ReadbackPath::ZeroCopy) {
+			try {
+
+				// map the file
+				outputMapping.open(
+					"image.bmp",  // fileName
+					imageExtent.width, imageExtent.height,  // width, height
+					size_t(importAlignment),  // mappingAlignment
+					size_t(max(limits.optimalBufferCopyOffsetAlignment, vk::DeviceSize(4))),  // dataAlignment
+					pixelOrder  // pixelOrder
+				);
+				if(reinterpret_cast<uintptr_t>(outputMapping.mapping()) % importAlignment != 0)
+					throw runtime_error("File mapping does not satisfy minImportedHostPointerAlignment.");
+
+				// buffer
+				zeroCopyBuffer =
+					device->createBufferUnique(
+						vk::BufferCreateInfo(
+							vk::BufferCreateFlags(),  // flags
+							outputMapping.mappingSize(),  // size
+							vk::BufferUsageFlagBits::eTransferDst,  // usage
+							vk::SharingMode::eExclusive,  // sharingMode
+							0,        // queueFamilyIndexCount
+							nullptr   // pQueueFamilyIndices
+						).setPNext(
+							&(const vk::ExternalMemoryBufferCreateInfoKHR&)vk::ExternalMemoryBufferCreateInfoKHR(
+								vk::ExternalMemoryHandleTypeFlagBitsKHR::eHostAllocationEXT  // handleTypes
+							)
+						)
+					);
+
+				// memory type
+				// (it must be compatible with the host pointer and the buffer; coherent memory is required
+				// as the mapping is not accessed through vkMapMemory() and it cannot be invalidated)
+				vk::MemoryHostPointerPropertiesEXT hostPointerProperties =
+					device->getMemoryHostPointerPropertiesEXT(
+						vk::ExternalMemoryHandleTypeFlagBitsKHR::eHostAllocationEXT,  // handleType
+						outputMapping.mapping(),  // pHostPointer
+						vkFuncs  // dispatch
+					);
+				vk::MemoryRequirements memoryRequirements = device->getBufferMemoryRequirements(zeroCopyBuffer.get());
+				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+				uint32_t memoryTypeIndex = UINT32_MAX;
+				for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+					if(hostPointerProperties.memoryTypeBits & memoryRequirements.memoryTypeBits & (1<<i))
+						if(memoryProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eHostCoherent) {
+							memoryTypeIndex = i;
+							break;
+						}
+				if(memoryTypeIndex == UINT32_MAX)
+					throw runtime_error("No suitable memory type found for imported host memory.");
+
+				// import the mapping
+				zeroCopyMemory =
+					device->allocateMemoryUnique(
+						vk::MemoryAllocateInfo(
+							outputMapping.mappingSize(),  // allocationSize
+							memoryTypeIndex               // memoryTypeIndex
+						).setPNext(
+							&(const vk::ImportMemoryHostPointerInfoEXT&)vk::ImportMemoryHostPointerInfoEXT(
+								vk::ExternalMemoryHandleTypeFlagBitsKHR::eHostAllocationEXT,  // handleType
+								outputMapping.mapping()  // pHostPointer
+							)
+						)
+					);
+				device->bindBufferMemory(
+					zeroCopyBuffer.get(),  // buffer
+					zeroCopyMemory.get(),  // memory
+					0                      // memoryOffset
+				);
+
+			} catch(exception& e) {
+				cout << "Zero-copy import failed (" << e.what() << ").\n"
+				        "Falling back to buffer readback path." << endl;
+				zeroCopyBuffer.reset();
+				zeroCopyMemory.reset();
+				outputMapping.close();
+				readbackPath = ReadbackPath::Buffer;
 			}
-		);
-
-		// copy framebufferImage to hostVisibleImage
-		commandBuffer->copyImage(
-			framebufferImage.get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
-			hostVisibleImage.get(), vk::ImageLayout::eGeneral,  // dstImage, dstImageLayout
-			vk::ImageCopy(  // regions
-				vk::ImageSubresourceLayers(  // srcSubresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0,  // baseArrayLayer
-					1   // layerCount
-				),
-				vk::Offset3D(0,0,0),         // srcOffset
-				vk::ImageSubresourceLayers(  // dstSubresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0,  // baseArrayLayer
-					1   // layerCount
-				),
-				vk::Offset3D(0,0,0),         // dstOffset
-				vk::Extent3D(imageExtent.width, imageExtent.height, 1)  // extent
-			)
-		);
-
-		// end command buffer
-		commandBuffer->end();
-
-
-		// fence
-		renderingFinishedFence =
-			device->createFenceUnique(
-				vk::FenceCreateInfo{
-					vk::FenceCreateFlags()  // flags
+		}
+
+		// function to create host visible resources of the tile slot
+		// (they depend on the readback path, so they are created again
+		// when the next readback path is measured in compare mode)
+		auto createHostVisibleResources =
+			[&](TileSlot& slot) {
+
+				// release the resources of the previous readback path
+				slot.mappedMemory = nullptr;
+				slot.hostVisibleImage.reset();
+				slot.hostVisibleBuffer.reset();
+				slot.hostVisibleMemory.reset();
+
+				if(readbackPath == ReadbackPath::Image) {
+
+					// host visible image
+					slot.hostVisibleImage =
+						device->createImageUnique(
+							vk::ImageCreateInfo(
+								vk::ImageCreateFlags(),       // flags
+								vk::ImageType::e2D,           // imageType
+								framebufferFormat,            // format
+								vk::Extent3D(tileExtent.width, tileExtent.height, 1),  // extent
+								1,                            // mipLevels
+								1,                            // arrayLayers
+								vk::SampleCountFlagBits::e1,  // samples
+								vk::ImageTiling::eLinear,     // tiling
+								vk::ImageUsageFlagBits::eTransferDst,  // usage
+								vk::SharingMode::eExclusive,  // sharingMode
+								0,                            // queueFamilyIndexCount
+								nullptr,                      // pQueueFamilyIndices
+								vk::ImageLayout::eUndefined   // initialLayout
+							)
+						);
+
+					// memory for host visible image
+					slot.hostVisibleMemory = allocateMemory(slot.hostVisibleImage.get(), vk::MemoryPropertyFlagBits::eHostVisible |
+					                                                                     vk::MemoryPropertyFlagBits::eHostCached);
+					device->bindImageMemory(
+						slot.hostVisibleImage.get(),   // image
+						slot.hostVisibleMemory.get(),  // memory
+						0                              // memoryOffset
+					);
+
+					// get image memory layout
+					slot.hostLayout =
+						device->getImageSubresourceLayout(
+							slot.hostVisibleImage.get(),  // image
+							vk::ImageSubresource{    // subresource
+								vk::ImageAspectFlagBits::eColor,  // aspectMask
+								0,  // mipLevel
+								0   // arrayLayer
+							}
+						);
+
 				}
-			);
+				else if(readbackPath == ReadbackPath::Buffer) {
+
+					// host visible buffer
+					// (the rows of the tile are tightly packed in the buffer)
+					slot.hostVisibleBuffer =
+						device->createBufferUnique(
+							vk::BufferCreateInfo(
+								vk::BufferCreateFlags(),  // flags
+								vk::DeviceSize(tileExtent.width)*tileExtent.height*4,  // size
+								vk::BufferUsageFlagBits::eTransferDst,  // usage
+								vk::SharingMode::eExclusive,  // sharingMode
+								0,        // queueFamilyIndexCount
+								nullptr   // pQueueFamilyIndices
+							)
+						);
+
+					// memory for host visible buffer
+					// (host cached memory is preferred as the host reads the data)
+					slot.hostVisibleMemory =
+						allocateBufferMemory(
+							slot.hostVisibleBuffer.get(),
+							{ vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached,
+							  vk::MemoryPropertyFlagBits::eHostVisible }
+						);
+					device->bindBufferMemory(
+						slot.hostVisibleBuffer.get(),  // buffer
+						slot.hostVisibleMemory.get(),  // memory
+						0                              // memoryOffset
+					);
+
+					// buffer memory layout
+					// (rowPitch depends on the tile width and it is computed for each tile)
+					slot.hostLayout = vk::SubresourceLayout(0, vk::DeviceSize(tileExtent.width)*tileExtent.height*4, 0, 0, 0);
 
-		// submit work
-		graphicsQueue.submit(
-			vk::SubmitInfo(  // submits
-				0, nullptr, nullptr,       // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
-				1, &commandBuffer.get(),   // commandBufferCount, pCommandBuffers
-				0, nullptr                 // signalSemaphoreCount, pSignalSemaphores
-			),
-			renderingFinishedFence.get()  // fence
-		);
-
-		// wait for the work
-		vk::Result r = device->waitForFences(
-			renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
-			VK_TRUE,       // waitAll
-			uint64_t(3e9)  // timeout (3s)
-		);
-		if(r == vk::Result::eTimeout)
-			throw std::runtime_error("GPU timeout. Task is probably hanging.");
-
-
-		// map memory
-		struct MappedMemoryDeleter { void operator()(void*) { device->unmapMemory(hostVisibleImageMemory.get()); } } mappedMemoryDeleter;
-		unique_ptr<void, MappedMemoryDeleter> m(
-			device->mapMemory(hostVisibleImageMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()),  // pointer
-			mappedMemoryDeleter  // deleter
-		);
-
-		// invalidate caches to fetch a new content
-		// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
-		device->invalidateMappedMemoryRanges(
-			vk::MappedMemoryRange(
-				hostVisibleImageMemory.get(),  // memory
-				0,  // offset
-				VK_WHOLE_SIZE  // size
-			)
-		);
-
-		// get image memory layout
-		vk::SubresourceLayout hostImageLayout =
-			device->getImageSubresourceLayout(
-				hostVisibleImage.get(),  // image
-				vk::ImageSubresource{    // subresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0   // arrayLayer
 				}
+
+				// map memory
+				// (the memory stays mapped until it is freed)
+				if(slot.hostVisibleMemory)
+					slot.mappedMemory = reinterpret_cast<const char*>(
+						device->mapMemory(slot.hostVisibleMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+			};
+
+		// create resources of all tile slots
+		// (the resources have the size of the tile, not the size of the whole image,
+		// so the memory consumption does not depend on the image size)
+		for(size_t slotIndex=0; slotIndex<numTileSlots; slotIndex++) {
+
+			TileSlot& slot = tileSlots[slotIndex];
+
+			// framebuffer image
+			slot.framebufferImage =
+				device->createImageUnique(
+					vk::ImageCreateInfo(
+						vk::ImageCreateFlags(),       // flags
+						vk::ImageType::e2D,           // imageType
+						framebufferFormat,            // format
+						vk::Extent3D(tileExtent.width, tileExtent.height, 1),  // extent
+						1,                            // mipLevels
+						1,                            // arrayLayers
+						vk::SampleCountFlagBits::e1,  // samples
+						vk::ImageTiling::eOptimal,    // tiling
+						vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
+						vk::SharingMode::eExclusive,  // sharingMode
+						0,                            // queueFamilyIndexCount
+						nullptr,                      // pQueueFamilyIndices
+						vk::ImageLayout::eUndefined   // initialLayout
+					)
+				);
+
+			// memory for framebuffer image
+			slot.framebufferImageMemory = allocateMemory(slot.framebufferImage.get(), vk::MemoryPropertyFlagBits::eDeviceLocal);
+			device->bindImageMemory(
+				slot.framebufferImage.get(),        // image
+				slot.framebufferImageMemory.get(),  // memory
+				0                                   // memoryOffset
 			);
 
+			// host visible image or buffer
+			createHostVisibleResources(slot);
+
+			// image view
+			slot.frameImageView =
+				device->createImageViewUnique(
+					vk::ImageViewCreateInfo(
+						vk::ImageViewCreateFlags(),  // flags
+						slot.framebufferImage.get(), // image
+						vk::ImageViewType::e2D,      // viewType
+						framebufferFormat,           // format
+						vk::ComponentMapping(),      // components
+						vk::ImageSubresourceRange(   // subresourceRange
+							vk::ImageAspectFlagBits::eColor,  // aspectMask
+							0,  // baseMipLevel
+							1,  // levelCount
+							0,  // baseArrayLayer
+							1   // layerCount
+						)
+					)
+				);
+
+			// framebuffer
+			slot.framebuffer =
+				device->createFramebufferUnique(
+					vk::FramebufferCreateInfo(
+						vk::FramebufferCreateFlags(),  // flags
+						renderPass.get(),              // renderPass
+						1, &slot.frameImageView.get(), // attachmentCount, pAttachments
+						tileExtent.width,              // width
+						tileExtent.height,             // height
+						1  // layers
+					)
+				);
+
+			// command buffer
+			slot.commandBuffer = std::move(commandBuffers[slotIndex]);
+
+			// fence
+			slot.renderingFinishedFence =
+				device->createFenceUnique(
+					vk::FenceCreateInfo{
+						vk::FenceCreateFlags()  // flags
+					}
+				);
+		}
+
+		// timestamp pool
+		// (three timestamps per tile slot are used to measure the time of the rendering and of the copy)
+		uint32_t timestampValidBits = physicalDevice.getQueueFamilyProperties()[graphicsQueueFamily].timestampValidBits;
+		uint64_t timestampMask = timestampValidBits>=64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+		float timestampPeriod_ns = limits.timestampPeriod;
+		if(timestampValidBits != 0)
+			timestampPool =
+				device->createQueryPoolUnique(
+					vk::QueryPoolCreateInfo(
+						vk::QueryPoolCreateFlags(),  // flags
+						vk::QueryType::eTimestamp,  // queryType
+						uint32_t(numTileSlots*3),  // queryCount
+						vk::QueryPipelineStatisticFlags()  // pipelineStatistics
+					)
+				);
+
+
+		// readback paths to measure
+		// (compare mode renders the image by the image and by the buffer path;
+		// the output file written by the first pass is overwritten by the second one)
+		vector<ReadbackPath> readbackPaths;
+		if(compareReadbackPaths)
+			readbackPaths = { ReadbackPath::Image, ReadbackPath::Buffer };
+		else
+			readbackPaths = { readbackPath };
+		vector<double> passCopyTime;
+		vector<double> passTotalTime;
+		for(ReadbackPath passPath : readbackPaths) {
+
+			// host visible resources of the next readback path
+			if(passPath != readbackPath) {
+				readbackPath = passPath;
+				for(TileSlot& slot : tileSlots)
+					createHostVisibleResources(slot);
+			}
+
+			// open the output file
+			// (zero-copy path has the file already opened and mapped)
+			BmpWriter writer;
+			unique_ptr<CompressedWriter> compressedWriter;
+			if(compressedOutput) {
+				string fileName = string("image.") + CompressedWriter::formatName(compressedFormat);
+				cout << "Writing \"" << fileName << "\"..." << endl;
+				compressedWriter = CompressedWriter::create(compressedFormat);
+				compressedWriter->open(fileName, imageExtent.width, imageExtent.height, pixelOrder);
+			}
+			else {
+				cout << "Writing \"image.bmp\"..." << endl;
+				if(readbackPath != ReadbackPath::ZeroCopy)
+					writer.open("image.bmp", imageExtent.width, imageExtent.height, writerMethod, pixelOrder);
+			}
+
+
+			// readback statistics
+			double renderTime = 0.;
+			double copyTime = 0.;
+			uint64_t copiedBytes = 0;
+			auto startTime = chrono::steady_clock::now();
+
+			// function to record and submit the work of a single tile
+			auto renderTile =
+				[&](TileSlot& slot, const vk::Rect2D& tile) {
+
+					// begin command buffer
+					slot.commandBuffer->begin(
+						vk::CommandBufferBeginInfo(
+							vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
+							nullptr  // pInheritanceInfo
+						)
+					);
+
+					// timestamp before the rendering
+					uint32_t queryIndex = uint32_t(&slot - tileSlots.data()) * 3;
+					if(timestampPool) {
+						slot.commandBuffer->resetQueryPool(timestampPool.get(), queryIndex, 3);
+						slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampPool.get(), queryIndex);
+					}
+
+					// begin render pass
+					// (renderArea covers just the part of the framebuffer that is used by the tile;
+					// the tiles on the right and bottom border might be smaller than the framebuffer)
+					slot.commandBuffer->beginRenderPass(
+						vk::RenderPassBeginInfo(
+							renderPass.get(),        // renderPass
+							slot.framebuffer.get(),  // framebuffer
+							vk::Rect2D(vk::Offset2D(0,0), tile.extent),  // renderArea
+							1,      // clearValueCount
+							array{  // pClearValues
+								vk::ClearValue(array<float,4>{0.f,1.f,0.f,1.f}),
+							}.data()
+						),
+						vk::SubpassContents::eInline
+					);
+
+					// end render pass
+					slot.commandBuffer->endRenderPass();
+
+
+					// timestamp before the copy
+					if(timestampPool)
+						slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eAllCommands, timestampPool.get(), queryIndex+1);
 
-		// open the output file
-		cout << "Writing \"image.bmp\"..." << endl;
-		fstream s("image.bmp", fstream::out | fstream::binary);
-
-		// write BitmapFileHeader
-		struct BitmapFileHeader {
-			uint16_t type = 0x4d42;
-			uint16_t sizeLo;
-			uint16_t sizeHi;
-			uint16_t reserved1 = 0;
-			uint16_t reserved2 = 0;
-			uint16_t offsetLo;
-			uint16_t offsetHi;
-		};
-		static_assert(sizeof(BitmapFileHeader)==14, "Wrong alignment of BitmapFileHeader members.");
-
-		uint32_t imageDataSize = imageExtent.width*imageExtent.height*4;
-		uint32_t fileSize = imageDataSize+14+40+2;
-		BitmapFileHeader bitmapFileHeader = {
-			0x4d42,
-			uint16_t(fileSize&0xffff),
-			uint16_t(fileSize>>16),
-			0, 0,
-			14+40+2,  // equal to sum of sizeof(BitmapFileHeader), sizeof(BitmapInfoHeader) and 2 (as alignment)
-			0
-		};
-		s.write(reinterpret_cast<char*>(&bitmapFileHeader), sizeof(BitmapFileHeader));
-
-		// write BitmapInfoHeader
-		struct BitmapInfoHeader {
-			uint32_t size = 40;
-			int32_t  width;
-			int32_t  height;
-			uint16_t numPlanes = 1;
-			uint16_t bpp = 32;
-			uint32_t compression = 0;  // 0 - no compression
-			uint32_t imageDataSize;
-			int32_t  xPixelsPerMeter;
-			int32_t  yPixelsPerMeter;
-			uint32_t numColorsInPalette = 0;  // no colors in color palette
-			uint32_t numImportantColors = 0;  // all colors are important
-		};
-		static_assert(sizeof(BitmapInfoHeader)==40, "Wrong size of BitmapInfoHeader.");
-
-		BitmapInfoHeader bitmapInfoHeader = {
-			40,
-			int32_t(imageExtent.width),
-			-int32_t(imageExtent.height),
-			1, 32, 0,
-			imageDataSize,
-			2835, 2835,  // roughly 72 DPI
-			0, 0
-		};
-		s.write(reinterpret_cast<char*>(&bitmapInfoHeader), sizeof(BitmapInfoHeader));
-		s.write(array<char,2>{'\0','\0'}.data(), 2);
-
-		// write image data,
-		// line by line
-		const char* linePtr = reinterpret_cast<char*>(m.get());
-		char b[4];
-		for(auto y=imageExtent.height; y>0; y--) {
-			for(size_t i=0, e=imageExtent.width*4; i<e; i+=4) {
-				b[0] = linePtr[i+2];
-				b[1] = linePtr[i+1];
-				b[2] = linePtr[i+0];
-				b[3] = linePtr[i+3];
-				s.write(b, 4);
+					if(readbackPath == ReadbackPath::Image) {
+
+						// hostVisibleImage layout to eGeneral
+						slot.commandBuffer->pipelineBarrier(
+							vk::PipelineStageFlagBits::eTopOfPipe,  // srcStageMask
+							vk::PipelineStageFlagBits::eTransfer,   // dstStageMask
+							vk::DependencyFlags(),  // dependencyFlags
+							nullptr,  // memoryBarriers
+							nullptr,  // bufferMemoryBarriers
+							vk::ImageMemoryBarrier{  // imageMemoryBarriers
+								vk::AccessFlags(),                   // srcAccessMask
+								vk::AccessFlagBits::eTransferWrite,  // dstAccessMask
+								vk::ImageLayout::eUndefined,         // oldLayout
+								vk::ImageLayout::eGeneral,           // newLayout
+								0,                          // srcQueueFamilyIndex
+								0,                          // dstQueueFamilyIndex
+								slot.hostVisibleImage.get(),  // image
+								vk::ImageSubresourceRange{  // subresourceRange
+									vk::ImageAspectFlagBits::eColor,  // aspectMask
+									0,  // baseMipLevel
+									1,  // levelCount
+									0,  // baseArrayLayer
+									1   // layerCount
+								}
+							}
+						);
+
+						// copy framebufferImage to hostVisibleImage
+						slot.commandBuffer->copyImage(
+							slot.framebufferImage.get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
+							slot.hostVisibleImage.get(), vk::ImageLayout::eGeneral,  // dstImage, dstImageLayout
+							vk::ImageCopy(  // regions
+								vk::ImageSubresourceLayers(  // srcSubresource
+									vk::ImageAspectFlagBits::eColor,  // aspectMask
+									0,  // mipLevel
+									0,  // baseArrayLayer
+									1   // layerCount
+								),
+								vk::Offset3D(0,0,0),         // srcOffset
+								vk::ImageSubresourceLayers(  // dstSubresource
+									vk::ImageAspectFlagBits::eColor,  // aspectMask
+									0,  // mipLevel
+									0,  // baseArrayLayer
+									1   // layerCount
+								),
+								vk::Offset3D(0,0,0),         // dstOffset
+								vk::Extent3D(tile.extent.width, tile.extent.height, 1)  // extent
+							)
+						);
+
+					}
+					else if(readbackPath == ReadbackPath::Buffer) {
+
+						// copy framebufferImage to hostVisibleBuffer
+						// (bufferRowLength and bufferImageHeight are zero, so the rows are tightly packed)
+						slot.commandBuffer->copyImageToBuffer(
+							slot.framebufferImage.get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
+							slot.hostVisibleBuffer.get(),  // dstBuffer
+							vk::BufferImageCopy(  // regions
+								0,  // bufferOffset
+								0,  // bufferRowLength
+								0,  // bufferImageHeight
+								vk::ImageSubresourceLayers(  // imageSubresource
+									vk::ImageAspectFlagBits::eColor,  // aspectMask
+									0,  // mipLevel
+									0,  // baseArrayLayer
+									1   // layerCount
+								),
+								vk::Offset3D(0,0,0),  // imageOffset
+								vk::Extent3D(tile.extent.width, tile.extent.height, 1)  // imageExtent
+							)
+						);
+
+					}
+					else {
+
+						// copy framebufferImage directly to its position in the output file
+						// (bufferRowLength is the image width, so the tile rows are placed into the image rows)
+						slot.commandBuffer->copyImageToBuffer(
+							slot.framebufferImage.get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
+							zeroCopyBuffer.get(),  // dstBuffer
+							vk::BufferImageCopy(  // regions
+								outputMapping.dataOffset() +
+									(vk::DeviceSize(tile.offset.y) * imageExtent.width + tile.offset.x) * 4,  // bufferOffset
+								imageExtent.width,  // bufferRowLength
+								0,  // bufferImageHeight
+								vk::ImageSubresourceLayers(  // imageSubresource
+									vk::ImageAspectFlagBits::eColor,  // aspectMask
+									0,  // mipLevel
+									0,  // baseArrayLayer
+									1   // layerCount
+								),
+								vk::Offset3D(0,0,0),  // imageOffset
+								vk::Extent3D(tile.extent.width, tile.extent.height, 1)  // imageExtent
+							)
+						);
+
+					}
+
+					// timestamp after the copy
+					if(timestampPool)
+						slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eTransfer, timestampPool.get(), queryIndex+2);
+
+					// make the copied data available to the host
+					slot.commandBuffer->pipelineBarrier(
+						vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+						vk::PipelineStageFlagBits::eHost,      // dstStageMask
+						vk::DependencyFlags(),  // dependencyFlags
+						vk::MemoryBarrier(  // memoryBarriers
+							vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+							vk::AccessFlagBits::eHostRead        // dstAccessMask
+						),
+						nullptr,  // bufferMemoryBarriers
+						nullptr   // imageMemoryBarriers
+					);
+
+					// end command buffer
+					slot.commandBuffer->end();
+
+					// submit work
+					graphicsQueue.submit(
+						vk::SubmitInfo(  // submits
+							0, nullptr, nullptr,            // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
+							1, &slot.commandBuffer.get(),   // commandBufferCount, pCommandBuffers
+							0, nullptr                      // signalSemaphoreCount, pSignalSemaphores
+						),
+						slot.renderingFinishedFence.get()  // fence
+					);
+					slot.tile = tile;
+					slot.pending = true;
+				};
+
+			// function to wait for the tile and to write it into the file
+			auto writeTile =
+				[&](TileSlot& slot) {
+
+					// wait for the work
+					vk::Result r = device->waitForFences(
+						slot.renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
+						VK_TRUE,       // waitAll
+						uint64_t(3e9)  // timeout (3s)
+					);
+					if(r == vk::Result::eTimeout)
+						throw std::runtime_error("GPU timeout. Task is probably hanging.");
+					device->resetFences(slot.renderingFinishedFence.get());
+					slot.pending = false;
+
+					// read timestamps
+					if(timestampPool) {
+						array<uint64_t,3> timestamps;
+						uint32_t queryIndex = uint32_t(&slot - tileSlots.data()) * 3;
+						vk::Result r = device->getQueryPoolResults(
+							timestampPool.get(),  // queryPool
+							queryIndex,  // firstQuery
+							3,  // queryCount
+							sizeof(timestamps),  // dataSize
+							timestamps.data(),  // pData
+							sizeof(uint64_t),  // stride
+							vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait  // flags
+						);
+						if(r != vk::Result::eSuccess)
+							throw std::runtime_error("vkGetQueryPoolResults() did not finish with VK_SUCCESS result.");
+						renderTime += double((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod_ns * 1e-9;
+						copyTime += double((timestamps[2] - timestamps[1]) & timestampMask) * timestampPeriod_ns * 1e-9;
+					}
+					copiedBytes += uint64_t(slot.tile.extent.width) * slot.tile.extent.height * 4;
+
+					// zero-copy path has the data already in the file
+					if(readbackPath == ReadbackPath::ZeroCopy)
+						return;
+
+					// invalidate caches to fetch a new content
+					// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
+					device->invalidateMappedMemoryRanges(
+						vk::MappedMemoryRange(
+							slot.hostVisibleMemory.get(),  // memory
+							0,  // offset
+							VK_WHOLE_SIZE  // size
+						)
+					);
+
+					// write image data
+					// (the tile is placed on its position in the file, or, for compressed formats,
+					// it is collected until the whole row of tiles is complete and can be encoded;
+					// buffer rows are tightly packed while image rows use rowPitch given by the driver)
+					size_t rowPitch = (readbackPath == ReadbackPath::Buffer) ? size_t(slot.tile.extent.width) * 4
+					                                                         : size_t(slot.hostLayout.rowPitch);
+					if(compressedWriter)
+						compressedWriter->writeRect(
+							slot.mappedMemory + slot.hostLayout.offset,  // data
+							rowPitch,  // rowPitch
+							uint32_t(slot.tile.offset.x), uint32_t(slot.tile.offset.y),  // x, y
+							slot.tile.extent.width, slot.tile.extent.height  // width, height
+						);
+					else
+						writer.writeRect(
+							slot.mappedMemory + slot.hostLayout.offset,  // data
+							rowPitch,  // rowPitch
+							uint32_t(slot.tile.offset.x), uint32_t(slot.tile.offset.y),  // x, y
+							slot.tile.extent.width, slot.tile.extent.height  // width, height
+						);
+				};
+
+			// render all the tiles
+			// (while one tile is rendered, the previous one is written into the file)
+			size_t tileIndex = 0;
+			for(uint32_t tileY=0; tileY<numTilesY; tileY++)
+				for(uint32_t tileX=0; tileX<numTilesX; tileX++, tileIndex++) {
+					TileSlot& slot = tileSlots[tileIndex % numTileSlots];
+					if(slot.pending)
+						writeTile(slot);
+					vk::Offset2D offset(int32_t(tileX*tileExtent.width), int32_t(tileY*tileExtent.height));
+					renderTile(
+						slot,
+						vk::Rect2D(
+							offset,
+							vk::Extent2D(min(tileExtent.width, imageExtent.width - uint32_t(offset.x)),
+							             min(tileExtent.height, imageExtent.height - uint32_t(offset.y)))
+						)
+					);
+				}
+
+			// write the remaining tiles in the order of their submission
+			for(size_t i=0; i<numTileSlots; i++) {
+				TileSlot& slot = tileSlots[(tileIndex + i) % numTileSlots];
+				if(slot.pending)
+					writeTile(slot);
+			}
+			auto closeStartTime = chrono::steady_clock::now();
+			if(readbackPath == ReadbackPath::ZeroCopy) {
+				zeroCopyBuffer.reset();
+				zeroCopyMemory.reset();
+				outputMapping.close();
+			}
+			else if(compressedWriter)
+				compressedWriter->close();
+			else
+				writer.close();
+			double closeTime = chrono::duration<double>(chrono::steady_clock::now() - closeStartTime).count();
+			double totalTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+			cout << "Readback path: " << (readbackPath == ReadbackPath::Image ? "image" :
+			                              readbackPath == ReadbackPath::Buffer ? "buffer" : "zero-copy") << endl;
+			if(timestampPool) {
+				cout << "   GPU render: " << renderTime*1000 << " ms" << endl;
+				cout << "   GPU copy:  " << copyTime*1000 << " ms ("
+				     << (copyTime>0. ? double(copiedBytes)/copyTime*1e-6 : 0.) << " MB/s)" << endl;
 			}
-			linePtr += hostImageLayout.rowPitch;
+			else
+				cout << "   GPU render and copy:  timestamps not supported" << endl;
+			if(compressedWriter)
+				cout << "   Encode:    " << compressedWriter->encodeTime()*1000 << " ms of CPU time on "
+				     << compressedWriter->numThreads() << " threads, " << closeTime*1000 << " ms after the last tile" << endl;
+			cout << "   Total:     " << totalTime*1000 << " ms ("
+			     << (totalTime>0. ? double(copiedBytes)/totalTime*1e-6 : 0.) << " MB/s)" << endl;
+			if(readbackPath == ReadbackPath::ZeroCopy)
+				cout << "Done. Written " << double(outputMapping.fileSize())/(1024*1024) << " MiB directly by the GPU, "
+				        "file closed in " << outputMapping.closeTime()*1000 << " ms." << endl;
+			else if(compressedWriter)
+				cout << "Done. Written " << double(compressedWriter->bytesWritten())/(1024*1024) << " MiB ("
+				     << CompressedWriter::formatName(compressedWriter->format()) << ", compression ratio "
+				     << compressedWriter->compressionRatio() << ", band height " << compressedWriter->bandHeight() << ")." << endl;
+			else
+				cout << "Done. Written " << double(writer.bytesWritten())/(1024*1024) << " MiB in "
+				     << writer.writeTime()*1000 << " ms (" << writer.throughput() << " MB/s, "
+				     << writer.conversionName() << " writer)." << endl;
+
+			passCopyTime.push_back(copyTime);
+			passTotalTime.push_back(totalTime);
+		}
+
+		// comparison of the readback paths
+		if(compareReadbackPaths) {
+			cout << "Readback path comparison (image vs. buffer):" << endl;
+			if(timestampPool)
+				cout << "   GPU copy:  " << passCopyTime[0]*1000 << " ms vs. " << passCopyTime[1]*1000 << " ms" << endl;
+			cout << "   Total:     " << passTotalTime[0]*1000 << " ms vs. " << passTotalTime[1]*1000 << " ms" << endl;
 		}
-		cout << "Done." << endl;
 
 	// catch exceptions
 	} catch(vk::Error& e) {
@@ -0,0 +1,646 @@
+#include "CompressedWriter.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#if defined(COMPRESSED_WRITER_ZLIB)
+# include <zlib.h>
+#endif
+
+using namespace std;
+
+
+// band parameters
+// (bands have roughly targetBandSize of raw data, but they are made smaller for small images
+// to keep all the workers busy; on the other side, very small bands hurt the compression ratio)
+static constexpr const size_t targetBandSize = 1024 * 1024;
+static constexpr const uint32_t minBandHeight = 16;
+static constexpr const unsigned bandsPerThread = 4;
+
+
+static void storeBE32(uint8_t* p, uint32_t v)
+{
+	p[0] = uint8_t(v >> 24);
+	p[1] = uint8_t(v >> 16);
+	p[2] = uint8_t(v >> 8);
+	p[3] = uint8_t(v);
+}
+
+
+const char* CompressedWriter::formatName(Format format)
+{
+	switch(format) {
+	case Format::Qoi: return "qoi";
+	case Format::Png: return "png";
+	}
+	return "unknown";
+}
+
+
+CompressedWriter::Format CompressedWriter::formatFromName(const char* name)
+{
+	for(Format f : { Format::Qoi, Format::Png })
+		if(strcmp(name, formatName(f)) == 0)
+			return f;
+	throw invalid_argument(string("Unknown compressed image format: ") + name + ".");
+}
+
+
+bool CompressedWriter::isSupported(Format format)
+{
+#if defined(COMPRESSED_WRITER_ZLIB)
+	return format == Format::Qoi || format == Format::Png;
+#else
+	return format != Format::Png;
+#endif
+}
+
+
+unique_ptr<CompressedWriter> CompressedWriter::create(Format format)
+{
+	if(!isSupported(format))
+		throw runtime_error(string("Image format ") + formatName(format) + " is not supported by this build.");
+
+	switch(format) {
+	case Format::Qoi: return make_unique<QoiWriter>();
+	case Format::Png: return make_unique<PngWriter>();
+	}
+	throw invalid_argument("Unknown compressed image format.");
+}
+
+
+void CompressedWriter::open(const string& fileName, uint32_t width, uint32_t height, PixelOrder pixelOrder, unsigned numThreads)
+{
+	if(_stream.is_open())
+		close();
+
+	// start workers
+	// (they are reused by the following images, unless the number of threads changes)
+	if(numThreads == 0)
+		numThreads = max(thread::hardware_concurrency(), 1u);
+	if(numThreads != _workers.size()) {
+		stopWorkers();
+		_workers.reserve(numThreads);
+		for(unsigned i=0; i<numThreads; i++)
+			_workers.emplace_back(&CompressedWriter::workerMain, this);
+	}
+
+	_fileName = fileName;
+	_width = width;
+	_height = height;
+	_pixelOrder = pixelOrder;
+	_rows.clear();
+	_nextBandRow = 0;
+	_numBandsDispatched = 0;
+	_nextBandToWrite = 0;
+	_maxBandsInFlight = 2*numThreads + 2;
+	_workerException = nullptr;
+	_bytesEncoded = 0;
+	_bytesWritten = 0;
+	_encodeTime = 0.;
+	_wallTime = 0.;
+	_openTime = chrono::steady_clock::now();
+
+	// band height
+	size_t rowSize = size_t(width) * 4;
+	size_t heightBySize = max((targetBandSize + rowSize - 1) / rowSize, size_t(1));
+	size_t heightByThreads = (size_t(height) + numThreads*bandsPerThread - 1) / (numThreads*bandsPerThread);
+	_bandHeight = uint32_t(min(max(min(heightBySize, heightByThreads), size_t(minBandHeight)), size_t(max(height, 1u))));
+
+	// open the output file
+	_stream.open(fileName, ofstream::out | ofstream::binary | ofstream::trunc);
+	if(!_stream)
+		throw runtime_error("Failed to open \"" + fileName + "\".");
+	writeHeader();
+}
+
+
+void CompressedWriter::writeRect(const void* data, size_t rowPitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+{
+	rethrowWorkerException();
+	if(x+width > _width || y+height > _height || y < _nextBandRow)
+		throw runtime_error("Invalid rectangle written to \"" + _fileName + "\".");
+
+	// copy the rows into the band assembly,
+	// converting them to RGBA byte order used by all the compressed formats
+	const uint8_t* rowPtr = reinterpret_cast<const uint8_t*>(data);
+	size_t rowSize = size_t(_width) * 4;
+	for(uint32_t r=0; r<height; r++) {
+		Row& row = _rows[y+r];
+		if(row.data.empty())
+			row.data.resize(rowSize);
+		if(_pixelOrder == PixelOrder::BGRA)
+			BmpWriter::convertRow(rowPtr, row.data.data()+size_t(x)*4, width, BmpWriter::bestMethod());
+		else
+			memcpy(row.data.data()+size_t(x)*4, rowPtr, size_t(width)*4);
+		row.numPixelsFilled += width;
+		rowPtr += rowPitch;
+	}
+	_bytesEncoded += uint64_t(width) * height * 4;
+
+	dispatchBands();
+}
+
+
+void CompressedWriter::dispatchBands()
+{
+	size_t rowSize = size_t(_width) * 4;
+
+	while(_nextBandRow < _height) {
+
+		// is the next band complete?
+		uint32_t numRows = min(_bandHeight, _height-_nextBandRow);
+		for(uint32_t r=_nextBandRow, e=_nextBandRow+numRows; r<e; r++) {
+			auto it = _rows.find(r);
+			if(it == _rows.end() || it->second.numPixelsFilled < _width)
+				return;
+		}
+
+		// gather band rows
+		auto band = make_unique<Band>();
+		band->index = _numBandsDispatched;
+		band->y = _nextBandRow;
+		band->numRows = numRows;
+		band->last = (_nextBandRow+numRows == _height);
+		band->pixels.resize(rowSize * numRows);
+		for(uint32_t r=0; r<numRows; r++) {
+			auto it = _rows.find(_nextBandRow+r);
+			memcpy(band->pixels.data()+rowSize*r, it->second.data.data(), rowSize);
+			_rows.erase(it);
+		}
+
+		// sequential part of the encoding
+		auto startTime = chrono::steady_clock::now();
+		prepareBand(*band);
+		double prepareTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		// pass the band to the workers
+		// (wait if too many bands are in flight)
+		waitForBands(_maxBandsInFlight-1);
+		rethrowWorkerException();
+		{
+			lock_guard<mutex> lock(_mutex);
+			_encodeTime += prepareTime;
+			_pendingBands.emplace_back(move(band));
+			_numBandsInFlight++;
+		}
+		_workCondition.notify_one();
+		_numBandsDispatched++;
+		_nextBandRow += numRows;
+	}
+}
+
+
+void CompressedWriter::workerMain()
+{
+	for(;;) {
+
+		// wait for work
+		unique_ptr<Band> band;
+		{
+			unique_lock<mutex> lock(_mutex);
+			_workCondition.wait(lock, [&]{ return _exitWorkers || !_pendingBands.empty(); });
+			if(_exitWorkers)
+				return;
+			band = move(_pendingBands.front());
+			_pendingBands.pop_front();
+		}
+
+		// encode the band
+		auto startTime = chrono::steady_clock::now();
+		try {
+			encodeBand(*band);
+		} catch(...) {
+			lock_guard<mutex> lock(_mutex);
+			if(!_workerException)
+				_workerException = current_exception();
+		}
+		double t = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+		{
+			lock_guard<mutex> lock(_mutex);
+			_encodeTime += t;
+			size_t index = band->index;
+			_finishedBands.emplace(index, move(band));
+		}
+
+		// write all the bands that are ready
+		writeFinishedBands();
+	}
+}
+
+
+void CompressedWriter::writeFinishedBands()
+{
+	// only one thread writes at a time;
+	// a band finished while another thread is writing is either picked up by that thread,
+	// or by the thread that finished it after it gets the write lock
+	lock_guard<mutex> writeLock(_writeMutex);
+
+	for(;;) {
+
+		unique_ptr<Band> band;
+		bool failed;
+		{
+			lock_guard<mutex> lock(_mutex);
+			auto it = _finishedBands.find(_nextBandToWrite);
+			if(it == _finishedBands.end())
+				return;
+			band = move(it->second);
+			_finishedBands.erase(it);
+			failed = (_workerException != nullptr);
+		}
+
+		// the remaining bands are dropped after a failure
+		if(!failed) {
+			try {
+				writeBand(*band);
+			} catch(...) {
+				lock_guard<mutex> lock(_mutex);
+				if(!_workerException)
+					_workerException = current_exception();
+			}
+		}
+
+		{
+			lock_guard<mutex> lock(_mutex);
+			_nextBandToWrite++;
+			_numBandsInFlight--;
+		}
+		_doneCondition.notify_all();
+	}
+}
+
+
+void CompressedWriter::waitForBands(size_t maxBandsInFlight)
+{
+	unique_lock<mutex> lock(_mutex);
+	_doneCondition.wait(lock, [&]{ return _numBandsInFlight <= maxBandsInFlight; });
+}
+
+
+void CompressedWriter::rethrowWorkerException()
+{
+	exception_ptr e;
+	{
+		lock_guard<mutex> lock(_mutex);
+		e = _workerException;
+	}
+	if(e)
+		rethrow_exception(e);
+}
+
+
+void CompressedWriter::stopWorkers()
+{
+	if(_workers.empty())
+		return;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		_exitWorkers = true;
+	}
+	_workCondition.notify_all();
+	for(thread& t : _workers)
+		t.join();
+	_workers.clear();
+	_exitWorkers = false;
+	_pendingBands.clear();
+	_finishedBands.clear();
+	_numBandsInFlight = 0;
+}
+
+
+void CompressedWriter::writeData(const void* data, size_t size)
+{
+	_stream.write(reinterpret_cast<const char*>(data), streamsize(size));
+	if(!_stream)
+		throw runtime_error("Failed to write \"" + _fileName + "\".");
+	_bytesWritten += size;
+}
+
+
+void CompressedWriter::close()
+{
+	if(!_stream.is_open())
+		return;
+
+	// finish all the bands
+	// (in-flight bands are always finished, even after a failure,
+	// because the workers might still be writing to the stream)
+	exception_ptr e;
+	try {
+		dispatchBands();
+		if(_nextBandRow < _height)
+			throw runtime_error("Image \"" + _fileName + "\" is not complete.");
+		waitForBands(0);
+		rethrowWorkerException();
+		writeTrailer();
+	} catch(...) {
+		e = current_exception();
+		waitForBands(0);
+	}
+
+	_stream.close();
+	if(!e && !_stream)
+		e = make_exception_ptr(runtime_error("Failed to write \"" + _fileName + "\"."));
+	_rows.clear();
+	_wallTime = chrono::duration<double>(chrono::steady_clock::now() - _openTime).count();
+	if(e)
+		rethrow_exception(e);
+}
+
+
+//
+// QoiWriter
+//
+
+// QOI operations
+static constexpr const uint8_t qoiOpIndex = 0x00;
+static constexpr const uint8_t qoiOpDiff  = 0x40;
+static constexpr const uint8_t qoiOpLuma  = 0x80;
+static constexpr const uint8_t qoiOpRun   = 0xc0;
+static constexpr const uint8_t qoiOpRGB   = 0xfe;
+static constexpr const uint8_t qoiOpRGBA  = 0xff;
+static constexpr const unsigned qoiMaxRun = 62;
+
+
+static inline unsigned qoiHash(uint32_t p)
+{
+	// pixel is stored as RGBA bytes, so red is in the lowest byte on little-endian machines
+	unsigned r = p & 0xff, g = (p >> 8) & 0xff, b = (p >> 16) & 0xff, a = p >> 24;
+	return (r*3 + g*5 + b*7 + a*11) % 64;
+}
+
+
+void QoiWriter::writeHeader()
+{
+	uint8_t header[14] = { 'q', 'o', 'i', 'f' };
+	storeBE32(header+4, _width);
+	storeBE32(header+8, _height);
+	header[12] = 4;  // RGBA
+	header[13] = 0;  // sRGB with linear alpha
+	writeData(header, sizeof(header));
+
+	// initial encoder state defined by QOI specification
+	memset(_index, 0, sizeof(_index));
+	_prevPixel = 0xff000000;
+}
+
+
+void QoiWriter::prepareBand(Band& band)
+{
+	// store the state at the start of the band
+	band.context.resize(sizeof(_index)+4);
+	memcpy(band.context.data(), _index, sizeof(_index));
+	memcpy(band.context.data()+sizeof(_index), &_prevPixel, 4);
+
+	// update the state by the band pixels
+	// (the index is updated by each pixel that is not encoded by run, e.g. the pixel different from its predecessor)
+	const uint8_t* src = band.pixels.data();
+	size_t numPixels = band.pixels.size() / 4;
+	uint32_t prev = _prevPixel;
+	for(size_t i=0; i<numPixels; i++) {
+		uint32_t p;
+		memcpy(&p, src+i*4, 4);
+		if(p != prev) {
+			_index[qoiHash(p)] = p;
+			prev = p;
+		}
+	}
+	_prevPixel = prev;
+}
+
+
+void QoiWriter::encodeBand(Band& band)
+{
+	uint32_t index[64];
+	uint32_t prev;
+	memcpy(index, band.context.data(), sizeof(index));
+	memcpy(&prev, band.context.data()+sizeof(index), 4);
+
+	// worst case is 5 bytes per pixel
+	const uint8_t* src = band.pixels.data();
+	size_t numPixels = band.pixels.size() / 4;
+	band.output.resize(numPixels*5);
+	uint8_t* dst = band.output.data();
+	unsigned run = 0;
+
+	for(size_t i=0; i<numPixels; i++) {
+
+		uint32_t p;
+		memcpy(&p, src+i*4, 4);
+
+		// runs
+		if(p == prev) {
+			run++;
+			if(run == qoiMaxRun) {
+				*dst++ = qoiOpRun | uint8_t(run-1);
+				run = 0;
+			}
+			continue;
+		}
+		if(run > 0) {
+			*dst++ = qoiOpRun | uint8_t(run-1);
+			run = 0;
+		}
+
+		// index
+		unsigned h = qoiHash(p);
+		if(index[h] == p) {
+			*dst++ = qoiOpIndex | uint8_t(h);
+			prev = p;
+			continue;
+		}
+		index[h] = p;
+
+		// differences
+		uint8_t r = uint8_t(p), g = uint8_t(p >> 8), b = uint8_t(p >> 16), a = uint8_t(p >> 24);
+		if(a == uint8_t(prev >> 24)) {
+			int8_t vr = int8_t(r - uint8_t(prev));
+			int8_t vg = int8_t(g - uint8_t(prev >> 8));
+			int8_t vb = int8_t(b - uint8_t(prev >> 16));
+			int8_t vgr = int8_t(vr - vg);
+			int8_t vgb = int8_t(vb - vg);
+			if(vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+				*dst++ = qoiOpDiff | uint8_t((vr+2) << 4 | (vg+2) << 2 | (vb+2));
+			else if(vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+				*dst++ = qoiOpLuma | uint8_t(vg+32);
+				*dst++ = uint8_t((vgr+8) << 4 | (vgb+8));
+			}
+			else {
+				dst[0] = qoiOpRGB;
+				dst[1] = r;
+				dst[2] = g;
+				dst[3] = b;
+				dst += 4;
+			}
+		}
+		else {
+			dst[0] = qoiOpRGBA;
+			dst[1] = r;
+			dst[2] = g;
+			dst[3] = b;
+			dst[4] = a;
+			dst += 5;
+		}
+		prev = p;
+	}
+
+	// terminate the run at the end of the band
+	// (the following band starts with no run)
+	if(run > 0)
+		*dst++ = qoiOpRun | uint8_t(run-1);
+
+	band.output.resize(dst - band.output.data());
+}
+
+
+void QoiWriter::writeBand(Band& band)
+{
+	writeData(band.output.data(), band.output.size());
+}
+
+
+void QoiWriter::writeTrailer()
+{
+	static const uint8_t endMarker[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+	writeData(endMarker, sizeof(endMarker));
+}
+
+
+//
+// PngWriter
+//
+
+#if defined(COMPRESSED_WRITER_ZLIB)
+
+static inline uint8_t paethPredictor(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if(pa <= pb && pa <= pc)
+		return uint8_t(a);
+	if(pb <= pc)
+		return uint8_t(b);
+	return uint8_t(c);
+}
+
+
+void PngWriter::writeChunk(const char* type, const void* data, size_t size)
+{
+	uint8_t header[8];
+	storeBE32(header, uint32_t(size));
+	memcpy(header+4, type, 4);
+	uLong crc = crc32(0, reinterpret_cast<const Bytef*>(type), 4);
+	if(size > 0)  // crc32() returns initial value for null data
+		crc = crc32(crc, reinterpret_cast<const Bytef*>(data), uInt(size));
+	uint8_t trailer[4];
+	storeBE32(trailer, uint32_t(crc));
+	writeData(header, sizeof(header));
+	writeData(data, size);
+	writeData(trailer, sizeof(trailer));
+}
+
+
+void PngWriter::writeHeader()
+{
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+	writeData(signature, sizeof(signature));
+
+	uint8_t ihdr[13];
+	storeBE32(ihdr, _width);
+	storeBE32(ihdr+4, _height);
+	ihdr[8] = 8;  // bit depth
+	ihdr[9] = 6;  // color type RGBA
+	ihdr[10] = 0;  // deflate compression
+	ihdr[11] = 0;  // adaptive filtering
+	ihdr[12] = 0;  // no interlace
+	writeChunk("IHDR", ihdr, sizeof(ihdr));
+
+	// zlib header goes to its own IDAT chunk,
+	// the deflated bands follow in the next IDAT chunks
+	static const uint8_t zlibHeader[2] = { 0x78, 0x9c };
+	writeChunk("IDAT", zlibHeader, sizeof(zlibHeader));
+
+	_prevRow.assign(size_t(_width)*4, 0);
+	_adler = adler32(0, nullptr, 0);
+}
+
+
+void PngWriter::prepareBand(Band& band)
+{
+	// the first row of the band is filtered using the last row of the previous band
+	size_t rowSize = size_t(_width) * 4;
+	band.context = _prevRow;
+	memcpy(_prevRow.data(), band.pixels.data()+rowSize*(band.numRows-1), rowSize);
+}
+
+
+void PngWriter::encodeBand(Band& band)
+{
+	// filter the rows
+	// (Paeth filter is used for all the rows; it is usually the best one for rendered images
+	// and it avoids the cost of trying all the filters)
+	size_t rowSize = size_t(_width) * 4;
+	vector<uint8_t> filtered((rowSize+1) * band.numRows);
+	const uint8_t* prior = band.context.data();
+	for(uint32_t r=0; r<band.numRows; r++) {
+		const uint8_t* cur = band.pixels.data() + rowSize*r;
+		uint8_t* dst = filtered.data() + (rowSize+1)*r;
+		dst[0] = 4;  // Paeth
+		for(size_t i=0; i<4 && i<rowSize; i++)
+			dst[1+i] = uint8_t(cur[i] - paethPredictor(0, prior[i], 0));
+		for(size_t i=4; i<rowSize; i++)
+			dst[1+i] = uint8_t(cur[i] - paethPredictor(cur[i-4], prior[i], prior[i-4]));
+		prior = cur;
+	}
+	band.checksum = uint32_t(adler32(adler32(0, nullptr, 0), filtered.data(), uInt(filtered.size())));
+
+	// deflate the band as raw deflate data
+	// (the last band finishes the stream, the others end by sync flush on byte boundary)
+	z_stream zs = {};
+	if(deflateInit2(&zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_FILTERED) != Z_OK)
+		throw runtime_error("Failed to initialize deflate.");
+	band.output.resize(deflateBound(&zs, uLong(filtered.size())) + 16);
+	zs.next_in = filtered.data();
+	zs.avail_in = uInt(filtered.size());
+	zs.next_out = band.output.data();
+	zs.avail_out = uInt(band.output.size());
+	int r = deflate(&zs, band.last ? Z_FINISH : Z_SYNC_FLUSH);
+	size_t outSize = zs.total_out;
+	bool ok = band.last ? r == Z_STREAM_END : (r == Z_OK && zs.avail_in == 0 && zs.avail_out != 0);
+	deflateEnd(&zs);
+	if(!ok)
+		throw runtime_error("Failed to deflate png data.");
+	band.output.resize(outSize);
+}
+
+
+void PngWriter::writeBand(Band& band)
+{
+	size_t filteredSize = (size_t(_width)*4+1) * band.numRows;
+	_adler = uint32_t(adler32_combine(_adler, band.checksum, z_off_t(filteredSize)));
+	writeChunk("IDAT", band.output.data(), band.output.size());
+}
+
+
+void PngWriter::writeTrailer()
+{
+	uint8_t adler[4];
+	storeBE32(adler, _adler);
+	writeChunk("IDAT", adler, sizeof(adler));
+	writeChunk("IEND", nullptr, 0);
+}
+
+#else
+
+void PngWriter::writeHeader()  { throw runtime_error("Png writer is not supported by this build (zlib was not found)."); }
+void PngWriter::prepareBand(Band&)  {}
+void PngWriter::encodeBand(Band&)  {}
+void PngWriter::writeBand(Band&)  {}
+void PngWriter::writeTrailer()  {}
+void PngWriter::writeChunk(const char*, const void*, size_t)  {}
+
+#endif
@@ -1,14 +1,45 @@
+#include "BmpWriter.h"
+#include "CompressedWriter.h"
 #include <vulkan/vulkan.hpp>
 #include <array>
-#include <fstream>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
 #include <iostream>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 using namespace std;
 
 // constants
+constexpr const char* appName = "08-helloTriangle";
 static const vk::Extent2D imageExtent(128, 128);
 
+// method used to write the image data
+// (it can be changed by command-line argument)
+static BmpWriter::Method writerMethod = BmpWriter::Method::Auto;
+
+// output format
+// (bmp is written by BmpWriter, qoi and png are encoded by CompressedWriter on all the cores)
+static bool compressedOutput = false;
+static CompressedWriter::Format compressedFormat = CompressedWriter::Format::Qoi;
+
+// framebuffer format
+// (B8G8R8A8 format is used when supported, so the rendered data are already
+// in bmp byte order and no swizzle is needed on the host)
+static vk::Format framebufferFormat = vk::Format::eR8G8B8A8Unorm;
+static BmpWriter::PixelOrder pixelOrder = BmpWriter::PixelOrder::RGBA;
+
+// number of rendered frames and number of frames in flight
+// (when more than one frame is rendered, the frames are written into image-NNNN.<format> files;
+// while the GPU renders the next frames, the writer thread writes the finished ones)
+static size_t numFrames = 1;
+static size_t numFramesInFlight = 3;
+
 
 // Vulkan instance
 // (it must be destructed as the last one)
@@ -25,16 +56,26 @@ static vk::UniqueRenderPass renderPass;
 static vk::UniqueShaderModule vsModule;
 static vk::UniqueShaderModule fsModule;
 static vk::UniquePipelineLayout pipelineLayout;
-static vk::UniqueImage framebufferImage;
-static vk::UniqueImage hostVisibleImage;
-static vk::UniqueDeviceMemory framebufferImageMemory;
-static vk::UniqueDeviceMemory hostVisibleImageMemory;
-static vk::UniqueImageView frameImageView;
 static vk::UniquePipeline pipeline;
-static vk::UniqueFramebuffer framebuffer;
 static vk::UniqueCommandPool commandPool;
-static vk::UniqueCommandBuffer commandBuffer;
-static vk::UniqueFence renderingFinishedFence;
+static vk::UniqueQueryPool timestampPool;
+
+// resources of a single frame in flight
+// (the frames use the slots in the round-robin fashion)
+struct FrameSlot {
+	vk::UniqueImage framebufferImage;
+	vk::UniqueDeviceMemory framebufferImageMemory;
+	vk::UniqueImageView frameImageView;
+	vk::UniqueFramebuffer framebuffer;
+	vk::UniqueBuffer readbackBuffer;
+	vk::UniqueDeviceMemory readbackBufferMemory;
+	vk::UniqueCommandBuffer commandBuffer;
+	vk::UniqueFence renderingFinishedFence;
+	const char* mappedMemory = nullptr;
+	size_t frameIndex = 0;
+	bool busy = false;  // the slot is used by the frame that was not written yet
+};
+static vector<FrameSlot> frameSlots;
 
 // shader code in SPIR-V binary
 static const uint32_t vsSpirv[] = {
@@ -44,21 +85,86 @@ static const uint32_t fsSpirv[] = {
 #include "shader.frag.spv"
 };
 
+// writer thread state
+// (submitted slots are passed to the writer thread that returns them back by clearing FrameSlot::busy)
+static mutex writerMutex;
+static condition_variable writerCondition;
+static deque<size_t> submittedSlots;
+static bool submissionFinished = false;
+static exception_ptr writerException;
+
+// statistics of the stages
+// (they are written by the writer thread and read after it finishes)
+static double gpuTime = 0.;
+static double writerWaitTime = 0.;
+static double writerBusyTime = 0.;
+static uint64_t bytesWritten = 0;
+static uint64_t bytesEncoded = 0;
+static double encodeTime = 0.;
+static unsigned numEncoderThreads = 0;
+static const char* usedConversion = "";
+
 
 /// main function of the application
-int main(int, char**)
+int main(int argc, char* argv[])
 {
+	thread writerThread;
+
 	// catch exceptions
 	// (vulkan.hpp functions throw if they fail)
 	try {
 
+		// process command-line arguments
+		auto selectFormat =
+			[](const char* name) {
+				compressedOutput = (strcmp(name, "bmp") != 0);
+				if(compressedOutput)
+					compressedFormat = CompressedWriter::formatFromName(name);
+			};
+		for(int i=1; i<argc; i++)
+			if(strcmp(argv[i], "--writer") == 0 && i+1 < argc) {
+				writerMethod = BmpWriter::methodFromName(argv[i+1]);
+				i++;
+			}
+			else if(strcmp(argv[i], "--format") == 0 && i+1 < argc) {
+				selectFormat(argv[i+1]);
+				i++;
+			}
+			else if(strncmp(argv[i], "--format=", 9) == 0)
+				selectFormat(argv[i]+9);
+			else if(strcmp(argv[i], "--frames") == 0 && i+1 < argc &&
+			        sscanf(argv[i+1], "%zu", &numFrames) == 1 && numFrames != 0)
+				i++;
+			else if(strcmp(argv[i], "--frames-in-flight") == 0 && i+1 < argc &&
+			        sscanf(argv[i+1], "%zu", &numFramesInFlight) == 1 && numFramesInFlight != 0)
+				i++;
+			else {
+				if(strcmp(argv[i], "--help") != 0 && strcmp(argv[i], "-h") != 0)
+					cout << "Unrecognized option: " << argv[i] << endl;
+				cout << appName << " usage:\n"
+				        "   --help or -h:  usage information\n"
+				        "   --frames <n>:  number of rendered frames; if more than one,\n"
+				        "                  the frames are written into image-NNNN.<format> files,\n"
+				        "                  default: 1\n"
+				        "   --frames-in-flight <n>:  number of frames processed at once,\n"
+				        "                            default: 3\n"
+				        "   --writer <method>:  method used to write the image data,\n"
+				        "                       auto, per-pixel, scalar, ssse3 or avx2,\n"
+				        "                       default: auto\n"
+				        "   --format <format>:  format of the output images, bmp, qoi or png,\n"
+				        "                       qoi and png are encoded in parallel,\n"
+				        "                       default: bmp\n" << endl;
+				exit(99);
+			}
+		numFramesInFlight = min(numFramesInFlight, numFrames);
+
 		// Vulkan instance
 		instance =
 			vk::createInstanceUnique(
 				vk::InstanceCreateInfo{
 					vk::InstanceCreateFlags(),  // flags
 					&(const vk::ApplicationInfo&)vk::ApplicationInfo{
-						"08-helloTriangle",      // application name
+						appName,                 // application name
 						VK_MAKE_VERSION(0,0,0),  // application version
 						nullptr,                 // engine name
 						VK_MAKE_VERSION(0,0,0),  // engine version
@@ -124,6 +230,14 @@ int main(int, char**)
 		graphicsQueue = device->getQueue(graphicsQueueFamily, 0);
 
 
+		// framebuffer format
+		vk::FormatProperties bgraProperties = physicalDevice.getFormatProperties(vk::Format::eB8G8R8A8Unorm);
+		if(bgraProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment) {
+			framebufferFormat = vk::Format::eB8G8R8A8Unorm;
+			pixelOrder = BmpWriter::PixelOrder::BGRA;
+		}
+		cout << "Framebuffer format: " << vk::to_string(framebufferFormat) << endl;
+
 		// render pass
 		renderPass =
 			device->createRenderPassUnique(
@@ -133,7 +247,7 @@ int main(int, char**)
 					array{  // pAttachments
 						vk::AttachmentDescription(
 							vk::AttachmentDescriptionFlags(),  // flags
-							vk::Format::eR8G8B8A8Unorm,        // format
+							framebufferFormat,                 // format
 							vk::SampleCountFlagBits::e1,       // samples
 							vk::AttachmentLoadOp::eClear,      // loadOp
 							vk::AttachmentStoreOp::eStore,     // storeOp
@@ -178,106 +292,6 @@ int main(int, char**)
 				)
 			);
 
-		// images
-		framebufferImage =
-			device->createImageUnique(
-				vk::ImageCreateInfo(
-					vk::ImageCreateFlags(),       // flags
-					vk::ImageType::e2D,           // imageType
-					vk::Format::eR8G8B8A8Unorm,   // format
-					vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
-					1,                            // mipLevels
-					1,                            // arrayLayers
-					vk::SampleCountFlagBits::e1,  // samples
-					vk::ImageTiling::eOptimal,    // tiling
-					vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
-					vk::SharingMode::eExclusive,  // sharingMode
-					0,                            // queueFamilyIndexCount
-					nullptr,                      // pQueueFamilyIndices
-					vk::ImageLayout::eUndefined   // initialLayout
-				)
-			);
-		hostVisibleImage =
-			device->createImageUnique(
-				vk::ImageCreateInfo(
-					vk::ImageCreateFlags(),       // flags
-					vk::ImageType::e2D,           // imageType
-					vk::Format::eR8G8B8A8Unorm,   // format
-					vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
-					1,                            // mipLevels
-					1,                            // arrayLayers
-					vk::SampleCountFlagBits::e1,  // samples
-					vk::ImageTiling::eLinear,     // tiling
-					vk::ImageUsageFlagBits::eTransferDst,  // usage
-					vk::SharingMode::eExclusive,  // sharingMode
-					0,                            // queueFamilyIndexCount
-					nullptr,                      // pQueueFamilyIndices
-					vk::ImageLayout::eUndefined   // initialLayout
-				)
-			);
-
-		// memory for images
-		auto allocateMemory =
-			[](vk::Image image, vk::MemoryPropertyFlags requiredFlags) -> vk::UniqueDeviceMemory{
-				vk::MemoryRequirements memoryRequirements = device->getImageMemoryRequirements(image);
-				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
-				for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
-					if(memoryRequirements.memoryTypeBits & (1<<i))
-						if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
-							return
-								device->allocateMemoryUnique(
-									vk::MemoryAllocateInfo(
-										memoryRequirements.size,  // allocationSize
-										i                         // memoryTypeIndex
-									)
-								);
-				throw std::runtime_error("No suitable memory type found for image.");
-			};
-		framebufferImageMemory = allocateMemory(framebufferImage.get(), vk::MemoryPropertyFlagBits::eDeviceLocal);
-		hostVisibleImageMemory = allocateMemory(hostVisibleImage.get(), vk::MemoryPropertyFlagBits::eHostVisible |
-		                                                                vk::MemoryPropertyFlagBits::eHostCached);
-		device->bindImageMemory(
-			framebufferImage.get(),        // image
-			framebufferImageMemory.get(),  // memory
-			0                              // memoryOffset
-		);
-		device->bindImageMemory(
-			hostVisibleImage.get(),        // image
-			hostVisibleImageMemory.get(),  // memory
-			0                              // memoryOffset
-		);
-
-		// image view
-		frameImageView =
-			device->createImageViewUnique(
-				vk::ImageViewCreateInfo(
-					vk::ImageViewCreateFlags(),  // flags
-					framebufferImage.get(),      // image
-					vk::ImageViewType::e2D,      // viewType
-					vk::Format::eR8G8B8A8Unorm,  // format
-					vk::ComponentMapping(),      // components
-					vk::ImageSubresourceRange(   // subresourceRange
-						vk::ImageAspectFlagBits::eColor,  // aspectMask
-						0,  // baseMipLevel
-						1,  // levelCount
-						0,  // baseArrayLayer
-						1   // layerCount
-					)
-				)
-			);
-
-		// framebuffers
-		framebuffer =
-			device->createFramebufferUnique(
-				vk::FramebufferCreateInfo(
-					vk::FramebufferCreateFlags(),  // flags
-					renderPass.get(),              // renderPass
-					1, &frameImageView.get(),      // attachmentCount, pAttachments
-					imageExtent.width,             // width
-					imageExtent.height,            // height
-					1  // layers
-				)
-			);
 
 
 		// create shader modules
@@ -429,235 +443,449 @@ int main(int, char**)
 			).asTuple();
 
 
+		// memory allocation functions
+		auto allocateMemory =
+			[](vk::Image image, vk::MemoryPropertyFlags requiredFlags) -> vk::UniqueDeviceMemory{
+				vk::MemoryRequirements memoryRequirements = device->getImageMemoryRequirements(image);
+				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+				for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+					if(memoryRequirements.memoryTypeBits & (1<<i))
+						if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
+							return
+								device->allocateMemoryUnique(
+									vk::MemoryAllocateInfo(
+										memoryRequirements.size,  // allocationSize
+										i                         // memoryTypeIndex
+									)
+								);
+				throw std::runtime_error("No suitable memory type found for image.");
+			};
+		auto allocateBufferMemory =
+			[](vk::Buffer buffer, initializer_list<vk::MemoryPropertyFlags> flagCandidates) -> vk::UniqueDeviceMemory{
+				vk::MemoryRequirements memoryRequirements = device->getBufferMemoryRequirements(buffer);
+				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+				for(vk::MemoryPropertyFlags requiredFlags : flagCandidates)
+					for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+						if(memoryRequirements.memoryTypeBits & (1<<i))
+							if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
+								return
+									device->allocateMemoryUnique(
+										vk::MemoryAllocateInfo(
+											memoryRequirements.size,  // allocationSize
+											i                         // memoryTypeIndex
+										)
+									);
+				throw std::runtime_error("No suitable memory type found for buffer.");
+			};
+
 		// command pool
+		// (command buffers are recorded again for each frame)
 		commandPool =
 			device->createCommandPoolUnique(
 				vk::CommandPoolCreateInfo(
-					vk::CommandPoolCreateFlags(),  // flags
-					graphicsQueueFamily            // queueFamilyIndex
+					vk::CommandPoolCreateFlagBits::eResetCommandBuffer,  // flags
+					graphicsQueueFamily  // queueFamilyIndex
 				)
 			);
 
-		// allocate command buffer
-		commandBuffer = std::move(
+		// allocate command buffers
+		vector<vk::UniqueCommandBuffer> commandBuffers =
 			device->allocateCommandBuffersUnique(
 				vk::CommandBufferAllocateInfo(
 					commandPool.get(),                 // commandPool
 					vk::CommandBufferLevel::ePrimary,  // level
-					1                                  // commandBufferCount
+					uint32_t(numFramesInFlight)        // commandBufferCount
 				)
-			)[0]);
-
-		// begin command buffer
-		commandBuffer->begin(
-			vk::CommandBufferBeginInfo(
-				vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
-				nullptr  // pInheritanceInfo
-			)
-		);
-
-		// begin render pass
-		commandBuffer->beginRenderPass(
-			vk::RenderPassBeginInfo(
-				renderPass.get(),   // renderPass
-				framebuffer.get(),  // framebuffer
-				vk::Rect2D(vk::Offset2D(0,0), imageExtent),  // renderArea
-				1,      // clearValueCount
-				array{  // pClearValues
-					vk::ClearValue(array<float,4>{0.f,0.f,0.f,1.f}),
-				}.data()
-			),
-			vk::SubpassContents::eInline
-		);
-
-		// rendering commands
-		commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());  // bind pipeline
-		commandBuffer->draw(3,1,0,0);  // draw single triangle
-
-		// end render pass
-		commandBuffer->endRenderPass();
-
-
-		// hostVisibleImage layout to eGeneral
-		commandBuffer->pipelineBarrier(
-			vk::PipelineStageFlagBits::eTopOfPipe,  // srcStageMask
-			vk::PipelineStageFlagBits::eTransfer,   // dstStageMask
-			vk::DependencyFlags(),  // dependencyFlags
-			nullptr,  // memoryBarriers
-			nullptr,  // bufferMemoryBarriers
-			vk::ImageMemoryBarrier{  // imageMemoryBarriers
-				vk::AccessFlags(),                   // srcAccessMask
-				vk::AccessFlagBits::eTransferWrite,  // dstAccessMask
-				vk::ImageLayout::eUndefined,         // oldLayout
-				vk::ImageLayout::eGeneral,           // newLayout
-				0,                          // srcQueueFamilyIndex
-				0,                          // dstQueueFamilyIndex
-				hostVisibleImage.get(),     // image
-				vk::ImageSubresourceRange{  // subresourceRange
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // baseMipLevel
-					1,  // levelCount
-					0,  // baseArrayLayer
-					1   // layerCount
+			);
+
+		// create resources of all frame slots
+		frameSlots.resize(numFramesInFlight);
+		const vk::DeviceSize imageDataSize = vk::DeviceSize(imageExtent.width) * imageExtent.height * 4;
+		for(size_t slotIndex=0; slotIndex<numFramesInFlight; slotIndex++) {
+
+			FrameSlot& slot = frameSlots[slotIndex];
+
+			// framebuffer image
+			slot.framebufferImage =
+				device->createImageUnique(
+					vk::ImageCreateInfo(
+						vk::ImageCreateFlags(),       // flags
+						vk::ImageType::e2D,           // imageType
+						framebufferFormat,            // format
+						vk::Extent3D(imageExtent.width, imageExtent.height, 1),  // extent
+						1,                            // mipLevels
+						1,                            // arrayLayers
+						vk::SampleCountFlagBits::e1,  // samples
+						vk::ImageTiling::eOptimal,    // tiling
+						vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
+						vk::SharingMode::eExclusive,  // sharingMode
+						0,                            // queueFamilyIndexCount
+						nullptr,                      // pQueueFamilyIndices
+						vk::ImageLayout::eUndefined   // initialLayout
+					)
+				);
+			slot.framebufferImageMemory = allocateMemory(slot.framebufferImage.get(), vk::MemoryPropertyFlagBits::eDeviceLocal);
+			device->bindImageMemory(
+				slot.framebufferImage.get(),        // image
+				slot.framebufferImageMemory.get(),  // memory
+				0                                   // memoryOffset
+			);
+
+			// readback buffer
+			// (the rows are tightly packed in the buffer; host cached memory is preferred as the host reads the data)
+			slot.readbackBuffer =
+				device->createBufferUnique(
+					vk::BufferCreateInfo(
+						vk::BufferCreateFlags(),  // flags
+						imageDataSize,            // size
+						vk::BufferUsageFlagBits::eTransferDst,  // usage
+						vk::SharingMode::eExclusive,  // sharingMode
+						0,        // queueFamilyIndexCount
+						nullptr   // pQueueFamilyIndices
+					)
+				);
+			slot.readbackBufferMemory =
+				allocateBufferMemory(
+					slot.readbackBuffer.get(),
+					{ vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached,
+					  vk::MemoryPropertyFlagBits::eHostVisible }
+				);
+			device->bindBufferMemory(
+				slot.readbackBuffer.get(),        // buffer
+				slot.readbackBufferMemory.get(),  // memory
+				0                                 // memoryOffset
+			);
+
+			// map memory
+			// (the memory stays mapped until it is freed)
+			slot.mappedMemory = reinterpret_cast<const char*>(
+				device->mapMemory(slot.readbackBufferMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+
+			// image view
+			slot.frameImageView =
+				device->createImageViewUnique(
+					vk::ImageViewCreateInfo(
+						vk::ImageViewCreateFlags(),   // flags
+						slot.framebufferImage.get(),  // image
+						vk::ImageViewType::e2D,       // viewType
+						framebufferFormat,            // format
+						vk::ComponentMapping(),       // components
+						vk::ImageSubresourceRange(    // subresourceRange
+							vk::ImageAspectFlagBits::eColor,  // aspectMask
+							0,  // baseMipLevel
+							1,  // levelCount
+							0,  // baseArrayLayer
+							1   // layerCount
+						)
+					)
+				);
+
+			// framebuffer
+			slot.framebuffer =
+				device->createFramebufferUnique(
+					vk::FramebufferCreateInfo(
+						vk::FramebufferCreateFlags(),    // flags
+						renderPass.get(),                // renderPass
+						1, &slot.frameImageView.get(),   // attachmentCount, pAttachments
+						imageExtent.width,               // width
+						imageExtent.height,              // height
+						1  // layers
+					)
+				);
+
+			// command buffer
+			slot.commandBuffer = std::move(commandBuffers[slotIndex]);
+
+			// fence
+			slot.renderingFinishedFence =
+				device->createFenceUnique(
+					vk::FenceCreateInfo{
+						vk::FenceCreateFlags()  // flags
+					}
+				);
+		}
+
+		// timestamp pool
+		// (two timestamps per frame slot are used to measure the GPU time of each frame)
+		uint32_t timestampValidBits = physicalDevice.getQueueFamilyProperties()[graphicsQueueFamily].timestampValidBits;
+		uint64_t timestampMask = timestampValidBits>=64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+		float timestampPeriod_ns = physicalDevice.getProperties().limits.timestampPeriod;
+		if(timestampValidBits != 0)
+			timestampPool =
+				device->createQueryPoolUnique(
+					vk::QueryPoolCreateInfo(
+						vk::QueryPoolCreateFlags(),  // flags
+						vk::QueryType::eTimestamp,  // queryType
+						uint32_t(numFramesInFlight*2),  // queryCount
+						vk::QueryPipelineStatisticFlags()  // pipelineStatistics
+					)
+				);
+
+
+		// writer thread
+		// (it waits for the frames in the order of their submission and writes them into the files;
+		// compressed formats are encoded by the worker threads of CompressedWriter
+		// that are reused by all the frames)
+		writerThread = thread(
+			[=]() {
+				try {
+					unique_ptr<CompressedWriter> compressedWriter;
+					if(compressedOutput)
+						compressedWriter = CompressedWriter::create(compressedFormat);
+					const char* extension = compressedOutput ? CompressedWriter::formatName(compressedFormat) : "bmp";
+					for(;;) {
+
+						// get the next submitted slot
+						auto t1 = chrono::steady_clock::now();
+						unique_lock lock(writerMutex);
+						writerCondition.wait(lock, []{ return !submittedSlots.empty() || submissionFinished; });
+						if(submittedSlots.empty())
+							break;
+						size_t slotIndex = submittedSlots.front();
+						submittedSlots.pop_front();
+						lock.unlock();
+						FrameSlot& slot = frameSlots[slotIndex];
+
+						// wait for the work
+						vk::Result r = device->waitForFences(
+							slot.renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
+							VK_TRUE,       // waitAll
+							uint64_t(3e9)  // timeout (3s)
+						);
+						if(r == vk::Result::eTimeout)
+							throw std::runtime_error("GPU timeout. Task is probably hanging.");
+						device->resetFences(slot.renderingFinishedFence.get());
+						auto t2 = chrono::steady_clock::now();
+
+						// read timestamps
+						if(timestampPool) {
+							array<uint64_t,2> timestamps;
+							vk::Result r = device->getQueryPoolResults(
+								timestampPool.get(),  // queryPool
+								uint32_t(slotIndex*2),  // firstQuery
+								2,  // queryCount
+								sizeof(timestamps),  // dataSize
+								timestamps.data(),  // pData
+								sizeof(uint64_t),  // stride
+								vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait  // flags
+							);
+							if(r != vk::Result::eSuccess)
+								throw std::runtime_error("vkGetQueryPoolResults() did not finish with VK_SUCCESS result.");
+							gpuTime += double((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod_ns * 1e-9;
+						}
+
+						// invalidate caches to fetch a new content
+						// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
+						device->invalidateMappedMemoryRanges(
+							vk::MappedMemoryRange(
+								slot.readbackBufferMemory.get(),  // memory
+								0,  // offset
+								VK_WHOLE_SIZE  // size
+							)
+						);
+
+						// write the image
+						char fileName[32];
+						if(numFrames == 1) {
+							snprintf(fileName, sizeof(fileName), "image.%s", extension);
+							cout << "Writing \"" << fileName << "\"..." << endl;
+						}
+						else
+							snprintf(fileName, sizeof(fileName), "image-%04zu.%s", slot.frameIndex, extension);
+						if(compressedWriter) {
+							compressedWriter->open(fileName, imageExtent.width, imageExtent.height, pixelOrder);
+							compressedWriter->writeRows(
+								slot.mappedMemory,  // data
+								size_t(imageExtent.width) * 4,  // rowPitch
+								0,  // y
+								imageExtent.height  // numRows
+							);
+							compressedWriter->close();
+							bytesWritten += compressedWriter->bytesWritten();
+							bytesEncoded += compressedWriter->bytesEncoded();
+							encodeTime += compressedWriter->encodeTime();
+							numEncoderThreads = compressedWriter->numThreads();
+							usedConversion = extension;
+						}
+						else {
+							BmpWriter writer;
+							writer.open(fileName, imageExtent.width, imageExtent.height, writerMethod, pixelOrder);
+							writer.writeRows(
+								slot.mappedMemory,  // data
+								size_t(imageExtent.width) * 4,  // rowPitch
+								0,  // y
+								imageExtent.height  // numRows
+							);
+							writer.close();
+							bytesWritten += writer.bytesWritten();
+							usedConversion = writer.conversionName();
+						}
+						auto t3 = chrono::steady_clock::now();
+						writerWaitTime += chrono::duration<double>(t2 - t1).count();
+						writerBusyTime += chrono::duration<double>(t3 - t2).count();
+
+						// return the slot
+						lock.lock();
+						slot.busy = false;
+						lock.unlock();
+						writerCondition.notify_all();
+
+					}
+				} catch(...) {
+					lock_guard lock(writerMutex);
+					writerException = current_exception();
+					writerCondition.notify_all();
 				}
+			});
+
+
+		// render all the frames
+		// (the submission waits only when all the slots are busy)
+		double submitStallTime = 0.;
+		auto startTime = chrono::steady_clock::now();
+		for(size_t frameIndex=0; frameIndex<numFrames; frameIndex++) {
+
+			// wait for the free slot
+			size_t slotIndex = frameIndex % numFramesInFlight;
+			FrameSlot& slot = frameSlots[slotIndex];
+			auto t1 = chrono::steady_clock::now();
+			{
+				unique_lock lock(writerMutex);
+				writerCondition.wait(lock, [&slot]{ return !slot.busy || writerException; });
+				if(writerException)
+					break;
+				slot.busy = true;
 			}
-		);
-
-		// copy framebufferImage to hostVisibleImage
-		commandBuffer->copyImage(
-			framebufferImage.get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
-			hostVisibleImage.get(), vk::ImageLayout::eGeneral,  // dstImage, dstImageLayout
-			vk::ImageCopy(  // regions
-				vk::ImageSubresourceLayers(  // srcSubresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0,  // baseArrayLayer
-					1   // layerCount
-				),
-				vk::Offset3D(0,0,0),         // srcOffset
-				vk::ImageSubresourceLayers(  // dstSubresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0,  // baseArrayLayer
-					1   // layerCount
-				),
-				vk::Offset3D(0,0,0),         // dstOffset
-				vk::Extent3D(imageExtent.width, imageExtent.height, 1)  // extent
-			)
-		);
+			submitStallTime += chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+			slot.frameIndex = frameIndex;
+
+			// begin command buffer
+			slot.commandBuffer->begin(
+				vk::CommandBufferBeginInfo(
+					vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
+					nullptr  // pInheritanceInfo
+				)
+			);
 
-		// end command buffer
-		commandBuffer->end();
+			// timestamp at the beginning of the frame
+			if(timestampPool) {
+				slot.commandBuffer->resetQueryPool(timestampPool.get(), uint32_t(slotIndex*2), 2);
+				slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampPool.get(), uint32_t(slotIndex*2));
+			}
 
+			// begin render pass
+			slot.commandBuffer->beginRenderPass(
+				vk::RenderPassBeginInfo(
+					renderPass.get(),        // renderPass
+					slot.framebuffer.get(),  // framebuffer
+					vk::Rect2D(vk::Offset2D(0,0), imageExtent),  // renderArea
+					1,      // clearValueCount
+					array{  // pClearValues
+						vk::ClearValue(array<float,4>{0.f,0.f,0.f,1.f}),
+					}.data()
+				),
+				vk::SubpassContents::eInline
+			);
 
-		// fence
-		renderingFinishedFence =
-			device->createFenceUnique(
-				vk::FenceCreateInfo{
-					vk::FenceCreateFlags()  // flags
-				}
+			// rendering commands
+			// (frame index is passed as the first instance to rotate the triangle)
+			slot.commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());  // bind pipeline
+			slot.commandBuffer->draw(3, 1, 0, uint32_t(frameIndex));  // draw single triangle
+
+			// end render pass
+			slot.commandBuffer->endRenderPass();
+
+			// copy framebufferImage to readbackBuffer
+			// (bufferRowLength and bufferImageHeight are zero, so the rows are tightly packed)
+			slot.commandBuffer->copyImageToBuffer(
+				slot.framebufferImage.get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
+				slot.readbackBuffer.get(),  // dstBuffer
+				vk::BufferImageCopy(  // regions
+					0,  // bufferOffset
+					0,  // bufferRowLength
+					0,  // bufferImageHeight
+					vk::ImageSubresourceLayers(  // imageSubresource
+						vk::ImageAspectFlagBits::eColor,  // aspectMask
+						0,  // mipLevel
+						0,  // baseArrayLayer
+						1   // layerCount
+					),
+					vk::Offset3D(0,0,0),  // imageOffset
+					vk::Extent3D(imageExtent.width, imageExtent.height, 1)  // imageExtent
+				)
 			);
 
-		// submit work
-		graphicsQueue.submit(
-			vk::SubmitInfo(  // submits
-				0, nullptr, nullptr,       // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
-				1, &commandBuffer.get(),   // commandBufferCount, pCommandBuffers
-				0, nullptr                 // signalSemaphoreCount, pSignalSemaphores
-			),
-			renderingFinishedFence.get()  // fence
-		);
-
-		// wait for the work
-		vk::Result r = device->waitForFences(
-			renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
-			VK_TRUE,       // waitAll
-			uint64_t(3e9)  // timeout (3s)
-		);
-		if(r == vk::Result::eTimeout)
-			throw std::runtime_error("GPU timeout. Task is probably hanging.");
-
-
-		// map memory
-		struct MappedMemoryDeleter { void operator()(void*) { device->unmapMemory(hostVisibleImageMemory.get()); } } mappedMemoryDeleter;
-		unique_ptr<void, MappedMemoryDeleter> m(
-			device->mapMemory(hostVisibleImageMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()),  // pointer
-			mappedMemoryDeleter  // deleter
-		);
-
-		// invalidate caches to fetch a new content
-		// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
-		device->invalidateMappedMemoryRanges(
-			vk::MappedMemoryRange(
-				hostVisibleImageMemory.get(),  // memory
-				0,  // offset
-				VK_WHOLE_SIZE  // size
-			)
-		);
-
-		// get image memory layout
-		vk::SubresourceLayout hostImageLayout =
-			device->getImageSubresourceLayout(
-				hostVisibleImage.get(),  // image
-				vk::ImageSubresource{    // subresource
-					vk::ImageAspectFlagBits::eColor,  // aspectMask
-					0,  // mipLevel
-					0   // arrayLayer
-				}
+			// make the copied data available to the host
+			slot.commandBuffer->pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+				vk::PipelineStageFlagBits::eHost,      // dstStageMask
+				vk::DependencyFlags(),  // dependencyFlags
+				vk::MemoryBarrier(  // memoryBarriers
+					vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+					vk::AccessFlagBits::eHostRead        // dstAccessMask
+				),
+				nullptr,  // bufferMemoryBarriers
+				nullptr   // imageMemoryBarriers
 			);
 
+			// timestamp at the end of the frame
+			if(timestampPool)
+				slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampPool.get(), uint32_t(slotIndex*2+1));
+
+			// end command buffer
+			slot.commandBuffer->end();
+
+			// submit work
+			graphicsQueue.submit(
+				vk::SubmitInfo(  // submits
+					0, nullptr, nullptr,            // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
+					1, &slot.commandBuffer.get(),   // commandBufferCount, pCommandBuffers
+					0, nullptr                      // signalSemaphoreCount, pSignalSemaphores
+				),
+				slot.renderingFinishedFence.get()  // fence
+			);
 
-		// open the output file
-		cout << "Writing \"image.bmp\"..." << endl;
-		fstream s("image.bmp", fstream::out | fstream::binary);
-
-		// write BitmapFileHeader
-		struct BitmapFileHeader {
-			uint16_t type = 0x4d42;
-			uint16_t sizeLo;
-			uint16_t sizeHi;
-			uint16_t reserved1 = 0;
-			uint16_t reserved2 = 0;
-			uint16_t offsetLo;
-			uint16_t offsetHi;
-		};
-		static_assert(sizeof(BitmapFileHeader)==14, "Wrong alignment of BitmapFileHeader members.");
-
-		uint32_t imageDataSize = imageExtent.width*imageExtent.height*4;
-		uint32_t fileSize = imageDataSize+14+40+2;
-		BitmapFileHeader bitmapFileHeader = {
-			0x4d42,
-			uint16_t(fileSize&0xffff),
-			uint16_t(fileSize>>16),
-			0, 0,
-			14+40+2,  // equal to sum of sizeof(BitmapFileHeader), sizeof(BitmapInfoHeader) and 2 (as alignment)
-			0
-		};
-		s.write(reinterpret_cast<char*>(&bitmapFileHeader), sizeof(BitmapFileHeader));
-
-		// write BitmapInfoHeader
-		struct BitmapInfoHeader {
-			uint32_t size = 40;
-			int32_t  width;
-			int32_t  height;
-			uint16_t numPlanes = 1;
-			uint16_t bpp = 32;
-			uint32_t compression = 0;  // 0 - no compression
-			uint32_t imageDataSize;
-			int32_t  xPixelsPerMeter;
-			int32_t  yPixelsPerMeter;
-			uint32_t numColorsInPalette = 0;  // no colors in color palette
-			uint32_t numImportantColors = 0;  // all colors are important
-		};
-		static_assert(sizeof(BitmapInfoHeader)==40, "Wrong size of BitmapInfoHeader.");
-
-		BitmapInfoHeader bitmapInfoHeader = {
-			40,
-			int32_t(imageExtent.width),
-			-int32_t(imageExtent.height),
-			1, 32, 0,
-			imageDataSize,
-			2835, 2835,  // roughly 72 DPI
-			0, 0
-		};
-		s.write(reinterpret_cast<char*>(&bitmapInfoHeader), sizeof(BitmapInfoHeader));
-		s.write(array<char,2>{'\0','\0'}.data(), 2);
-
-		// write image data,
-		// line by line
-		const char* linePtr = reinterpret_cast<char*>(m.get());
-		char b[4];
-		for(auto y=imageExtent.height; y>0; y--) {
-			for(size_t i=0, e=imageExtent.width*4; i<e; i+=4) {
-				b[0] = linePtr[i+2];
-				b[1] = linePtr[i+1];
-				b[2] = linePtr[i+0];
-				b[3] = linePtr[i+3];
-				s.write(b, 4);
+			// pass the slot to the writer thread
+			{
+				lock_guard lock(writerMutex);
+				submittedSlots.push_back(slotIndex);
 			}
-			linePtr += hostImageLayout.rowPitch;
+			writerCondition.notify_all();
+		}
+
+		// wait for the writer thread
+		{
+			lock_guard lock(writerMutex);
+			submissionFinished = true;
+		}
+		writerCondition.notify_all();
+		writerThread.join();
+		if(writerException)
+			rethrow_exception(writerException);
+		double totalTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		// print statistics
+		cout << "Done. Written " << double(bytesWritten)/(1024*1024) << " MiB in "
+		     << writerBusyTime*1000 << " ms (" << (writerBusyTime>0. ? double(bytesWritten)/writerBusyTime*1e-6 : 0.)
+		     << " MB/s, " << usedConversion << " writer)." << endl;
+		if(compressedOutput)
+			cout << "Encoded " << double(bytesEncoded)/(1024*1024) << " MiB with compression ratio "
+			     << (bytesWritten>0 ? double(bytesEncoded)/bytesWritten : 0.) << " in " << encodeTime*1000
+			     << " ms of CPU time on " << numEncoderThreads << " threads." << endl;
+		if(timestampPool)
+			cout << "GPU render time: " << gpuTime*1000 << " ms." << endl;
+		if(numFrames > 1) {
+			cout << "Rendered " << numFrames << " frames with " << numFramesInFlight << " frames in flight in "
+			     << totalTime*1000 << " ms (" << double(numFrames)/totalTime << " FPS)." << endl;
+			cout << "Stage occupancy:" << endl;
+			cout << "   Submission stalled:  " << submitStallTime/totalTime*100 << "%" << endl;
+			if(timestampPool)
+				cout << "   GPU busy:            " << gpuTime/totalTime*100 << "%" << endl;
+			else
+				cout << "   GPU busy:            timestamps not supported" << endl;
+			cout << "   Writer waiting:      " << writerWaitTime/totalTime*100 << "%" << endl;
+			cout << "   Writer busy:         " << writerBusyTime/totalTime*100 << "%" << endl;
 		}
-		cout << "Done." << endl;
 
 	// catch exceptions
 	} catch(vk::Error& e) {
@@ -668,6 +896,17 @@ int main(int, char**)
 		cout << "Failed because of unspecified exception." << endl;
 	}
 
+	// stop writer thread
+	// (it finishes the frames that were already submitted)
+	if(writerThread.joinable()) {
+		{
+			lock_guard lock(writerMutex);
+			submissionFinished = true;
+		}
+		writerCondition.notify_all();
+		writerThread.join();
+	}
+
 	// wait device idle
 	// this is important if there was an exception and device is still busy
 	// (device need to be idle before destruction of buffers and other stuff)
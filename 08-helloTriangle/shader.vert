@@ -22,6 +22,10 @@ vec3 colors[3] = vec3[](
 
 void main()
 {
-	gl_Position=vec4(positions[gl_VertexIndex],0.0,1.0);
+	// rotate the triangle by 6 degrees per instance index
+	// (instance index is used as the frame number when image sequence is rendered)
+	float alpha=radians(gl_InstanceIndex*6);
+	vec2 p=positions[gl_VertexIndex];
+	gl_Position=vec4(p.x*cos(alpha)-p.y*sin(alpha),p.x*sin(alpha)+p.y*cos(alpha),0.0,1.0);
 	outColor=colors[gl_VertexIndex];
 }
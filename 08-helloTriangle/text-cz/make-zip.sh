@@ -10,12 +10,12 @@ if test -f $NAME-text.zip; then
 fi
 zip $NAME-text.zip text.html image.bmp
 mkdir tmp
-cp ../main.cpp ../FindVulkan.cmake ../shader.vert ../shader.frag tmp/
+cp ../main.cpp ../BmpWriter.h ../BmpWriter.cpp ../CompressedWriter.h ../CompressedWriter.cpp ../FindVulkan.cmake ../shader.vert ../shader.frag tmp/
 echo "cmake_minimum_required(VERSION 3.10.2)" > tmp/CMakeLists.txt
 echo >> tmp/CMakeLists.txt
 cat < ../CMakeLists.txt >> tmp/CMakeLists.txt
 cd tmp
-zip $NAME.zip main.cpp FindVulkan.cmake shader.vert shader.frag CMakeLists.txt
+zip $NAME.zip main.cpp BmpWriter.h BmpWriter.cpp CompressedWriter.h CompressedWriter.cpp FindVulkan.cmake shader.vert shader.frag CMakeLists.txt
 mv $NAME.zip ..
 cmake .
 make
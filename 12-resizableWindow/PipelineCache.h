@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <mutex>
+#include <vulkan/vulkan.hpp>
+
+
+/** PipelineCache keeps vk::PipelineCache persistent between the application runs.
+ *  The cache blob is loaded from the file on init() and written back by save().
+ *  The blob is used only if its header matches the vendor, the device and the pipelineCacheUUID
+ *  of the physical device; otherwise, the cache starts empty (cold). The file is written atomically
+ *  by writing a temporary file and renaming it over the old one, so an interrupted write never leaves
+ *  a damaged cache behind. All the pipelines are expected to be created through the cache,
+ *  so it can measure their creation time. The pipelines might be created from more threads at once,
+ *  as vk::PipelineCache is internally synchronized and the statistics are guarded by a mutex. */
+class PipelineCache {
+protected:
+	vk::Device _device;
+	vk::PipelineCache _pipelineCache;
+	std::filesystem::path _filePath;
+	bool _warm = false;  // valid blob was loaded
+	size_t _loadedSize = 0;
+	size_t _numPipelines = 0;
+	double _creationTime = 0.;  // in seconds
+	mutable std::mutex _statsMutex;  // guards _numPipelines and _creationTime
+	void addCreationTime(double seconds);
+public:
+
+	PipelineCache() = default;
+	~PipelineCache();
+	void init(vk::PhysicalDevice physicalDevice, vk::Device device, const char* appName);
+	void save();
+	void destroy() noexcept;
+
+	// pipeline creation
+	vk::Pipeline createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo& createInfo);
+	vk::UniquePipeline createGraphicsPipelineUnique(const vk::GraphicsPipelineCreateInfo& createInfo);
+	vk::Pipeline createComputePipeline(const vk::ComputePipelineCreateInfo& createInfo);
+	vk::UniquePipeline createComputePipelineUnique(const vk::ComputePipelineCreateInfo& createInfo);
+
+	// getters
+	vk::PipelineCache get() const;
+	const std::filesystem::path& filePath() const;
+	bool warm() const;
+	size_t numPipelines() const;  // created since init()
+	double creationTime() const;  // of all the pipelines, in seconds
+	void printStats() const;
+
+	static std::filesystem::path defaultFilePath(vk::PhysicalDevice physicalDevice, const char* appName);
+
+};
+
+
+// inline methods
+inline PipelineCache::~PipelineCache()  { destroy(); }
+inline vk::PipelineCache PipelineCache::get() const  { return _pipelineCache; }
+inline const std::filesystem::path& PipelineCache::filePath() const  { return _filePath; }
+inline bool PipelineCache::warm() const  { return _warm; }
+inline size_t PipelineCache::numPipelines() const  { std::lock_guard lock(_statsMutex); return _numPipelines; }
+inline double PipelineCache::creationTime() const  { std::lock_guard lock(_statsMutex); return _creationTime; }
+inline void PipelineCache::addCreationTime(double seconds)  { std::lock_guard lock(_statsMutex); _numPipelines++; _creationTime += seconds; }
@@ -1,5 +1,7 @@
 #include "VulkanWindow.h"
+#include "PipelineCache.h"
 #include <algorithm>
+#include <chrono>
 #include <iostream>
 
 using namespace std;
@@ -34,6 +36,7 @@ static vk::PhysicalDevice physicalDevice;
 static uint32_t graphicsQueueFamily;
 static uint32_t presentationQueueFamily;
 static vk::UniqueDevice device;
+static PipelineCache pipelineCache;
 static vk::Queue graphicsQueue;
 static vk::Queue presentationQueue;
 static vk::SurfaceFormatKHR surfaceFormat;
@@ -50,6 +53,10 @@ static vk::UniqueShaderModule fsModule;
 static vk::UniquePipelineLayout pipelineLayout;
 static vk::UniquePipeline pipeline;
 
+// resize latency measurement
+static chrono::high_resolution_clock::time_point resizeStartTime;
+static bool resizeMeasurementPending = false;
+
 
 int main(int, char**)
 {
@@ -195,6 +202,10 @@ int main(int, char**)
 		graphicsQueue = device->getQueue(graphicsQueueFamily, 0);
 		presentationQueue = device->getQueue(presentationQueueFamily, 0);
 
+		// pipeline cache
+		// (loaded from the previous run, if any)
+		pipelineCache.init(physicalDevice, device.get(), appName);
+
 		// print surface formats
 		cout << "Surface formats:" << endl;
 		vector<vk::SurfaceFormatKHR> availableSurfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface);
@@ -285,6 +296,10 @@ int main(int, char**)
 		window.setRecreateSwapchainCallback(
 			[](const vk::SurfaceCapabilitiesKHR& surfaceCapabilities, vk::Extent2D newSurfaceExtent) {
 
+				// start measuring resize latency
+				resizeStartTime = chrono::high_resolution_clock::now();
+				resizeMeasurementPending = true;
+
 				// clear resources
 				swapchainImageViews.clear();
 				framebuffers.clear();
@@ -362,124 +377,6 @@ int main(int, char**)
 						)
 					);
 
-				// pipeline
-				pipeline =
-					device->createGraphicsPipelineUnique(
-						nullptr,  // pipelineCache
-						vk::GraphicsPipelineCreateInfo(
-							vk::PipelineCreateFlags(),  // flags
-
-							// shader stages
-							2,  // stageCount
-							array{  // pStages
-								vk::PipelineShaderStageCreateInfo{
-									vk::PipelineShaderStageCreateFlags(),  // flags
-									vk::ShaderStageFlagBits::eVertex,  // stage
-									vsModule.get(),  // module
-									"main",  // pName
-									nullptr  // pSpecializationInfo
-								},
-								vk::PipelineShaderStageCreateInfo{
-									vk::PipelineShaderStageCreateFlags(),  // flags
-									vk::ShaderStageFlagBits::eFragment,  // stage
-									fsModule.get(),  // module
-									"main",  // pName
-									nullptr  // pSpecializationInfo
-								},
-							}.data(),
-
-							// vertex input
-							&(const vk::PipelineVertexInputStateCreateInfo&)vk::PipelineVertexInputStateCreateInfo{  // pVertexInputState
-								vk::PipelineVertexInputStateCreateFlags(),  // flags
-								0,        // vertexBindingDescriptionCount
-								nullptr,  // pVertexBindingDescriptions
-								0,        // vertexAttributeDescriptionCount
-								nullptr   // pVertexAttributeDescriptions
-							},
-
-							// input assembly
-							&(const vk::PipelineInputAssemblyStateCreateInfo&)vk::PipelineInputAssemblyStateCreateInfo{  // pInputAssemblyState
-								vk::PipelineInputAssemblyStateCreateFlags(),  // flags
-								vk::PrimitiveTopology::eTriangleList,  // topology
-								VK_FALSE  // primitiveRestartEnable
-							},
-
-							// tessellation
-							nullptr, // pTessellationState
-
-							// viewport
-							&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
-								vk::PipelineViewportStateCreateFlags(),  // flags
-								1,  // viewportCount
-								array{  // pViewports
-									vk::Viewport(0.f, 0.f, float(newSurfaceExtent.width), float(newSurfaceExtent.height), 0.f, 1.f),
-								}.data(),
-								1,  // scissorCount
-								array{  // pScissors
-									vk::Rect2D(vk::Offset2D(0,0), newSurfaceExtent)
-								}.data(),
-							},
-
-							// rasterization
-							&(const vk::PipelineRasterizationStateCreateInfo&)vk::PipelineRasterizationStateCreateInfo{  // pRasterizationState
-								vk::PipelineRasterizationStateCreateFlags(),  // flags
-								VK_FALSE,  // depthClampEnable
-								VK_FALSE,  // rasterizerDiscardEnable
-								vk::PolygonMode::eFill,  // polygonMode
-								vk::CullModeFlagBits::eNone,  // cullMode
-								vk::FrontFace::eCounterClockwise,  // frontFace
-								VK_FALSE,  // depthBiasEnable
-								0.f,  // depthBiasConstantFactor
-								0.f,  // depthBiasClamp
-								0.f,  // depthBiasSlopeFactor
-								1.f   // lineWidth
-							},
-
-							// multisampling
-							&(const vk::PipelineMultisampleStateCreateInfo&)vk::PipelineMultisampleStateCreateInfo{  // pMultisampleState
-								vk::PipelineMultisampleStateCreateFlags(),  // flags
-								vk::SampleCountFlagBits::e1,  // rasterizationSamples
-								VK_FALSE,  // sampleShadingEnable
-								0.f,       // minSampleShading
-								nullptr,   // pSampleMask
-								VK_FALSE,  // alphaToCoverageEnable
-								VK_FALSE   // alphaToOneEnable
-							},
-
-							// depth and stencil
-							nullptr,  // pDepthStencilState
-
-							// blending
-							&(const vk::PipelineColorBlendStateCreateInfo&)vk::PipelineColorBlendStateCreateInfo{  // pColorBlendState
-								vk::PipelineColorBlendStateCreateFlags(),  // flags
-								VK_FALSE,  // logicOpEnable
-								vk::LogicOp::eClear,  // logicOp
-								1,  // attachmentCount
-								array{  // pAttachments
-									vk::PipelineColorBlendAttachmentState{
-										VK_FALSE,  // blendEnable
-										vk::BlendFactor::eZero,  // srcColorBlendFactor
-										vk::BlendFactor::eZero,  // dstColorBlendFactor
-										vk::BlendOp::eAdd,       // colorBlendOp
-										vk::BlendFactor::eZero,  // srcAlphaBlendFactor
-										vk::BlendFactor::eZero,  // dstAlphaBlendFactor
-										vk::BlendOp::eAdd,       // alphaBlendOp
-										vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
-											vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA  // colorWriteMask
-									},
-								}.data(),
-								array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
-							},
-
-							nullptr,  // pDynamicState
-							pipelineLayout.get(),  // layout
-							renderPass.get(),  // renderPass
-							0,  // subpass
-							vk::Pipeline(nullptr),  // basePipelineHandle
-							-1 // basePipelineIndex
-						)
-					).value;
-
 			});
 
 		// commandPool and commandBuffer
@@ -544,6 +441,130 @@ int main(int, char**)
 				}
 			);
 
+		// pipeline
+		// (it is created once, as it does not depend on the swapchain)
+		pipeline =
+			pipelineCache.createGraphicsPipelineUnique(
+				vk::GraphicsPipelineCreateInfo(
+					vk::PipelineCreateFlags(),  // flags
+
+					// shader stages
+					2,  // stageCount
+					array{  // pStages
+						vk::PipelineShaderStageCreateInfo{
+							vk::PipelineShaderStageCreateFlags(),  // flags
+							vk::ShaderStageFlagBits::eVertex,  // stage
+							vsModule.get(),  // module
+							"main",  // pName
+							nullptr  // pSpecializationInfo
+						},
+						vk::PipelineShaderStageCreateInfo{
+							vk::PipelineShaderStageCreateFlags(),  // flags
+							vk::ShaderStageFlagBits::eFragment,  // stage
+							fsModule.get(),  // module
+							"main",  // pName
+							nullptr  // pSpecializationInfo
+						},
+					}.data(),
+
+					// vertex input
+					&(const vk::PipelineVertexInputStateCreateInfo&)vk::PipelineVertexInputStateCreateInfo{  // pVertexInputState
+						vk::PipelineVertexInputStateCreateFlags(),  // flags
+						0,        // vertexBindingDescriptionCount
+						nullptr,  // pVertexBindingDescriptions
+						0,        // vertexAttributeDescriptionCount
+						nullptr   // pVertexAttributeDescriptions
+					},
+
+					// input assembly
+					&(const vk::PipelineInputAssemblyStateCreateInfo&)vk::PipelineInputAssemblyStateCreateInfo{  // pInputAssemblyState
+						vk::PipelineInputAssemblyStateCreateFlags(),  // flags
+						vk::PrimitiveTopology::eTriangleList,  // topology
+						VK_FALSE  // primitiveRestartEnable
+					},
+
+					// tessellation
+					nullptr, // pTessellationState
+
+					// viewport
+					// (viewport and scissor are dynamic state, so the pipeline survives the window resize)
+					&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
+						vk::PipelineViewportStateCreateFlags(),  // flags
+						1,  // viewportCount
+						nullptr,  // pViewports
+						1,  // scissorCount
+						nullptr  // pScissors
+					},
+
+					// rasterization
+					&(const vk::PipelineRasterizationStateCreateInfo&)vk::PipelineRasterizationStateCreateInfo{  // pRasterizationState
+						vk::PipelineRasterizationStateCreateFlags(),  // flags
+						VK_FALSE,  // depthClampEnable
+						VK_FALSE,  // rasterizerDiscardEnable
+						vk::PolygonMode::eFill,  // polygonMode
+						vk::CullModeFlagBits::eNone,  // cullMode
+						vk::FrontFace::eCounterClockwise,  // frontFace
+						VK_FALSE,  // depthBiasEnable
+						0.f,  // depthBiasConstantFactor
+						0.f,  // depthBiasClamp
+						0.f,  // depthBiasSlopeFactor
+						1.f   // lineWidth
+					},
+
+					// multisampling
+					&(const vk::PipelineMultisampleStateCreateInfo&)vk::PipelineMultisampleStateCreateInfo{  // pMultisampleState
+						vk::PipelineMultisampleStateCreateFlags(),  // flags
+						vk::SampleCountFlagBits::e1,  // rasterizationSamples
+						VK_FALSE,  // sampleShadingEnable
+						0.f,       // minSampleShading
+						nullptr,   // pSampleMask
+						VK_FALSE,  // alphaToCoverageEnable
+						VK_FALSE   // alphaToOneEnable
+					},
+
+					// depth and stencil
+					nullptr,  // pDepthStencilState
+
+					// blending
+					&(const vk::PipelineColorBlendStateCreateInfo&)vk::PipelineColorBlendStateCreateInfo{  // pColorBlendState
+						vk::PipelineColorBlendStateCreateFlags(),  // flags
+						VK_FALSE,  // logicOpEnable
+						vk::LogicOp::eClear,  // logicOp
+						1,  // attachmentCount
+						array{  // pAttachments
+							vk::PipelineColorBlendAttachmentState{
+								VK_FALSE,  // blendEnable
+								vk::BlendFactor::eZero,  // srcColorBlendFactor
+								vk::BlendFactor::eZero,  // dstColorBlendFactor
+								vk::BlendOp::eAdd,       // colorBlendOp
+								vk::BlendFactor::eZero,  // srcAlphaBlendFactor
+								vk::BlendFactor::eZero,  // dstAlphaBlendFactor
+								vk::BlendOp::eAdd,       // alphaBlendOp
+								vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+									vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA  // colorWriteMask
+							},
+						}.data(),
+						array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
+					},
+
+					// dynamic state
+					&(const vk::PipelineDynamicStateCreateInfo&)vk::PipelineDynamicStateCreateInfo{  // pDynamicState
+						vk::PipelineDynamicStateCreateFlags(),  // flags
+						2,  // dynamicStateCount
+						array{  // pDynamicStates
+							vk::DynamicState::eViewport,
+							vk::DynamicState::eScissor,
+						}.data()
+					},
+
+					pipelineLayout.get(),  // layout
+					renderPass.get(),  // renderPass
+					0,  // subpass
+					vk::Pipeline(nullptr),  // basePipelineHandle
+					-1 // basePipelineIndex
+				)
+			);
+
 		window.setFrameCallback(
 			[]() {
 
@@ -596,6 +617,14 @@ int main(int, char**)
 
 				// rendering commands
 				commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());  // bind pipeline
+				commandBuffer.setViewport(
+					0,  // firstViewport
+					vk::Viewport(0.f, 0.f, float(window.surfaceExtent().width), float(window.surfaceExtent().height), 0.f, 1.f)  // viewports
+				);
+				commandBuffer.setScissor(
+					0,  // firstScissor
+					vk::Rect2D(vk::Offset2D(0, 0), window.surfaceExtent())  // scissors
+				);
 				commandBuffer.draw(  // draw single triangle
 					3,  // vertexCount
 					1,  // instanceCount
@@ -642,6 +671,15 @@ int main(int, char**)
 						throw runtime_error("Vulkan error: vkQueuePresentKHR() failed with error " + to_string(r) + ".");
 				}
 
+				// report resize latency
+				// (time from the swapchain recreation to the presentation of the first frame)
+				if(resizeMeasurementPending) {
+					resizeMeasurementPending = false;
+					cout << "Resize to first frame: "
+					     << chrono::duration<double>(chrono::high_resolution_clock::now() - resizeStartTime).count() * 1000
+					     << "ms" << endl;
+				}
+
 			},
 			physicalDevice,
 			device.get()
@@ -650,6 +688,10 @@ int main(int, char**)
 		// run main loop
 		window.mainLoop();
 
+		// save pipeline cache for the next run
+		pipelineCache.printStats();
+		pipelineCache.save();
+
 	// catch exceptions
 	} catch(vk::Error& e) {
 		cout << "Failed because of Vulkan exception: " << e.what() << endl;
@@ -1,4 +1,5 @@
 #include "VulkanWindow.h"
+#include "PipelineCache.h"
 #include <algorithm>
 #include <chrono>
 #include <iostream>
@@ -45,6 +46,7 @@ public:
 	uint32_t graphicsQueueFamily;
 	uint32_t presentationQueueFamily;
 	vk::Device device;
+	PipelineCache pipelineCache;
 	vk::Queue graphicsQueue;
 	vk::Queue presentationQueue;
 	vk::SurfaceFormatKHR surfaceFormat;
@@ -67,6 +69,8 @@ public:
 	size_t frameID = ~size_t(0);
 	size_t fpsNumFrames = ~size_t(0);
 	chrono::high_resolution_clock::time_point fpsStartTime;
+	chrono::high_resolution_clock::time_point resizeStartTime;
+	bool resizeMeasurementPending = false;
 
 };
 
@@ -124,6 +128,7 @@ App::~App()
 		for(auto v : swapchainImageViews)  device.destroy(v);
 		device.destroy(swapchain);
 		device.destroy(renderPass);
+		pipelineCache.destroy();
 		device.destroy();
 	}
 
@@ -282,6 +287,10 @@ void App::init()
 	graphicsQueue = device.getQueue(graphicsQueueFamily, 0);
 	presentationQueue = device.getQueue(presentationQueueFamily, 0);
 
+	// pipeline cache
+	// (loaded from the previous run, if any)
+	pipelineCache.init(physicalDevice, device, appName);
+
 	// print surface formats
 	cout << "Surface formats:" << endl;
 	vector<vk::SurfaceFormatKHR> availableSurfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface);
@@ -436,114 +445,11 @@ void App::init()
 				nullptr  // pPushConstantRanges
 			}
 		);
-}
-
-
-/** Recreate swapchain and pipeline callback method.
- *  The method is usually called after the window resize and on the application start. */
-void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& surfaceCapabilities,
-                            vk::Extent2D newSurfaceExtent)
-{
-	// clear resources
-	for(auto v : swapchainImageViews)  device.destroy(v);
-	swapchainImageViews.clear();
-	for(auto f : framebuffers)  device.destroy(f);
-	framebuffers.clear();
-	device.destroy(pipeline);
-	pipeline = nullptr;
-
-	// print info
-	cout << "Recreating swapchain (extent: " << newSurfaceExtent.width << "x" << newSurfaceExtent.height
-	     << ", extent by surfaceCapabilities: " << surfaceCapabilities.currentExtent.width << "x"
-	     << surfaceCapabilities.currentExtent.height << ", minImageCount: " << surfaceCapabilities.minImageCount
-	     << ", maxImageCount: " << surfaceCapabilities.maxImageCount << ")" << endl;
-
-	// create new swapchain
-	constexpr const uint32_t requestedImageCount = 2;
-	vk::UniqueSwapchainKHR newSwapchain =
-		device.createSwapchainKHRUnique(
-			vk::SwapchainCreateInfoKHR(
-				vk::SwapchainCreateFlagsKHR(),  // flags
-				window.surface(),               // surface
-				surfaceCapabilities.maxImageCount==0  // minImageCount
-					? max(requestedImageCount, surfaceCapabilities.minImageCount)
-					: clamp(requestedImageCount, surfaceCapabilities.minImageCount, surfaceCapabilities.maxImageCount),
-				surfaceFormat.format,           // imageFormat
-				surfaceFormat.colorSpace,       // imageColorSpace
-				newSurfaceExtent,               // imageExtent
-				1,                              // imageArrayLayers
-				vk::ImageUsageFlagBits::eColorAttachment,  // imageUsage
-				(graphicsQueueFamily==presentationQueueFamily) ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent, // imageSharingMode
-				uint32_t(2),  // queueFamilyIndexCount
-				array<uint32_t, 2>{graphicsQueueFamily, presentationQueueFamily}.data(),  // pQueueFamilyIndices
-				surfaceCapabilities.currentTransform,    // preTransform
-				vk::CompositeAlphaFlagBitsKHR::eOpaque,  // compositeAlpha
-				[](FrameUpdateMode frameUpdateMode, vk::PhysicalDevice physicalDevice, VulkanWindow& window)  // presentMode
-					{
-						// for MaxFrameRate, try Mailbox and Immediate if they are available
-						if(frameUpdateMode == FrameUpdateMode::MaxFrameRate) {
-							vector<vk::PresentModeKHR> modes =
-								physicalDevice.getSurfacePresentModesKHR(window.surface());
-							if(find(modes.begin(), modes.end(), vk::PresentModeKHR::eMailbox) != modes.end())
-								return vk::PresentModeKHR::eMailbox;
-							if(find(modes.begin(), modes.end(), vk::PresentModeKHR::eImmediate) != modes.end())
-								return vk::PresentModeKHR::eImmediate;
-						}
-
-						// return Fifo that is always supported
-						return vk::PresentModeKHR::eFifo;
-					}(frameUpdateMode, physicalDevice, window),
-				VK_TRUE,  // clipped
-				swapchain  // oldSwapchain
-			)
-		);
-	device.destroy(swapchain);
-	swapchain = newSwapchain.release();
-
-	// swapchain images and image views
-	vector<vk::Image> swapchainImages = device.getSwapchainImagesKHR(swapchain);
-	swapchainImageViews.reserve(swapchainImages.size());
-	for(vk::Image image : swapchainImages)
-		swapchainImageViews.emplace_back(
-			device.createImageView(
-				vk::ImageViewCreateInfo(
-					vk::ImageViewCreateFlags(),  // flags
-					image,                       // image
-					vk::ImageViewType::e2D,      // viewType
-					surfaceFormat.format,        // format
-					vk::ComponentMapping(),      // components
-					vk::ImageSubresourceRange(   // subresourceRange
-						vk::ImageAspectFlagBits::eColor,  // aspectMask
-						0,  // baseMipLevel
-						1,  // levelCount
-						0,  // baseArrayLayer
-						1   // layerCount
-					)
-				)
-			)
-		);
-
-	// framebuffers
-	framebuffers.reserve(swapchainImages.size());
-	for(size_t i=0, c=swapchainImages.size(); i<c; i++)
-		framebuffers.emplace_back(
-			device.createFramebuffer(
-				vk::FramebufferCreateInfo(
-					vk::FramebufferCreateFlags(),  // flags
-					renderPass,  // renderPass
-					1,  // attachmentCount
-					&swapchainImageViews[i],  // pAttachments
-					newSurfaceExtent.width,  // width
-					newSurfaceExtent.height,  // height
-					1  // layers
-				)
-			)
-		);
 
 	// pipeline
+	// (it is created once, as it does not depend on the swapchain)
 	pipeline =
-		device.createGraphicsPipeline(
-			nullptr,  // pipelineCache
+		pipelineCache.createGraphicsPipeline(
 			vk::GraphicsPipelineCreateInfo(
 				vk::PipelineCreateFlags(),  // flags
 
@@ -586,16 +492,13 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 				nullptr, // pTessellationState
 
 				// viewport
+				// (viewport and scissor are dynamic state, so the pipeline survives the window resize)
 				&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
 					vk::PipelineViewportStateCreateFlags(),  // flags
 					1,  // viewportCount
-					array{  // pViewports
-						vk::Viewport(0.f, 0.f, float(newSurfaceExtent.width), float(newSurfaceExtent.height), 0.f, 1.f),
-					}.data(),
+					nullptr,  // pViewports
 					1,  // scissorCount
-					array{  // pScissors
-						vk::Rect2D(vk::Offset2D(0,0), newSurfaceExtent)
-					}.data(),
+					nullptr  // pScissors
 				},
 
 				// rasterization
@@ -649,14 +552,128 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 					array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
 				},
 
-				nullptr,  // pDynamicState
+				// dynamic state
+				&(const vk::PipelineDynamicStateCreateInfo&)vk::PipelineDynamicStateCreateInfo{  // pDynamicState
+					vk::PipelineDynamicStateCreateFlags(),  // flags
+					2,  // dynamicStateCount
+					array{  // pDynamicStates
+						vk::DynamicState::eViewport,
+						vk::DynamicState::eScissor,
+					}.data()
+				},
+
 				pipelineLayout,  // layout
 				renderPass,  // renderPass
 				0,  // subpass
 				vk::Pipeline(nullptr),  // basePipelineHandle
 				-1 // basePipelineIndex
 			)
-		).value;
+		);
+}
+
+
+/** Recreate swapchain callback method.
+ *  The method is usually called after the window resize and on the application start. */
+void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& surfaceCapabilities,
+                            vk::Extent2D newSurfaceExtent)
+{
+	// start measuring resize latency
+	resizeStartTime = chrono::high_resolution_clock::now();
+	resizeMeasurementPending = true;
+
+	// clear resources
+	for(auto v : swapchainImageViews)  device.destroy(v);
+	swapchainImageViews.clear();
+	for(auto f : framebuffers)  device.destroy(f);
+	framebuffers.clear();
+
+	// print info
+	cout << "Recreating swapchain (extent: " << newSurfaceExtent.width << "x" << newSurfaceExtent.height
+	     << ", extent by surfaceCapabilities: " << surfaceCapabilities.currentExtent.width << "x"
+	     << surfaceCapabilities.currentExtent.height << ", minImageCount: " << surfaceCapabilities.minImageCount
+	     << ", maxImageCount: " << surfaceCapabilities.maxImageCount << ")" << endl;
+
+	// create new swapchain
+	constexpr const uint32_t requestedImageCount = 2;
+	vk::UniqueSwapchainKHR newSwapchain =
+		device.createSwapchainKHRUnique(
+			vk::SwapchainCreateInfoKHR(
+				vk::SwapchainCreateFlagsKHR(),  // flags
+				window.surface(),               // surface
+				surfaceCapabilities.maxImageCount==0  // minImageCount
+					? max(requestedImageCount, surfaceCapabilities.minImageCount)
+					: clamp(requestedImageCount, surfaceCapabilities.minImageCount, surfaceCapabilities.maxImageCount),
+				surfaceFormat.format,           // imageFormat
+				surfaceFormat.colorSpace,       // imageColorSpace
+				newSurfaceExtent,               // imageExtent
+				1,                              // imageArrayLayers
+				vk::ImageUsageFlagBits::eColorAttachment,  // imageUsage
+				(graphicsQueueFamily==presentationQueueFamily) ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent, // imageSharingMode
+				uint32_t(2),  // queueFamilyIndexCount
+				array<uint32_t, 2>{graphicsQueueFamily, presentationQueueFamily}.data(),  // pQueueFamilyIndices
+				surfaceCapabilities.currentTransform,    // preTransform
+				vk::CompositeAlphaFlagBitsKHR::eOpaque,  // compositeAlpha
+				[](FrameUpdateMode frameUpdateMode, vk::PhysicalDevice physicalDevice, VulkanWindow& window)  // presentMode
+					{
+						// for MaxFrameRate, try Mailbox and Immediate if they are available
+						if(frameUpdateMode == FrameUpdateMode::MaxFrameRate) {
+							vector<vk::PresentModeKHR> modes =
+								physicalDevice.getSurfacePresentModesKHR(window.surface());
+							if(find(modes.begin(), modes.end(), vk::PresentModeKHR::eMailbox) != modes.end())
+								return vk::PresentModeKHR::eMailbox;
+							if(find(modes.begin(), modes.end(), vk::PresentModeKHR::eImmediate) != modes.end())
+								return vk::PresentModeKHR::eImmediate;
+						}
+
+						// return Fifo that is always supported
+						return vk::PresentModeKHR::eFifo;
+					}(frameUpdateMode, physicalDevice, window),
+				VK_TRUE,  // clipped
+				swapchain  // oldSwapchain
+			)
+		);
+	device.destroy(swapchain);
+	swapchain = newSwapchain.release();
+
+	// swapchain images and image views
+	vector<vk::Image> swapchainImages = device.getSwapchainImagesKHR(swapchain);
+	swapchainImageViews.reserve(swapchainImages.size());
+	for(vk::Image image : swapchainImages)
+		swapchainImageViews.emplace_back(
+			device.createImageView(
+				vk::ImageViewCreateInfo(
+					vk::ImageViewCreateFlags(),  // flags
+					image,                       // image
+					vk::ImageViewType::e2D,      // viewType
+					surfaceFormat.format,        // format
+					vk::ComponentMapping(),      // components
+					vk::ImageSubresourceRange(   // subresourceRange
+						vk::ImageAspectFlagBits::eColor,  // aspectMask
+						0,  // baseMipLevel
+						1,  // levelCount
+						0,  // baseArrayLayer
+						1   // layerCount
+					)
+				)
+			)
+		);
+
+	// framebuffers
+	framebuffers.reserve(swapchainImages.size());
+	for(size_t i=0, c=swapchainImages.size(); i<c; i++)
+		framebuffers.emplace_back(
+			device.createFramebuffer(
+				vk::FramebufferCreateInfo(
+					vk::FramebufferCreateFlags(),  // flags
+					renderPass,  // renderPass
+					1,  // attachmentCount
+					&swapchainImageViews[i],  // pAttachments
+					newSurfaceExtent.width,  // width
+					newSurfaceExtent.height,  // height
+					1  // layers
+				)
+			)
+		);
 }
 
 
@@ -741,6 +758,14 @@ void App::frame(VulkanWindow&)
 
 	// rendering commands
 	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);  // bind pipeline
+	commandBuffer.setViewport(
+		0,  // firstViewport
+		vk::Viewport(0.f, 0.f, float(window.surfaceExtent().width), float(window.surfaceExtent().height), 0.f, 1.f)  // viewports
+	);
+	commandBuffer.setScissor(
+		0,  // firstScissor
+		vk::Rect2D(vk::Offset2D(0, 0), window.surfaceExtent())  // scissors
+	);
 	commandBuffer.draw(  // draw single triangle
 		3,  // vertexCount
 		1,  // instanceCount
@@ -787,6 +812,15 @@ void App::frame(VulkanWindow&)
 			throw runtime_error("Vulkan error: vkQueuePresentKHR() failed with error " + to_string(r) + ".");
 	}
 
+	// report resize latency
+	// (time from the swapchain recreation to the presentation of the first frame)
+	if(resizeMeasurementPending) {
+		resizeMeasurementPending = false;
+		cout << "Resize to first frame: "
+		     << chrono::duration<double>(chrono::high_resolution_clock::now() - resizeStartTime).count() * 1000
+		     << "ms" << endl;
+	}
+
 	// schedule next frame
 	if(frameUpdateMode != FrameUpdateMode::OnDemand)
 		window.scheduleFrame();
@@ -818,6 +852,10 @@ int main(int argc, char* argv[])
 		app.window.show();
 		app.window.mainLoop();
 
+		// save pipeline cache for the next run
+		app.pipelineCache.printStats();
+		app.pipelineCache.save();
+
 	// catch exceptions
 	} catch(vk::Error& e) {
 		cout << "Failed because of Vulkan exception: " << e.what() << endl;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+
+/** StartupProfiler measures the phases of the application start up to the first presented frame.
+ *  The events are nested: Scope objects and begin()/end() pairs open and close events, and phase()
+ *  closes the previous phase of the same level and opens the next one, so the sequential code
+ *  is split into phases by a single call each. The time is measured from the construction
+ *  of the profiler, so a static instance measures from about the process start.
+ *  finish() closes all the open events and stops the recording. The result is printed
+ *  as a tree by printSummary() or written by writeTrace() as Chrome trace JSON
+ *  that can be opened by chrome://tracing or https://ui.perfetto.dev.
+ *  The profiler is meant to be used from the main thread only. */
+class StartupProfiler {
+public:
+
+	struct Event {
+		std::string name;
+		double start;  // in seconds since the construction
+		double duration;  // in seconds
+		unsigned depth;
+	};
+
+	class Scope {
+	protected:
+		StartupProfiler* _profiler;
+	public:
+		Scope(StartupProfiler& profiler, const char* name);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+
+protected:
+
+	struct OpenEvent {
+		size_t index;  // into _events
+		bool phase;  // opened by phase()
+	};
+
+	std::chrono::high_resolution_clock::time_point _startTime;
+	std::vector<Event> _events;
+	std::vector<OpenEvent> _openEvents;
+	bool _recording = true;
+	double _finishTime = 0.;  // in seconds
+
+	double now() const;
+	void open(const char* name, bool phase);
+	void close();
+
+public:
+
+	StartupProfiler();
+
+	void begin(const char* name);
+	void end();  // closes the open phase too, if any
+	void phase(const char* name);
+	void endPhase();
+	void finish();
+
+	// getters
+	bool recording() const;
+	const std::vector<Event>& events() const;
+	double finishTime() const;  // in seconds since the construction, zero if not finished yet
+
+	// output
+	void printSummary() const;
+	void writeTrace(const std::filesystem::path& path, const char* processName) const;
+
+};
+
+
+// inline methods
+inline StartupProfiler::Scope::Scope(StartupProfiler& profiler, const char* name) : _profiler(&profiler)  { profiler.begin(name); }
+inline StartupProfiler::Scope::~Scope()  { _profiler->end(); }
+inline bool StartupProfiler::recording() const  { return _recording; }
+inline const std::vector<StartupProfiler::Event>& StartupProfiler::events() const  { return _events; }
+inline double StartupProfiler::finishTime() const  { return _finishTime; }
@@ -1,13 +1,19 @@
 #include "VulkanWindow.h"
+#include "PipelineCache.h"
+#include "StartupProfiler.h"
 #include <algorithm>
 #include <chrono>
+#include <cmath>
 #include <iostream>
+#include <map>
 
 using namespace std;
 
 
 // constants
 constexpr const char* appName = "15-mandelbrot";
+constexpr const size_t calibrationWarmUpFrames = 5;  // frames of each render variant that are not measured
+constexpr const size_t calibrationMeasuredFrames = 20;  // measured frames of each render variant
 
 
 // shader code in SPIR-V binary
@@ -17,6 +23,23 @@ static const uint32_t vsSpirv[] = {
 static const uint32_t fsSpirv[] = {
 #include "shader.frag.spv"
 };
+static const uint32_t fsDf64Spirv[] = {
+#include "shader-df64.frag.spv"
+};
+static const uint32_t fsFp64Spirv[] = {
+#include "shader-fp64.frag.spv"
+};
+static const uint32_t csSpirv[] = {
+#include "shader.comp.spv"
+};
+static const uint32_t csTilesSpirv[] = {
+#include "shader-tiles.comp.spv"
+};
+
+
+// startup profiler
+// (static object, so the time is measured from about the process start)
+static StartupProfiler startupProfiler;
 
 
 // global application data
@@ -30,6 +53,8 @@ public:
 	void recreateSwapchain(VulkanWindow& window,
 		const vk::SurfaceCapabilitiesKHR& surfaceCapabilities, vk::Extent2D newSurfaceExtent);
 	void frame(VulkanWindow& window);
+	string variantName(size_t index) const;
+	vk::Pipeline createPipeline(vk::ShaderModule fragmentShader, const vk::SpecializationInfo* specializationInfo);
 
 	// Vulkan instance must be destructed as the last Vulkan handle.
 	// It is probably good idea to destroy it after the display connection.
@@ -45,6 +70,7 @@ public:
 	uint32_t graphicsQueueFamily;
 	uint32_t presentationQueueFamily;
 	vk::Device device;
+	PipelineCache pipelineCache;
 	vk::Queue graphicsQueue;
 	vk::Queue presentationQueue;
 	vk::SurfaceFormatKHR surfaceFormat;
@@ -59,14 +85,111 @@ public:
 	vk::Fence renderFinishedFence;
 	vk::ShaderModule vsModule;
 	vk::ShaderModule fsModule;
+	vk::ShaderModule fsDf64Module;
+	vk::ShaderModule fsFp64Module;
 	vk::PipelineLayout pipelineLayout;
-	vk::Pipeline pipeline;
+	vk::QueryPool timestampPool;
+
+	// push constants
+	// (iteration limit grows with the zoom; pixel size scales the epsilon of the periodicity check;
+	// df64 and fp64 shaders compute c from gl_FragCoord using the reference pixel and the pixel step
+	// given in their precision, so c is not limited by the float varying of shader.vert)
+	struct PushData {
+		int32_t maxIter;
+		float pixelSize;
+		float referencePixel[2];
+		float pixelStepHi[2];
+		float pixelStepLo[2];
+		double pixelStep[2];
+	};
+	static_assert(sizeof(PushData) == 48, "PushData does not match push constant layout.");
+	static uint32_t iterationLimit(double pixelSize);
+	bool fp64Supported;
+
+	// iterations per pixel
+	// (estimated on CPU for the current window size, for the former fixed limit of 255 iterations,
+	// for the current limit without the early-outs and for the current limit with them)
+	double estimatedPixelSize = 0.;
+	void printIterationEstimate();
+
+	// compute path
+	// (compute shader writes the fractal into the storage image that is blitted into the swapchain image)
+	vk::ShaderModule csModule;
+	vk::DescriptorSetLayout computeDescriptorSetLayout;
+	vk::PipelineLayout computePipelineLayout;
+	vk::DescriptorPool descriptorPool;
+	vk::DescriptorSet descriptorSet;
+	vk::Image storageImage;
+	vk::DeviceMemory storageImageMemory;
+	vk::ImageView storageImageView;
+	vector<vk::Image> swapchainImages;
+	bool computePathEnabled = false;
+
+	// tiled compute path
+	// (border pass computes the borders of 16x16 tiles and fills the tiles with uniform border;
+	// the remaining tiles are listed in the tile buffer and computed by indirect dispatch;
+	// the buffer is host visible, so the number of listed tiles is read back for the statistics)
+	static constexpr const uint32_t tileSize = 16;
+	vk::ShaderModule csTilesModule;
+	vk::Buffer tileBuffer;
+	vk::DeviceMemory tileBufferMemory;
+	uint32_t* tileBufferPtr = nullptr;
+	vk::Extent2D tileGridExtent;
+	bool tileStatsPending = false;
+	double fpsSkippedPixels = 0.;
+	double fpsTiledPixels = 0.;
+
+	// precision tiers
+	// (fp32 uses floats, df64 emulates higher precision by pairs of floats and fp64 uses doubles
+	// if shaderFloat64 is supported)
+	enum class Precision { Fp32, Df64, Fp64, Auto };
+	static const char* precisionName(Precision p);
+
+	// render variants
+	// (fragment path variants of all the precision tiers come first, compute path variants
+	// with different workgroup sizes follow and the tiled compute variant is the last one;
+	// if there are more variants, a few frames are rendered
+	// by each of them, they are measured by timestamps and the fastest one is selected;
+	// pipeline and interiorPipeline read the iteration limit from push constants, the pipelines
+	// specialized by the iteration limit are created on the first use of the limit and kept,
+	// as the limit changes with the window size only)
+	struct RenderVariant {
+		bool compute;
+		Precision precision;
+		vk::Extent2D workgroupSize;
+		vk::Pipeline pipeline;  // border pass pipeline for the tiled variant
+		vk::Pipeline interiorPipeline = nullptr;  // used by the tiled variant only
+		bool tiled = false;
+		map<uint32_t, array<vk::Pipeline,2>> specializedPipelines;  // pipeline and interior pipeline of each iteration limit
+		double gpuTime = 0.;
+		size_t numSamples = 0;
+	};
+	vector<RenderVariant> renderVariants;
+	bool specializeIterations = true;
+	vk::Pipeline createVariantPipeline(const RenderVariant& v, bool interiorPass, uint32_t maxIter);
+	const array<vk::Pipeline,2>& specializedPipelines(size_t variantIndex, uint32_t maxIter);
+	size_t activeVariant = 0;
+	size_t timedVariant = ~size_t(0);  // variant measured by the timestamps of the last submitted frame
+	bool timedCalibrationSample = false;
+	size_t calibrationFrame = ~size_t(0);  // ~0 means no calibration in progress
+	uint64_t timestampMask;
+	float timestampPeriod_ns;
+	double fpsGpuTime = 0.;
+	size_t fpsGpuNumFrames = 0;
+
+	enum class RenderPath { Fragment, Compute, Tiled, Auto };
+	RenderPath renderPath = RenderPath::Fragment;
+	vk::Extent2D requestedWorkgroupSize = vk::Extent2D(0,0);  // zero means the default
+	Precision requestedPrecision = Precision::Auto;
 
 	enum class FrameUpdateMode { OnDemand, Continuous, MaxFrameRate };
 	FrameUpdateMode frameUpdateMode = FrameUpdateMode::Continuous;
 	size_t frameID = ~size_t(0);
 	size_t fpsNumFrames = ~size_t(0);
 	chrono::high_resolution_clock::time_point fpsStartTime;
+	chrono::high_resolution_clock::time_point resizeStartTime;
+	bool resizeMeasurementPending = false;
+	string startupTracePath;  // empty means no trace file
 
 };
 
@@ -82,6 +205,32 @@ App::App(int argc, char** argv)
 			frameUpdateMode = FrameUpdateMode::Continuous;
 		else if(strcmp(argv[i], "--max-frame-rate") == 0)
 			frameUpdateMode = FrameUpdateMode::MaxFrameRate;
+		else if(strcmp(argv[i], "--path") == 0 && i+1 < argc &&
+		        (strcmp(argv[i+1], "fragment") == 0 || strcmp(argv[i+1], "compute") == 0 ||
+		         strcmp(argv[i+1], "tiled") == 0 || strcmp(argv[i+1], "auto") == 0)) {
+			renderPath = (strcmp(argv[i+1], "fragment") == 0) ? RenderPath::Fragment :
+			             (strcmp(argv[i+1], "compute") == 0) ? RenderPath::Compute :
+			             (strcmp(argv[i+1], "tiled") == 0) ? RenderPath::Tiled : RenderPath::Auto;
+			i++;
+		}
+		else if(strcmp(argv[i], "--workgroup-size") == 0 && i+1 < argc &&
+		        sscanf(argv[i+1], "%ux%u", &requestedWorkgroupSize.width, &requestedWorkgroupSize.height) == 2 &&
+		        requestedWorkgroupSize.width != 0 && requestedWorkgroupSize.height != 0)
+			i++;
+		else if(strcmp(argv[i], "--no-specialization") == 0)
+			specializeIterations = false;
+		else if(strcmp(argv[i], "--startup-trace") == 0 && i+1 < argc) {
+			startupTracePath = argv[i+1];
+			i++;
+		}
+		else if(strcmp(argv[i], "--precision") == 0 && i+1 < argc &&
+		        (strcmp(argv[i+1], "fp32") == 0 || strcmp(argv[i+1], "df64") == 0 ||
+		         strcmp(argv[i+1], "fp64") == 0 || strcmp(argv[i+1], "auto") == 0)) {
+			requestedPrecision = (strcmp(argv[i+1], "fp32") == 0) ? Precision::Fp32 :
+			                     (strcmp(argv[i+1], "df64") == 0) ? Precision::Df64 :
+			                     (strcmp(argv[i+1], "fp64") == 0) ? Precision::Fp64 : Precision::Auto;
+			i++;
+		}
 		else {
 			if(strcmp(argv[i], "--help") != 0 && strcmp(argv[i], "-h") != 0)
 				cout << "Unrecognized option: " << argv[i] << endl;
@@ -92,7 +241,27 @@ App::App(int argc, char** argv)
 			        "   --continuous:  constantly update window content using\n"
 			        "                  screen refresh rate, this is the default\n"
 			        "   --max-frame-rate:  ignore screen refresh rate, update\n"
-			        "                      window content as often as possible\n" << endl;
+			        "                      window content as often as possible\n"
+			        "   --path <path>:  fragment - compute the fractal in fragment shader,\n"
+			        "                   compute - compute the fractal in compute shader\n"
+			        "                   and blit it into the swapchain image,\n"
+			        "                   tiled - compute path that computes tile borders first\n"
+			        "                   and skips the insides of the tiles with uniform border,\n"
+			        "                   auto - measure all paths and use the fastest one,\n"
+			        "                   default: fragment\n"
+			        "   --workgroup-size <x>x<y>:  workgroup size of the compute path,\n"
+			        "                              default: 16x8, auto path tries more sizes\n"
+			        "   --precision <tier>:  fp32 - single precision floats,\n"
+			        "                        df64 - double precision emulated by float pairs,\n"
+			        "                        fp64 - double precision floats,\n"
+			        "                        auto - measure all supported tiers and use the fastest one,\n"
+			        "                        default: auto\n"
+			        "   --no-specialization:  read the iteration limit from push constants\n"
+			        "                         instead of creating pipeline variants\n"
+			        "                         specialized for each limit\n"
+			        "   --startup-trace <file>:  write the startup phases up to the first\n"
+			        "                            presented frame as Chrome trace JSON file\n"
+			        "                            (chrome://tracing or ui.perfetto.dev)\n" << endl;
 			exit(99);
 		}
 }
@@ -112,8 +281,28 @@ App::~App()
 
 		// destroy handles
 		// (the handles are destructed in certain (not arbitrary) order)
-		device.destroy(pipeline);
+		for(auto& v : renderVariants) {
+			for(auto& [maxIter, p] : v.specializedPipelines) {
+				device.destroy(p[0]);
+				device.destroy(p[1]);
+			}
+			device.destroy(v.pipeline);
+			device.destroy(v.interiorPipeline);
+		}
+		device.destroy(tileBuffer);
+		device.free(tileBufferMemory);
+		device.destroy(storageImageView);
+		device.destroy(storageImage);
+		device.free(storageImageMemory);
+		device.destroy(descriptorPool);
+		device.destroy(computePipelineLayout);
+		device.destroy(computeDescriptorSetLayout);
+		device.destroy(csTilesModule);
+		device.destroy(csModule);
+		device.destroy(timestampPool);
 		device.destroy(pipelineLayout);
+		device.destroy(fsFp64Module);
+		device.destroy(fsDf64Module);
 		device.destroy(fsModule);
 		device.destroy(vsModule);
 		device.destroy(renderFinishedFence);
@@ -124,6 +313,7 @@ App::~App()
 		for(auto v : swapchainImageViews)  device.destroy(v);
 		device.destroy(swapchain);
 		device.destroy(renderPass);
+		pipelineCache.destroy();
 		device.destroy();
 	}
 
@@ -141,10 +331,15 @@ App::~App()
 
 void App::init()
 {
+	// profile the startup phases
+	StartupProfiler::Scope profilerScope(startupProfiler, "App::init");
+
 	// init VulkanWindow
+	startupProfiler.phase("VulkanWindow::init");
 	VulkanWindow::init();
 
 	// Vulkan instance
+	startupProfiler.phase("instance creation");
 	instance =
 		vk::createInstance(
 			vk::InstanceCreateInfo{
@@ -163,10 +358,12 @@ void App::init()
 		);
 
 	// create surface
+	startupProfiler.phase("VulkanWindow::create");
 	vk::SurfaceKHR surface =
 		window.create(instance, {1024, 768}, appName);
 
 	// find compatible devices
+	startupProfiler.phase("device enumeration");
 	vector<vk::PhysicalDevice> deviceList = instance.enumeratePhysicalDevices();
 	vector<tuple<vk::PhysicalDevice, uint32_t, uint32_t, vk::PhysicalDeviceProperties>> compatibleDevices;
 	for(vk::PhysicalDevice pd : deviceList) {
@@ -250,8 +447,10 @@ void App::init()
 	physicalDevice = get<0>(*bestDevice);
 	graphicsQueueFamily = get<1>(*bestDevice);
 	presentationQueueFamily = get<2>(*bestDevice);
+	fp64Supported = physicalDevice.getFeatures().shaderFloat64;
 
 	// create device
+	startupProfiler.phase("device creation");
 	device =
 		physicalDevice.createDevice(
 			vk::DeviceCreateInfo{
@@ -274,7 +473,9 @@ void App::init()
 				0, nullptr,  // no layers
 				1,           // number of enabled extensions
 				array<const char*, 1>{ "VK_KHR_swapchain" }.data(),  // enabled extension names
-				nullptr,    // enabled features
+				fp64Supported  // enabled features
+					? &vk::PhysicalDeviceFeatures().setShaderFloat64(true)
+					: nullptr,
 			}
 		);
 
@@ -282,7 +483,13 @@ void App::init()
 	graphicsQueue = device.getQueue(graphicsQueueFamily, 0);
 	presentationQueue = device.getQueue(presentationQueueFamily, 0);
 
+	// pipeline cache
+	// (loaded from the previous run, if any)
+	startupProfiler.phase("pipeline cache load");
+	pipelineCache.init(physicalDevice, device, appName);
+
 	// print surface formats
+	startupProfiler.phase("surface format query");
 	cout << "Surface formats:" << endl;
 	vector<vk::SurfaceFormatKHR> availableSurfaceFormats = physicalDevice.getSurfaceFormatsKHR(surface);
 	for(vk::SurfaceFormatKHR sf : availableSurfaceFormats)
@@ -316,6 +523,7 @@ void App::init()
 	     << "   " << to_string(surfaceFormat.format) << ", color space: " << to_string(surfaceFormat.colorSpace) << endl;
 
 	// render pass
+	startupProfiler.phase("render pass");
 	renderPass =
 		device.createRenderPass(
 			vk::RenderPassCreateInfo(
@@ -370,6 +578,7 @@ void App::init()
 		);
 
 	// commandPool and commandBuffer
+	startupProfiler.phase("command buffer and synchronization");
 	commandPool =
 		device.createCommandPool(
 			vk::CommandPoolCreateInfo(
@@ -408,6 +617,7 @@ void App::init()
 		);
 
 	// create shader modules
+	startupProfiler.phase("shader modules");
 	vsModule =
 		device.createShaderModule(
 			vk::ShaderModuleCreateInfo(
@@ -424,33 +634,305 @@ void App::init()
 				fsSpirv  // pCode
 			)
 		);
+	fsDf64Module =
+		device.createShaderModule(
+			vk::ShaderModuleCreateInfo(
+				vk::ShaderModuleCreateFlags(),  // flags
+				sizeof(fsDf64Spirv),  // codeSize
+				fsDf64Spirv  // pCode
+			)
+		);
+	if(fp64Supported)
+		fsFp64Module =
+			device.createShaderModule(
+				vk::ShaderModuleCreateInfo(
+					vk::ShaderModuleCreateFlags(),  // flags
+					sizeof(fsFp64Spirv),  // codeSize
+					fsFp64Spirv  // pCode
+				)
+			);
 
 	// pipeline layout
+	startupProfiler.phase("pipeline layout and timestamp pool");
 	pipelineLayout =
 		device.createPipelineLayout(
 			vk::PipelineLayoutCreateInfo{
 				vk::PipelineLayoutCreateFlags(),  // flags
 				0,       // setLayoutCount
 				nullptr, // pSetLayouts
-				0,       // pushConstantRangeCount
-				nullptr  // pPushConstantRanges
+				1,       // pushConstantRangeCount
+				&(const vk::PushConstantRange&)vk::PushConstantRange{  // pPushConstantRanges
+					vk::ShaderStageFlagBits::eFragment,  // stageFlags
+					0,  // offset
+					sizeof(PushData)  // size
+				}
 			}
 		);
+
+	// timestamp pool
+	// (two timestamps measure the GPU time of each frame)
+	vector<vk::QueueFamilyProperties> queueFamilyList = physicalDevice.getQueueFamilyProperties();
+	uint32_t timestampValidBits = queueFamilyList[graphicsQueueFamily].timestampValidBits;
+	timestampMask = timestampValidBits>=64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+	timestampPeriod_ns = physicalDevice.getProperties().limits.timestampPeriod;
+	if(timestampValidBits != 0)
+		timestampPool =
+			device.createQueryPool(
+				vk::QueryPoolCreateInfo(
+					vk::QueryPoolCreateFlags(),  // flags
+					vk::QueryType::eTimestamp,  // queryType
+					2,  // queryCount
+					vk::QueryPipelineStatisticFlags()  // pipelineStatistics
+				)
+			);
+
+	// compute path support
+	// (the graphics queue must support compute operations and the swapchain images must support blit into them)
+	startupProfiler.phase("support checks");
+	if(renderPath != RenderPath::Fragment) {
+		if(!(queueFamilyList[graphicsQueueFamily].queueFlags & vk::QueueFlagBits::eCompute) ||
+		   !(physicalDevice.getSurfaceCapabilitiesKHR(window.surface()).supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) ||
+		   !(physicalDevice.getFormatProperties(surfaceFormat.format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eBlitDst))
+		{
+			cout << "Compute path is not supported by the device. Using fragment path." << endl;
+			renderPath = RenderPath::Fragment;
+		}
+		else if(renderPath == RenderPath::Auto && !timestampPool) {
+			cout << "Timestamps are not supported by the device, so the paths cannot be compared. "
+			        "Using fragment path." << endl;
+			renderPath = RenderPath::Fragment;
+		}
+	}
+
+	// precision support
+	// (compute path is implemented in fp32 only)
+	if(requestedPrecision == Precision::Fp64 && !fp64Supported) {
+		cout << "Fp64 precision is not supported by the device. Using df64 precision." << endl;
+		requestedPrecision = Precision::Df64;
+	}
+	if(requestedPrecision == Precision::Auto && !timestampPool) {
+		cout << "Timestamps are not supported by the device, so the precision tiers cannot be compared. "
+		        "Using fp32 precision." << endl;
+		requestedPrecision = Precision::Fp32;
+	}
+	if((renderPath == RenderPath::Compute || renderPath == RenderPath::Tiled) &&
+	   requestedPrecision != Precision::Fp32 && requestedPrecision != Precision::Auto)
+	{
+		cout << "Compute path supports fp32 precision only. Using fragment path." << endl;
+		renderPath = RenderPath::Fragment;
+	}
+
+	// fragment path variants
+	// (the view of this sample is fixed, so all the precision tiers are precise enough
+	// and the selection is given by their speed; the pipelines use dynamic viewport,
+	// so they are created just once)
+	startupProfiler.phase("fragment pipelines");
+	if(renderPath == RenderPath::Fragment || renderPath == RenderPath::Auto)
+		for(Precision p : { Precision::Fp32, Precision::Df64, Precision::Fp64 }) {
+			if(requestedPrecision != Precision::Auto && requestedPrecision != p)
+				continue;
+			if(p == Precision::Fp64 && !fp64Supported)
+				continue;
+			RenderVariant v{ false, p, vk::Extent2D(0,0), nullptr };
+			v.pipeline = createVariantPipeline(v, false, 0);
+			renderVariants.push_back(v);
+		}
+
+	if(renderPath != RenderPath::Fragment &&
+	   (requestedPrecision == Precision::Fp32 || requestedPrecision == Precision::Auto))
+	{
+		computePathEnabled = true;
+
+		// compute shader module
+		startupProfiler.phase("compute shader modules and descriptors");
+		csModule =
+			device.createShaderModule(
+				vk::ShaderModuleCreateInfo(
+					vk::ShaderModuleCreateFlags(),  // flags
+					sizeof(csSpirv),  // codeSize
+					csSpirv  // pCode
+				)
+			);
+		csTilesModule =
+			device.createShaderModule(
+				vk::ShaderModuleCreateInfo(
+					vk::ShaderModuleCreateFlags(),  // flags
+					sizeof(csTilesSpirv),  // codeSize
+					csTilesSpirv  // pCode
+				)
+			);
+
+		// descriptor set layout, pipeline layout and descriptor set
+		// (the descriptors are the storage image and the tile buffer of the tiled path;
+		// they are updated whenever the image and the buffer are recreated)
+		computeDescriptorSetLayout =
+			device.createDescriptorSetLayout(
+				vk::DescriptorSetLayoutCreateInfo(
+					vk::DescriptorSetLayoutCreateFlags(),  // flags
+					2,  // bindingCount
+					array{  // pBindings
+						vk::DescriptorSetLayoutBinding{
+							0,  // binding
+							vk::DescriptorType::eStorageImage,  // descriptorType
+							1,  // descriptorCount
+							vk::ShaderStageFlagBits::eCompute,  // stageFlags
+							nullptr  // pImmutableSamplers
+						},
+						vk::DescriptorSetLayoutBinding{
+							1,  // binding
+							vk::DescriptorType::eStorageBuffer,  // descriptorType
+							1,  // descriptorCount
+							vk::ShaderStageFlagBits::eCompute,  // stageFlags
+							nullptr  // pImmutableSamplers
+						},
+					}.data()
+				)
+			);
+		computePipelineLayout =
+			device.createPipelineLayout(
+				vk::PipelineLayoutCreateInfo{
+					vk::PipelineLayoutCreateFlags(),  // flags
+					1,       // setLayoutCount
+					&computeDescriptorSetLayout,  // pSetLayouts
+					1,       // pushConstantRangeCount
+					&(const vk::PushConstantRange&)vk::PushConstantRange{  // pPushConstantRanges
+						vk::ShaderStageFlagBits::eCompute,  // stageFlags
+						0,  // offset
+						sizeof(PushData)  // size
+					}
+				}
+			);
+		descriptorPool =
+			device.createDescriptorPool(
+				vk::DescriptorPoolCreateInfo(
+					vk::DescriptorPoolCreateFlags(),  // flags
+					1,  // maxSets
+					2,  // poolSizeCount
+					array{  // pPoolSizes
+						vk::DescriptorPoolSize(
+							vk::DescriptorType::eStorageImage,  // type
+							1  // descriptorCount
+						),
+						vk::DescriptorPoolSize(
+							vk::DescriptorType::eStorageBuffer,  // type
+							1  // descriptorCount
+						),
+					}.data()
+				)
+			);
+		descriptorSet =
+			device.allocateDescriptorSets(
+				vk::DescriptorSetAllocateInfo(
+					descriptorPool,  // descriptorPool
+					1,  // descriptorSetCount
+					&computeDescriptorSetLayout  // pSetLayouts
+				)
+			)[0];
+
+		// workgroup sizes
+		// (auto path tries several sizes; 16x8 and 8x8 are always within the device limits
+		// as maxComputeWorkGroupInvocations is at least 128)
+		vector<vk::Extent2D> workgroupSizes;
+		if(requestedWorkgroupSize.width != 0 && renderPath != RenderPath::Tiled)
+			workgroupSizes.push_back(requestedWorkgroupSize);
+		else if(renderPath == RenderPath::Auto)
+			workgroupSizes = { {8,8}, {16,8}, {16,16}, {32,8}, {64,4} };
+		else if(renderPath == RenderPath::Compute)
+			workgroupSizes = { {16,8} };
+
+		// compute pipelines
+		// (workgroup size is given by specialization constants, see createVariantPipeline())
+		startupProfiler.phase("compute pipelines");
+		const vk::PhysicalDeviceLimits& limits = physicalDevice.getProperties().limits;
+		for(vk::Extent2D size : workgroupSizes) {
+			if(size.width > limits.maxComputeWorkGroupSize[0] || size.height > limits.maxComputeWorkGroupSize[1] ||
+			   size.width*size.height > limits.maxComputeWorkGroupInvocations)
+			{
+				if(requestedWorkgroupSize.width != 0)
+					throw runtime_error("Workgroup size exceeds device limits.");
+				continue;
+			}
+			RenderVariant v{ true, Precision::Fp32, size, nullptr };
+			v.pipeline = createVariantPipeline(v, false, 0);
+			renderVariants.push_back(v);
+		}
+
+		// tiled compute path pipelines
+		// (both passes are built from the same shader; border pass uses 64 invocations per tile,
+		// interior pass uses 16x8 invocations per tile, so both are within the minimal device limits)
+		startupProfiler.phase("tiled compute pipelines");
+		if(renderPath == RenderPath::Tiled || renderPath == RenderPath::Auto) {
+			RenderVariant v{ true, Precision::Fp32, vk::Extent2D(tileSize, tileSize), nullptr };
+			v.tiled = true;
+			v.pipeline = createVariantPipeline(v, false, 0);
+			v.interiorPipeline = createVariantPipeline(v, true, 0);
+			renderVariants.push_back(v);
+		}
+	}
+
+	// initial render variant
+	// (more variants are measured by calibration starting by the first variant)
+	startupProfiler.phase("initial render variant");
+	activeVariant = 0;
+	if(renderVariants.size() > 1) {
+		calibrationFrame = 0;
+		cout << "Measuring " << renderVariants.size() << " render variants..." << endl;
+	}
+	else
+		cout << "Using " << variantName(activeVariant) << " path." << endl;
+}
+
+
+string App::variantName(size_t index) const
+{
+	const RenderVariant& v = renderVariants[index];
+	if(!v.compute)
+		return string("fragment ") + precisionName(v.precision);
+	if(v.tiled)
+		return "compute tiled";
+	return "compute " + to_string(v.workgroupSize.width) + "x" + to_string(v.workgroupSize.height);
+}
+
+
+const char* App::precisionName(Precision p)
+{
+	switch(p) {
+	case Precision::Fp32: return "fp32";
+	case Precision::Df64: return "df64";
+	case Precision::Fp64: return "fp64";
+	default: return "auto";
+	}
 }
 
 
-/** Recreate swapchain and pipeline callback method.
+/** Recreate swapchain callback method.
  *  The method is usually called after the window resize and on the application start. */
 void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& surfaceCapabilities,
                             vk::Extent2D newSurfaceExtent)
 {
+	StartupProfiler::Scope profilerScope(startupProfiler, "recreateSwapchain");
+
+	// start measuring resize latency
+	resizeStartTime = chrono::high_resolution_clock::now();
+	resizeMeasurementPending = true;
+
 	// clear resources
 	for(auto v : swapchainImageViews)  device.destroy(v);
 	swapchainImageViews.clear();
 	for(auto f : framebuffers)  device.destroy(f);
 	framebuffers.clear();
-	device.destroy(pipeline);
-	pipeline = nullptr;
+	device.destroy(storageImageView);
+	storageImageView = nullptr;
+	device.destroy(storageImage);
+	storageImage = nullptr;
+	device.free(storageImageMemory);
+	storageImageMemory = nullptr;
+	device.destroy(tileBuffer);
+	tileBuffer = nullptr;
+	device.free(tileBufferMemory);
+	tileBufferMemory = nullptr;
+	tileBufferPtr = nullptr;
+	tileStatsPending = false;
 
 	// print info
 	cout << "Recreating swapchain (extent: " << newSurfaceExtent.width << "x" << newSurfaceExtent.height
@@ -472,7 +954,9 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 				surfaceFormat.colorSpace,       // imageColorSpace
 				newSurfaceExtent,               // imageExtent
 				1,                              // imageArrayLayers
-				vk::ImageUsageFlagBits::eColorAttachment,  // imageUsage
+				computePathEnabled  // imageUsage
+					? vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst
+					: vk::ImageUsageFlagBits::eColorAttachment,
 				(graphicsQueueFamily==presentationQueueFamily) ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent, // imageSharingMode
 				uint32_t(2),  // queueFamilyIndexCount
 				array<uint32_t, 2>{graphicsQueueFamily, presentationQueueFamily}.data(),  // pQueueFamilyIndices
@@ -501,7 +985,7 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 	swapchain = newSwapchain.release();
 
 	// swapchain images and image views
-	vector<vk::Image> swapchainImages = device.getSwapchainImagesKHR(swapchain);
+	swapchainImages = device.getSwapchainImagesKHR(swapchain);
 	swapchainImageViews.reserve(swapchainImages.size());
 	for(vk::Image image : swapchainImages)
 		swapchainImageViews.emplace_back(
@@ -540,10 +1024,165 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 			)
 		);
 
-	// pipeline
-	pipeline =
-		device.createGraphicsPipeline(
-			nullptr,  // pipelineCache
+	// storage image of the compute path
+	if(computePathEnabled) {
+
+		storageImage =
+			device.createImage(
+				vk::ImageCreateInfo(
+					vk::ImageCreateFlags(),       // flags
+					vk::ImageType::e2D,           // imageType
+					vk::Format::eR8G8B8A8Unorm,   // format
+					vk::Extent3D(newSurfaceExtent.width, newSurfaceExtent.height, 1),  // extent
+					1,                            // mipLevels
+					1,                            // arrayLayers
+					vk::SampleCountFlagBits::e1,  // samples
+					vk::ImageTiling::eOptimal,    // tiling
+					vk::ImageUsageFlagBits::eStorage | vk::ImageUsageFlagBits::eTransferSrc,  // usage
+					vk::SharingMode::eExclusive,  // sharingMode
+					0,                            // queueFamilyIndexCount
+					nullptr,                      // pQueueFamilyIndices
+					vk::ImageLayout::eUndefined   // initialLayout
+				)
+			);
+
+		// allocate device-local memory
+		vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(storageImage);
+		vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+			if(memoryRequirements.memoryTypeBits & (1<<i))
+				if(memoryProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) {
+					memoryTypeIndex = i;
+					break;
+				}
+		if(memoryTypeIndex == UINT32_MAX)
+			throw runtime_error("No suitable memory type found for the storage image.");
+		storageImageMemory =
+			device.allocateMemory(
+				vk::MemoryAllocateInfo(
+					memoryRequirements.size,  // allocationSize
+					memoryTypeIndex           // memoryTypeIndex
+				)
+			);
+		device.bindImageMemory(
+			storageImage,        // image
+			storageImageMemory,  // memory
+			0                    // memoryOffset
+		);
+
+		// image view
+		storageImageView =
+			device.createImageView(
+				vk::ImageViewCreateInfo(
+					vk::ImageViewCreateFlags(),  // flags
+					storageImage,                // image
+					vk::ImageViewType::e2D,      // viewType
+					vk::Format::eR8G8B8A8Unorm,  // format
+					vk::ComponentMapping(),      // components
+					vk::ImageSubresourceRange(   // subresourceRange
+						vk::ImageAspectFlagBits::eColor,  // aspectMask
+						0,  // baseMipLevel
+						1,  // levelCount
+						0,  // baseArrayLayer
+						1   // layerCount
+					)
+				)
+			);
+
+		// update descriptor set
+		device.updateDescriptorSets(
+			vk::WriteDescriptorSet(  // descriptorWrites
+				descriptorSet,  // dstSet
+				0,  // dstBinding
+				0,  // dstArrayElement
+				1,  // descriptorCount
+				vk::DescriptorType::eStorageImage,  // descriptorType
+				&(const vk::DescriptorImageInfo&)vk::DescriptorImageInfo(  // pImageInfo
+					nullptr,  // sampler
+					storageImageView,  // imageView
+					vk::ImageLayout::eGeneral  // imageLayout
+				),
+				nullptr,  // pBufferInfo
+				nullptr   // pTexelBufferView
+			),
+			nullptr  // descriptorCopies
+		);
+
+		// tile buffer
+		// (it holds the indirect dispatch command and the number of tiles followed by the list of tiles)
+		tileGridExtent = vk::Extent2D((newSurfaceExtent.width + tileSize - 1) / tileSize,
+		                              (newSurfaceExtent.height + tileSize - 1) / tileSize);
+		size_t tileBufferSize = (4 + size_t(tileGridExtent.width) * tileGridExtent.height) * sizeof(uint32_t);
+		tileBuffer =
+			device.createBuffer(
+				vk::BufferCreateInfo(
+					vk::BufferCreateFlags(),  // flags
+					tileBufferSize,  // size
+					vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer |
+						vk::BufferUsageFlagBits::eTransferDst,  // usage
+					vk::SharingMode::eExclusive,  // sharingMode
+					0,  // queueFamilyIndexCount
+					nullptr  // pQueueFamilyIndices
+				)
+			);
+
+		// allocate host-visible memory
+		memoryRequirements = device.getBufferMemoryRequirements(tileBuffer);
+		memoryTypeIndex = UINT32_MAX;
+		for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+			if(memoryRequirements.memoryTypeBits & (1<<i))
+				if((memoryProperties.memoryTypes[i].propertyFlags &
+				    (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)) ==
+				   (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))
+				{
+					memoryTypeIndex = i;
+					break;
+				}
+		if(memoryTypeIndex == UINT32_MAX)
+			throw runtime_error("No suitable memory type found for the tile buffer.");
+		tileBufferMemory =
+			device.allocateMemory(
+				vk::MemoryAllocateInfo(
+					memoryRequirements.size,  // allocationSize
+					memoryTypeIndex           // memoryTypeIndex
+				)
+			);
+		device.bindBufferMemory(
+			tileBuffer,        // buffer
+			tileBufferMemory,  // memory
+			0                  // memoryOffset
+		);
+		tileBufferPtr =
+			reinterpret_cast<uint32_t*>(device.mapMemory(tileBufferMemory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+
+		// update descriptor set
+		device.updateDescriptorSets(
+			vk::WriteDescriptorSet(  // descriptorWrites
+				descriptorSet,  // dstSet
+				1,  // dstBinding
+				0,  // dstArrayElement
+				1,  // descriptorCount
+				vk::DescriptorType::eStorageBuffer,  // descriptorType
+				nullptr,  // pImageInfo
+				&(const vk::DescriptorBufferInfo&)vk::DescriptorBufferInfo(  // pBufferInfo
+					tileBuffer,  // buffer
+					0,  // offset
+					VK_WHOLE_SIZE  // range
+				),
+				nullptr   // pTexelBufferView
+			),
+			nullptr  // descriptorCopies
+		);
+
+	}
+}
+
+
+vk::Pipeline App::createPipeline(vk::ShaderModule fragmentShader, const vk::SpecializationInfo* specializationInfo)
+{
+	return
+		pipelineCache.createGraphicsPipeline(
 			vk::GraphicsPipelineCreateInfo(
 				vk::PipelineCreateFlags(),  // flags
 
@@ -560,9 +1199,9 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 					vk::PipelineShaderStageCreateInfo{
 						vk::PipelineShaderStageCreateFlags(),  // flags
 						vk::ShaderStageFlagBits::eFragment,  // stage
-						fsModule,  // module
+						fragmentShader,  // module
 						"main",  // pName
-						nullptr  // pSpecializationInfo
+						specializationInfo  // pSpecializationInfo
 					},
 				}.data(),
 
@@ -586,16 +1225,13 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 				nullptr, // pTessellationState
 
 				// viewport
+				// (viewport and scissor are dynamic state, so the pipeline survives the window resize)
 				&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
 					vk::PipelineViewportStateCreateFlags(),  // flags
 					1,  // viewportCount
-					array{  // pViewports
-						vk::Viewport(0.f, 0.f, float(newSurfaceExtent.width), float(newSurfaceExtent.height), 0.f, 1.f),
-					}.data(),
+					nullptr,  // pViewports
 					1,  // scissorCount
-					array{  // pScissors
-						vk::Rect2D(vk::Offset2D(0,0), newSurfaceExtent)
-					}.data(),
+					nullptr  // pScissors
 				},
 
 				// rasterization
@@ -649,23 +1285,185 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 					array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
 				},
 
-				nullptr,  // pDynamicState
+				// dynamic state
+				&(const vk::PipelineDynamicStateCreateInfo&)vk::PipelineDynamicStateCreateInfo{  // pDynamicState
+					vk::PipelineDynamicStateCreateFlags(),  // flags
+					2,  // dynamicStateCount
+					array{  // pDynamicStates
+						vk::DynamicState::eViewport,
+						vk::DynamicState::eScissor,
+					}.data()
+				},
+
 				pipelineLayout,  // layout
 				renderPass,  // renderPass
 				0,  // subpass
 				vk::Pipeline(nullptr),  // basePipelineHandle
 				-1 // basePipelineIndex
 			)
-		).value;
+		);
+}
+
+
+vk::Pipeline App::createVariantPipeline(const RenderVariant& v, bool interiorPass, uint32_t maxIter)
+{
+	// specialization constants
+	// (constant_id 0 and 1 are the workgroup size of the compute shaders, constant_id 2 selects the pass
+	// of the tiled compute shader and constant_id 3 is the iteration limit, zero meaning the push constant;
+	// the entries of the constants not used by the shader are ignored)
+	vk::Extent2D workgroupSize =
+		!v.tiled ? v.workgroupSize :
+		interiorPass ? vk::Extent2D(tileSize, 8) : vk::Extent2D(64, 1);
+	array<uint32_t,4> specializationData = { workgroupSize.width, workgroupSize.height, uint32_t(interiorPass), maxIter };
+	array specializationMap = {
+		vk::SpecializationMapEntry(0, 0, sizeof(uint32_t)),  // constantID, offset, size
+		vk::SpecializationMapEntry(1, sizeof(uint32_t), sizeof(uint32_t)),
+		vk::SpecializationMapEntry(2, 2*sizeof(uint32_t), sizeof(uint32_t)),
+		vk::SpecializationMapEntry(3, 3*sizeof(uint32_t), sizeof(uint32_t)),
+	};
+	vk::SpecializationInfo specializationInfo(
+		uint32_t(specializationMap.size()),  // mapEntryCount
+		specializationMap.data(),  // pMapEntries
+		sizeof(specializationData),  // dataSize
+		specializationData.data()  // pData
+	);
+
+	// fragment path pipeline
+	if(!v.compute)
+		return
+			createPipeline(
+				(v.precision == Precision::Df64) ? fsDf64Module :
+				(v.precision == Precision::Fp64) ? fsFp64Module : fsModule,
+				&specializationInfo
+			);
+
+	// compute path pipeline
+	return
+		pipelineCache.createComputePipeline(
+			vk::ComputePipelineCreateInfo(
+				vk::PipelineCreateFlags(),  // flags
+				vk::PipelineShaderStageCreateInfo{  // stage
+					vk::PipelineShaderStageCreateFlags(),  // flags
+					vk::ShaderStageFlagBits::eCompute,  // stage
+					v.tiled ? csTilesModule : csModule,  // module
+					"main",  // pName
+					&specializationInfo  // pSpecializationInfo
+				},
+				computePipelineLayout,  // layout
+				nullptr,  // basePipelineHandle
+				-1  // basePipelineIndex
+			)
+		);
+}
+
+
+const array<vk::Pipeline,2>& App::specializedPipelines(size_t variantIndex, uint32_t maxIter)
+{
+	// return existing pipelines
+	RenderVariant& v = renderVariants[variantIndex];
+	auto it = v.specializedPipelines.find(maxIter);
+	if(it != v.specializedPipelines.end())
+		return it->second;
+
+	// create pipelines
+	// (the creation time is printed, so it can be compared with the GPU time saved by the specialization)
+	auto startTime = chrono::high_resolution_clock::now();
+	array<vk::Pipeline,2> p = { createVariantPipeline(v, false, maxIter), nullptr };
+	if(v.tiled)
+		p[1] = createVariantPipeline(v, true, maxIter);
+	double t = chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+	cout << "Created " << variantName(variantIndex) << " pipeline specialized for maxIter " << maxIter
+	     << " in " << t * 1000 << "ms" << endl;
+	return v.specializedPipelines.emplace(maxIter, p).first->second;
+}
+
+
+uint32_t App::iterationLimit(double pixelSize)
+{
+	// iteration limit grows with the zoom, as the deep zooms need more iterations to show the details
+	// (the zoom is relative to 1024 pixels over the whole set; the limit is rounded up to multiple of 256)
+	double zoom = 4. / (pixelSize * 1024);
+	uint32_t n = 256 + uint32_t(max(log2(zoom), 0.) * 24);
+	return (n + 255) & ~uint32_t(255);
+}
+
+
+// countIterations - iterates the point in the same way as the shaders do
+// (the number of performed iterations is returned, so the interior points cost
+// the iterations done before their early-out)
+static uint32_t countIterations(double cx, double cy, uint32_t maxIter, bool earlyOuts, double periodEpsilon)
+{
+	if(earlyOuts) {
+		double x = cx - 0.25;
+		double q = x*x + cy*cy;
+		if(q*(q + x) <= 0.25*cy*cy || (cx+1.)*(cx+1.) + cy*cy <= 0.0625)
+			return 0;
+	}
+	double zx = 0.;
+	double zy = 0.;
+	double savedX = zx;
+	double savedY = zy;
+	uint32_t periodLength = 8;
+	uint32_t periodCounter = 0;
+	for(uint32_t i=0; i<maxIter; i++) {
+		double x = zx*zx - zy*zy + cx;
+		zy = 2.*zx*zy + cy;
+		zx = x;
+		if(zx*zx + zy*zy >= 4.)
+			return i+1;
+		if(earlyOuts && fabs(zx - savedX) + fabs(zy - savedY) < periodEpsilon)
+			return i+1;
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			savedX = zx;
+			savedY = zy;
+		}
+	}
+	return maxIter;
+}
+
+
+void App::printIterationEstimate()
+{
+	// skip unchanged pixel size
+	// (the view is fixed, so the window size affects just the iteration limit and the periodicity epsilon)
+	vk::Extent2D surfaceExtent = window.surfaceExtent();
+	double pixelSize = 4. / max(surfaceExtent.width, surfaceExtent.height);
+	if(pixelSize == estimatedPixelSize)
+		return;
+	estimatedPixelSize = pixelSize;
+
+	// iterate grid of samples over the view
+	// (the view spans the range <-2,2> in both directions)
+	constexpr const unsigned n = 64;
+	uint32_t maxIter = iterationLimit(pixelSize);
+	double fixedLimit = 0.;
+	double noEarlyOuts = 0.;
+	double earlyOuts = 0.;
+	for(unsigned j=0; j<n; j++)
+		for(unsigned i=0; i<n; i++) {
+			double cx = ((j + 0.5) / n - 0.5) * 4.;
+			double cy = ((i + 0.5) / n - 0.5) * 4.;
+			fixedLimit += countIterations(cx, cy, 255, false, 0.);
+			noEarlyOuts += countIterations(cx, cy, maxIter, false, 0.);
+			earlyOuts += countIterations(cx, cy, maxIter, true, pixelSize * 1e-3);
+		}
+	cout << "Iterations per pixel (estimate from " << n << "x" << n << " samples): "
+	     << fixedLimit / (n*n) << " with fixed limit of 255, "
+	     << noEarlyOuts / (n*n) << " with limit of " << maxIter << ", "
+	     << earlyOuts / (n*n) << " with limit of " << maxIter << " and interior early-outs" << endl;
 }
 
 
 void App::frame(VulkanWindow&)
 {
+	StartupProfiler::Scope profilerScope(startupProfiler, "frame");
 	cout << "x" << flush;
 
 	// wait for previous frame rendering work
 	// if still not finished
+	startupProfiler.phase("wait for the previous frame");
 	vk::Result r =
 		device.waitForFences(
 			renderFinishedFence,  // fences
@@ -679,6 +1477,67 @@ void App::frame(VulkanWindow&)
 	}
 	device.resetFences(renderFinishedFence);
 
+	// read timestamps of the previous frame
+	if(timedVariant != ~size_t(0)) {
+		array<uint64_t,2> timestamps;
+		r =
+			device.getQueryPoolResults(
+				timestampPool,  // queryPool
+				0,  // firstQuery
+				2,  // queryCount
+				sizeof(timestamps),  // dataSize
+				timestamps.data(),  // pData
+				sizeof(uint64_t),  // stride
+				vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait  // flags
+			);
+		if(r != vk::Result::eSuccess)
+			throw runtime_error("Vulkan error: vkGetQueryPoolResults failed with error " + to_string(r) + ".");
+		double t = double((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod_ns * 1e-9;
+		fpsGpuTime += t;
+		fpsGpuNumFrames++;
+		if(timedCalibrationSample) {
+			renderVariants[timedVariant].gpuTime += t;
+			renderVariants[timedVariant].numSamples++;
+		}
+		timedVariant = ~size_t(0);
+	}
+
+	// read tile statistics of the previous frame
+	// (the number of tiles listed for the interior pass follows the indirect dispatch command in the tile buffer;
+	// the other tiles had their inside of (tileSize-2)^2 pixels filled without computation)
+	if(tileStatsPending) {
+		vk::Extent2D extent = window.surfaceExtent();
+		uint32_t numTiles = tileGridExtent.width * tileGridExtent.height;
+		uint32_t numListedTiles = tileBufferPtr[3];
+		fpsSkippedPixels += double(numTiles - numListedTiles) * (tileSize-2) * (tileSize-2);
+		fpsTiledPixels += double(extent.width) * extent.height;
+		tileStatsPending = false;
+	}
+
+	// calibration
+	// (each variant renders warm-up frames followed by measured frames; the fastest one is selected at the end)
+	startupProfiler.phase("calibration");
+	if(calibrationFrame != ~size_t(0)) {
+		constexpr size_t framesPerVariant = calibrationWarmUpFrames + calibrationMeasuredFrames;
+		if(calibrationFrame < renderVariants.size() * framesPerVariant)
+			activeVariant = calibrationFrame / framesPerVariant;
+		else {
+			size_t best = 0;
+			cout << "\nCalibration results:" << endl;
+			for(size_t i=0; i<renderVariants.size(); i++) {
+				const RenderVariant& v = renderVariants[i];
+				double avg = v.numSamples ? v.gpuTime / v.numSamples : 0.;
+				cout << "   " << variantName(i) << ": " << avg * 1000 << "ms" << endl;
+				const RenderVariant& b = renderVariants[best];
+				if(v.numSamples && (!b.numSamples || avg < b.gpuTime / b.numSamples))
+					best = i;
+			}
+			activeVariant = best;
+			calibrationFrame = ~size_t(0);
+			cout << "Using " << variantName(activeVariant) << " path." << endl;
+		}
+	}
+
 	// increment frame counter
 	frameID++;
 
@@ -690,13 +1549,24 @@ void App::frame(VulkanWindow&)
 		auto t = chrono::high_resolution_clock::now();
 		auto dt = t - fpsStartTime;
 		if(dt >= chrono::seconds(2)) {
-			cout << "FPS: " << fpsNumFrames/chrono::duration<double>(dt).count() << endl;
+			cout << "FPS: " << fpsNumFrames/chrono::duration<double>(dt).count();
+			if(fpsGpuNumFrames != 0)
+				cout << ", GPU time: " << fpsGpuTime / fpsGpuNumFrames * 1000 << "ms (" << variantName(activeVariant) << ")";
+			if(fpsTiledPixels != 0.)
+				cout << ", skipped pixels: " << fpsSkippedPixels / fpsTiledPixels * 100 << "%";
+			cout << endl;
+			printIterationEstimate();
 			fpsNumFrames = 0;
+			fpsGpuTime = 0.;
+			fpsGpuNumFrames = 0;
+			fpsSkippedPixels = 0.;
+			fpsTiledPixels = 0.;
 			fpsStartTime = t;
 		}
 	}
 
 	// acquire image
+	startupProfiler.phase("acquire image");
 	uint32_t imageIndex;
 	r =
 		device.acquireNextImageKHR(
@@ -720,54 +1590,313 @@ void App::frame(VulkanWindow&)
 	}
 
 	// record command buffer
+	startupProfiler.phase("record command buffer");
 	commandBuffer.begin(
 		vk::CommandBufferBeginInfo(
 			vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
 			nullptr  // pInheritanceInfo
 		)
 	);
-	commandBuffer.beginRenderPass(
-		vk::RenderPassBeginInfo(
-			renderPass,  // renderPass
-			framebuffers[imageIndex],  // framebuffer
-			vk::Rect2D(vk::Offset2D(0, 0), window.surfaceExtent()),  // renderArea
-			1,  // clearValueCount
-			&(const vk::ClearValue&)vk::ClearValue(  // pClearValues
-				vk::ClearColorValue(array<float, 4>{0.0f, 0.0f, 0.0f, 1.f})
-			)
-		),
-		vk::SubpassContents::eInline
-	);
+	if(timestampPool) {
+		commandBuffer.resetQueryPool(timestampPool, 0, 2);
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampPool, 0);
+	}
+	const RenderVariant& variant = renderVariants[activeVariant];
+
+	// push constants
+	// (the view spans the range <-2,2> in both directions, so the pixel size is given by the larger side;
+	// c is zero in the middle of the surface, its x grows with the framebuffer y and its y
+	// with the framebuffer x, as shader.vert swaps the coordinates)
+	vk::Extent2D surfaceExtent = window.surfaceExtent();
+	double pixelSize = 4. / max(surfaceExtent.width, surfaceExtent.height);
+	double pixelStepX = 4. / surfaceExtent.height;
+	double pixelStepY = 4. / surfaceExtent.width;
+	PushData pushData{
+		int32_t(iterationLimit(pixelSize)),  // maxIter
+		float(pixelSize),  // pixelSize
+		{ float(surfaceExtent.width) / 2.f, float(surfaceExtent.height) / 2.f },  // referencePixel
+		{ float(pixelStepX), float(pixelStepY) },  // pixelStepHi
+		{ float(pixelStepX - float(pixelStepX)), float(pixelStepY - float(pixelStepY)) },  // pixelStepLo
+		{ pixelStepX, pixelStepY },  // pixelStep
+	};
 
-	// rendering commands
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);  // bind pipeline
-	commandBuffer.draw(  // draw single triangle
-		4,  // vertexCount
-		1,  // instanceCount
-		0,  // firstVertex
-		uint32_t(frameID)  // firstInstance
-	);
+	// pipelines
+	// (pipelines specialized by the iteration limit are used unless the specialization is disabled)
+	vk::Pipeline pipeline = variant.pipeline;
+	vk::Pipeline interiorPipeline = variant.interiorPipeline;
+	if(specializeIterations) {
+		const array<vk::Pipeline,2>& p = specializedPipelines(activeVariant, uint32_t(pushData.maxIter));
+		pipeline = p[0];
+		interiorPipeline = p[1];
+	}
+
+	if(!variant.compute) {
+
+		// fragment path
+		commandBuffer.beginRenderPass(
+			vk::RenderPassBeginInfo(
+				renderPass,  // renderPass
+				framebuffers[imageIndex],  // framebuffer
+				vk::Rect2D(vk::Offset2D(0, 0), window.surfaceExtent()),  // renderArea
+				1,  // clearValueCount
+				&(const vk::ClearValue&)vk::ClearValue(  // pClearValues
+					vk::ClearColorValue(array<float, 4>{0.0f, 0.0f, 0.0f, 1.f})
+				)
+			),
+			vk::SubpassContents::eInline
+		);
+
+		// rendering commands
+		commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);  // bind pipeline
+		commandBuffer.setViewport(
+			0,  // firstViewport
+			vk::Viewport(0.f, 0.f, float(surfaceExtent.width), float(surfaceExtent.height), 0.f, 1.f)  // viewports
+		);
+		commandBuffer.setScissor(
+			0,  // firstScissor
+			vk::Rect2D(vk::Offset2D(0, 0), surfaceExtent)  // scissors
+		);
+		commandBuffer.pushConstants(
+			pipelineLayout,  // layout
+			vk::ShaderStageFlagBits::eFragment,  // stageFlags
+			0,  // offset
+			sizeof(PushData),  // size
+			&pushData  // pValues
+		);
+		commandBuffer.draw(  // draw single triangle
+			4,  // vertexCount
+			1,  // instanceCount
+			0,  // firstVertex
+			uint32_t(frameID)  // firstInstance
+		);
+
+		// end render pass
+		commandBuffer.endRenderPass();
+
+	}
+	else {
+
+		// compute path
+		// (storage image content of the previous frame is discarded)
+		const vk::ImageSubresourceRange colorRange(
+			vk::ImageAspectFlagBits::eColor,  // aspectMask
+			0,  // baseMipLevel
+			1,  // levelCount
+			0,  // baseArrayLayer
+			1   // layerCount
+		);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTopOfPipe,  // srcStageMask
+			vk::PipelineStageFlagBits::eComputeShader,  // dstStageMask
+			vk::DependencyFlags(),  // dependencyFlags
+			nullptr,  // memoryBarriers
+			nullptr,  // bufferMemoryBarriers
+			vk::ImageMemoryBarrier{  // imageMemoryBarriers
+				vk::AccessFlags(),  // srcAccessMask
+				vk::AccessFlagBits::eShaderWrite,  // dstAccessMask
+				vk::ImageLayout::eUndefined,  // oldLayout
+				vk::ImageLayout::eGeneral,  // newLayout
+				VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+				VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+				storageImage,  // image
+				colorRange  // subresourceRange
+			}
+		);
+
+		// dispatch
+		vk::Extent2D extent = window.surfaceExtent();
+		commandBuffer.bindDescriptorSets(
+			vk::PipelineBindPoint::eCompute,  // pipelineBindPoint
+			computePipelineLayout,  // layout
+			0,  // firstSet
+			descriptorSet,  // descriptorSets
+			nullptr  // dynamicOffsets
+		);
+		commandBuffer.pushConstants(
+			computePipelineLayout,  // layout
+			vk::ShaderStageFlagBits::eCompute,  // stageFlags
+			0,  // offset
+			sizeof(PushData),  // size
+			&pushData  // pValues
+		);
+		if(!variant.tiled) {
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+			commandBuffer.dispatch(
+				(extent.width + variant.workgroupSize.width - 1) / variant.workgroupSize.width,  // groupCountX
+				(extent.height + variant.workgroupSize.height - 1) / variant.workgroupSize.height,  // groupCountY
+				1  // groupCountZ
+			);
+		}
+		else {
 
-	// end render pass and command buffer
-	commandBuffer.endRenderPass();
+			// reset the indirect dispatch command and the number of tiles of the tile buffer
+			// (the tile buffer of the previous frame was already read, as its fence was waited for;
+			// the border pass raises groupCountX and groupCountY, as the tiles are dispatched in rows
+			// of 1024 workgroups to stay within maxComputeWorkGroupCount)
+			commandBuffer.updateBuffer(
+				tileBuffer,  // dstBuffer
+				0,  // dstOffset
+				4 * sizeof(uint32_t),  // dataSize
+				array<uint32_t,4>{ 0, 0, 1, 0 }.data()  // pData
+			);
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+				vk::PipelineStageFlagBits::eComputeShader,  // dstStageMask
+				vk::DependencyFlags(),  // dependencyFlags
+				vk::MemoryBarrier(  // memoryBarriers
+					vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+					vk::AccessFlagBits::eShaderRead | vk::AccessFlagBits::eShaderWrite  // dstAccessMask
+				),
+				nullptr,  // bufferMemoryBarriers
+				nullptr  // imageMemoryBarriers
+			);
+
+			// border pass
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline);
+			commandBuffer.dispatch(
+				tileGridExtent.width,  // groupCountX
+				tileGridExtent.height,  // groupCountY
+				1  // groupCountZ
+			);
+
+			// interior pass over the listed tiles
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eComputeShader,  // srcStageMask
+				vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eComputeShader,  // dstStageMask
+				vk::DependencyFlags(),  // dependencyFlags
+				vk::MemoryBarrier(  // memoryBarriers
+					vk::AccessFlagBits::eShaderWrite,  // srcAccessMask
+					vk::AccessFlagBits::eIndirectCommandRead | vk::AccessFlagBits::eShaderRead  // dstAccessMask
+				),
+				nullptr,  // bufferMemoryBarriers
+				nullptr  // imageMemoryBarriers
+			);
+			commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, interiorPipeline);
+			commandBuffer.dispatchIndirect(
+				tileBuffer,  // buffer
+				0  // offset
+			);
+
+			// make the tile list readable by host after the fence
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eComputeShader,  // srcStageMask
+				vk::PipelineStageFlagBits::eHost,  // dstStageMask
+				vk::DependencyFlags(),  // dependencyFlags
+				vk::MemoryBarrier(  // memoryBarriers
+					vk::AccessFlagBits::eShaderWrite,  // srcAccessMask
+					vk::AccessFlagBits::eHostRead  // dstAccessMask
+				),
+				nullptr,  // bufferMemoryBarriers
+				nullptr  // imageMemoryBarriers
+			);
+			tileStatsPending = true;
+
+		}
+
+		// transition storage image to blit source and swapchain image to blit destination
+		// (the swapchain image barrier is chained with the semaphore wait in eTransfer stage)
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eComputeShader | vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+			vk::PipelineStageFlagBits::eTransfer,  // dstStageMask
+			vk::DependencyFlags(),  // dependencyFlags
+			nullptr,  // memoryBarriers
+			nullptr,  // bufferMemoryBarriers
+			array{  // imageMemoryBarriers
+				vk::ImageMemoryBarrier{
+					vk::AccessFlagBits::eShaderWrite,  // srcAccessMask
+					vk::AccessFlagBits::eTransferRead,  // dstAccessMask
+					vk::ImageLayout::eGeneral,  // oldLayout
+					vk::ImageLayout::eTransferSrcOptimal,  // newLayout
+					VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+					VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+					storageImage,  // image
+					colorRange  // subresourceRange
+				},
+				vk::ImageMemoryBarrier{
+					vk::AccessFlags(),  // srcAccessMask
+					vk::AccessFlagBits::eTransferWrite,  // dstAccessMask
+					vk::ImageLayout::eUndefined,  // oldLayout
+					vk::ImageLayout::eTransferDstOptimal,  // newLayout
+					VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+					VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+					swapchainImages[imageIndex],  // image
+					colorRange  // subresourceRange
+				},
+			}
+		);
+
+		// blit into the swapchain image
+		// (blit converts unorm values into the swapchain format, including sRGB encoding,
+		// so the result matches the fragment path)
+		const vk::ImageSubresourceLayers colorLayers(
+			vk::ImageAspectFlagBits::eColor,  // aspectMask
+			0,  // mipLevel
+			0,  // baseArrayLayer
+			1   // layerCount
+		);
+		const array<vk::Offset3D,2> offsets = {
+			vk::Offset3D(0, 0, 0),
+			vk::Offset3D(int32_t(extent.width), int32_t(extent.height), 1),
+		};
+		commandBuffer.blitImage(
+			storageImage, vk::ImageLayout::eTransferSrcOptimal,  // srcImage + srcImageLayout
+			swapchainImages[imageIndex], vk::ImageLayout::eTransferDstOptimal,  // dstImage + dstImageLayout
+			vk::ImageBlit(colorLayers, offsets, colorLayers, offsets),  // regions
+			vk::Filter::eNearest  // filter
+		);
+
+		// transition swapchain image for presentation
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+			vk::PipelineStageFlagBits::eBottomOfPipe,  // dstStageMask
+			vk::DependencyFlags(),  // dependencyFlags
+			nullptr,  // memoryBarriers
+			nullptr,  // bufferMemoryBarriers
+			vk::ImageMemoryBarrier{  // imageMemoryBarriers
+				vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+				vk::AccessFlags(),  // dstAccessMask
+				vk::ImageLayout::eTransferDstOptimal,  // oldLayout
+				vk::ImageLayout::ePresentSrcKHR,  // newLayout
+				VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+				VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+				swapchainImages[imageIndex],  // image
+				colorRange  // subresourceRange
+			}
+		);
+
+	}
+
+	// end command buffer
+	if(timestampPool)
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampPool, 1);
 	commandBuffer.end();
 
 	// submit frame
+	startupProfiler.phase("submit");
 	graphicsQueue.submit(
 		vk::ArrayProxy<const vk::SubmitInfo>(
 			1,
 			&(const vk::SubmitInfo&)vk::SubmitInfo(
 				1, &imageAvailableSemaphore,  // waitSemaphoreCount + pWaitSemaphores +
 				&(const vk::PipelineStageFlags&)vk::PipelineStageFlags(  // pWaitDstStageMask
-					vk::PipelineStageFlagBits::eColorAttachmentOutput),
+					variant.compute ? vk::PipelineStageFlagBits::eTransfer
+					                : vk::PipelineStageFlagBits::eColorAttachmentOutput),
 				1, &commandBuffer,  // commandBufferCount + pCommandBuffers
 				1, &renderFinishedSemaphore  // signalSemaphoreCount + pSignalSemaphores
 			)
 		),
 		renderFinishedFence  // fence
 	);
+	if(timestampPool) {
+		timedVariant = activeVariant;
+		timedCalibrationSample = calibrationFrame != ~size_t(0) &&
+			calibrationFrame % (calibrationWarmUpFrames + calibrationMeasuredFrames) >= calibrationWarmUpFrames;
+	}
+	if(calibrationFrame != ~size_t(0))
+		calibrationFrame++;
 
 	// present
+	startupProfiler.phase("present");
 	r =
 		presentationQueue.presentKHR(
 			&(const vk::PresentInfoKHR&)vk::PresentInfoKHR(
@@ -787,8 +1916,33 @@ void App::frame(VulkanWindow&)
 			throw runtime_error("Vulkan error: vkQueuePresentKHR() failed with error " + to_string(r) + ".");
 	}
 
+	// finish startup profiling
+	// (the first presented frame ends the startup)
+	if(startupProfiler.recording()) {
+		startupProfiler.finish();
+		startupProfiler.printSummary();
+		// (failure to write the trace is reported only, so it does not end the application)
+		if(!startupTracePath.empty()) {
+			try {
+				startupProfiler.writeTrace(startupTracePath, appName);
+			} catch(exception& e) {
+				cout << "Failed to write startup trace: " << e.what() << endl;
+			}
+		}
+	}
+
+	// report resize latency
+	// (time from the swapchain recreation to the presentation of the first frame)
+	if(resizeMeasurementPending) {
+		resizeMeasurementPending = false;
+		cout << "Resize to first frame: "
+		     << chrono::duration<double>(chrono::high_resolution_clock::now() - resizeStartTime).count() * 1000
+		     << "ms" << endl;
+	}
+
 	// schedule next frame
-	if(frameUpdateMode != FrameUpdateMode::OnDemand)
+	// (calibration renders frames continuously)
+	if(frameUpdateMode != FrameUpdateMode::OnDemand || calibrationFrame != ~size_t(0))
 		window.scheduleFrame();
 }
 
@@ -815,9 +1969,15 @@ int main(int argc, char* argv[])
 			app.physicalDevice,
 			app.device
 		);
+		startupProfiler.phase("VulkanWindow::show");
 		app.window.show();
+		startupProfiler.phase("mainLoop up to the first frame");
 		app.window.mainLoop();
 
+		// save pipeline cache for the next run
+		app.pipelineCache.printStats();
+		app.pipelineCache.save();
+
 	// catch exceptions
 	} catch(vk::Error& e) {
 		cout << "Failed because of Vulkan exception: " << e.what() << endl;
@@ -0,0 +1,140 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+
+// push constants
+// (the first part is shared with shader.frag; c is computed from gl_FragCoord
+// and the pixel step given in df64, as the float varying would limit its precision)
+layout(push_constant) uniform pushConstants {
+	layout(offset=0) int maxIter;  // iteration limit growing with the zoom
+	layout(offset=4) float pixelSize;
+	layout(offset=8) vec2 referencePixel;  // position of the view center (c = 0) in framebuffer coordinates
+	layout(offset=16) vec2 pixelStepHi;  // pixel step of c as sum of pixelStepHi and pixelStepLo
+	layout(offset=24) vec2 pixelStepLo;
+};
+
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop)
+layout(constant_id = 3) const int specializedMaxIter = 0;
+
+
+// double-float arithmetic
+// (each number is stored as unevaluated sum of two floats, hi in x and lo in y,
+// giving about 48 bits of mantissa; precise qualifier prevents the compiler
+// from reassociating the operations that compute rounding errors)
+vec2 quickTwoSum(float a, float b)
+{
+	precise float s = a + b;
+	precise float e = b - (s - a);
+	return vec2(s, e);
+}
+
+vec2 twoSum(float a, float b)
+{
+	precise float s = a + b;
+	precise float v = s - a;
+	precise float e = (a - (s - v)) + (b - v);
+	return vec2(s, e);
+}
+
+// split - splits float into high and low halves of 12 bits each (Veltkamp split)
+vec2 split(float a)
+{
+	precise float t = 4097.0 * a;
+	precise float hi = t - (t - a);
+	precise float lo = a - hi;
+	return vec2(hi, lo);
+}
+
+// twoProd - exact product by Dekker's algorithm
+// (fma() is not guaranteed to be fused by Vulkan, so the error term is not computed by it)
+vec2 twoProd(float a, float b)
+{
+	precise float p = a * b;
+	vec2 as = split(a);
+	vec2 bs = split(b);
+	precise float e = ((as.x*bs.x - p) + as.x*bs.y + as.y*bs.x) + as.y*bs.y;
+	return vec2(p, e);
+}
+
+vec2 dfAdd(vec2 a, vec2 b)
+{
+	vec2 s = twoSum(a.x, b.x);
+	precise float e = s.y + a.y + b.y;
+	return quickTwoSum(s.x, e);
+}
+
+vec2 dfMul(vec2 a, vec2 b)
+{
+	vec2 p = twoProd(a.x, b.x);
+	precise float e = p.y + (a.x*b.y + a.y*b.x);
+	return quickTwoSum(p.x, e);
+}
+
+
+void main()
+{
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
+	// initialize z and c complex numbers
+	// (x and y coordinates are swapped in the same way as shader.vert does;
+	// the offset from the view center is exact in float and it is multiplied in df64)
+	vec2 zx, zy;
+	vec2 offset = (gl_FragCoord.xy - referencePixel).yx;
+	vec2 cx = dfMul(vec2(offset.x, 0.0), vec2(pixelStepHi.x, pixelStepLo.x));
+	vec2 cy = dfMul(vec2(offset.y, 0.0), vec2(pixelStepHi.y, pixelStepLo.y));
+
+	// interior test
+	// (points of the main cardioid and of the period-2 bulb are inside the Mandelbrot set,
+	// so they are not iterated; the test is evaluated in df64, as c is given in df64)
+	int i = 0;
+	vec2 x = dfAdd(cx, vec2(-0.25, 0.0));
+	vec2 cyy = dfMul(cy, cy);
+	vec2 q = dfAdd(dfMul(x, x), cyy);
+	vec2 cardioid = dfAdd(dfMul(q, dfAdd(q, x)), -0.25*cyy);
+	vec2 x1 = dfAdd(cx, vec2(1.0, 0.0));
+	vec2 bulb = dfAdd(dfAdd(dfMul(x1, x1), cyy), vec2(-0.0625, 0.0));
+	if(cardioid.x <= 0.0 || bulb.x <= 0.0)
+		i = iterLimit;
+
+	// iterate z = z^2 + c
+	// (the squares of z are computed once and used by both the escape test and the next iteration;
+	// periodicity check: z returning close to the value saved after power-of-two iterations
+	// means attracting cycle, so the point is inside the set)
+	vec2 xx = vec2(0.0, 0.0);
+	vec2 yy = vec2(0.0, 0.0);
+	vec2 xy = vec2(0.0, 0.0);
+	float periodEpsilon = pixelSize * 1e-3;
+	vec2 zxSaved = vec2(0.0, 0.0);
+	vec2 zySaved = vec2(0.0, 0.0);
+	int periodLength = 8;
+	int periodCounter = 0;
+	for(; i<iterLimit; i++) {
+		zx = dfAdd(dfAdd(xx, -yy), cx);
+		zy = dfAdd(2.*xy, cy);
+		xx = dfMul(zx, zx);
+		yy = dfMul(zy, zy);
+		xy = dfMul(zx, zy);
+		if(xx.x + yy.x >= 4.0)
+			break;
+		if(abs(dfAdd(zx, -zxSaved).x) + abs(dfAdd(zy, -zySaved).x) < periodEpsilon) {
+			i = iterLimit;
+			break;
+		}
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			zxSaved = zx;
+			zySaved = zy;
+		}
+	}
+
+	// assign color
+	// (fixed scale of 255 iterations, so the brightness does not depend on iterLimit;
+	// the interior and the counts above 255 are white)
+	float l = min(float(i) / 255., 1.);
+	outColor = vec4(l);
+}
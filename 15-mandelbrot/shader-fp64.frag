@@ -0,0 +1,69 @@
+#version 450
+
+layout(location = 0) out vec4 outColor;
+
+// push constants
+// (the first part is shared with shader.frag; c is computed from gl_FragCoord
+// and the pixel step given in double, as the float varying would limit its precision)
+layout(push_constant) uniform pushConstants {
+	layout(offset=0) int maxIter;  // iteration limit growing with the zoom
+	layout(offset=4) float pixelSize;
+	layout(offset=8) vec2 referencePixel;  // position of the view center (c = 0) in framebuffer coordinates
+	layout(offset=32) dvec2 pixelStep;  // pixel step of c
+};
+
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop)
+layout(constant_id = 3) const int specializedMaxIter = 0;
+
+
+void main()
+{
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
+	// initialize z and c complex numbers
+	// (x and y coordinates are swapped in the same way as shader.vert does;
+	// the offset from the view center is exact in float and it is multiplied in double)
+	dvec2 z = dvec2(0.0, 0.0);
+	dvec2 c = dvec2((gl_FragCoord.xy - referencePixel).yx) * pixelStep;
+
+	// interior test
+	// (points of the main cardioid and of the period-2 bulb are inside the Mandelbrot set,
+	// so they are not iterated)
+	int i = 0;
+	double x = c.x - 0.25;
+	double q = x*x + c.y*c.y;
+	if(q*(q + x) <= 0.25*c.y*c.y || (c.x+1.0)*(c.x+1.0) + c.y*c.y <= 0.0625)
+		i = iterLimit;
+
+	// iterate z = z^2 + c
+	// (periodicity check: z returning close to the value saved after power-of-two iterations
+	// means attracting cycle, so the point is inside the set)
+	double periodEpsilon = double(pixelSize) * 1e-3;
+	dvec2 zSaved = z;
+	int periodLength = 8;
+	int periodCounter = 0;
+	for(; i<iterLimit; i++) {
+		z = dvec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
+		if(z.x*z.x + z.y*z.y >= 4.0)
+			break;
+		if(abs(z.x - zSaved.x) + abs(z.y - zSaved.y) < periodEpsilon) {
+			i = iterLimit;
+			break;
+		}
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			zSaved = z;
+		}
+	}
+
+	// assign color
+	// (fixed scale of 255 iterations, so the brightness does not depend on iterLimit;
+	// the interior and the counts above 255 are white)
+	float l = min(float(i) / 255., 1.);
+	outColor = vec4(l);
+}
@@ -4,24 +4,61 @@ layout(location = 0) in vec2 inInitialValue;
 
 layout(location = 0) out vec4 outColor;
 
-const int maxIter = 255;
+layout(push_constant) uniform pushConstants {
+	int maxIter;  // iteration limit growing with the zoom
+	float pixelSize;
+};
+
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop; constant_id 3 matches the compute shaders)
+layout(constant_id = 3) const int specializedMaxIter = 0;
 
 
 void main()
 {
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
 	// initialize z and c complex numbers
 	vec2 z = vec2(0.0, 0.0);
 	vec2 c = inInitialValue;
 
-	// iterate z = z^2 + c
+	// interior test
+	// (points of the main cardioid and of the period-2 bulb are inside the Mandelbrot set,
+	// so they are not iterated)
 	int i = 0;
-	for(; i<maxIter; i++) {
+	float x = c.x - 0.25;
+	float q = x*x + c.y*c.y;
+	if(q*(q + x) <= 0.25*c.y*c.y || (c.x+1.0)*(c.x+1.0) + c.y*c.y <= 0.0625)
+		i = iterLimit;
+
+	// iterate z = z^2 + c
+	// (periodicity check: z returning close to the value saved after power-of-two iterations
+	// means attracting cycle, so the point is inside the set)
+	float periodEpsilon = pixelSize * 1e-3;
+	vec2 zSaved = z;
+	int periodLength = 8;
+	int periodCounter = 0;
+	for(; i<iterLimit; i++) {
 		z = vec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
 		if(z.x*z.x + z.y*z.y >= 4.0)
 			break;
+		if(abs(z.x - zSaved.x) + abs(z.y - zSaved.y) < periodEpsilon) {
+			i = iterLimit;
+			break;
+		}
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			zSaved = z;
+		}
 	}
 
 	// assign color
-	float l = float(i) / maxIter;
+	// (fixed scale of 255 iterations, so the brightness does not depend on iterLimit;
+	// the interior and the counts above 255 are white)
+	float l = min(float(i) / 255., 1.);
 	outColor = vec4(l);
 }
@@ -0,0 +1,210 @@
+#include "FixedPoint.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace std;
+
+
+FixedPoint FixedPoint::fromDouble(double v, unsigned numFractionalLimbs)
+{
+	if(!isfinite(v) || fabs(v) >= 4294967296.)
+		throw out_of_range("FixedPoint::fromDouble(): Value out of range.");
+
+	FixedPoint r(numFractionalLimbs);
+	r._negative = v < 0.;
+	double a = fabs(v);
+
+	// integer part and fractional limbs
+	// (multiplication by 2^32 and subtraction of the integer part are exact in double arithmetic)
+	double i = floor(a);
+	r._limbs[numFractionalLimbs] = uint32_t(i);
+	a -= i;
+	for(unsigned j=numFractionalLimbs; j>0 && a!=0.; j--) {
+		a *= 4294967296.;
+		i = floor(a);
+		r._limbs[j-1] = uint32_t(i);
+		a -= i;
+	}
+	r.normalizeSign();
+	return r;
+}
+
+
+FixedPoint FixedPoint::withPrecision(unsigned numFractionalLimbs) const
+{
+	FixedPoint r;
+	unsigned n = this->numFractionalLimbs();
+	r._limbs.assign(numFractionalLimbs+1, 0);
+	r._negative = _negative;
+	if(numFractionalLimbs >= n)
+		copy(_limbs.begin(), _limbs.end(), r._limbs.begin() + (numFractionalLimbs-n));
+	else
+		copy(_limbs.begin() + (n-numFractionalLimbs), _limbs.end(), r._limbs.begin());
+	r.normalizeSign();
+	return r;
+}
+
+
+void FixedPoint::extend(unsigned numFractionalLimbs)
+{
+	unsigned n = this->numFractionalLimbs();
+	if(numFractionalLimbs > n)
+		_limbs.insert(_limbs.begin(), numFractionalLimbs-n, 0);
+}
+
+
+void FixedPoint::normalizeSign()
+{
+	// zero is always positive
+	if(_negative && all_of(_limbs.begin(), _limbs.end(), [](uint32_t l) { return l == 0; }))
+		_negative = false;
+}
+
+
+double FixedPoint::toDouble() const
+{
+	// sum the limbs from the least significant one,
+	// stopping early as the lower limbs cannot affect the double mantissa
+	unsigned n = numFractionalLimbs();
+	double r = 0.;
+	for(unsigned j = (n > 3) ? n-3 : 0; j<=n; j++)
+		r += ldexp(double(_limbs[j]), 32*(int(j)-int(n)));
+	return _negative ? -r : r;
+}
+
+
+string FixedPoint::toString(unsigned numDigits) const
+{
+	string s = _negative ? "-" : "";
+	unsigned n = numFractionalLimbs();
+	s += to_string(_limbs[n]);
+	if(numDigits == 0)
+		return s;
+	s += '.';
+
+	// multiply the fractional part by ten and take the overflow as the next digit
+	vector<uint32_t> frac(_limbs.begin(), _limbs.begin()+n);
+	for(unsigned d=0; d<numDigits; d++) {
+		uint64_t carry = 0;
+		for(uint32_t& l : frac) {
+			uint64_t t = uint64_t(l) * 10 + carry;
+			l = uint32_t(t);
+			carry = t >> 32;
+		}
+		s += char('0' + carry);
+	}
+	return s;
+}
+
+
+int FixedPoint::compareMagnitudes(const FixedPoint& a, const FixedPoint& b)
+{
+	// the numbers are compared limb by limb from the most significant one,
+	// the missing lower limbs of the less precise number are zeros
+	unsigned na = a.numFractionalLimbs();
+	unsigned nb = b.numFractionalLimbs();
+	unsigned n = max(na, nb);
+	for(unsigned j=n+1; j>0; j--) {
+		unsigned k = j-1;
+		uint32_t la = (k+na >= n) ? a._limbs[k+na-n] : 0;
+		uint32_t lb = (k+nb >= n) ? b._limbs[k+nb-n] : 0;
+		if(la != lb)
+			return (la < lb) ? -1 : 1;
+	}
+	return 0;
+}
+
+
+FixedPoint FixedPoint::addSigned(const FixedPoint& a, const FixedPoint& b, bool negateB)
+{
+	unsigned n = max(a.numFractionalLimbs(), b.numFractionalLimbs());
+	FixedPoint x = a;
+	FixedPoint y = b;
+	x.extend(n);
+	y.extend(n);
+	if(negateB)
+		y._negative = !y._negative;
+
+	// same signs - add magnitudes
+	if(x._negative == y._negative) {
+		uint64_t carry = 0;
+		for(size_t j=0; j<=n; j++) {
+			uint64_t t = uint64_t(x._limbs[j]) + y._limbs[j] + carry;
+			x._limbs[j] = uint32_t(t);
+			carry = t >> 32;
+		}
+		if(carry)
+			throw overflow_error("FixedPoint overflow.");
+		return x;
+	}
+
+	// different signs - subtract smaller magnitude from the larger one
+	if(compareMagnitudes(x, y) < 0)
+		swap(x, y);
+	int64_t borrow = 0;
+	for(size_t j=0; j<=n; j++) {
+		int64_t t = int64_t(x._limbs[j]) - y._limbs[j] - borrow;
+		borrow = (t < 0) ? 1 : 0;
+		x._limbs[j] = uint32_t(t + (borrow << 32));
+	}
+	x.normalizeSign();
+	return x;
+}
+
+
+FixedPoint FixedPoint::operator*(const FixedPoint& b) const
+{
+	unsigned na = numFractionalLimbs();
+	unsigned nb = b.numFractionalLimbs();
+	unsigned n = max(na, nb);
+
+	// schoolbook multiplication into double-length accumulator
+	vector<uint32_t> product(_limbs.size() + b._limbs.size(), 0);
+	for(size_t i=0; i<_limbs.size(); i++) {
+		uint64_t carry = 0;
+		uint64_t ai = _limbs[i];
+		if(ai == 0)
+			continue;
+		for(size_t j=0; j<b._limbs.size(); j++) {
+			uint64_t t = ai * b._limbs[j] + product[i+j] + carry;
+			product[i+j] = uint32_t(t);
+			carry = t >> 32;
+		}
+		for(size_t k=i+b._limbs.size(); carry; k++) {
+			uint64_t t = uint64_t(product[k]) + carry;
+			product[k] = uint32_t(t);
+			carry = t >> 32;
+		}
+	}
+
+	// the product has na+nb fractional limbs; keep n of them and one integer limb
+	size_t shift = na + nb - n;
+	for(size_t k=shift+n+1; k<product.size(); k++)
+		if(product[k] != 0)
+			throw overflow_error("FixedPoint overflow.");
+	FixedPoint r(n);
+	copy(product.begin()+shift, product.begin()+shift+n+1, r._limbs.begin());
+	r._negative = _negative != b._negative;
+	r.normalizeSign();
+	return r;
+}
+
+
+FixedPoint FixedPoint::operator-() const
+{
+	FixedPoint r = *this;
+	r._negative = !r._negative;
+	r.normalizeSign();
+	return r;
+}
+
+
+unsigned FixedPoint::limbsForResolution(double resolution)
+{
+	// bits of the resolution plus 32 guard bits, at least one limb
+	int e;
+	frexp(resolution, &e);
+	int bits = max(-e, 0) + 32;
+	return unsigned(max((bits + 31) / 32, 1));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+/** FixedPoint is signed fixed-point number of arbitrary precision.
+ *  The magnitude is stored in 32-bit limbs; the most significant limb holds the integer part
+ *  and the remaining limbs hold the fractional part, so the resolution is 2^(-32*numFractionalLimbs).
+ *  It is used for the view center and for the reference orbit of deep zooms, where double
+ *  precision is not enough. The numbers of different precision might be mixed in the operations;
+ *  the result has the precision of the more precise operand. Multiplication truncates the result
+ *  to that precision. */
+class FixedPoint {
+protected:
+
+	std::vector<uint32_t> _limbs;  // magnitude, least significant limb first, the last limb is the integer part
+	bool _negative = false;
+
+	void extend(unsigned numFractionalLimbs);
+	void normalizeSign();
+	static int compareMagnitudes(const FixedPoint& a, const FixedPoint& b);
+	static FixedPoint addSigned(const FixedPoint& a, const FixedPoint& b, bool negateB);
+
+public:
+
+	FixedPoint();  // zero with one fractional limb
+	explicit FixedPoint(unsigned numFractionalLimbs);  // zero
+	static FixedPoint fromDouble(double v, unsigned numFractionalLimbs);
+
+	FixedPoint withPrecision(unsigned numFractionalLimbs) const;
+	double toDouble() const;
+	std::string toString(unsigned numDigits) const;  // decimal representation with numDigits fractional digits
+
+	FixedPoint operator+(const FixedPoint& b) const;
+	FixedPoint operator-(const FixedPoint& b) const;
+	FixedPoint operator*(const FixedPoint& b) const;
+	FixedPoint operator-() const;
+	FixedPoint& operator+=(const FixedPoint& b);
+	FixedPoint& operator-=(const FixedPoint& b);
+
+	// getters
+	unsigned numFractionalLimbs() const;
+	bool isNegative() const;
+
+	static unsigned limbsForResolution(double resolution);  // number of fractional limbs needed to represent the given resolution with 32 guard bits
+
+};
+
+
+// inline methods
+inline FixedPoint::FixedPoint() : _limbs(2, 0)  {}
+inline FixedPoint::FixedPoint(unsigned numFractionalLimbs) : _limbs(numFractionalLimbs+1, 0)  {}
+inline FixedPoint FixedPoint::operator+(const FixedPoint& b) const  { return addSigned(*this, b, false); }
+inline FixedPoint FixedPoint::operator-(const FixedPoint& b) const  { return addSigned(*this, b, true); }
+inline FixedPoint& FixedPoint::operator+=(const FixedPoint& b)  { *this = addSigned(*this, b, false); return *this; }
+inline FixedPoint& FixedPoint::operator-=(const FixedPoint& b)  { *this = addSigned(*this, b, true); return *this; }
+inline unsigned FixedPoint::numFractionalLimbs() const  { return unsigned(_limbs.size()) - 1; }
+inline bool FixedPoint::isNegative() const  { return _negative; }
@@ -0,0 +1,192 @@
+#include "PipelineCache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+
+filesystem::path PipelineCache::defaultFilePath(vk::PhysicalDevice physicalDevice, const char* appName)
+{
+	// cache directory
+	// (LOCALAPPDATA on Windows, XDG_CACHE_HOME or ~/.cache elsewhere, the current directory as the last resort)
+	filesystem::path dir;
+#ifdef _WIN32
+	if(const char* s = getenv("LOCALAPPDATA"); s && s[0])
+		dir = filesystem::path(s) / "VulkanTutorial";
+#else
+	if(const char* s = getenv("XDG_CACHE_HOME"); s && s[0])
+		dir = filesystem::path(s) / "VulkanTutorial";
+	else if(const char* s = getenv("HOME"); s && s[0])
+		dir = filesystem::path(s) / ".cache" / "VulkanTutorial";
+#endif
+
+	// file name
+	// (vendor and device ids are part of the name, so the machines with more devices
+	// do not overwrite the cache of one device by the cache of another)
+	vk::PhysicalDeviceProperties p = physicalDevice.getProperties();
+	char ids[20];
+	snprintf(ids, sizeof(ids), "-%04x-%04x", p.vendorID, p.deviceID);
+	return dir / (string(appName) + ids + ".pipelineCache");
+}
+
+
+void PipelineCache::init(vk::PhysicalDevice physicalDevice, vk::Device device, const char* appName)
+{
+	destroy();
+
+	_device = device;
+	_filePath = defaultFilePath(physicalDevice, appName);
+	_warm = false;
+	_loadedSize = 0;
+	{
+		lock_guard lock(_statsMutex);
+		_numPipelines = 0;
+		_creationTime = 0.;
+	}
+
+	// read cache file
+	vector<uint8_t> data;
+	ifstream f(_filePath, ios::binary | ios::ate);
+	if(f) {
+		streamoff size = f.tellg();
+		if(size > 0) {
+			data.resize(size_t(size));
+			f.seekg(0);
+			if(!f.read(reinterpret_cast<char*>(data.data()), size))
+				data.clear();
+		}
+	}
+
+	// validate header
+	// (VkPipelineCacheHeaderVersionOne: headerSize, headerVersion, vendorID, deviceID and pipelineCacheUUID;
+	// the blob of another device or of another driver version is dropped)
+	if(!data.empty()) {
+		vk::PhysicalDeviceProperties p = physicalDevice.getProperties();
+		uint32_t header[4];
+		const char* problem = nullptr;
+		if(data.size() < sizeof(header) + VK_UUID_SIZE)
+			problem = "too short";
+		else {
+			memcpy(header, data.data(), sizeof(header));
+			if(header[0] < sizeof(header) + VK_UUID_SIZE || header[0] > data.size() ||
+			   header[1] != uint32_t(VK_PIPELINE_CACHE_HEADER_VERSION_ONE))
+				problem = "unknown header";
+			else if(header[2] != p.vendorID || header[3] != p.deviceID)
+				problem = "different device";
+			else if(memcmp(data.data() + sizeof(header), p.pipelineCacheUUID.data(), VK_UUID_SIZE) != 0)
+				problem = "different driver";
+		}
+		if(problem) {
+			cout << "Pipeline cache " << _filePath.string() << " ignored (" << problem << ")." << endl;
+			data.clear();
+		}
+	}
+
+	// create cache
+	_pipelineCache =
+		_device.createPipelineCache(
+			vk::PipelineCacheCreateInfo(
+				vk::PipelineCacheCreateFlags(),  // flags
+				data.size(),  // initialDataSize
+				data.data()  // pInitialData
+			)
+		);
+	_warm = !data.empty();
+	_loadedSize = data.size();
+	if(_warm)
+		cout << "Pipeline cache loaded (" << _loadedSize << " bytes)." << endl;
+	else
+		cout << "Pipeline cache is empty (cold start)." << endl;
+}
+
+
+void PipelineCache::save()
+{
+	if(!_pipelineCache)
+		return;
+
+	// write temporary file
+	// (the cache directory is created if it does not exist)
+	vector<uint8_t> data = _device.getPipelineCacheData(_pipelineCache);
+	if(_filePath.has_parent_path())
+		filesystem::create_directories(_filePath.parent_path());
+	filesystem::path tmpPath = _filePath;
+	tmpPath += ".tmp";
+	{
+		ofstream f(tmpPath, ios::binary | ios::trunc);
+		f.write(reinterpret_cast<const char*>(data.data()), streamsize(data.size()));
+		f.close();
+		if(!f) {
+			error_code ec;
+			filesystem::remove(tmpPath, ec);
+			throw runtime_error("Failed to write pipeline cache file " + tmpPath.string() + ".");
+		}
+	}
+
+	// replace the cache file
+	// (rename is atomic, so the readers see either the old or the new file)
+	filesystem::rename(tmpPath, _filePath);
+	cout << "Pipeline cache saved (" << data.size() << " bytes)." << endl;
+}
+
+
+void PipelineCache::destroy() noexcept
+{
+	if(_pipelineCache) {
+		_device.destroy(_pipelineCache);
+		_pipelineCache = nullptr;
+	}
+}
+
+
+void PipelineCache::printStats() const
+{
+	lock_guard lock(_statsMutex);
+	cout << "Pipeline creation (" << (_warm ? "warm" : "cold") << " cache): " << _numPipelines
+	     << " pipelines in " << _creationTime * 1000 << "ms";
+	if(_numPipelines != 0)
+		cout << " (" << _creationTime / _numPipelines * 1000 << "ms per pipeline)";
+	cout << endl;
+}
+
+
+vk::Pipeline PipelineCache::createGraphicsPipeline(const vk::GraphicsPipelineCreateInfo& createInfo)
+{
+	auto t = chrono::high_resolution_clock::now();
+	vk::Pipeline p = _device.createGraphicsPipeline(_pipelineCache, createInfo).value;
+	addCreationTime(chrono::duration<double>(chrono::high_resolution_clock::now() - t).count());
+	return p;
+}
+
+
+vk::UniquePipeline PipelineCache::createGraphicsPipelineUnique(const vk::GraphicsPipelineCreateInfo& createInfo)
+{
+	auto t = chrono::high_resolution_clock::now();
+	vk::UniquePipeline p = std::move(_device.createGraphicsPipelineUnique(_pipelineCache, createInfo).value);
+	addCreationTime(chrono::duration<double>(chrono::high_resolution_clock::now() - t).count());
+	return p;
+}
+
+
+vk::Pipeline PipelineCache::createComputePipeline(const vk::ComputePipelineCreateInfo& createInfo)
+{
+	auto t = chrono::high_resolution_clock::now();
+	vk::Pipeline p = _device.createComputePipeline(_pipelineCache, createInfo).value;
+	addCreationTime(chrono::duration<double>(chrono::high_resolution_clock::now() - t).count());
+	return p;
+}
+
+
+vk::UniquePipeline PipelineCache::createComputePipelineUnique(const vk::ComputePipelineCreateInfo& createInfo)
+{
+	auto t = chrono::high_resolution_clock::now();
+	vk::UniquePipeline p = std::move(_device.createComputePipelineUnique(_pipelineCache, createInfo).value);
+	addCreationTime(chrono::duration<double>(chrono::high_resolution_clock::now() - t).count());
+	return p;
+}
@@ -0,0 +1,144 @@
+#include "StartupProfiler.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace std;
+
+
+StartupProfiler::StartupProfiler()
+	: _startTime(chrono::high_resolution_clock::now())
+{
+	_events.reserve(64);
+}
+
+
+double StartupProfiler::now() const
+{
+	return chrono::duration<double>(chrono::high_resolution_clock::now() - _startTime).count();
+}
+
+
+void StartupProfiler::open(const char* name, bool phase)
+{
+	if(!_recording)
+		return;
+	_openEvents.push_back(OpenEvent{ _events.size(), phase });
+	_events.push_back(Event{ name, now(), 0., unsigned(_openEvents.size() - 1) });
+}
+
+
+void StartupProfiler::close()
+{
+	if(_openEvents.empty())
+		return;
+	Event& e = _events[_openEvents.back().index];
+	e.duration = now() - e.start;
+	_openEvents.pop_back();
+}
+
+
+void StartupProfiler::begin(const char* name)
+{
+	open(name, false);
+}
+
+
+void StartupProfiler::end()
+{
+	// close the phase opened inside the event
+	// and the event itself
+	if(!_recording)
+		return;
+	endPhase();
+	close();
+}
+
+
+void StartupProfiler::phase(const char* name)
+{
+	endPhase();
+	open(name, true);
+}
+
+
+void StartupProfiler::endPhase()
+{
+	if(!_recording)
+		return;
+	if(!_openEvents.empty() && _openEvents.back().phase)
+		close();
+}
+
+
+void StartupProfiler::finish()
+{
+	// close all the open events
+	// (the Scope objects still alive end nothing, as the recording is stopped)
+	if(!_recording)
+		return;
+	while(!_openEvents.empty())
+		close();
+	_finishTime = now();
+	_recording = false;
+}
+
+
+void StartupProfiler::printSummary() const
+{
+	cout << "Startup phases:" << endl;
+	for(const Event& e : _events)
+		cout << "   " << string(e.depth * 3, ' ') << e.name << ": " << e.duration * 1000 << "ms" << endl;
+	if(!_recording)
+		cout << "Time to first frame: " << _finishTime * 1000 << "ms" << endl;
+}
+
+
+void StartupProfiler::writeTrace(const filesystem::path& path, const char* processName) const
+{
+	// escape string for JSON
+	auto escape =
+		[](const string& s) -> string
+		{
+			string r;
+			r.reserve(s.size());
+			for(char c : s) {
+				if(c == '"' || c == '\\') {
+					r += '\\';
+					r += c;
+				}
+				else if(unsigned(c) < 0x20) {
+					char buf[8];
+					snprintf(buf, sizeof(buf), "\\u%04x", unsigned(c));
+					r += buf;
+				}
+				else
+					r += c;
+			}
+			return r;
+		};
+
+	// write trace
+	// (complete events ("ph":"X") with the time in microseconds;
+	// the nesting is given by the times, so the events of the same thread form the tree)
+	ofstream f(path, ios::trunc);
+	f << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	f << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\""
+	  << escape(processName) << "\"}}";
+	char buf[64];
+	for(const Event& e : _events) {
+		snprintf(buf, sizeof(buf), "\"ts\":%.3f,\"dur\":%.3f", e.start * 1e6, e.duration * 1e6);
+		f << ",\n{\"name\":\"" << escape(e.name) << "\",\"cat\":\"startup\",\"ph\":\"X\",\"pid\":1,\"tid\":1," << buf << "}";
+	}
+	if(!_recording) {
+		snprintf(buf, sizeof(buf), "\"ts\":%.3f", _finishTime * 1e6);
+		f << ",\n{\"name\":\"first frame presented\",\"cat\":\"startup\",\"ph\":\"i\",\"s\":\"p\",\"pid\":1,\"tid\":1,"
+		  << buf << "}";
+	}
+	f << "\n]}\n";
+	f.close();
+	if(!f)
+		throw runtime_error("Failed to write startup trace file " + path.string() + ".");
+	cout << "Startup trace written to " << path.string() << "." << endl;
+}
@@ -1,15 +1,33 @@
 #include "VulkanWindow.h"
+#include "FixedPoint.h"
+#include "PipelineCache.h"
+#include "StartupProfiler.h"
 #include <vulkan/vulkan.hpp>
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
 #include <iostream>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <unordered_map>
 
 using namespace std;
 
 
 // constants
 constexpr const char* appName = "16-input";
+constexpr const double precisionMargin = 64.;  // minimal pixel size in ulps of the view coordinates
+constexpr const size_t calibrationWarmUpFrames = 3;  // frames of each precision tier that are not measured
+constexpr const size_t calibrationMeasuredFrames = 10;  // measured frames of each precision tier
+constexpr const uint32_t tileSize = 256;  // width and height of the cached tiles in pixels
+constexpr const double tileBasePixelSize = 4. / tileSize;  // pixel size of the tiles of level 0
+constexpr const size_t maxTilesPerFrame = 16;  // missing tiles rendered per frame if they can be substituted
+constexpr const int maxTileAncestorDepth = 6;  // how many levels up a substitute of a missing tile is searched
 
 
 // shader code in SPIR-V binary
@@ -19,6 +37,20 @@ static const uint32_t vsSpirv[] = {
 static const uint32_t fsSpirv[] = {
 #include "shader.frag.spv"
 };
+static const uint32_t fsDf64Spirv[] = {
+#include "shader-df64.frag.spv"
+};
+static const uint32_t fsFp64Spirv[] = {
+#include "shader-fp64.frag.spv"
+};
+static const uint32_t perturbationFsSpirv[] = {
+#include "perturbation.frag.spv"
+};
+
+
+// startup profiler
+// (static object, so the time is measured from about the process start)
+static StartupProfiler startupProfiler;
 
 
 // global application data
@@ -51,11 +83,14 @@ public:
 	uint32_t graphicsQueueFamily;
 	uint32_t presentationQueueFamily;
 	vk::Device device;
+	PipelineCache pipelineCache;
 	vk::Queue graphicsQueue;
 	vk::Queue presentationQueue;
 	vk::SurfaceFormatKHR surfaceFormat;
 	vk::RenderPass renderPass;
+	vk::RenderPass canvasRenderPass;
 	vk::SwapchainKHR swapchain;
+	vector<vk::Image> swapchainImages;
 	vector<vk::ImageView> swapchainImageViews;
 	vector<vk::Framebuffer> framebuffers;
 	vk::CommandPool commandPool;
@@ -65,19 +100,247 @@ public:
 	vk::Fence renderFinishedFence;
 	vk::ShaderModule vsModule;
 	vk::ShaderModule fsModule;
+	vk::ShaderModule fsDf64Module;
+	vk::ShaderModule fsFp64Module;
+	vk::ShaderModule perturbationFsModule;
+	vk::DescriptorSetLayout descriptorSetLayout;
+	vk::DescriptorPool descriptorPool;
+	vk::DescriptorSet descriptorSet;
 	vk::PipelineLayout pipelineLayout;
-	vk::Pipeline pipeline;
+	vk::QueryPool timestampPool;
+	bool fp64Supported;
+
+	// reference orbit of the perturbation path
+	// (it is stored in host visible buffer that is updated between the frames)
+	vk::Buffer orbitBuffer;
+	vk::DeviceMemory orbitMemory;
+	float* orbitData = nullptr;
+	size_t orbitCapacity = 0;  // in number of orbit values
+	uint32_t orbitLength = 0;
+	uint32_t referenceMaxIter = 0;
+	FixedPoint referenceX, referenceY;
+	bool referenceValid = false;
 
 	enum class FrameUpdateMode { OnDemand, Continuous, MaxFrameRate };
 	FrameUpdateMode frameUpdateMode = FrameUpdateMode::OnDemand;
 	size_t frameID = ~size_t(0);
 	size_t fpsNumFrames = ~size_t(0);
 	chrono::high_resolution_clock::time_point fpsStartTime;
+	chrono::high_resolution_clock::time_point resizeStartTime;
+	bool resizeMeasurementPending = false;
+	string startupTracePath;  // empty means no trace file
 
-	float valueGradient = -1.f;
+	double valueGradient = -1.;  // size of the pixel in fractal coordinates
 	uint32_t windowHeight;
-	float minX, minY, maxX, maxY;
-	void setView(float coordX, float coordY, float valueX, float valueY);
+	FixedPoint centerX, centerY;  // view center in arbitrary precision
+	int viewPlane = 0;  // 0 - c plane (Mandelbrot set), 1 - z plane (Julia set)
+	float constantParameter[2] = { 0.f, 0.f };  // initial z for c plane, c for z plane
+	void setView(double offsetX, double offsetY);  // moves the view center by the offset given in fractal coordinates
+	static uint32_t iterationLimit(double pixelSize);
+	vk::Pipeline createPipeline(vk::ShaderModule fragmentShader, const vk::SpecializationInfo* specializationInfo);
+	void pushFractalConstants(const FixedPoint& viewCenterX, const FixedPoint& viewCenterY, double pixelSize,
+		float centerPixelX, float centerPixelY, vk::Extent2D viewportExtent, uint32_t maxIter, bool perturbation);
+
+	// iterations per pixel
+	// (estimated on CPU for the current view, for the former fixed limit of 255 iterations
+	// and for the current limit with interior tests)
+	double estimatedGradient = 0.;
+	FixedPoint estimatedCenterX, estimatedCenterY;
+	void printIterationEstimate();
+
+	// precision tiers
+	// (fp32 uses floats, df64 emulates higher precision by pairs of floats and fp64 uses doubles
+	// if shaderFloat64 is supported; the fastest tier that is precise enough for the current zoom is used,
+	// the speed of the tiers is measured by timestamps on the start)
+	enum class Precision { Fp32, Df64, Fp64, Auto };
+	Precision requestedPrecision = Precision::Auto;
+	Precision activePrecision = Precision::Fp32;
+	struct TierTiming {
+		double gpuTime = 0.;
+		size_t numSamples = 0;
+	};
+	array<TierTiming,3> tierTimings;
+	vector<Precision> calibrationTiers;
+	size_t calibrationFrame = ~size_t(0);  // ~0 means no calibration in progress
+	bool timestampsPending = false;  // the last submitted frame wrote timestamps
+	size_t timedTier = ~size_t(0);  // tier measured by the timestamps of the last submitted frame
+	bool timedCalibrationSample = false;
+	uint64_t timestampMask;
+	float timestampPeriod_ns;
+	double fpsGpuTime = 0.;
+	size_t fpsGpuNumFrames = 0;
+	static const char* precisionName(Precision p);
+	bool isTierAvailable(Precision p) const;
+	bool isPrecise(Precision p) const;
+	Precision selectPrecision() const;
+
+	// perturbation path
+	// (deep zooms iterate float deltas of the pixels from the reference orbit computed in arbitrary precision)
+	enum class PerturbationMode { Auto, Always, Never };
+	PerturbationMode perturbationMode = PerturbationMode::Auto;
+	bool perturbationActive = false;
+	bool usePerturbation() const;
+	void updateReferenceOrbit();
+
+	// pipeline variants
+	// (fragment shaders are specialized by the iteration limit and by the coloring mode, so the compiler
+	// folds them into the iteration loop; the variants reading the iteration limit from push constants
+	// are created for all the coloring modes on the start, the variants of the specialized iteration limit
+	// are requested on their first use and built by the build thread; all of them are kept,
+	// so switching between them costs just the bind)
+	enum class FragmentShader { Fp32, Df64, Fp64, Perturbation };
+	static constexpr const int numColoringModes = 3;
+	struct PipelineVariantKey {
+		FragmentShader shader;
+		uint32_t maxIter;  // zero means the iteration limit given by push constants
+		int coloringMode;
+		bool operator==(const PipelineVariantKey& k) const;
+	};
+	struct PipelineVariantKeyHash {
+		size_t operator()(const PipelineVariantKey& k) const;
+	};
+	struct PipelineVariant {
+		vk::Pipeline pipeline;
+		double creationTime;  // in seconds
+		double gpuTime = 0.;  // sum of the frame times measured by timestamps
+		size_t numSamples = 0;
+		vk::Pipeline fragmentShaderLibrary;  // null if the pipeline library is not used
+		bool optimized = true;  // false while the fast-linked pipeline waits for the optimized one
+		double optimizedLinkTime = 0.;  // in seconds
+	};
+	unordered_map<PipelineVariantKey, PipelineVariant, PipelineVariantKeyHash> pipelineVariants;
+	bool specializeIterations = true;
+	int coloringMode = 0;  // 0 - hue gradient, 1 - hue bands, 2 - grayscale
+	PipelineVariant* frameVariant = nullptr;  // variant used by the frame being recorded
+	PipelineVariant* timedVariant = nullptr;  // variant measured by the timestamps of the last submitted frame
+	static const char* fragmentShaderName(FragmentShader s);
+	PipelineVariant createPipelineVariant(const PipelineVariantKey& key);
+	PipelineVariant& pipelineVariant(FragmentShader shader, uint32_t maxIter, int coloringMode);
+	vk::Pipeline selectPipeline(FragmentShader shader, uint32_t maxIter);
+	void destroyPipelineVariants();
+	void printPipelineVariants() const;
+
+	// graphics pipeline library
+	// (with VK_EXT_graphics_pipeline_library, the vertex input, pre-rasterization and fragment output parts
+	// are compiled once on the start and only the fragment shader part is compiled for each variant;
+	// the variant is fast-linked from the parts, so it is usable almost immediately, and the build thread
+	// links the optimized pipeline that replaces the fast-linked one when it is ready;
+	// without the extension, the variants are created as monolithic pipelines)
+	bool usePipelineLibrary = true;
+	bool pipelineLibrarySupported = false;
+	bool pipelineLibraryFastLinking = false;
+	vk::Pipeline vertexInputLibrary;
+	vk::Pipeline preRasterizationLibrary;
+	vk::Pipeline fragmentOutputLibrary;
+	void createPipelineLibraries();
+	vk::Pipeline createFragmentShaderLibrary(vk::ShaderModule fragmentShader,
+		const vk::SpecializationInfo* specializationInfo);
+	vk::Pipeline linkPipeline(vk::Pipeline fragmentShaderLibrary, bool optimize);
+	void destroyPipelineLibraries();
+
+	// build thread
+	// (the frame never waits for shader compilation; the missing variant is requested from the build thread
+	// and the frame is rendered by the variant of the same shader and coloring mode reading the iteration limit
+	// from push constants, which gives the same image; while any variant is being built, the frames
+	// are scheduled, so the finished variant is taken over by the frame as soon as it is ready)
+	struct BuildJob {
+		PipelineVariantKey key;
+		vk::Pipeline fragmentShaderLibrary;  // null for a new variant, the library of the variant for the optimized link
+	};
+	struct BuildResult {
+		PipelineVariantKey key;
+		PipelineVariant variant;  // new variant, or the optimized pipeline in variant.pipeline
+		bool optimizedLink;
+		string errorMessage;  // empty on success
+	};
+	thread buildThread;
+	mutex buildMutex;
+	condition_variable buildCondition;
+	deque<BuildJob> buildQueue;
+	vector<BuildResult> buildResults;
+	bool buildThreadExit = false;
+	unordered_map<PipelineVariantKey, chrono::high_resolution_clock::time_point, PipelineVariantKeyHash> requestedVariants;
+	size_t numFallbackFrames = 0;  // frames rendered by a fallback variant
+	void requestPipelineVariant(const PipelineVariantKey& key);
+	void requestOptimizedLink(const PipelineVariantKey& key, vk::Pipeline fragmentShaderLibrary);
+	void buildThreadMain();
+	void collectBuiltPipelines();
+	void stopBuildThread();
+
+	// scroll reuse
+	// (frames are rendered into two canvas images in turns and copied into the swapchain image;
+	// on pure pan, the still valid region of the previous frame is copied to its new position
+	// and only the newly exposed strips are rendered)
+	bool scrollReuseEnabled = true;
+	array<vk::Image,2> canvasImages;
+	array<vk::DeviceMemory,2> canvasMemory;
+	array<vk::ImageView,2> canvasImageViews;
+	array<vk::Framebuffer,2> canvasFramebuffers;
+	size_t canvasIndex = 0;  // canvas holding the last frame
+	struct CanvasContent {
+		bool valid = false;
+		FixedPoint centerX, centerY;
+		double valueGradient;
+		Precision precision;
+		bool perturbation;
+		uint32_t maxIter;
+		int coloringMode;
+		uint32_t level;  // refinement level, see below
+	} canvasContent;
+	float panRemainderX = 0.f;  // fraction of pixel not yet applied to the view
+	float panRemainderY = 0.f;
+	double fpsRenderedPixels = 0.;
+	double fpsTotalPixels = 0.;
+
+	// progressive refinement
+	// (full redraws are rendered at reduced resolution fitting into the frame time budget and upscaled;
+	// the following frames refine the image, each doubling the resolution, up to the full resolution;
+	// level n means 2^n x 2^n pixel blocks)
+	bool progressiveEnabled = false;
+	double frameTimeBudget = 0.008;  // in seconds
+	uint32_t refinementSteps = 3;  // the coarsest level
+	bool timedFullFrame = false;
+	double fullFrameGpuTime = 0.;  // GPU time of the last full resolution redraw, zero if unknown
+	uint32_t previewLevel() const;
+
+	// tile cache
+	// (tiles of tileSize x tileSize pixels form a quadtree over the fractal plane, the tile of level l
+	// has the pixel size tileBasePixelSize * 2^-l; rendered tiles are kept in the layers of the atlas image
+	// and blitted into the canvas; the least recently used tiles are evicted when the budget is exhausted)
+	struct TileKey {
+		int level;
+		int64_t x, y;
+		float constantParameter[2];
+		int viewPlane;
+		Precision precision;
+		int coloringMode;
+		bool operator==(const TileKey& k) const;
+	};
+	struct TileKeyHash {
+		size_t operator()(const TileKey& k) const;
+	};
+	struct TileSlot {
+		TileKey key;
+		bool used = false;
+		size_t lastUsedFrame = 0;
+	};
+	size_t tileCacheBudget = 0;  // in MiB, zero disables the cache
+	vk::RenderPass tileRenderPass;
+	vk::Image tileAtlas;
+	vk::DeviceMemory tileAtlasMemory;
+	vk::DeviceSize tileSlotSize;  // memory taken by one tile
+	vector<vk::ImageView> tileImageViews;
+	vector<vk::Framebuffer> tileFramebuffers;
+	vk::Filter tileFilter;
+	vector<TileSlot> tileSlots;
+	unordered_map<TileKey, size_t, TileKeyHash> tileMap;
+	size_t numUsedTileSlots = 0;
+	size_t tileHits = 0;
+	size_t tileMisses = 0;
+	bool tileFrameIncomplete = false;  // some missing tiles were substituted by coarser ones
+	bool tileBudgetWarningPrinted = false;
+	size_t allocateTileSlot(const TileKey& key);
+	bool recordTileCacheFrame(vk::Image canvas, vk::Extent2D windowSize);
 
 };
 
@@ -93,6 +356,47 @@ App::App(int argc, char** argv)
 			frameUpdateMode = FrameUpdateMode::Continuous;
 		else if(strcmp(argv[i], "--max-frame-rate") == 0)
 			frameUpdateMode = FrameUpdateMode::MaxFrameRate;
+		else if(strcmp(argv[i], "--perturbation") == 0 && i+1 < argc &&
+		        (strcmp(argv[i+1], "auto") == 0 || strcmp(argv[i+1], "always") == 0 ||
+		         strcmp(argv[i+1], "never") == 0)) {
+			perturbationMode = (strcmp(argv[i+1], "auto") == 0) ? PerturbationMode::Auto :
+			                   (strcmp(argv[i+1], "always") == 0) ? PerturbationMode::Always : PerturbationMode::Never;
+			i++;
+		}
+		else if(strcmp(argv[i], "--no-scroll-reuse") == 0)
+			scrollReuseEnabled = false;
+		else if(strcmp(argv[i], "--progressive") == 0)
+			progressiveEnabled = true;
+		else if(strcmp(argv[i], "--frame-budget") == 0 && i+1 < argc &&
+		        sscanf(argv[i+1], "%lf", &frameTimeBudget) == 1 && frameTimeBudget > 0.) {
+			frameTimeBudget *= 1e-3;
+			i++;
+		}
+		else if(strcmp(argv[i], "--tile-cache") == 0 && i+1 < argc &&
+		        sscanf(argv[i+1], "%zu", &tileCacheBudget) == 1)
+			i++;
+		else if(strcmp(argv[i], "--refinement-steps") == 0 && i+1 < argc &&
+		        sscanf(argv[i+1], "%u", &refinementSteps) == 1 && refinementSteps >= 1 && refinementSteps <= 6)
+			i++;
+		else if(strcmp(argv[i], "--no-specialization") == 0)
+			specializeIterations = false;
+		else if(strcmp(argv[i], "--no-pipeline-library") == 0)
+			usePipelineLibrary = false;
+		else if(strcmp(argv[i], "--startup-trace") == 0 && i+1 < argc) {
+			startupTracePath = argv[i+1];
+			i++;
+		}
+		else if(strcmp(argv[i], "--coloring") == 0 && i+1 < argc &&
+		        sscanf(argv[i+1], "%d", &coloringMode) == 1 && coloringMode >= 0 && coloringMode < numColoringModes)
+			i++;
+		else if(strcmp(argv[i], "--precision") == 0 && i+1 < argc &&
+		        (strcmp(argv[i+1], "fp32") == 0 || strcmp(argv[i+1], "df64") == 0 ||
+		         strcmp(argv[i+1], "fp64") == 0 || strcmp(argv[i+1], "auto") == 0)) {
+			requestedPrecision = (strcmp(argv[i+1], "fp32") == 0) ? Precision::Fp32 :
+			                     (strcmp(argv[i+1], "df64") == 0) ? Precision::Df64 :
+			                     (strcmp(argv[i+1], "fp64") == 0) ? Precision::Fp64 : Precision::Auto;
+			i++;
+		}
 		else {
 			if(strcmp(argv[i], "--help") != 0 && strcmp(argv[i], "-h") != 0)
 				cout << "Unrecognized option: " << argv[i] << endl;
@@ -103,7 +407,38 @@ App::App(int argc, char** argv)
 			        "   --continuous:  constantly update window content using\n"
 			        "                  screen refresh rate, this is the default\n"
 			        "   --max-frame-rate:  ignore screen refresh rate, update\n"
-			        "                      window content as often as possible\n" << endl;
+			        "                      window content as often as possible\n"
+			        "   --perturbation <mode>:  auto - use perturbation for the zooms\n"
+			        "                                  beyond the precision tiers,\n"
+			        "                           always - use perturbation for all zooms,\n"
+			        "                           never - use the precision tiers only,\n"
+			        "                           default: auto\n"
+			        "   --precision <tier>:  fp32 - single precision floats,\n"
+			        "                        df64 - double precision emulated by float pairs,\n"
+			        "                        fp64 - double precision floats,\n"
+			        "                        auto - the fastest tier precise enough for the zoom,\n"
+			        "                        default: auto\n"
+			        "   --no-scroll-reuse:  render the whole window on pan instead of\n"
+			        "                       reusing the content of the previous frame\n"
+			        "   --progressive:  render full redraws at reduced resolution\n"
+			        "                   and refine them over the following frames\n"
+			        "   --frame-budget <ms>:  GPU time of the reduced resolution frames,\n"
+			        "                         default: 8\n"
+			        "   --refinement-steps <n>:  maximal number of refinement steps (1..6),\n"
+			        "                            the coarsest resolution is 1/2^n, default: 3\n"
+			        "   --tile-cache <MiB>:  cache rendered tiles in GPU memory of the given\n"
+			        "                        budget, zero disables the cache, default: 0\n"
+			        "   --coloring <mode>:  0 - hue gradient, 1 - hue bands, 2 - grayscale,\n"
+			        "                       default: 0, C key cycles the modes\n"
+			        "   --no-specialization:  read the iteration limit from push constants\n"
+			        "                         instead of creating pipeline variants\n"
+			        "                         specialized for each limit\n"
+			        "   --no-pipeline-library:  create pipeline variants as monolithic\n"
+			        "                           pipelines even if VK_EXT_graphics_pipeline_library\n"
+			        "                           is supported\n"
+			        "   --startup-trace <file>:  write the startup phases up to the first\n"
+			        "                            presented frame as Chrome trace JSON file\n"
+			        "                            (chrome://tracing or ui.perfetto.dev)\n" << endl;
 			exit(99);
 		}
 }
@@ -123,18 +458,39 @@ App::~App()
 
 		// destroy handles
 		// (the handles are destructed in certain (not arbitrary) order)
-		device.destroy(pipeline);
+		device.destroy(orbitBuffer);
+		device.free(orbitMemory);
+		device.destroy(timestampPool);
+		stopBuildThread();
+		destroyPipelineVariants();
+		destroyPipelineLibraries();
 		device.destroy(pipelineLayout);
+		device.destroy(descriptorPool);
+		device.destroy(descriptorSetLayout);
+		device.destroy(perturbationFsModule);
+		device.destroy(fsFp64Module);
+		device.destroy(fsDf64Module);
 		device.destroy(fsModule);
 		device.destroy(vsModule);
 		device.destroy(renderFinishedFence);
 		device.destroy(renderFinishedSemaphore);
 		device.destroy(imageAvailableSemaphore);
 		device.destroy(commandPool);
+		for(auto f : tileFramebuffers)  device.destroy(f);
+		for(auto v : tileImageViews)  device.destroy(v);
+		device.destroy(tileAtlas);
+		device.free(tileAtlasMemory);
+		for(auto f : canvasFramebuffers)  device.destroy(f);
+		for(auto v : canvasImageViews)  device.destroy(v);
+		for(auto i : canvasImages)  device.destroy(i);
+		for(auto m : canvasMemory)  device.free(m);
 		for(auto f : framebuffers)  device.destroy(f);
 		for(auto v : swapchainImageViews)  device.destroy(v);
 		device.destroy(swapchain);
+		device.destroy(tileRenderPass);
+		device.destroy(canvasRenderPass);
 		device.destroy(renderPass);
+		pipelineCache.destroy();
 		device.destroy();
 	}
 
@@ -152,9 +508,24 @@ App::~App()
 
 void App::init()
 {
+	// profile the startup phases
+	StartupProfiler::Scope profilerScope(startupProfiler, "App::init");
+
 	// init VulkanWindow
+	startupProfiler.phase("VulkanWindow::init");
 	VulkanWindow::init();
 
+	// instance extensions
+	// (VK_KHR_get_physical_device_properties2 is used to query graphics pipeline library support)
+	startupProfiler.phase("instance creation");
+	bool physicalDeviceProperties2Supported = false;
+	for(vk::ExtensionProperties& e : vk::enumerateInstanceExtensionProperties())
+		if(strcmp(e.extensionName, "VK_KHR_get_physical_device_properties2") == 0)
+			physicalDeviceProperties2Supported = true;
+	vector<const char*> instanceExtensions = VulkanWindow::requiredExtensions();
+	if(physicalDeviceProperties2Supported)
+		instanceExtensions.push_back("VK_KHR_get_physical_device_properties2");
+
 	// Vulkan instance
 	instance =
 		vk::createInstance(
@@ -168,16 +539,18 @@ void App::init()
 					VK_API_VERSION_1_0,      // api version
 				},
 				0, nullptr,  // no layers
-				VulkanWindow::requiredExtensionCount(),  // enabled extension count
-				VulkanWindow::requiredExtensionNames(),  // enabled extension names
+				uint32_t(instanceExtensions.size()),  // enabled extension count
+				instanceExtensions.data(),  // enabled extension names
 			}
 		);
 
 	// create surface
+	startupProfiler.phase("VulkanWindow::create");
 	vk::SurfaceKHR surface =
 		window.create(instance, {1024, 768}, appName);
 
 	// find compatible devices
+	startupProfiler.phase("device enumeration");
 	vector<vk::PhysicalDevice> deviceList = instance.enumeratePhysicalDevices();
 	vector<tuple<vk::PhysicalDevice, uint32_t, uint32_t, vk::PhysicalDeviceProperties>> compatibleDevices;
 	for(vk::PhysicalDevice pd : deviceList) {
@@ -261,8 +634,54 @@ void App::init()
 	physicalDevice = get<0>(*bestDevice);
 	graphicsQueueFamily = get<1>(*bestDevice);
 	presentationQueueFamily = get<2>(*bestDevice);
+	fp64Supported = physicalDevice.getFeatures().shaderFloat64;
+
+	// graphics pipeline library support
+	// (the extension needs VK_KHR_pipeline_library and its feature is queried by vkGetPhysicalDeviceFeatures2KHR)
+	startupProfiler.phase("extension queries");
+	vector<const char*> deviceExtensions{ "VK_KHR_swapchain" };
+	if(usePipelineLibrary && physicalDeviceProperties2Supported) {
+		bool pipelineLibraryExtension = false;
+		bool graphicsPipelineLibraryExtension = false;
+		for(vk::ExtensionProperties& e : physicalDevice.enumerateDeviceExtensionProperties()) {
+			if(strcmp(e.extensionName, "VK_KHR_pipeline_library") == 0)
+				pipelineLibraryExtension = true;
+			else if(strcmp(e.extensionName, "VK_EXT_graphics_pipeline_library") == 0)
+				graphicsPipelineLibraryExtension = true;
+		}
+		if(pipelineLibraryExtension && graphicsPipelineLibraryExtension) {
+			struct InstanceFuncs : vk::DispatchLoaderBase {
+				PFN_vkGetPhysicalDeviceProperties2KHR vkGetPhysicalDeviceProperties2KHR;
+				PFN_vkGetPhysicalDeviceFeatures2KHR vkGetPhysicalDeviceFeatures2KHR;
+			} vkFuncs;
+			vkFuncs.vkGetPhysicalDeviceProperties2KHR =
+				PFN_vkGetPhysicalDeviceProperties2KHR(instance.getProcAddr("vkGetPhysicalDeviceProperties2KHR"));
+			vkFuncs.vkGetPhysicalDeviceFeatures2KHR =
+				PFN_vkGetPhysicalDeviceFeatures2KHR(instance.getProcAddr("vkGetPhysicalDeviceFeatures2KHR"));
+			auto features =
+				physicalDevice.getFeatures2KHR<vk::PhysicalDeviceFeatures2,
+				                               vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>(vkFuncs);
+			auto properties =
+				physicalDevice.getProperties2KHR<vk::PhysicalDeviceProperties2,
+				                                 vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>(vkFuncs);
+			pipelineLibrarySupported =
+				features.get<vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT>().graphicsPipelineLibrary;
+			pipelineLibraryFastLinking =
+				properties.get<vk::PhysicalDeviceGraphicsPipelineLibraryPropertiesEXT>().graphicsPipelineLibraryFastLinking;
+		}
+	}
+	if(pipelineLibrarySupported) {
+		deviceExtensions.push_back("VK_KHR_pipeline_library");
+		deviceExtensions.push_back("VK_EXT_graphics_pipeline_library");
+		cout << "Graphics pipeline library: used (fast linking: " << (pipelineLibraryFastLinking ? "yes" : "no")
+		     << ")" << endl;
+	}
+	else
+		cout << "Graphics pipeline library: not used, pipeline variants are created as monolithic pipelines" << endl;
 
 	// create device
+	startupProfiler.phase("device creation");
+	vk::PhysicalDeviceGraphicsPipelineLibraryFeaturesEXT pipelineLibraryFeatures(VK_TRUE);
 	device =
 		physicalDevice.createDevice(
 			vk::DeviceCreateInfo{
@@ -283,17 +702,25 @@ void App::init()
 					},
 				}.data(),
 				0, nullptr,  // no layers
-				1,           // number of enabled extensions
-				array<const char*, 1>{ "VK_KHR_swapchain" }.data(),  // enabled extension names
-				nullptr,    // enabled features
-			}
+				uint32_t(deviceExtensions.size()),  // number of enabled extensions
+				deviceExtensions.data(),  // enabled extension names
+				fp64Supported  // enabled features
+					? &vk::PhysicalDeviceFeatures().setShaderFloat64(true)
+					: nullptr,
+			}.setPNext(pipelineLibrarySupported ? &pipelineLibraryFeatures : nullptr)
 		);
 
 	// get queues
 	graphicsQueue = device.getQueue(graphicsQueueFamily, 0);
 	presentationQueue = device.getQueue(presentationQueueFamily, 0);
 
+	// pipeline cache
+	// (loaded from the previous run, if any)
+	startupProfiler.phase("pipeline cache load");
+	pipelineCache.init(physicalDevice, device, appName);
+
 	// give window Vulkan device used for rendering
+	startupProfiler.phase("surface format query");
 	window.setDevice(device, physicalDevice);
 
 	// print surface formats
@@ -330,6 +757,7 @@ void App::init()
 	     << "   " << to_string(surfaceFormat.format) << ", color space: " << to_string(surfaceFormat.colorSpace) << endl;
 
 	// render pass
+	startupProfiler.phase("render passes and tile cache");
 	renderPass =
 		device.createRenderPass(
 			vk::RenderPassCreateInfo(
@@ -383,7 +811,255 @@ void App::init()
 			)
 		);
 
+	// scroll reuse support
+	// (the canvas is rendered with the swapchain format and copied into the swapchain images)
+	if(scrollReuseEnabled &&
+	   (!(physicalDevice.getSurfaceCapabilitiesKHR(window.surface()).supportedUsageFlags & vk::ImageUsageFlagBits::eTransferDst) ||
+	    !(physicalDevice.getFormatProperties(surfaceFormat.format).optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment)))
+	{
+		cout << "Scroll reuse is not supported by the device. Rendering whole frames on pan." << endl;
+		scrollReuseEnabled = false;
+	}
+
+	// progressive refinement support
+	// (the reduced resolution frames are rendered into the canvas and blitted into the swapchain image)
+	if(progressiveEnabled &&
+	   (!scrollReuseEnabled ||
+	    (physicalDevice.getFormatProperties(surfaceFormat.format).optimalTilingFeatures &
+	     (vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst)) !=
+	    (vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst)))
+	{
+		cout << "Progressive refinement is not supported by the device or without scroll reuse. "
+		        "Rendering at full resolution." << endl;
+		progressiveEnabled = false;
+	}
+
+	// tile cache support
+	// (the tiles are blitted into the canvas)
+	vk::FormatFeatureFlags formatFeatures = physicalDevice.getFormatProperties(surfaceFormat.format).optimalTilingFeatures;
+	if(tileCacheBudget != 0 &&
+	   (!scrollReuseEnabled ||
+	    (formatFeatures & (vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst)) !=
+	    (vk::FormatFeatureFlagBits::eBlitSrc | vk::FormatFeatureFlagBits::eBlitDst)))
+	{
+		cout << "Tile cache is not supported by the device or without scroll reuse. Rendering without the cache." << endl;
+		tileCacheBudget = 0;
+	}
+
+	// tile cache
+	if(tileCacheBudget != 0) {
+
+		// render pass of the tiles
+		// (it is compatible with renderPass; the tiles are rendered whole, so no load is needed)
+		tileRenderPass =
+			device.createRenderPass(
+				vk::RenderPassCreateInfo(
+					vk::RenderPassCreateFlags(),  // flags
+					1,      // attachmentCount
+					array{  // pAttachments
+						vk::AttachmentDescription(
+							vk::AttachmentDescriptionFlags(),  // flags
+							surfaceFormat.format,              // format
+							vk::SampleCountFlagBits::e1,       // samples
+							vk::AttachmentLoadOp::eDontCare,   // loadOp
+							vk::AttachmentStoreOp::eStore,     // storeOp
+							vk::AttachmentLoadOp::eDontCare,   // stencilLoadOp
+							vk::AttachmentStoreOp::eDontCare,  // stencilStoreOp
+							vk::ImageLayout::eUndefined,       // initialLayout
+							vk::ImageLayout::eTransferSrcOptimal  // finalLayout
+						),
+					}.data(),
+					1,      // subpassCount
+					array{  // pSubpasses
+						vk::SubpassDescription(
+							vk::SubpassDescriptionFlags(),     // flags
+							vk::PipelineBindPoint::eGraphics,  // pipelineBindPoint
+							0,        // inputAttachmentCount
+							nullptr,  // pInputAttachments
+							1,        // colorAttachmentCount
+							array{    // pColorAttachments
+								vk::AttachmentReference(
+									0,  // attachment
+									vk::ImageLayout::eColorAttachmentOptimal  // layout
+								),
+							}.data(),
+							nullptr,  // pResolveAttachments
+							nullptr,  // pDepthStencilAttachment
+							0,        // preserveAttachmentCount
+							nullptr   // pPreserveAttachments
+						),
+					}.data(),
+					1,      // dependencyCount
+					array{  // pDependencies
+						vk::SubpassDependency(
+							0,                     // srcSubpass
+							VK_SUBPASS_EXTERNAL,   // dstSubpass
+							vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput),  // srcStageMask
+							vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer),  // dstStageMask
+							vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentWrite),  // srcAccessMask
+							vk::AccessFlags(vk::AccessFlagBits::eTransferRead),  // dstAccessMask
+							vk::DependencyFlags()  // dependencyFlags
+						),
+					}.data()
+				)
+			);
+
+		// atlas image
+		// (each tile takes one array layer; the number of tiles is limited by maxImageArrayLayers)
+		size_t numSlots = tileCacheBudget * 1024 * 1024 / (tileSize * tileSize * 4);
+		uint32_t maxLayers = physicalDevice.getProperties().limits.maxImageArrayLayers;
+		if(numSlots > maxLayers) {
+			cout << "Tile cache budget exceeds maxImageArrayLayers of the device, using " << maxLayers << " tiles." << endl;
+			numSlots = maxLayers;
+		}
+		numSlots = max(numSlots, size_t(1));
+		tileAtlas =
+			device.createImage(
+				vk::ImageCreateInfo(
+					vk::ImageCreateFlags(),       // flags
+					vk::ImageType::e2D,           // imageType
+					surfaceFormat.format,         // format
+					vk::Extent3D(tileSize, tileSize, 1),  // extent
+					1,                            // mipLevels
+					uint32_t(numSlots),           // arrayLayers
+					vk::SampleCountFlagBits::e1,  // samples
+					vk::ImageTiling::eOptimal,    // tiling
+					vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
+					vk::SharingMode::eExclusive,  // sharingMode
+					0,                            // queueFamilyIndexCount
+					nullptr,                      // pQueueFamilyIndices
+					vk::ImageLayout::eUndefined   // initialLayout
+				)
+			);
+
+		// allocate device-local memory
+		vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(tileAtlas);
+		vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+			if(memoryRequirements.memoryTypeBits & (1<<i))
+				if(memoryProperties.memoryTypes[i].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) {
+					memoryTypeIndex = i;
+					break;
+				}
+		if(memoryTypeIndex == UINT32_MAX)
+			throw runtime_error("No suitable memory type found for the tile atlas.");
+		tileAtlasMemory =
+			device.allocateMemory(
+				vk::MemoryAllocateInfo(
+					memoryRequirements.size,  // allocationSize
+					memoryTypeIndex           // memoryTypeIndex
+				)
+			);
+		device.bindImageMemory(
+			tileAtlas,        // image
+			tileAtlasMemory,  // memory
+			0                 // memoryOffset
+		);
+		tileSlotSize = memoryRequirements.size / numSlots;
+
+		// image view and framebuffer of each tile
+		tileImageViews.reserve(numSlots);
+		tileFramebuffers.reserve(numSlots);
+		for(size_t i=0; i<numSlots; i++) {
+			tileImageViews.emplace_back(
+				device.createImageView(
+					vk::ImageViewCreateInfo(
+						vk::ImageViewCreateFlags(),  // flags
+						tileAtlas,                   // image
+						vk::ImageViewType::e2D,      // viewType
+						surfaceFormat.format,        // format
+						vk::ComponentMapping(),      // components
+						vk::ImageSubresourceRange(   // subresourceRange
+							vk::ImageAspectFlagBits::eColor,  // aspectMask
+							0,  // baseMipLevel
+							1,  // levelCount
+							uint32_t(i),  // baseArrayLayer
+							1   // layerCount
+						)
+					)
+				)
+			);
+			tileFramebuffers.emplace_back(
+				device.createFramebuffer(
+					vk::FramebufferCreateInfo(
+						vk::FramebufferCreateFlags(),  // flags
+						tileRenderPass,  // renderPass
+						1,  // attachmentCount
+						&tileImageViews[i],  // pAttachments
+						tileSize,  // width
+						tileSize,  // height
+						1  // layers
+					)
+				)
+			);
+		}
+		tileSlots.resize(numSlots);
+		tileFilter = (formatFeatures & vk::FormatFeatureFlagBits::eSampledImageFilterLinear)
+			? vk::Filter::eLinear : vk::Filter::eNearest;
+		cout << "Tile cache: " << numSlots << " tiles of " << tileSize << "x" << tileSize
+		     << " pixels, " << double(memoryRequirements.size) / (1024 * 1024) << " MiB" << endl;
+	}
+
+	// canvas render pass
+	// (it is compatible with renderPass, so the same pipelines are used; the attachment content
+	// is loaded as it contains the region copied from the previous frame)
+	if(scrollReuseEnabled)
+		canvasRenderPass =
+			device.createRenderPass(
+				vk::RenderPassCreateInfo(
+					vk::RenderPassCreateFlags(),  // flags
+					1,      // attachmentCount
+					array{  // pAttachments
+						vk::AttachmentDescription(
+							vk::AttachmentDescriptionFlags(),  // flags
+							surfaceFormat.format,              // format
+							vk::SampleCountFlagBits::e1,       // samples
+							vk::AttachmentLoadOp::eLoad,       // loadOp
+							vk::AttachmentStoreOp::eStore,     // storeOp
+							vk::AttachmentLoadOp::eDontCare,   // stencilLoadOp
+							vk::AttachmentStoreOp::eDontCare,  // stencilStoreOp
+							vk::ImageLayout::eColorAttachmentOptimal,  // initialLayout
+							vk::ImageLayout::eTransferSrcOptimal       // finalLayout
+						),
+					}.data(),
+					1,      // subpassCount
+					array{  // pSubpasses
+						vk::SubpassDescription(
+							vk::SubpassDescriptionFlags(),     // flags
+							vk::PipelineBindPoint::eGraphics,  // pipelineBindPoint
+							0,        // inputAttachmentCount
+							nullptr,  // pInputAttachments
+							1,        // colorAttachmentCount
+							array{    // pColorAttachments
+								vk::AttachmentReference(
+									0,  // attachment
+									vk::ImageLayout::eColorAttachmentOptimal  // layout
+								),
+							}.data(),
+							nullptr,  // pResolveAttachments
+							nullptr,  // pDepthStencilAttachment
+							0,        // preserveAttachmentCount
+							nullptr   // pPreserveAttachments
+						),
+					}.data(),
+					1,      // dependencyCount
+					array{  // pDependencies
+						vk::SubpassDependency(
+							0,                     // srcSubpass
+							VK_SUBPASS_EXTERNAL,   // dstSubpass
+							vk::PipelineStageFlags(vk::PipelineStageFlagBits::eColorAttachmentOutput),  // srcStageMask
+							vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer),  // dstStageMask
+							vk::AccessFlags(vk::AccessFlagBits::eColorAttachmentWrite),  // srcAccessMask
+							vk::AccessFlags(vk::AccessFlagBits::eTransferRead),  // dstAccessMask
+							vk::DependencyFlags()  // dependencyFlags
+						),
+					}.data()
+				)
+			);
+
 	// commandPool and commandBuffer
+	startupProfiler.phase("command buffer and synchronization");
 	commandPool =
 		device.createCommandPool(
 			vk::CommandPoolCreateInfo(
@@ -422,6 +1098,7 @@ void App::init()
 		);
 
 	// create shader modules
+	startupProfiler.phase("shader modules");
 	vsModule =
 		device.createShaderModule(
 			vk::ShaderModuleCreateInfo(
@@ -438,39 +1115,180 @@ void App::init()
 				fsSpirv  // pCode
 			)
 		);
+	fsDf64Module =
+		device.createShaderModule(
+			vk::ShaderModuleCreateInfo(
+				vk::ShaderModuleCreateFlags(),  // flags
+				sizeof(fsDf64Spirv),  // codeSize
+				fsDf64Spirv  // pCode
+			)
+		);
+	if(fp64Supported)
+		fsFp64Module =
+			device.createShaderModule(
+				vk::ShaderModuleCreateInfo(
+					vk::ShaderModuleCreateFlags(),  // flags
+					sizeof(fsFp64Spirv),  // codeSize
+					fsFp64Spirv  // pCode
+				)
+			);
+	perturbationFsModule =
+		device.createShaderModule(
+			vk::ShaderModuleCreateInfo(
+				vk::ShaderModuleCreateFlags(),  // flags
+				sizeof(perturbationFsSpirv),  // codeSize
+				perturbationFsSpirv  // pCode
+			)
+		);
+
+	// descriptor set layout, descriptor pool and descriptor set
+	// (the only descriptor is the reference orbit buffer used by the perturbation path)
+	startupProfiler.phase("descriptors and pipeline layout");
+	descriptorSetLayout =
+		device.createDescriptorSetLayout(
+			vk::DescriptorSetLayoutCreateInfo(
+				vk::DescriptorSetLayoutCreateFlags(),  // flags
+				1,  // bindingCount
+				array{  // pBindings
+					vk::DescriptorSetLayoutBinding{
+						0,  // binding
+						vk::DescriptorType::eStorageBuffer,  // descriptorType
+						1,  // descriptorCount
+						vk::ShaderStageFlagBits::eFragment,  // stageFlags
+						nullptr  // pImmutableSamplers
+					},
+				}.data()
+			)
+		);
+	descriptorPool =
+		device.createDescriptorPool(
+			vk::DescriptorPoolCreateInfo(
+				vk::DescriptorPoolCreateFlags(),  // flags
+				1,  // maxSets
+				1,  // poolSizeCount
+				array{  // pPoolSizes
+					vk::DescriptorPoolSize(
+						vk::DescriptorType::eStorageBuffer,  // type
+						1  // descriptorCount
+					),
+				}.data()
+			)
+		);
+	descriptorSet =
+		device.allocateDescriptorSets(
+			vk::DescriptorSetAllocateInfo(
+				descriptorPool,  // descriptorPool
+				1,  // descriptorSetCount
+				&descriptorSetLayout  // pSetLayouts
+			)
+		)[0];
 
 	// pipeline layout
 	pipelineLayout =
 		device.createPipelineLayout(
 			vk::PipelineLayoutCreateInfo{
 				vk::PipelineLayoutCreateFlags(),  // flags
-				0,       // setLayoutCount
-				nullptr, // pSetLayouts
+				1,       // setLayoutCount
+				&descriptorSetLayout,  // pSetLayouts
 				1,       // pushConstantRangeCount
 				array{   // pPushConstantRanges
 					vk::PushConstantRange{
 						vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,  // stage flags
 						0,  // offset
-						32,  // size
+						96,  // size
 					},
 				}.data()
 			}
 		);
+
+	// timestamp pool
+	// (two timestamps measure the GPU time of each frame)
+	uint32_t timestampValidBits = physicalDevice.getQueueFamilyProperties()[graphicsQueueFamily].timestampValidBits;
+	timestampMask = timestampValidBits>=64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+	timestampPeriod_ns = physicalDevice.getProperties().limits.timestampPeriod;
+	if(timestampValidBits != 0)
+		timestampPool =
+			device.createQueryPool(
+				vk::QueryPoolCreateInfo(
+					vk::QueryPoolCreateFlags(),  // flags
+					vk::QueryType::eTimestamp,  // queryType
+					2,  // queryCount
+					vk::QueryPipelineStatisticFlags()  // pipelineStatistics
+				)
+			);
+
+	// pipeline libraries
+	// (the parts shared by all the variants)
+	startupProfiler.phase("pipeline libraries");
+	if(pipelineLibrarySupported)
+		createPipelineLibraries();
+
+	// build thread
+	buildThread = thread(&App::buildThreadMain, this);
+
+	// pipelines
+	// (variants reading the iteration limit from push constants for all the coloring modes;
+	// they are created once, as viewport and scissor are dynamic state and the render pass does not change)
+	startupProfiler.phase("pipeline variants");
+	auto startTime = chrono::high_resolution_clock::now();
+	for(FragmentShader s : { FragmentShader::Fp32, FragmentShader::Df64, FragmentShader::Fp64, FragmentShader::Perturbation })
+		if(s != FragmentShader::Fp64 || fp64Supported)
+			for(int m=0; m<numColoringModes; m++)
+				pipelineVariant(s, 0, m);
+	cout << "Created " << pipelineVariants.size() << " pipeline variants in "
+	     << chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count() * 1000 << "ms" << endl;
+
+	// precision tiers
+	// (if more tiers are available, each of them renders a few frames of the initial view
+	// to measure its speed)
+	startupProfiler.phase("precision tiers");
+	if(requestedPrecision == Precision::Fp64 && !fp64Supported) {
+		cout << "Fp64 precision is not supported by the device. Using df64 precision." << endl;
+		requestedPrecision = Precision::Df64;
+	}
+	for(Precision p : { Precision::Fp32, Precision::Df64, Precision::Fp64 })
+		if(isTierAvailable(p))
+			calibrationTiers.push_back(p);
+	activePrecision = calibrationTiers.front();
+	if(calibrationTiers.size() > 1) {
+		if(timestampPool) {
+			calibrationFrame = 0;
+			cout << "Measuring " << calibrationTiers.size() << " precision tiers..." << endl;
+		}
+		else
+			cout << "Timestamps are not supported by the device, so the precision tiers cannot be compared. "
+			        "The tiers will be preferred in the order fp32, df64, fp64." << endl;
+	}
 }
 
 
-/** Recreate swapchain and pipeline callback method.
+/** Recreate swapchain callback method.
  *  The method is usually called after the window resize and on the application start. */
 void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& surfaceCapabilities,
                             vk::Extent2D newSurfaceExtent)
 {
+	StartupProfiler::Scope profilerScope(startupProfiler, "recreateSwapchain");
+
+	// start measuring resize latency
+	resizeStartTime = chrono::high_resolution_clock::now();
+	resizeMeasurementPending = true;
+
 	// clear resources
 	for(auto v : swapchainImageViews)  device.destroy(v);
 	swapchainImageViews.clear();
 	for(auto f : framebuffers)  device.destroy(f);
 	framebuffers.clear();
-	device.destroy(pipeline);
-	pipeline = nullptr;
+	for(size_t i=0; i<2; i++) {
+		device.destroy(canvasFramebuffers[i]);
+		canvasFramebuffers[i] = nullptr;
+		device.destroy(canvasImageViews[i]);
+		canvasImageViews[i] = nullptr;
+		device.destroy(canvasImages[i]);
+		canvasImages[i] = nullptr;
+		device.free(canvasMemory[i]);
+		canvasMemory[i] = nullptr;
+	}
+	canvasContent.valid = false;
 
 	// print info
 	cout << "Recreating swapchain (extent: " << newSurfaceExtent.width << "x" << newSurfaceExtent.height
@@ -492,7 +1310,9 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 				surfaceFormat.colorSpace,       // imageColorSpace
 				newSurfaceExtent,               // imageExtent
 				1,                              // imageArrayLayers
-				vk::ImageUsageFlagBits::eColorAttachment,  // imageUsage
+				scrollReuseEnabled  // imageUsage
+					? vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferDst
+					: vk::ImageUsageFlagBits::eColorAttachment,
 				(graphicsQueueFamily==presentationQueueFamily) ? vk::SharingMode::eExclusive : vk::SharingMode::eConcurrent, // imageSharingMode
 				uint32_t(2),  // queueFamilyIndexCount
 				array<uint32_t, 2>{graphicsQueueFamily, presentationQueueFamily}.data(),  // pQueueFamilyIndices
@@ -521,7 +1341,7 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 	swapchain = newSwapchain.release();
 
 	// swapchain images and image views
-	vector<vk::Image> swapchainImages = device.getSwapchainImagesKHR(swapchain);
+	swapchainImages = device.getSwapchainImagesKHR(swapchain);
 	swapchainImageViews.reserve(swapchainImages.size());
 	for(vk::Image image : swapchainImages)
 		swapchainImageViews.emplace_back(
@@ -560,10 +1380,103 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 			)
 		);
 
-	// pipeline
-	pipeline =
-		device.createGraphicsPipeline(
-			nullptr,  // pipelineCache
+	// canvas images
+	if(scrollReuseEnabled) {
+		vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+		for(size_t i=0; i<2; i++) {
+
+			canvasImages[i] =
+				device.createImage(
+					vk::ImageCreateInfo(
+						vk::ImageCreateFlags(),       // flags
+						vk::ImageType::e2D,           // imageType
+						surfaceFormat.format,         // format
+						vk::Extent3D(newSurfaceExtent.width, newSurfaceExtent.height, 1),  // extent
+						1,                            // mipLevels
+						1,                            // arrayLayers
+						vk::SampleCountFlagBits::e1,  // samples
+						vk::ImageTiling::eOptimal,    // tiling
+						vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc |
+							vk::ImageUsageFlagBits::eTransferDst,  // usage
+						vk::SharingMode::eExclusive,  // sharingMode
+						0,                            // queueFamilyIndexCount
+						nullptr,                      // pQueueFamilyIndices
+						vk::ImageLayout::eUndefined   // initialLayout
+					)
+				);
+
+			// allocate device-local memory
+			vk::MemoryRequirements memoryRequirements = device.getImageMemoryRequirements(canvasImages[i]);
+			uint32_t memoryTypeIndex = UINT32_MAX;
+			for(uint32_t j=0; j<memoryProperties.memoryTypeCount; j++)
+				if(memoryRequirements.memoryTypeBits & (1<<j))
+					if(memoryProperties.memoryTypes[j].propertyFlags & vk::MemoryPropertyFlagBits::eDeviceLocal) {
+						memoryTypeIndex = j;
+						break;
+					}
+			if(memoryTypeIndex == UINT32_MAX)
+				throw runtime_error("No suitable memory type found for the canvas image.");
+			canvasMemory[i] =
+				device.allocateMemory(
+					vk::MemoryAllocateInfo(
+						memoryRequirements.size,  // allocationSize
+						memoryTypeIndex           // memoryTypeIndex
+					)
+				);
+			device.bindImageMemory(
+				canvasImages[i],  // image
+				canvasMemory[i],  // memory
+				0                 // memoryOffset
+			);
+
+			// image view and framebuffer
+			canvasImageViews[i] =
+				device.createImageView(
+					vk::ImageViewCreateInfo(
+						vk::ImageViewCreateFlags(),  // flags
+						canvasImages[i],             // image
+						vk::ImageViewType::e2D,      // viewType
+						surfaceFormat.format,        // format
+						vk::ComponentMapping(),      // components
+						vk::ImageSubresourceRange(   // subresourceRange
+							vk::ImageAspectFlagBits::eColor,  // aspectMask
+							0,  // baseMipLevel
+							1,  // levelCount
+							0,  // baseArrayLayer
+							1   // layerCount
+						)
+					)
+				);
+			canvasFramebuffers[i] =
+				device.createFramebuffer(
+					vk::FramebufferCreateInfo(
+						vk::FramebufferCreateFlags(),  // flags
+						canvasRenderPass,  // renderPass
+						1,  // attachmentCount
+						&canvasImageViews[i],  // pAttachments
+						newSurfaceExtent.width,  // width
+						newSurfaceExtent.height,  // height
+						1  // layers
+					)
+				);
+		}
+	}
+
+	// set view
+	// (the view center is kept and the pixel size is scaled, so the same area stays visible)
+	if(valueGradient == -1.)
+		valueGradient = 4. / newSurfaceExtent.height;
+	else
+		valueGradient *= double(windowHeight) / newSurfaceExtent.height;
+	windowHeight = newSurfaceExtent.height;
+	setView(0., 0.);
+}
+
+
+vk::Pipeline App::createPipeline(vk::ShaderModule fragmentShader, const vk::SpecializationInfo* specializationInfo)
+{
+	return
+		pipelineCache.createGraphicsPipeline(
 			vk::GraphicsPipelineCreateInfo(
 				vk::PipelineCreateFlags(),  // flags
 
@@ -580,9 +1493,9 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 					vk::PipelineShaderStageCreateInfo{
 						vk::PipelineShaderStageCreateFlags(),  // flags
 						vk::ShaderStageFlagBits::eFragment,  // stage
-						fsModule,  // module
+						fragmentShader,  // module
 						"main",  // pName
-						nullptr  // pSpecializationInfo
+						specializationInfo  // pSpecializationInfo
 					},
 				}.data(),
 
@@ -606,16 +1519,13 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 				nullptr, // pTessellationState
 
 				// viewport
+				// (viewport and scissor are dynamic state)
 				&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
 					vk::PipelineViewportStateCreateFlags(),  // flags
 					1,  // viewportCount
-					array{  // pViewports
-						vk::Viewport(0.f, 0.f, float(newSurfaceExtent.width), float(newSurfaceExtent.height), 0.f, 1.f),
-					}.data(),
+					nullptr,  // pViewports
 					1,  // scissorCount
-					array{  // pScissors
-						vk::Rect2D(vk::Offset2D(0,0), newSurfaceExtent)
-					}.data(),
+					nullptr  // pScissors
 				},
 
 				// rasterization
@@ -669,76 +1579,1416 @@ void App::recreateSwapchain(VulkanWindow&, const vk::SurfaceCapabilitiesKHR& sur
 					array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
 				},
 
-				nullptr,  // pDynamicState
+				// dynamic state
+				// (viewport shrinks for reduced resolution frames of progressive refinement
+				// and scissor restricts rendering to the newly exposed strips on scroll reuse)
+				&(const vk::PipelineDynamicStateCreateInfo&)vk::PipelineDynamicStateCreateInfo{  // pDynamicState
+					vk::PipelineDynamicStateCreateFlags(),  // flags
+					2,  // dynamicStateCount
+					array{  // pDynamicStates
+						vk::DynamicState::eViewport,
+						vk::DynamicState::eScissor,
+					}.data()
+				},
+
 				pipelineLayout,  // layout
 				renderPass,  // renderPass
 				0,  // subpass
 				vk::Pipeline(nullptr),  // basePipelineHandle
 				-1 // basePipelineIndex
 			)
-		).value;
-
-	// set view
-	if(valueGradient == -1.f) {
-		valueGradient = 4.f / newSurfaceExtent.height;
-		setView(float(newSurfaceExtent.width)/2, float(newSurfaceExtent.height)/2, 0.f, 0.f);
-	}
-	else {
-		valueGradient *= float(windowHeight) / newSurfaceExtent.height;
-		setView(float(newSurfaceExtent.width)/2, float(newSurfaceExtent.height)/2, (minX+maxX)/2, (minY+maxY)/2);
-	}
-	windowHeight = newSurfaceExtent.height;
+		);
 }
 
 
-void App::setView(float coordX, float coordY, float valueX, float valueY)
+void App::createPipelineLibraries()
 {
-	vk::Extent2D windowSize = window.surfaceExtent();
-	minY = valueY - (coordY * valueGradient);
-	maxY = valueY + ((int(windowSize.height) - coordY) * valueGradient);
-	minX = valueX - (coordX * valueGradient);
-	maxX = valueX + ((int(windowSize.width) - coordX) * valueGradient);
-	cout << "New coords: " << minX << "," << minY << ", " << maxX << "," << maxY << endl;
+	// library flags
+	// (the libraries retain the information needed by the optimized link)
+	vk::PipelineCreateFlags flags =
+		vk::PipelineCreateFlagBits::eLibraryKHR | vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT;
+
+	// vertex input interface
+	vk::GraphicsPipelineLibraryCreateInfoEXT vertexInputInfo(vk::GraphicsPipelineLibraryFlagBitsEXT::eVertexInputInterface);
+	vertexInputLibrary =
+		pipelineCache.createGraphicsPipeline(
+			vk::GraphicsPipelineCreateInfo(
+				flags,  // flags
+				0,  // stageCount
+				nullptr,  // pStages
+				&(const vk::PipelineVertexInputStateCreateInfo&)vk::PipelineVertexInputStateCreateInfo{  // pVertexInputState
+					vk::PipelineVertexInputStateCreateFlags(),  // flags
+					0,        // vertexBindingDescriptionCount
+					nullptr,  // pVertexBindingDescriptions
+					0,        // vertexAttributeDescriptionCount
+					nullptr   // pVertexAttributeDescriptions
+				},
+				&(const vk::PipelineInputAssemblyStateCreateInfo&)vk::PipelineInputAssemblyStateCreateInfo{  // pInputAssemblyState
+					vk::PipelineInputAssemblyStateCreateFlags(),  // flags
+					vk::PrimitiveTopology::eTriangleStrip,  // topology
+					VK_FALSE  // primitiveRestartEnable
+				},
+				nullptr,  // pTessellationState
+				nullptr,  // pViewportState
+				nullptr,  // pRasterizationState
+				nullptr,  // pMultisampleState
+				nullptr,  // pDepthStencilState
+				nullptr,  // pColorBlendState
+				nullptr,  // pDynamicState
+				nullptr,  // layout
+				nullptr,  // renderPass
+				0,  // subpass
+				vk::Pipeline(nullptr),  // basePipelineHandle
+				-1,  // basePipelineIndex
+				&vertexInputInfo  // pNext
+			)
+		);
+
+	// pre-rasterization shaders
+	// (viewport and scissor are dynamic state)
+	vk::GraphicsPipelineLibraryCreateInfoEXT preRasterizationInfo(vk::GraphicsPipelineLibraryFlagBitsEXT::ePreRasterizationShaders);
+	preRasterizationLibrary =
+		pipelineCache.createGraphicsPipeline(
+			vk::GraphicsPipelineCreateInfo(
+				flags,  // flags
+				1,  // stageCount
+				&(const vk::PipelineShaderStageCreateInfo&)vk::PipelineShaderStageCreateInfo{  // pStages
+					vk::PipelineShaderStageCreateFlags(),  // flags
+					vk::ShaderStageFlagBits::eVertex,  // stage
+					vsModule,  // module
+					"main",  // pName
+					nullptr  // pSpecializationInfo
+				},
+				nullptr,  // pVertexInputState
+				nullptr,  // pInputAssemblyState
+				nullptr,  // pTessellationState
+				&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
+					vk::PipelineViewportStateCreateFlags(),  // flags
+					1,  // viewportCount
+					nullptr,  // pViewports
+					1,  // scissorCount
+					nullptr  // pScissors
+				},
+				&(const vk::PipelineRasterizationStateCreateInfo&)vk::PipelineRasterizationStateCreateInfo{  // pRasterizationState
+					vk::PipelineRasterizationStateCreateFlags(),  // flags
+					VK_FALSE,  // depthClampEnable
+					VK_FALSE,  // rasterizerDiscardEnable
+					vk::PolygonMode::eFill,  // polygonMode
+					vk::CullModeFlagBits::eNone,  // cullMode
+					vk::FrontFace::eCounterClockwise,  // frontFace
+					VK_FALSE,  // depthBiasEnable
+					0.f,  // depthBiasConstantFactor
+					0.f,  // depthBiasClamp
+					0.f,  // depthBiasSlopeFactor
+					1.f   // lineWidth
+				},
+				nullptr,  // pMultisampleState
+				nullptr,  // pDepthStencilState
+				nullptr,  // pColorBlendState
+				&(const vk::PipelineDynamicStateCreateInfo&)vk::PipelineDynamicStateCreateInfo{  // pDynamicState
+					vk::PipelineDynamicStateCreateFlags(),  // flags
+					2,  // dynamicStateCount
+					array{  // pDynamicStates
+						vk::DynamicState::eViewport,
+						vk::DynamicState::eScissor,
+					}.data()
+				},
+				pipelineLayout,  // layout
+				renderPass,  // renderPass
+				0,  // subpass
+				vk::Pipeline(nullptr),  // basePipelineHandle
+				-1,  // basePipelineIndex
+				&preRasterizationInfo  // pNext
+			)
+		);
+
+	// fragment output interface
+	vk::GraphicsPipelineLibraryCreateInfoEXT fragmentOutputInfo(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentOutputInterface);
+	fragmentOutputLibrary =
+		pipelineCache.createGraphicsPipeline(
+			vk::GraphicsPipelineCreateInfo(
+				flags,  // flags
+				0,  // stageCount
+				nullptr,  // pStages
+				nullptr,  // pVertexInputState
+				nullptr,  // pInputAssemblyState
+				nullptr,  // pTessellationState
+				nullptr,  // pViewportState
+				nullptr,  // pRasterizationState
+				&(const vk::PipelineMultisampleStateCreateInfo&)vk::PipelineMultisampleStateCreateInfo{  // pMultisampleState
+					vk::PipelineMultisampleStateCreateFlags(),  // flags
+					vk::SampleCountFlagBits::e1,  // rasterizationSamples
+					VK_FALSE,  // sampleShadingEnable
+					0.f,       // minSampleShading
+					nullptr,   // pSampleMask
+					VK_FALSE,  // alphaToCoverageEnable
+					VK_FALSE   // alphaToOneEnable
+				},
+				nullptr,  // pDepthStencilState
+				&(const vk::PipelineColorBlendStateCreateInfo&)vk::PipelineColorBlendStateCreateInfo{  // pColorBlendState
+					vk::PipelineColorBlendStateCreateFlags(),  // flags
+					VK_FALSE,  // logicOpEnable
+					vk::LogicOp::eClear,  // logicOp
+					1,  // attachmentCount
+					array{  // pAttachments
+						vk::PipelineColorBlendAttachmentState{
+							VK_FALSE,  // blendEnable
+							vk::BlendFactor::eZero,  // srcColorBlendFactor
+							vk::BlendFactor::eZero,  // dstColorBlendFactor
+							vk::BlendOp::eAdd,       // colorBlendOp
+							vk::BlendFactor::eZero,  // srcAlphaBlendFactor
+							vk::BlendFactor::eZero,  // dstAlphaBlendFactor
+							vk::BlendOp::eAdd,       // alphaBlendOp
+							vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+								vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA  // colorWriteMask
+						},
+					}.data(),
+					array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
+				},
+				nullptr,  // pDynamicState
+				pipelineLayout,  // layout
+				renderPass,  // renderPass
+				0,  // subpass
+				vk::Pipeline(nullptr),  // basePipelineHandle
+				-1,  // basePipelineIndex
+				&fragmentOutputInfo  // pNext
+			)
+		);
 }
 
 
-void App::frame(VulkanWindow&)
+vk::Pipeline App::createFragmentShaderLibrary(vk::ShaderModule fragmentShader,
+                                              const vk::SpecializationInfo* specializationInfo)
 {
-	cout << "x" << flush;
+	// fragment shader part of the variant
+	// (the render pass has no depth attachment, so no depth and stencil state is given)
+	vk::GraphicsPipelineLibraryCreateInfoEXT fragmentShaderInfo(vk::GraphicsPipelineLibraryFlagBitsEXT::eFragmentShader);
+	return
+		pipelineCache.createGraphicsPipeline(
+			vk::GraphicsPipelineCreateInfo(
+				vk::PipelineCreateFlagBits::eLibraryKHR |
+					vk::PipelineCreateFlagBits::eRetainLinkTimeOptimizationInfoEXT,  // flags
+				1,  // stageCount
+				&(const vk::PipelineShaderStageCreateInfo&)vk::PipelineShaderStageCreateInfo{  // pStages
+					vk::PipelineShaderStageCreateFlags(),  // flags
+					vk::ShaderStageFlagBits::eFragment,  // stage
+					fragmentShader,  // module
+					"main",  // pName
+					specializationInfo  // pSpecializationInfo
+				},
+				nullptr,  // pVertexInputState
+				nullptr,  // pInputAssemblyState
+				nullptr,  // pTessellationState
+				nullptr,  // pViewportState
+				nullptr,  // pRasterizationState
+				&(const vk::PipelineMultisampleStateCreateInfo&)vk::PipelineMultisampleStateCreateInfo{  // pMultisampleState
+					vk::PipelineMultisampleStateCreateFlags(),  // flags
+					vk::SampleCountFlagBits::e1,  // rasterizationSamples
+					VK_FALSE,  // sampleShadingEnable
+					0.f,       // minSampleShading
+					nullptr,   // pSampleMask
+					VK_FALSE,  // alphaToCoverageEnable
+					VK_FALSE   // alphaToOneEnable
+				},
+				nullptr,  // pDepthStencilState
+				nullptr,  // pColorBlendState
+				nullptr,  // pDynamicState
+				pipelineLayout,  // layout
+				renderPass,  // renderPass
+				0,  // subpass
+				vk::Pipeline(nullptr),  // basePipelineHandle
+				-1,  // basePipelineIndex
+				&fragmentShaderInfo  // pNext
+			)
+		);
+}
 
-	// wait for previous frame rendering work
-	// if still not finished
-	vk::Result r =
-		device.waitForFences(
-			renderFinishedFence,  // fences
-			VK_TRUE,  // waitAll
-			uint64_t(3e9)  // timeout
+
+vk::Pipeline App::linkPipeline(vk::Pipeline fragmentShaderLibrary, bool optimize)
+{
+	// link the four parts
+	// (fast link skips link time optimization, so it is cheap enough to be done on the first use of the variant)
+	array libraries{ vertexInputLibrary, preRasterizationLibrary, fragmentShaderLibrary, fragmentOutputLibrary };
+	vk::PipelineLibraryCreateInfoKHR libraryInfo(
+		uint32_t(libraries.size()),  // libraryCount
+		libraries.data()  // pLibraries
+	);
+	return
+		pipelineCache.createGraphicsPipeline(
+			vk::GraphicsPipelineCreateInfo(
+				optimize ? vk::PipelineCreateFlags(vk::PipelineCreateFlagBits::eLinkTimeOptimizationEXT)
+				         : vk::PipelineCreateFlags(),  // flags
+				0,  // stageCount
+				nullptr,  // pStages
+				nullptr,  // pVertexInputState
+				nullptr,  // pInputAssemblyState
+				nullptr,  // pTessellationState
+				nullptr,  // pViewportState
+				nullptr,  // pRasterizationState
+				nullptr,  // pMultisampleState
+				nullptr,  // pDepthStencilState
+				nullptr,  // pColorBlendState
+				nullptr,  // pDynamicState
+				pipelineLayout,  // layout
+				renderPass,  // renderPass
+				0,  // subpass
+				vk::Pipeline(nullptr),  // basePipelineHandle
+				-1,  // basePipelineIndex
+				&libraryInfo  // pNext
+			)
 		);
-	if(r != vk::Result::eSuccess) {
-		if(r == vk::Result::eTimeout)
-			throw runtime_error("GPU timeout. Task is probably hanging on GPU.");
-		throw runtime_error("Vulkan error: vkWaitForFences failed with error " + to_string(r) + ".");
-	}
-	device.resetFences(renderFinishedFence);
+}
 
-	// increment frame counter
-	frameID++;
 
-	// measure FPS
-	fpsNumFrames++;
-	if(fpsNumFrames == 0)
-		fpsStartTime = chrono::high_resolution_clock::now();
-	else {
-		auto t = chrono::high_resolution_clock::now();
+void App::destroyPipelineLibraries()
+{
+	device.destroy(fragmentOutputLibrary);
+	fragmentOutputLibrary = nullptr;
+	device.destroy(preRasterizationLibrary);
+	preRasterizationLibrary = nullptr;
+	device.destroy(vertexInputLibrary);
+	vertexInputLibrary = nullptr;
+}
+
+
+bool App::PipelineVariantKey::operator==(const PipelineVariantKey& k) const
+{
+	return shader == k.shader && maxIter == k.maxIter && coloringMode == k.coloringMode;
+}
+
+
+size_t App::PipelineVariantKeyHash::operator()(const PipelineVariantKey& k) const
+{
+	size_t h = hash<int>()(int(k.shader));
+	h = h * 31 + hash<uint32_t>()(k.maxIter);
+	return h * 31 + hash<int>()(k.coloringMode);
+}
+
+
+const char* App::fragmentShaderName(FragmentShader s)
+{
+	switch(s) {
+	case FragmentShader::Fp32: return "fp32";
+	case FragmentShader::Df64: return "df64";
+	case FragmentShader::Fp64: return "fp64";
+	case FragmentShader::Perturbation: return "perturbation";
+	}
+	return "unknown";
+}
+
+
+App::PipelineVariant App::createPipelineVariant(const PipelineVariantKey& key)
+{
+	// specialization constants
+	// (constant_id 0 is the iteration limit, constant_id 1 is the coloring mode)
+	array<int32_t,2> data{ int32_t(key.maxIter), int32_t(key.coloringMode) };
+	array entries{
+		vk::SpecializationMapEntry{ 0, 0, sizeof(int32_t) },  // constantID, offset, size
+		vk::SpecializationMapEntry{ 1, sizeof(int32_t), sizeof(int32_t) },
+	};
+	vk::SpecializationInfo specializationInfo(
+		uint32_t(entries.size()),  // mapEntryCount
+		entries.data(),  // pMapEntries
+		sizeof(data),  // dataSize
+		data.data()  // pData
+	);
+
+	// create pipeline
+	// (with the pipeline library, the fragment shader part is compiled and fast-linked with the other parts;
+	// the function is called from both the main thread and the build thread, so it touches no shared state)
+	vk::ShaderModule module =
+		(key.shader == FragmentShader::Df64) ? fsDf64Module :
+		(key.shader == FragmentShader::Fp64) ? fsFp64Module :
+		(key.shader == FragmentShader::Perturbation) ? perturbationFsModule : fsModule;
+	auto startTime = chrono::high_resolution_clock::now();
+	PipelineVariant v;
+	if(pipelineLibrarySupported) {
+		v.fragmentShaderLibrary = createFragmentShaderLibrary(module, &specializationInfo);
+		try {
+			v.pipeline = linkPipeline(v.fragmentShaderLibrary, false);
+		} catch(...) {
+			device.destroy(v.fragmentShaderLibrary);
+			throw;
+		}
+		v.optimized = false;
+	}
+	else
+		v.pipeline = createPipeline(module, &specializationInfo);
+	v.creationTime = chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+	return v;
+}
+
+
+App::PipelineVariant& App::pipelineVariant(FragmentShader shader, uint32_t maxIter, int coloringMode)
+{
+	// return existing variant
+	PipelineVariantKey key{ shader, maxIter, coloringMode };
+	auto it = pipelineVariants.find(key);
+	if(it != pipelineVariants.end())
+		return it->second;
+
+	// create the variant on this thread
+	// (used for the push constant variants that serve as the fallbacks)
+	PipelineVariant& v = pipelineVariants.emplace(key, createPipelineVariant(key)).first->second;
+	if(v.fragmentShaderLibrary)
+		requestOptimizedLink(key, v.fragmentShaderLibrary);
+	return v;
+}
+
+
+vk::Pipeline App::selectPipeline(FragmentShader shader, uint32_t maxIter)
+{
+	// variant for the current coloring mode,
+	// it is remembered for the timestamp measurement of the frame
+	PipelineVariantKey key{ shader, specializeIterations ? maxIter : 0, coloringMode };
+	auto it = pipelineVariants.find(key);
+	if(it != pipelineVariants.end())
+		frameVariant = &it->second;
+	else if(key.maxIter == 0)
+		frameVariant = &pipelineVariant(shader, 0, coloringMode);
+	else {
+
+		// request the specialized variant and use the fallback meanwhile
+		requestPipelineVariant(key);
+		frameVariant = &pipelineVariant(shader, 0, coloringMode);
+		numFallbackFrames++;
+
+	}
+	return frameVariant->pipeline;
+}
+
+
+void App::destroyPipelineVariants()
+{
+	for(auto& v : pipelineVariants) {
+		device.destroy(v.second.pipeline);
+		device.destroy(v.second.fragmentShaderLibrary);
+	}
+	pipelineVariants.clear();
+	requestedVariants.clear();
+	frameVariant = nullptr;
+	timedVariant = nullptr;
+}
+
+
+void App::printPipelineVariants() const
+{
+	// print the variants sorted by shader, iteration limit and coloring mode
+	vector<pair<PipelineVariantKey, const PipelineVariant*>> list;
+	for(auto& v : pipelineVariants)
+		list.emplace_back(v.first, &v.second);
+	sort(list.begin(), list.end(),
+		[](auto& a, auto& b) {
+			return tie(a.first.shader, a.first.maxIter, a.first.coloringMode) <
+			       tie(b.first.shader, b.first.maxIter, b.first.coloringMode);
+		});
+	cout << "\nPipeline variants (creation time, average GPU time of the frame):" << endl;
+	for(auto& [k, v] : list) {
+		cout << "   " << fragmentShaderName(k.shader) << ", maxIter ";
+		if(k.maxIter != 0)
+			cout << k.maxIter;
+		else
+			cout << "push constant";
+		cout << ", coloring " << k.coloringMode << ": " << v->creationTime * 1000 << "ms, ";
+		if(v->fragmentShaderLibrary) {
+			if(v->optimized)
+				cout << "optimized link " << v->optimizedLinkTime * 1000 << "ms, ";
+			else
+				cout << "fast-linked, ";
+		}
+		if(v->numSamples != 0)
+			cout << v->gpuTime / v->numSamples * 1000 << "ms (" << v->numSamples << " frames)" << endl;
+		else
+			cout << "not used" << endl;
+	}
+	cout << "Variants being built: " << requestedVariants.size()
+	     << ", frames rendered by fallback variants: " << numFallbackFrames << endl;
+}
+
+
+void App::requestPipelineVariant(const PipelineVariantKey& key)
+{
+	// skip the variants already requested
+	if(!requestedVariants.emplace(key, chrono::high_resolution_clock::now()).second)
+		return;
+
+	// queue the job
+	// (new variants go before the optimized links, as the frames are waiting for them,
+	// and the latest request goes first, as it is the most likely to be used by the next frame)
+	{
+		lock_guard lock(buildMutex);
+		buildQueue.push_front(BuildJob{ key, nullptr });
+	}
+	buildCondition.notify_one();
+}
+
+
+void App::requestOptimizedLink(const PipelineVariantKey& key, vk::Pipeline fragmentShaderLibrary)
+{
+	{
+		lock_guard lock(buildMutex);
+		buildQueue.push_back(BuildJob{ key, fragmentShaderLibrary });
+	}
+	buildCondition.notify_one();
+}
+
+
+void App::buildThreadMain()
+{
+	unique_lock lock(buildMutex);
+	while(true) {
+
+		// wait for a job
+		buildCondition.wait(lock, [this]{ return buildThreadExit || !buildQueue.empty(); });
+		if(buildThreadExit)
+			return;
+		BuildJob job = buildQueue.front();
+		buildQueue.pop_front();
+		lock.unlock();
+
+		// build the variant or link the optimized pipeline
+		// (exceptions are handed over to the main thread)
+		BuildResult result{ job.key, PipelineVariant{}, bool(job.fragmentShaderLibrary), {} };
+		try {
+			if(!result.optimizedLink)
+				result.variant = createPipelineVariant(job.key);
+			else {
+				auto startTime = chrono::high_resolution_clock::now();
+				result.variant.pipeline = linkPipeline(job.fragmentShaderLibrary, true);
+				result.variant.creationTime =
+					chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+			}
+		} catch(exception& e) {
+			result.errorMessage = e.what();
+		}
+
+		// hand over the result
+		// (the optimized link of the new variant is queued right away)
+		lock.lock();
+		if(!result.optimizedLink && result.variant.fragmentShaderLibrary)
+			buildQueue.push_back(BuildJob{ job.key, result.variant.fragmentShaderLibrary });
+		buildResults.push_back(move(result));
+	}
+}
+
+
+void App::collectBuiltPipelines()
+{
+	// take the results of the build thread
+	vector<BuildResult> results;
+	{
+		lock_guard lock(buildMutex);
+		if(buildResults.empty())
+			return;
+		results.swap(buildResults);
+	}
+
+	for(size_t i=0; i<results.size(); i++) {
+		BuildResult& r = results[i];
+
+		// new variant
+		// (failure to build it is fatal, as it would be on the main thread)
+		if(!r.optimizedLink) {
+			if(!r.errorMessage.empty()) {
+				for(size_t j=i+1; j<results.size(); j++) {
+					device.destroy(results[j].variant.pipeline);
+					if(!results[j].optimizedLink)
+						device.destroy(results[j].variant.fragmentShaderLibrary);
+				}
+				throw runtime_error("Building of pipeline variant " + string(fragmentShaderName(r.key.shader)) +
+				                    " failed: " + r.errorMessage);
+			}
+			auto it = requestedVariants.find(r.key);
+			double latency =
+				chrono::duration<double>(chrono::high_resolution_clock::now() - it->second).count();
+			requestedVariants.erase(it);
+			cout << "Created pipeline variant " << fragmentShaderName(r.key.shader) << ", maxIter " << r.key.maxIter
+			     << ", coloring " << r.key.coloringMode << " in " << r.variant.creationTime * 1000 << "ms"
+			     << (r.variant.fragmentShaderLibrary ? " (fast-linked)" : "") << " on the build thread, "
+			     << latency * 1000 << "ms after the request" << endl;
+			pipelineVariants.emplace(r.key, r.variant);
+			continue;
+		}
+
+		// optimized pipeline
+		// (the caller guarantees that no submitted work uses the fast-linked pipeline;
+		// GPU time statistics restart, so they describe the optimized pipeline)
+		if(!r.errorMessage.empty()) {
+			cout << "Optimized link of pipeline variant " << fragmentShaderName(r.key.shader)
+			     << " failed: " << r.errorMessage << endl;
+			continue;
+		}
+		PipelineVariant& v = pipelineVariants.at(r.key);
+		device.destroy(v.pipeline);
+		v.pipeline = r.variant.pipeline;
+		v.optimized = true;
+		v.optimizedLinkTime = r.variant.creationTime;
+		v.gpuTime = 0.;
+		v.numSamples = 0;
+	}
+}
+
+
+void App::stopBuildThread()
+{
+	// stop the thread
+	if(buildThread.joinable()) {
+		{
+			lock_guard lock(buildMutex);
+			buildThreadExit = true;
+		}
+		buildCondition.notify_one();
+		buildThread.join();
+	}
+
+	// release the pipelines that were not collected
+	for(BuildResult& r : buildResults) {
+		device.destroy(r.variant.pipeline);
+		if(!r.optimizedLink)
+			device.destroy(r.variant.fragmentShaderLibrary);
+	}
+	buildResults.clear();
+	buildQueue.clear();
+}
+
+
+void App::setView(double offsetX, double offsetY)
+{
+	// move the center
+	// (its precision grows with the zoom)
+	unsigned numLimbs = FixedPoint::limbsForResolution(valueGradient);
+	centerX += FixedPoint::fromDouble(offsetX, numLimbs);
+	centerY += FixedPoint::fromDouble(offsetY, numLimbs);
+
+	unsigned numDigits = unsigned(max(ceil(-log10(valueGradient)), 0.)) + 2;
+	cout << "New view: center " << centerX.toString(numDigits) << ", " << centerY.toString(numDigits)
+	     << ", pixel size " << valueGradient << endl;
+}
+
+
+void App::pushFractalConstants(const FixedPoint& viewCenterX, const FixedPoint& viewCenterY, double pixelSize,
+                               float centerPixelX, float centerPixelY, vk::Extent2D viewportExtent, uint32_t maxIter,
+                               bool perturbation)
+{
+	// push constants
+	// (the reference pixel is the reference point of the perturbation path or the view center otherwise;
+	// the view center in higher precision is used by df64 and fp64 tiers)
+	struct PushData {
+		float juliaCoords[4];
+		int viewPlane;
+		int dummy;
+		float constantParameters[2];
+		float referencePixel[2];
+		float gradientMantissa;
+		int gradientExponent;
+		int orbitLength;
+		int maxIter;
+		float centerHi[2];
+		float centerLo[2];
+		float padding[2];
+		double center[2];
+	};
+	static_assert(sizeof(PushData) == 96, "PushData does not match push constant layout.");
+	int gradientExponent;
+	float gradientMantissa = float(frexp(pixelSize, &gradientExponent));
+	float referencePixelX = centerPixelX;
+	float referencePixelY = centerPixelY;
+	if(perturbation) {
+		referencePixelX = float(centerPixelX + (referenceX - viewCenterX).toDouble() / pixelSize);
+		referencePixelY = float(centerPixelY + (referenceY - viewCenterY).toDouble() / pixelSize);
+	}
+	double cx = viewCenterX.toDouble();
+	double cy = viewCenterY.toDouble();
+	float centerHiX = float(cx);
+	float centerHiY = float(cy);
+	float centerLoX = float((viewCenterX - FixedPoint::fromDouble(centerHiX, viewCenterX.numFractionalLimbs())).toDouble());
+	float centerLoY = float((viewCenterY - FixedPoint::fromDouble(centerHiY, viewCenterY.numFractionalLimbs())).toDouble());
+	commandBuffer.pushConstants(
+		pipelineLayout,  // layout
+		vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,  // stageFlags
+		0,  // offset
+		sizeof(PushData),  // size
+		&(const PushData&)PushData{  // pValues
+			float(cx - centerPixelX * pixelSize),  // juliaCoords are coordinates of the viewport edges
+			float(cy - centerPixelY * pixelSize),
+			float(cx + (viewportExtent.width - centerPixelX) * pixelSize),
+			float(cy + (viewportExtent.height - centerPixelY) * pixelSize),
+			viewPlane,
+			0,
+			constantParameter[0], constantParameter[1],
+			referencePixelX, referencePixelY,
+			gradientMantissa,
+			gradientExponent,
+			int(orbitLength),
+			int(maxIter),
+			centerHiX, centerHiY,
+			centerLoX, centerLoY,
+			0.f, 0.f,
+			cx, cy,
+		}
+	);
+}
+
+
+const char* App::precisionName(Precision p)
+{
+	switch(p) {
+	case Precision::Fp32: return "fp32";
+	case Precision::Df64: return "df64";
+	case Precision::Fp64: return "fp64";
+	default: return "auto";
+	}
+}
+
+
+bool App::isTierAvailable(Precision p) const
+{
+	if(requestedPrecision != Precision::Auto && requestedPrecision != p)
+		return false;
+	return p != Precision::Fp64 || fp64Supported;
+}
+
+
+bool App::isPrecise(Precision p) const
+{
+	// the pixel size must be at least precisionMargin ulps of the view coordinates
+	// (fp32 has 24 bits of mantissa, df64 about 48 bits and fp64 53 bits)
+	double m = max({ 1., fabs(centerX.toDouble()), fabs(centerY.toDouble()) });
+	int bits = (p == Precision::Fp32) ? 24 : (p == Precision::Df64) ? 48 : 53;
+	return valueGradient >= precisionMargin * ldexp(m, -bits);
+}
+
+
+App::Precision App::selectPrecision() const
+{
+	// the fastest tier that is precise enough,
+	// or the most precise tier if none of them is precise enough
+	Precision best = Precision::Auto;
+	Precision mostPrecise = Precision::Fp32;
+	for(Precision p : calibrationTiers) {
+		mostPrecise = p;
+		if(!isPrecise(p))
+			continue;
+		const TierTiming& t = tierTimings[size_t(p)];
+		const TierTiming& b = tierTimings[size_t(best == Precision::Auto ? p : best)];
+		double time = t.numSamples ? t.gpuTime / t.numSamples : 0.;
+		double bestTime = b.numSamples ? b.gpuTime / b.numSamples : 0.;
+		if(best == Precision::Auto || time < bestTime)
+			best = p;
+	}
+	return (best != Precision::Auto) ? best : mostPrecise;
+}
+
+
+uint32_t App::previewLevel() const
+{
+	// the finest level whose estimated time fits into the budget
+	// (each level has four times less pixels than the finer one;
+	// without measurement, the coarsest level is used)
+	if(fullFrameGpuTime == 0.)
+		return refinementSteps;
+	uint32_t level = 0;
+	double t = fullFrameGpuTime;
+	while(t > frameTimeBudget && level < refinementSteps) {
+		t /= 4.;
+		level++;
+	}
+	return level;
+}
+
+
+bool App::TileKey::operator==(const TileKey& k) const
+{
+	return level == k.level && x == k.x && y == k.y &&
+	       constantParameter[0] == k.constantParameter[0] && constantParameter[1] == k.constantParameter[1] &&
+	       viewPlane == k.viewPlane && precision == k.precision && coloringMode == k.coloringMode;
+}
+
+
+size_t App::TileKeyHash::operator()(const TileKey& k) const
+{
+	size_t h = hash<int>()(k.level);
+	h = h * 31 + hash<int64_t>()(k.x);
+	h = h * 31 + hash<int64_t>()(k.y);
+	h = h * 31 + hash<float>()(k.constantParameter[0]);
+	h = h * 31 + hash<float>()(k.constantParameter[1]);
+	h = h * 31 + hash<int>()(k.viewPlane);
+	h = h * 31 + hash<int>()(int(k.precision));
+	return h * 31 + hash<int>()(k.coloringMode);
+}
+
+
+size_t App::allocateTileSlot(const TileKey& key)
+{
+	// free slot or the least recently used slot that is not used by the current frame
+	// (a frame uses at most half of the slots for its tiles and the other half for their substitutes,
+	// so the slot is always found)
+	size_t best = ~size_t(0);
+	for(size_t i=0; i<tileSlots.size(); i++) {
+		const TileSlot& slot = tileSlots[i];
+		if(!slot.used) {
+			best = i;
+			break;
+		}
+		if(slot.lastUsedFrame != frameID &&
+		   (best == ~size_t(0) || slot.lastUsedFrame < tileSlots[best].lastUsedFrame))
+			best = i;
+	}
+	TileSlot& slot = tileSlots[best];
+	if(slot.used)
+		tileMap.erase(slot.key);
+	else
+		numUsedTileSlots++;
+	slot.key = key;
+	slot.used = true;
+	slot.lastUsedFrame = frameID;
+	tileMap.emplace(key, best);
+	return best;
+}
+
+
+bool App::recordTileCacheFrame(vk::Image canvas, vk::Extent2D windowSize)
+{
+	// tile level of the pixel size nearest to the pixel size of the view
+	// (tiles are scaled by up to sqrt(2) when blitted)
+	int tileLevel = int(lround(log2(tileBasePixelSize / valueGradient)));
+	double tilePixelSize = ldexp(tileBasePixelSize, -tileLevel);
+	auto tileExtent = [](int level) { return tileSize * ldexp(tileBasePixelSize, -level); };
+
+	// visible tiles
+	double viewX0 = centerX.toDouble() - windowSize.width/2. * valueGradient;
+	double viewY0 = centerY.toDouble() - windowSize.height/2. * valueGradient;
+	double viewX1 = viewX0 + windowSize.width * valueGradient;
+	double viewY1 = viewY0 + windowSize.height * valueGradient;
+	double e = tileExtent(tileLevel);
+	if(max({ fabs(viewX0), fabs(viewX1), fabs(viewY0), fabs(viewY1) }) / e > 0x1p52)
+		return false;
+	int64_t tileX0 = int64_t(floor(viewX0 / e));
+	int64_t tileY0 = int64_t(floor(viewY0 / e));
+	int64_t tileX1 = int64_t(ceil(viewX1 / e)) - 1;
+	int64_t tileY1 = int64_t(ceil(viewY1 / e)) - 1;
+	if(size_t((tileX1 - tileX0 + 1) * (tileY1 - tileY0 + 1)) > tileSlots.size() / 2) {
+		if(!tileBudgetWarningPrinted) {
+			cout << "Tile cache budget is too small for the window. Rendering without the cache." << endl;
+			tileBudgetWarningPrinted = true;
+		}
+		return false;
+	}
+
+	// blit of a part of the cached tile into the canvas
+	// (the part is given by the rectangle in fractal coordinates; the canvas pixels are computed
+	// by the same rounding for all tiles, so the neighbour tiles leave no gaps)
+	const vk::ImageSubresourceLayers canvasLayers(
+		vk::ImageAspectFlagBits::eColor,  // aspectMask
+		0,  // mipLevel
+		0,  // baseArrayLayer
+		1   // layerCount
+	);
+	vector<vk::ImageBlit> blits;
+	auto addBlit =
+		[&](size_t slot, int level, int64_t x, int64_t y, double x0, double y0, double x1, double y1)
+		{
+			array<vk::Offset3D,2> dst = {
+				vk::Offset3D(int32_t(lround((x0 - viewX0) / valueGradient)), int32_t(lround((y0 - viewY0) / valueGradient)), 0),
+				vk::Offset3D(int32_t(lround((x1 - viewX0) / valueGradient)), int32_t(lround((y1 - viewY0) / valueGradient)), 1),
+			};
+			if(dst[0].x >= dst[1].x || dst[0].y >= dst[1].y)
+				return;
+			double e = tileExtent(level);
+			double scale = tileSize / e;
+			array<vk::Offset3D,2> src = {
+				vk::Offset3D(int32_t(lround((x0 - x*e) * scale)), int32_t(lround((y0 - y*e) * scale)), 0),
+				vk::Offset3D(int32_t(lround((x1 - x*e) * scale)), int32_t(lround((y1 - y*e) * scale)), 1),
+			};
+			src[0].x = clamp(src[0].x, 0, int32_t(tileSize) - 1);
+			src[0].y = clamp(src[0].y, 0, int32_t(tileSize) - 1);
+			src[1].x = clamp(src[1].x, src[0].x + 1, int32_t(tileSize));
+			src[1].y = clamp(src[1].y, src[0].y + 1, int32_t(tileSize));
+			blits.emplace_back(
+				vk::ImageSubresourceLayers(  // srcSubresource
+					vk::ImageAspectFlagBits::eColor,  // aspectMask
+					0,  // mipLevel
+					uint32_t(slot),  // baseArrayLayer
+					1   // layerCount
+				),
+				src,  // srcOffsets
+				canvasLayers,  // dstSubresource
+				dst  // dstOffsets
+			);
+		};
+
+	// look up the tiles and render the missing ones
+	// (after maxTilesPerFrame rendered tiles, missing tiles are substituted by a part of a cached coarser tile
+	// if there is any, and the following frame continues rendering;
+	// all the tiles are of the same level, so they share the iteration limit and the pipeline variant)
+	uint32_t tileMaxIter = iterationLimit(tilePixelSize);
+	size_t numRendered = 0;
+	tileFrameIncomplete = false;
+	for(int64_t y=tileY0; y<=tileY1; y++)
+		for(int64_t x=tileX0; x<=tileX1; x++) {
+
+			// visible part of the tile
+			double x0 = max(x*e, viewX0);
+			double y0 = max(y*e, viewY0);
+			double x1 = min((x+1)*e, viewX1);
+			double y1 = min((y+1)*e, viewY1);
+
+			// cached tile
+			TileKey key{ tileLevel, x, y, { constantParameter[0], constantParameter[1] }, viewPlane, activePrecision,
+			             coloringMode };
+			auto it = tileMap.find(key);
+			if(it != tileMap.end()) {
+				tileHits++;
+				tileSlots[it->second].lastUsedFrame = frameID;
+				addBlit(it->second, tileLevel, x, y, x0, y0, x1, y1);
+				continue;
+			}
+			tileMisses++;
+
+			// substitute by coarser tile
+			if(numRendered >= maxTilesPerFrame) {
+				bool found = false;
+				for(int d=1; d<=maxTileAncestorDepth && !found; d++) {
+					TileKey k = key;
+					k.level = tileLevel - d;
+					k.x = int64_t(floor(ldexp(double(x), -d)));
+					k.y = int64_t(floor(ldexp(double(y), -d)));
+					auto it = tileMap.find(k);
+					if(it != tileMap.end()) {
+						tileSlots[it->second].lastUsedFrame = frameID;
+						addBlit(it->second, k.level, k.x, k.y, x0, y0, x1, y1);
+						found = true;
+					}
+				}
+				if(found) {
+					tileFrameIncomplete = true;
+					continue;
+				}
+			}
+
+			// render the tile
+			size_t slot = allocateTileSlot(key);
+			if(numRendered == 0)
+				commandBuffer.bindPipeline(
+					vk::PipelineBindPoint::eGraphics,
+					selectPipeline(
+						(activePrecision == Precision::Df64) ? FragmentShader::Df64 :
+						(activePrecision == Precision::Fp64) ? FragmentShader::Fp64 : FragmentShader::Fp32,
+						tileMaxIter
+					)
+				);
+			commandBuffer.beginRenderPass(
+				vk::RenderPassBeginInfo(
+					tileRenderPass,  // renderPass
+					tileFramebuffers[slot],  // framebuffer
+					vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(tileSize, tileSize)),  // renderArea
+					0,  // clearValueCount
+					nullptr  // pClearValues
+				),
+				vk::SubpassContents::eInline
+			);
+			commandBuffer.setViewport(0, vk::Viewport(0.f, 0.f, float(tileSize), float(tileSize), 0.f, 1.f));
+			commandBuffer.setScissor(0, vk::Rect2D(vk::Offset2D(0, 0), vk::Extent2D(tileSize, tileSize)));
+			unsigned numLimbs = FixedPoint::limbsForResolution(tilePixelSize);
+			pushFractalConstants(
+				FixedPoint::fromDouble((x + 0.5) * e, numLimbs),  // viewCenterX
+				FixedPoint::fromDouble((y + 0.5) * e, numLimbs),  // viewCenterY
+				tilePixelSize,  // pixelSize
+				tileSize/2.f, tileSize/2.f,  // centerPixelX, centerPixelY
+				vk::Extent2D(tileSize, tileSize),  // viewportExtent
+				tileMaxIter,  // maxIter
+				false  // perturbation
+			);
+			commandBuffer.draw(4, 1, 0, uint32_t(frameID));
+			commandBuffer.endRenderPass();
+			numRendered++;
+			fpsRenderedPixels += double(tileSize) * tileSize;
+			addBlit(slot, tileLevel, x, y, x0, y0, x1, y1);
+		}
+
+	// blit the tiles into the canvas
+	// (tile render pass dependency makes the tiles visible to the transfer;
+	// the canvas is left in TransferSrcOptimal layout as after the canvas render pass)
+	const vk::ImageSubresourceRange colorRange(
+		vk::ImageAspectFlagBits::eColor,  // aspectMask
+		0,  // baseMipLevel
+		1,  // levelCount
+		0,  // baseArrayLayer
+		1   // layerCount
+	);
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+		vk::PipelineStageFlagBits::eTransfer,  // dstStageMask
+		vk::DependencyFlags(),  // dependencyFlags
+		nullptr,  // memoryBarriers
+		nullptr,  // bufferMemoryBarriers
+		vk::ImageMemoryBarrier{  // imageMemoryBarriers
+			vk::AccessFlags(),  // srcAccessMask
+			vk::AccessFlagBits::eTransferWrite,  // dstAccessMask
+			vk::ImageLayout::eUndefined,  // oldLayout
+			vk::ImageLayout::eTransferDstOptimal,  // newLayout
+			VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+			VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+			canvas,  // image
+			colorRange  // subresourceRange
+		}
+	);
+	commandBuffer.blitImage(
+		tileAtlas, vk::ImageLayout::eTransferSrcOptimal,  // srcImage + srcImageLayout
+		canvas, vk::ImageLayout::eTransferDstOptimal,  // dstImage + dstImageLayout
+		blits,  // regions
+		tileFilter  // filter
+	);
+	commandBuffer.pipelineBarrier(
+		vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+		vk::PipelineStageFlagBits::eTransfer,  // dstStageMask
+		vk::DependencyFlags(),  // dependencyFlags
+		nullptr,  // memoryBarriers
+		nullptr,  // bufferMemoryBarriers
+		vk::ImageMemoryBarrier{  // imageMemoryBarriers
+			vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+			vk::AccessFlagBits::eTransferRead,  // dstAccessMask
+			vk::ImageLayout::eTransferDstOptimal,  // oldLayout
+			vk::ImageLayout::eTransferSrcOptimal,  // newLayout
+			VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+			VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+			canvas,  // image
+			colorRange  // subresourceRange
+		}
+	);
+	return true;
+}
+
+
+bool App::usePerturbation() const
+{
+	// perturbation shader supports only the c plane with zero initial z,
+	// so the other views always use the regular pipeline
+	if(viewPlane != 0 || constantParameter[0] != 0.f || constantParameter[1] != 0.f)
+		return false;
+
+	switch(perturbationMode) {
+	case PerturbationMode::Always: return true;
+	case PerturbationMode::Never:  return false;
+	default: return !isPrecise(activePrecision);
+	}
+}
+
+
+uint32_t App::iterationLimit(double pixelSize)
+{
+	// iteration limit grows with the zoom, as the deep zooms need more iterations to show the details;
+	// it is rounded up to multiple of 256, so the reference orbit is not recomputed on each zoom step;
+	// the zoom is relative to 1024 pixels over the whole set, not to the window size,
+	// so the cached tiles of the same level get the same limit
+	double zoom = 4. / (pixelSize * 1024);
+	uint32_t n = 256 + uint32_t(max(log2(zoom), 0.) * 24);
+	return (n + 255) & ~uint32_t(255);
+}
+
+
+// countIterations - iterates the point in the same way as the shaders do
+// (the number of performed iterations is returned, so the interior points cost
+// the iterations done before their early-out)
+static uint32_t countIterations(double cx, double cy, double zx, double zy, uint32_t maxIter,
+                                bool interiorTests, double periodEpsilon)
+{
+	if(interiorTests) {
+		double x = cx - 0.25;
+		double q = x*x + cy*cy;
+		if(q*(q + x) <= 0.25*cy*cy || (cx+1.)*(cx+1.) + cy*cy <= 0.0625)
+			return 0;
+	}
+	double savedX = zx;
+	double savedY = zy;
+	uint32_t periodLength = 8;
+	uint32_t periodCounter = 0;
+	for(uint32_t i=0; i<maxIter; i++) {
+		double x = zx*zx - zy*zy + cx;
+		zy = 2.*zx*zy + cy;
+		zx = x;
+		if(zx*zx + zy*zy >= 4.)
+			return i+1;
+		if(fabs(zx - savedX) + fabs(zy - savedY) < periodEpsilon)
+			return i+1;
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			savedX = zx;
+			savedY = zy;
+		}
+	}
+	return maxIter;
+}
+
+
+void App::printIterationEstimate()
+{
+	// skip unchanged view
+	if(valueGradient == estimatedGradient &&
+	   (centerX - estimatedCenterX).toDouble() == 0. && (centerY - estimatedCenterY).toDouble() == 0.)
+		return;
+	estimatedGradient = valueGradient;
+	estimatedCenterX = centerX;
+	estimatedCenterY = centerY;
+
+	// iterate grid of samples over the view
+	// (before: fixed limit of 255 without early-outs, after: the current limit with interior tests
+	// and periodicity check)
+	constexpr const unsigned n = 64;
+	vk::Extent2D windowSize = window.surfaceExtent();
+	double x0 = centerX.toDouble() - windowSize.width/2. * valueGradient;
+	double y0 = centerY.toDouble() - windowSize.height/2. * valueGradient;
+	uint32_t maxIter = iterationLimit(valueGradient);
+	bool interiorTests = viewPlane == 0 && constantParameter[0] == 0.f && constantParameter[1] == 0.f;
+	double before = 0.;
+	double after = 0.;
+	for(unsigned j=0; j<n; j++)
+		for(unsigned i=0; i<n; i++) {
+			double x = x0 + (i + 0.5) / n * windowSize.width * valueGradient;
+			double y = y0 + (j + 0.5) / n * windowSize.height * valueGradient;
+			double cx = viewPlane == 0 ? x : constantParameter[0];
+			double cy = viewPlane == 0 ? y : constantParameter[1];
+			double zx = viewPlane == 0 ? constantParameter[0] : x;
+			double zy = viewPlane == 0 ? constantParameter[1] : y;
+			before += countIterations(cx, cy, zx, zy, 255, false, 0.);
+			after += countIterations(cx, cy, zx, zy, maxIter, interiorTests, valueGradient * 1e-3);
+		}
+	cout << "Iterations per pixel (estimate from " << n << "x" << n << " samples): "
+	     << before / (n*n) << " with fixed limit of 255, "
+	     << after / (n*n) << " with limit of " << maxIter << " and interior tests" << endl;
+}
+
+
+void App::updateReferenceOrbit()
+{
+	// reuse the current reference orbit if possible
+	// (it must have enough precision and iterations, and the reference point must not be far
+	// from the view, otherwise the float deltas lose their precision)
+	vk::Extent2D windowSize = window.surfaceExtent();
+	unsigned numLimbs = FixedPoint::limbsForResolution(valueGradient);
+	uint32_t maxIter = iterationLimit(valueGradient);
+	if(referenceValid && referenceX.numFractionalLimbs() >= numLimbs && referenceMaxIter == maxIter &&
+	   fabs((referenceX - centerX).toDouble()) <= windowSize.width * valueGradient &&
+	   fabs((referenceY - centerY).toDouble()) <= windowSize.height * valueGradient)
+		return;
+
+	// compute reference orbit
+	// (the view center is tried first; if its orbit escapes early, the points around it are tried
+	// and the longest orbit is used, as the short orbit causes frequent rebasing)
+	auto startTime = chrono::high_resolution_clock::now();
+	constexpr const array<array<double,2>,9> candidates = {{
+		{ 0., 0. }, { -0.25, -0.25 }, { 0.25, -0.25 }, { -0.25, 0.25 }, { 0.25, 0.25 },
+		{ 0., -0.25 }, { 0., 0.25 }, { -0.25, 0. }, { 0.25, 0. },
+	}};
+	vector<float> orbit, bestOrbit;
+	for(const array<double,2>& candidate : candidates) {
+
+		FixedPoint cx = centerX.withPrecision(numLimbs) +
+			FixedPoint::fromDouble(candidate[0] * windowSize.width * valueGradient, numLimbs);
+		FixedPoint cy = centerY.withPrecision(numLimbs) +
+			FixedPoint::fromDouble(candidate[1] * windowSize.height * valueGradient, numLimbs);
+
+		// iterate z = z^2 + c
+		orbit.clear();
+		orbit.reserve(size_t(maxIter+1) * 2);
+		orbit.push_back(0.f);
+		orbit.push_back(0.f);
+		FixedPoint zx(numLimbs), zy(numLimbs);
+		for(uint32_t i=0; i<maxIter; i++) {
+			FixedPoint xy = zx * zy;
+			zx = zx*zx - zy*zy + cx;
+			zy = xy + xy + cy;
+			double x = zx.toDouble();
+			double y = zy.toDouble();
+			orbit.push_back(float(x));
+			orbit.push_back(float(y));
+			if(x*x + y*y >= 4.)
+				break;
+		}
+
+		if(orbit.size() > bestOrbit.size()) {
+			swap(orbit, bestOrbit);
+			referenceX = cx;
+			referenceY = cy;
+		}
+		if(bestOrbit.size() == size_t(maxIter+1) * 2)
+			break;
+	}
+	orbitLength = uint32_t(bestOrbit.size() / 2);
+	referenceMaxIter = maxIter;
+	referenceValid = true;
+
+	// reallocate the buffer if needed
+	if(orbitLength > orbitCapacity) {
+
+		device.destroy(orbitBuffer);
+		device.free(orbitMemory);
+		orbitBuffer = nullptr;
+		orbitMemory = nullptr;
+		orbitCapacity = max(size_t(orbitLength), orbitCapacity*2);
+
+		orbitBuffer =
+			device.createBuffer(
+				vk::BufferCreateInfo(
+					vk::BufferCreateFlags(),  // flags
+					orbitCapacity * 2 * sizeof(float),  // size
+					vk::BufferUsageFlagBits::eStorageBuffer,  // usage
+					vk::SharingMode::eExclusive,  // sharingMode
+					0,  // queueFamilyIndexCount
+					nullptr  // pQueueFamilyIndices
+				)
+			);
+
+		// allocate host visible memory
+		vk::MemoryRequirements memoryRequirements = device.getBufferMemoryRequirements(orbitBuffer);
+		vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+		uint32_t memoryTypeIndex = UINT32_MAX;
+		for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+			if(memoryRequirements.memoryTypeBits & (1<<i))
+				if((memoryProperties.memoryTypes[i].propertyFlags &
+				    (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent)) ==
+				   (vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent))
+				{
+					memoryTypeIndex = i;
+					break;
+				}
+		if(memoryTypeIndex == UINT32_MAX)
+			throw runtime_error("No suitable memory type found for the reference orbit buffer.");
+		orbitMemory =
+			device.allocateMemory(
+				vk::MemoryAllocateInfo(
+					memoryRequirements.size,  // allocationSize
+					memoryTypeIndex           // memoryTypeIndex
+				)
+			);
+		device.bindBufferMemory(
+			orbitBuffer,  // buffer
+			orbitMemory,  // memory
+			0             // memoryOffset
+		);
+		orbitData = reinterpret_cast<float*>(device.mapMemory(orbitMemory, 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+
+		// update descriptor set
+		device.updateDescriptorSets(
+			vk::WriteDescriptorSet(  // descriptorWrites
+				descriptorSet,  // dstSet
+				0,  // dstBinding
+				0,  // dstArrayElement
+				1,  // descriptorCount
+				vk::DescriptorType::eStorageBuffer,  // descriptorType
+				nullptr,  // pImageInfo
+				&(const vk::DescriptorBufferInfo&)vk::DescriptorBufferInfo(  // pBufferInfo
+					orbitBuffer,  // buffer
+					0,  // offset
+					VK_WHOLE_SIZE  // range
+				),
+				nullptr  // pTexelBufferView
+			),
+			nullptr  // descriptorCopies
+		);
+	}
+
+	// upload the orbit
+	memcpy(orbitData, bestOrbit.data(), bestOrbit.size() * sizeof(float));
+
+	double dt = chrono::duration<double>(chrono::high_resolution_clock::now() - startTime).count();
+	cout << "Reference orbit: " << orbitLength-1 << " iterations of " << maxIter << ", "
+	     << numLimbs*32 << " bits of precision, computed in " << dt*1000 << "ms" << endl;
+}
+
+
+void App::frame(VulkanWindow&)
+{
+	StartupProfiler::Scope profilerScope(startupProfiler, "frame");
+	cout << "x" << flush;
+
+	// wait for previous frame rendering work
+	// if still not finished
+	startupProfiler.phase("wait for the previous frame");
+	vk::Result r =
+		device.waitForFences(
+			renderFinishedFence,  // fences
+			VK_TRUE,  // waitAll
+			uint64_t(3e9)  // timeout
+		);
+	if(r != vk::Result::eSuccess) {
+		if(r == vk::Result::eTimeout)
+			throw runtime_error("GPU timeout. Task is probably hanging on GPU.");
+		throw runtime_error("Vulkan error: vkWaitForFences failed with error " + to_string(r) + ".");
+	}
+	device.resetFences(renderFinishedFence);
+
+	// read timestamps of the previous frame
+	if(timestampsPending) {
+		array<uint64_t,2> timestamps;
+		r =
+			device.getQueryPoolResults(
+				timestampPool,  // queryPool
+				0,  // firstQuery
+				2,  // queryCount
+				sizeof(timestamps),  // dataSize
+				timestamps.data(),  // pData
+				sizeof(uint64_t),  // stride
+				vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait  // flags
+			);
+		if(r != vk::Result::eSuccess)
+			throw runtime_error("Vulkan error: vkGetQueryPoolResults failed with error " + to_string(r) + ".");
+		double t = double((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod_ns * 1e-9;
+		fpsGpuTime += t;
+		fpsGpuNumFrames++;
+		if(timedCalibrationSample && timedTier != ~size_t(0)) {
+			tierTimings[timedTier].gpuTime += t;
+			tierTimings[timedTier].numSamples++;
+		}
+		if(timedFullFrame)
+			fullFrameGpuTime = t;
+		if(timedVariant) {
+			timedVariant->gpuTime += t;
+			timedVariant->numSamples++;
+		}
+		timestampsPending = false;
+	}
+
+	// take over the pipelines built by the build thread
+	// (the previous frame is finished, so the fast-linked pipelines it used can be destroyed)
+	collectBuiltPipelines();
+
+	// select precision tier
+	// (calibration renders warm-up and measured frames by each tier)
+	startupProfiler.phase("view update");
+	bool perturbation = false;
+	if(calibrationFrame != ~size_t(0)) {
+		constexpr size_t framesPerTier = calibrationWarmUpFrames + calibrationMeasuredFrames;
+		if(calibrationFrame < calibrationTiers.size() * framesPerTier)
+			activePrecision = calibrationTiers[calibrationFrame / framesPerTier];
+		else {
+			cout << "\nPrecision tiers:" << endl;
+			for(Precision p : calibrationTiers) {
+				const TierTiming& t = tierTimings[size_t(p)];
+				cout << "   " << precisionName(p) << ": " << (t.numSamples ? t.gpuTime / t.numSamples * 1000 : 0.)
+				     << "ms" << endl;
+			}
+			calibrationFrame = ~size_t(0);
+		}
+	}
+	if(calibrationFrame == ~size_t(0)) {
+		Precision p = selectPrecision();
+		perturbation = usePerturbation();
+		if(p != activePrecision || perturbation != perturbationActive || frameID == ~size_t(0)) {
+			activePrecision = p;
+			perturbationActive = perturbation;
+			cout << "Using " << (perturbation ? "perturbation" : precisionName(activePrecision)) << endl;
+		}
+	}
+
+	// update reference orbit of the perturbation path
+	// (the previous frame finished, so the orbit buffer is not in use)
+	if(perturbation)
+		updateReferenceOrbit();
+
+	// tile cache
+	// (the frame is composed of the cached tiles if possible; perturbation path does not use the cache)
+	bool tileCandidate = tileCacheBudget != 0 && !perturbation && calibrationFrame == ~size_t(0);
+
+	// scroll reuse
+	// (if only the view center moved by whole number of pixels since the previous full resolution frame,
+	// its still valid region is copied and only the newly exposed strips are rendered;
+	// everything else, including zoom, resize and calibration, causes full redraw)
+	vk::Extent2D windowSize = window.surfaceExtent();
+	uint32_t maxIter = perturbation ? referenceMaxIter : iterationLimit(valueGradient);
+	int32_t shiftX = 0;
+	int32_t shiftY = 0;
+	bool wholePixelShift = false;
+	if(scrollReuseEnabled && !tileCandidate && canvasContent.valid && calibrationFrame == ~size_t(0) &&
+	   canvasContent.valueGradient == valueGradient && canvasContent.precision == activePrecision &&
+	   canvasContent.perturbation == perturbation && canvasContent.maxIter == maxIter &&
+	   canvasContent.coloringMode == coloringMode)
+	{
+		double sx = (canvasContent.centerX - centerX).toDouble() / valueGradient;
+		double sy = (canvasContent.centerY - centerY).toDouble() / valueGradient;
+		if(fabs(sx) < windowSize.width && fabs(sy) < windowSize.height) {
+			shiftX = int32_t(lround(sx));
+			shiftY = int32_t(lround(sy));
+			wholePixelShift = fabs(sx - shiftX) < 1e-3 && fabs(sy - shiftY) < 1e-3;
+		}
+	}
+	bool reuse = wholePixelShift && canvasContent.level == 0;
+
+	// progressive refinement
+	// (unchanged view of reduced resolution is refined by one level,
+	// full redraw of the changed view starts at the level that fits into the frame time budget)
+	uint32_t level = 0;
+	if(progressiveEnabled && !reuse && !tileCandidate && calibrationFrame == ~size_t(0)) {
+		if(wholePixelShift && shiftX == 0 && shiftY == 0)
+			level = canvasContent.level - 1;
+		else
+			level = previewLevel();
+	}
+	uint32_t blockSize = 1 << level;
+	vk::Extent2D levelExtent((windowSize.width + blockSize - 1) / blockSize,
+	                         (windowSize.height + blockSize - 1) / blockSize);
+
+	array<vk::Rect2D,2> renderRects;
+	uint32_t numRenderRects = 0;
+	uint32_t copyWidth = windowSize.width - abs(shiftX);
+	uint32_t copyHeight = windowSize.height - abs(shiftY);
+	if(reuse) {
+		// vertical strip of the full height and horizontal strip over the copied columns
+		if(shiftX != 0)
+			renderRects[numRenderRects++] =
+				vk::Rect2D(vk::Offset2D(shiftX>0 ? 0 : int32_t(copyWidth), 0),
+				           vk::Extent2D(abs(shiftX), windowSize.height));
+		if(shiftY != 0)
+			renderRects[numRenderRects++] =
+				vk::Rect2D(vk::Offset2D(max(shiftX, 0), shiftY>0 ? 0 : int32_t(copyHeight)),
+				           vk::Extent2D(copyWidth, abs(shiftY)));
+	}
+	else
+		renderRects[numRenderRects++] = vk::Rect2D(vk::Offset2D(0, 0), levelExtent);
+	fpsTotalPixels += double(windowSize.width) * windowSize.height;
+
+	// increment frame counter
+	frameID++;
+
+	// measure FPS
+	fpsNumFrames++;
+	if(fpsNumFrames == 0)
+		fpsStartTime = chrono::high_resolution_clock::now();
+	else {
+		auto t = chrono::high_resolution_clock::now();
 		auto dt = t - fpsStartTime;
 		if(dt >= chrono::seconds(2)) {
-			cout << "FPS: " << fpsNumFrames/chrono::duration<double>(dt).count() << endl;
+			cout << "FPS: " << fpsNumFrames/chrono::duration<double>(dt).count();
+			if(fpsGpuNumFrames != 0)
+				cout << ", GPU time: " << fpsGpuTime / fpsGpuNumFrames * 1000 << "ms";
+			cout << ", rendered pixels: " << fpsRenderedPixels / fpsTotalPixels * 100 << "%";
+			if(tileCacheBudget != 0) {
+				cout << ", tile cache hit rate: ";
+				if(tileHits + tileMisses != 0)
+					cout << double(tileHits) / (tileHits + tileMisses) * 100 << "%";
+				else
+					cout << "-";
+				cout << ", tiles: " << numUsedTileSlots << "/" << tileSlots.size()
+				     << " (" << double(numUsedTileSlots * tileSlotSize) / (1024 * 1024) << " MiB of "
+				     << double(tileSlots.size() * tileSlotSize) / (1024 * 1024) << " MiB)";
+				tileHits = 0;
+				tileMisses = 0;
+			}
+			cout << endl;
+			if(!perturbationActive)
+				printIterationEstimate();
 			fpsNumFrames = 0;
+			fpsGpuTime = 0.;
+			fpsGpuNumFrames = 0;
+			fpsRenderedPixels = 0.;
+			fpsTotalPixels = 0.;
 			fpsStartTime = t;
 		}
 	}
 
 	// acquire image
+	startupProfiler.phase("acquire image");
 	uint32_t imageIndex;
 	r =
 		device.acquireNextImageKHR(
@@ -762,74 +3012,288 @@ void App::frame(VulkanWindow&)
 	}
 
 	// record command buffer
+	startupProfiler.phase("record command buffer");
 	commandBuffer.begin(
 		vk::CommandBufferBeginInfo(
 			vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
 			nullptr  // pInheritanceInfo
 		)
 	);
-	commandBuffer.beginRenderPass(
-		vk::RenderPassBeginInfo(
-			renderPass,  // renderPass
-			framebuffers[imageIndex],  // framebuffer
-			vk::Rect2D(vk::Offset2D(0, 0), window.surfaceExtent()),  // renderArea
-			1,  // clearValueCount
-			&(const vk::ClearValue&)vk::ClearValue(  // pClearValues
-				vk::ClearColorValue(array<float, 4>{0.0f, 0.0f, 0.0f, 1.f})
-			)
-		),
-		vk::SubpassContents::eInline
+	if(timestampPool) {
+		commandBuffer.resetQueryPool(timestampPool, 0, 2);
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampPool, 0);
+	}
+	const vk::ImageSubresourceRange colorRange(
+		vk::ImageAspectFlagBits::eColor,  // aspectMask
+		0,  // baseMipLevel
+		1,  // levelCount
+		0,  // baseArrayLayer
+		1   // layerCount
+	);
+	const vk::ImageSubresourceLayers colorLayers(
+		vk::ImageAspectFlagBits::eColor,  // aspectMask
+		0,  // mipLevel
+		0,  // baseArrayLayer
+		1   // layerCount
 	);
+	size_t targetCanvas = 1 - canvasIndex;
+	frameVariant = nullptr;
+	bool tilePath = tileCandidate && recordTileCacheFrame(canvasImages[targetCanvas], windowSize);
+	if(!tilePath) {
+
+		for(uint32_t i=0; i<numRenderRects; i++)
+			fpsRenderedPixels += double(renderRects[i].extent.width) * renderRects[i].extent.height;
+
+		if(scrollReuseEnabled) {
+
+			// transition the target canvas
+			// (its previous content is discarded; the source canvas is in TransferSrcOptimal
+			// layout since the previous frame)
+			commandBuffer.pipelineBarrier(
+				vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+				reuse ? vk::PipelineStageFlagBits::eTransfer : vk::PipelineStageFlagBits::eColorAttachmentOutput,  // dstStageMask
+				vk::DependencyFlags(),  // dependencyFlags
+				nullptr,  // memoryBarriers
+				nullptr,  // bufferMemoryBarriers
+				vk::ImageMemoryBarrier{  // imageMemoryBarriers
+					vk::AccessFlags(),  // srcAccessMask
+					reuse ? vk::AccessFlagBits::eTransferWrite  // dstAccessMask
+					      : vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,
+					vk::ImageLayout::eUndefined,  // oldLayout
+					reuse ? vk::ImageLayout::eTransferDstOptimal : vk::ImageLayout::eColorAttachmentOptimal,  // newLayout
+					VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+					VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+					canvasImages[targetCanvas],  // image
+					colorRange  // subresourceRange
+				}
+			);
+
+			// copy still valid region of the previous frame
+			if(reuse) {
+				if(copyWidth != 0 && copyHeight != 0)
+					commandBuffer.copyImage(
+						canvasImages[canvasIndex], vk::ImageLayout::eTransferSrcOptimal,  // srcImage + srcImageLayout
+						canvasImages[targetCanvas], vk::ImageLayout::eTransferDstOptimal,  // dstImage + dstImageLayout
+						vk::ImageCopy(  // regions
+							colorLayers,  // srcSubresource
+							vk::Offset3D(max(-shiftX, 0), max(-shiftY, 0), 0),  // srcOffset
+							colorLayers,  // dstSubresource
+							vk::Offset3D(max(shiftX, 0), max(shiftY, 0), 0),  // dstOffset
+							vk::Extent3D(copyWidth, copyHeight, 1)  // extent
+						)
+					);
+				commandBuffer.pipelineBarrier(
+					vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+					vk::PipelineStageFlagBits::eColorAttachmentOutput,  // dstStageMask
+					vk::DependencyFlags(),  // dependencyFlags
+					nullptr,  // memoryBarriers
+					nullptr,  // bufferMemoryBarriers
+					vk::ImageMemoryBarrier{  // imageMemoryBarriers
+						vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+						vk::AccessFlagBits::eColorAttachmentRead | vk::AccessFlagBits::eColorAttachmentWrite,  // dstAccessMask
+						vk::ImageLayout::eTransferDstOptimal,  // oldLayout
+						vk::ImageLayout::eColorAttachmentOptimal,  // newLayout
+						VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+						VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+						canvasImages[targetCanvas],  // image
+						colorRange  // subresourceRange
+					}
+				);
+			}
 
-	// push constants
-	struct PushData {
-		float juliaCoords[4];
-		int viewPlane;
-		int dummy;
-		float constantParameters[2];
-	};
-	commandBuffer.pushConstants(
-		pipelineLayout,  // layout
-		vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,  // stageFlags
-		0,  // offset
-		32,  // size
-		&(const PushData&)PushData{  // pValues
-			minX, minY, maxX, maxY,
-			0,
-			0,
-			0.f, 0.f,
+			commandBuffer.beginRenderPass(
+				vk::RenderPassBeginInfo(
+					canvasRenderPass,  // renderPass
+					canvasFramebuffers[targetCanvas],  // framebuffer
+					vk::Rect2D(vk::Offset2D(0, 0), windowSize),  // renderArea
+					0,  // clearValueCount
+					nullptr  // pClearValues
+				),
+				vk::SubpassContents::eInline
+			);
 		}
-	);
+		else
+			commandBuffer.beginRenderPass(
+				vk::RenderPassBeginInfo(
+					renderPass,  // renderPass
+					framebuffers[imageIndex],  // framebuffer
+					vk::Rect2D(vk::Offset2D(0, 0), windowSize),  // renderArea
+					1,  // clearValueCount
+					&(const vk::ClearValue&)vk::ClearValue(  // pClearValues
+						vk::ClearColorValue(array<float, 4>{0.0f, 0.0f, 0.0f, 1.f})
+					)
+				),
+				vk::SubpassContents::eInline
+			);
+
+		// push constants
+		// (reduced resolution frames use pixels of the block size)
+		pushFractalConstants(
+			centerX, centerY,  // viewCenterX, viewCenterY
+			valueGradient * blockSize,  // pixelSize
+			float(windowSize.width/2. / blockSize), float(windowSize.height/2. / blockSize),  // centerPixelX, centerPixelY
+			levelExtent,  // viewportExtent
+			maxIter,  // maxIter
+			perturbation  // perturbation
+		);
 
-	// rendering commands
-	commandBuffer.bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline);  // bind pipeline
-	commandBuffer.draw(  // draw single triangle
-		4,  // vertexCount
-		1,  // instanceCount
-		0,  // firstVertex
-		uint32_t(frameID)  // firstInstance
-	);
+		// rendering commands
+		if(perturbation) {
+			commandBuffer.bindDescriptorSets(
+				vk::PipelineBindPoint::eGraphics,  // pipelineBindPoint
+				pipelineLayout,  // layout
+				0,  // firstSet
+				descriptorSet,  // descriptorSets
+				nullptr  // dynamicOffsets
+			);
+			commandBuffer.bindPipeline(  // bind pipeline
+				vk::PipelineBindPoint::eGraphics,
+				selectPipeline(FragmentShader::Perturbation, maxIter)
+			);
+		}
+		else
+			commandBuffer.bindPipeline(  // bind pipeline
+				vk::PipelineBindPoint::eGraphics,
+				selectPipeline(
+					(activePrecision == Precision::Df64) ? FragmentShader::Df64 :
+					(activePrecision == Precision::Fp64) ? FragmentShader::Fp64 : FragmentShader::Fp32,
+					maxIter
+				)
+			);
+		commandBuffer.setViewport(
+			0,  // firstViewport
+			vk::Viewport(0.f, 0.f, float(levelExtent.width), float(levelExtent.height), 0.f, 1.f)  // viewports
+		);
+		for(uint32_t i=0; i<numRenderRects; i++) {
+			commandBuffer.setScissor(0, renderRects[i]);
+			commandBuffer.draw(  // draw single triangle
+				4,  // vertexCount
+				1,  // instanceCount
+				0,  // firstVertex
+				uint32_t(frameID)  // firstInstance
+			);
+		}
+
+		// end render pass
+		commandBuffer.endRenderPass();
+	}
+
+	// copy the canvas into the swapchain image
+	// (render pass dependency makes the canvas content visible to the transfer;
+	// reduced resolution content is upscaled by blit)
+	if(scrollReuseEnabled) {
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+			vk::PipelineStageFlagBits::eTransfer,  // dstStageMask
+			vk::DependencyFlags(),  // dependencyFlags
+			nullptr,  // memoryBarriers
+			nullptr,  // bufferMemoryBarriers
+			vk::ImageMemoryBarrier{  // imageMemoryBarriers
+				vk::AccessFlags(),  // srcAccessMask
+				vk::AccessFlagBits::eTransferWrite,  // dstAccessMask
+				vk::ImageLayout::eUndefined,  // oldLayout
+				vk::ImageLayout::eTransferDstOptimal,  // newLayout
+				VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+				VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+				swapchainImages[imageIndex],  // image
+				colorRange  // subresourceRange
+			}
+		);
+		if(level == 0)
+			commandBuffer.copyImage(
+				canvasImages[targetCanvas], vk::ImageLayout::eTransferSrcOptimal,  // srcImage + srcImageLayout
+				swapchainImages[imageIndex], vk::ImageLayout::eTransferDstOptimal,  // dstImage + dstImageLayout
+				vk::ImageCopy(  // regions
+					colorLayers,  // srcSubresource
+					vk::Offset3D(0, 0, 0),  // srcOffset
+					colorLayers,  // dstSubresource
+					vk::Offset3D(0, 0, 0),  // dstOffset
+					vk::Extent3D(windowSize.width, windowSize.height, 1)  // extent
+				)
+			);
+		else
+			commandBuffer.blitImage(
+				canvasImages[targetCanvas], vk::ImageLayout::eTransferSrcOptimal,  // srcImage + srcImageLayout
+				swapchainImages[imageIndex], vk::ImageLayout::eTransferDstOptimal,  // dstImage + dstImageLayout
+				vk::ImageBlit(  // regions
+					colorLayers,  // srcSubresource
+					array<vk::Offset3D,2>{  // srcOffsets
+						vk::Offset3D(0, 0, 0),
+						vk::Offset3D(int32_t(levelExtent.width), int32_t(levelExtent.height), 1),
+					},
+					colorLayers,  // dstSubresource
+					array<vk::Offset3D,2>{  // dstOffsets
+						vk::Offset3D(0, 0, 0),
+						vk::Offset3D(int32_t(windowSize.width), int32_t(windowSize.height), 1),
+					}
+				),
+				vk::Filter::eNearest  // filter
+			);
+		commandBuffer.pipelineBarrier(
+			vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+			vk::PipelineStageFlagBits::eBottomOfPipe,  // dstStageMask
+			vk::DependencyFlags(),  // dependencyFlags
+			nullptr,  // memoryBarriers
+			nullptr,  // bufferMemoryBarriers
+			vk::ImageMemoryBarrier{  // imageMemoryBarriers
+				vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+				vk::AccessFlags(),  // dstAccessMask
+				vk::ImageLayout::eTransferDstOptimal,  // oldLayout
+				vk::ImageLayout::ePresentSrcKHR,  // newLayout
+				VK_QUEUE_FAMILY_IGNORED,  // srcQueueFamilyIndex
+				VK_QUEUE_FAMILY_IGNORED,  // dstQueueFamilyIndex
+				swapchainImages[imageIndex],  // image
+				colorRange  // subresourceRange
+			}
+		);
+
+		// remember what the canvas contains
+		canvasIndex = targetCanvas;
+		canvasContent.valid = !tilePath;
+		canvasContent.centerX = centerX;
+		canvasContent.centerY = centerY;
+		canvasContent.valueGradient = valueGradient;
+		canvasContent.precision = activePrecision;
+		canvasContent.perturbation = perturbation;
+		canvasContent.maxIter = maxIter;
+		canvasContent.coloringMode = coloringMode;
+		canvasContent.level = level;
+	}
 
-	// end render pass and command buffer
-	commandBuffer.endRenderPass();
+	// end command buffer
+	if(timestampPool)
+		commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampPool, 1);
 	commandBuffer.end();
 
 	// submit frame
+	startupProfiler.phase("submit");
 	graphicsQueue.submit(
 		vk::ArrayProxy<const vk::SubmitInfo>(
 			1,
 			&(const vk::SubmitInfo&)vk::SubmitInfo(
 				1, &imageAvailableSemaphore,  // waitSemaphoreCount + pWaitSemaphores +
 				&(const vk::PipelineStageFlags&)vk::PipelineStageFlags(  // pWaitDstStageMask
-					vk::PipelineStageFlagBits::eColorAttachmentOutput),
+					scrollReuseEnabled ? vk::PipelineStageFlagBits::eTransfer
+					                   : vk::PipelineStageFlagBits::eColorAttachmentOutput),
 				1, &commandBuffer,  // commandBufferCount + pCommandBuffers
 				1, &renderFinishedSemaphore  // signalSemaphoreCount + pSignalSemaphores
 			)
 		),
 		renderFinishedFence  // fence
 	);
+	if(timestampPool) {
+		timestampsPending = true;
+		timedFullFrame = !reuse && level == 0 && !tilePath;
+		timedTier = perturbation ? ~size_t(0) : size_t(activePrecision);
+		timedVariant = frameVariant;
+		timedCalibrationSample = calibrationFrame != ~size_t(0) &&
+			calibrationFrame % (calibrationWarmUpFrames + calibrationMeasuredFrames) >= calibrationWarmUpFrames;
+	}
+	if(calibrationFrame != ~size_t(0))
+		calibrationFrame++;
 
 	// present
+	startupProfiler.phase("present");
 	r =
 		presentationQueue.presentKHR(
 			&(const vk::PresentInfoKHR&)vk::PresentInfoKHR(
@@ -849,8 +3313,36 @@ void App::frame(VulkanWindow&)
 			throw runtime_error("Vulkan error: vkQueuePresentKHR() failed with error " + to_string(r) + ".");
 	}
 
+	// finish startup profiling
+	// (the first presented frame ends the startup)
+	if(startupProfiler.recording()) {
+		startupProfiler.finish();
+		startupProfiler.printSummary();
+		// (failure to write the trace is reported only, so it does not end the application)
+		if(!startupTracePath.empty()) {
+			try {
+				startupProfiler.writeTrace(startupTracePath, appName);
+			} catch(exception& e) {
+				cout << "Failed to write startup trace: " << e.what() << endl;
+			}
+		}
+	}
+
+	// report resize latency
+	// (time from the swapchain recreation to the presentation of the first frame)
+	if(resizeMeasurementPending) {
+		resizeMeasurementPending = false;
+		cout << "Resize to first frame: "
+		     << chrono::duration<double>(chrono::high_resolution_clock::now() - resizeStartTime).count() * 1000
+		     << "ms" << endl;
+	}
+
 	// schedule next frame
-	if(frameUpdateMode != FrameUpdateMode::OnDemand)
+	// (calibration renders frames continuously, reduced resolution frames schedule their refinement,
+	// the frames with substituted tiles schedule rendering of the missing tiles
+	// and the pipeline variants being built are taken over by the next frame once they are ready)
+	if(frameUpdateMode != FrameUpdateMode::OnDemand || calibrationFrame != ~size_t(0) || level != 0 ||
+	   (tilePath && tileFrameIncomplete) || !requestedVariants.empty())
 		window.scheduleFrame();
 }
 
@@ -861,12 +3353,19 @@ void App::mouseMove(VulkanWindow&, const VulkanWindow::MouseState& s)
 	cout << "m(" << s.posX << "," << s.posY << ")" << flush;
 #endif
 
+	// pan by whole pixels
+	// (the remainder is kept for the next move, so the previous frame content can be reused)
 	if(s.buttons.test(VulkanWindow::MouseButton::Left)) {
-		vk::Extent2D windowSize = window.surfaceExtent();
-		float rx = (s.posX-s.relX) / windowSize.width;
-		float ry = (s.posY-s.relY) / windowSize.height;
-		setView(s.posX, s.posY, minX*(1.f-rx) + maxX*rx, minY*(1.f-ry) + maxY*ry);
-		window.scheduleFrame();
+		panRemainderX += s.relX;
+		panRemainderY += s.relY;
+		float dx = round(panRemainderX);
+		float dy = round(panRemainderY);
+		panRemainderX -= dx;
+		panRemainderY -= dy;
+		if(dx != 0.f || dy != 0.f) {
+			setView(-dx * valueGradient, -dy * valueGradient);
+			window.scheduleFrame();
+		}
 	}
 }
 
@@ -891,16 +3390,18 @@ void App::mouseWheel(VulkanWindow&, float wheelX, float wheelY, const VulkanWind
 {
 	cout << "w(" << wheelX << "," << wheelY << ")" << flush;
 
+	// zoom around the mouse pointer
+	// (the point under the mouse pointer stays in place, so the center moves by the difference of the pixel sizes)
 	vk::Extent2D windowSize = window.surfaceExtent();
-	float rx = s.posX / windowSize.width;
-	float ry = s.posY / windowSize.height;
-	valueGradient *= powf(0.9f, wheelY / 120);
-	setView(s.posX, s.posY, minX*(1.f-rx) + maxX*rx, minY*(1.f-ry) + maxY*ry);
+	double oldGradient = valueGradient;
+	valueGradient *= pow(0.9, wheelY / 120);
+	setView((s.posX - windowSize.width/2.) * (oldGradient - valueGradient),
+	        (s.posY - windowSize.height/2.) * (oldGradient - valueGradient));
 	window.scheduleFrame();
 }
 
 
-void App::key(VulkanWindow&, VulkanWindow::KeyState keyState, VulkanWindow::ScanCode scanCode)
+void App::key(VulkanWindow& window, VulkanWindow::KeyState keyState, VulkanWindow::ScanCode scanCode)
 {
 	if(keyState == VulkanWindow::KeyState::Pressed)
 		cout << "KeyDown";
@@ -908,6 +3409,22 @@ void App::key(VulkanWindow&, VulkanWindow::KeyState keyState, VulkanWindow::Scan
 		cout << "KeyUp";
 
 	cout << ", scanCode: " << uint16_t(scanCode) << endl;
+
+	if(keyState != VulkanWindow::KeyState::Pressed)
+		return;
+
+	// C key cycles the coloring modes
+	// (all the modes have their pipeline variants, so the switch costs no pipeline creation
+	// unless the specialized iteration limit was not used with the mode yet)
+	if(scanCode == VulkanWindow::ScanCode::C) {
+		coloringMode = (coloringMode + 1) % numColoringModes;
+		cout << "Coloring mode " << coloringMode << endl;
+		window.scheduleFrame();
+	}
+
+	// V key prints the pipeline variants and their timing
+	else if(scanCode == VulkanWindow::ScanCode::V)
+		printPipelineVariants();
 }
 
 
@@ -935,9 +3452,15 @@ int main(int argc, char* argv[])
 		app.window.setMouseButtonCallback(bind(&App::mouseButton, &app, placeholders::_1, placeholders::_2, placeholders::_3, placeholders::_4));
 		app.window.setMouseWheelCallback(bind(&App::mouseWheel, &app, placeholders::_1, placeholders::_2, placeholders::_3, placeholders::_4));
 		app.window.setKeyCallback(bind(&App::key, &app, placeholders::_1, placeholders::_2, placeholders::_3));
+		startupProfiler.phase("VulkanWindow::show");
 		app.window.show();
+		startupProfiler.phase("mainLoop up to the first frame");
 		app.window.mainLoop();
 
+		// save pipeline cache for the next run
+		app.pipelineCache.printStats();
+		app.pipelineCache.save();
+
 	// catch exceptions
 	} catch(vk::Error& e) {
 		cout << "Failed because of Vulkan exception: " << e.what() << endl;
@@ -0,0 +1,114 @@
+#version 450
+
+// push constants
+// (the first part is shared with shader.vert and shader.frag;
+// viewPlane and constantParameter are not used, as perturbation supports only the c plane
+// with zero initial z and the host selects the regular pipeline for the other views)
+layout(push_constant) uniform pushConstants {
+	layout(offset=0) vec4 juliaCoords;
+	layout(offset=16) int viewPlane;
+	layout(offset=24) vec2 constantParameter;
+	layout(offset=32) vec2 referencePixel;  // position of the reference point in framebuffer coordinates
+	layout(offset=40) float gradientMantissa;  // pixel size is gradientMantissa * 2^gradientExponent
+	layout(offset=44) int gradientExponent;
+	layout(offset=48) int orbitLength;  // number of values of the reference orbit
+	layout(offset=52) int maxIter;
+};
+
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop; coloringMode selects the palette)
+layout(constant_id = 0) const int specializedMaxIter = 0;
+layout(constant_id = 1) const int coloringMode = 0;  // 0 - hue gradient, 1 - hue bands, 2 - grayscale
+
+// reference orbit
+// (z values of the reference point computed on CPU in arbitrary precision and rounded to float)
+layout(std430, binding = 0) restrict readonly buffer ReferenceOrbit {
+	vec2 orbit[];
+};
+
+// output
+layout(location = 0) out vec4 outColor;
+
+
+// hsvToRgb - convert color given in HSV (Hue Saturation Value) into color given in RGB (Red Green Blue)
+vec3 hsvToRgb(vec3 hsv)
+{
+	vec3 c = clamp(abs(fract(vec3(hsv.x + 1, hsv.x + 2./3., hsv.x + 1./3.)) * 6 - 3) - 1, 0, 1);
+	return hsv.z * mix(vec3(1,1,1), c, hsv.y);
+}
+
+
+// iterationColor - color of the pixel of the given iteration count
+vec4 iterationColor(int i, int iterLimit)
+{
+	if(i == iterLimit)
+		return vec4(0,0,0,1);
+	if(coloringMode == 1)
+		return vec4(hsvToRgb(vec3(2./3. - float(i % 32) / 32., 1, 1)), 1);
+	// (fixed scale of 255 iterations, so the colors do not depend on iterLimit;
+	// the hue repeats every 255 iterations, the gray level saturates)
+	float l = float(i) / 255.;
+	if(coloringMode == 2)
+		return vec4(vec3(1. - min(l, 1.)), 1);
+	return vec4(hsvToRgb(vec3(2./3. - l, 1, 1)), 1);
+}
+
+
+vec2 complexMul(vec2 a, vec2 b)
+{
+	return vec2(a.x*b.x - a.y*b.y, a.x*b.y + a.y*b.x);
+}
+
+
+void main()
+{
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
+	// delta of c from the reference point
+	// (the deltas are kept scaled as ds * 2^e, because they are far below the float range at deep zooms)
+	vec2 dcs = (gl_FragCoord.xy - referencePixel) * gradientMantissa;
+	int ec = gradientExponent;
+	vec2 ds = vec2(0.0, 0.0);
+	int e = ec;
+
+	// iterate delta d of z from the reference orbit Z: d = 2*Z*d + d^2 + dc
+	int n = 0;
+	int i = 0;
+	for(; i<iterLimit; i++) {
+
+		ds = 2.*complexMul(orbit[n], ds) + ldexp(complexMul(ds, ds), ivec2(e)) + ldexp(dcs, ivec2(ec - e));
+		n++;
+
+		// keep scaled delta around one
+		float m = max(abs(ds.x), abs(ds.y));
+		if(m > 65536.0 || (m < 1.0/65536.0 && m != 0.0)) {
+			int k;
+			frexp(m, k);
+			ds = ldexp(ds, ivec2(-k));
+			e += k;
+		}
+
+		// escape test on the full value
+		vec2 d = ldexp(ds, ivec2(e));
+		vec2 z = orbit[n] + d;
+		float zz = dot(z, z);
+		if(zz >= 4.0)
+			break;
+
+		// glitch detection and rebasing
+		// (when z gets closer to zero than to the reference orbit, the delta loses its precision;
+		// z becomes the new delta against the beginning of the reference orbit,
+		// which is done also when the reference orbit ends)
+		if(zz < dot(d, d) || n == orbitLength-1) {
+			ds = z;
+			e = 0;
+			n = 0;
+		}
+	}
+
+	// assign color
+	outColor = iterationColor(i, iterLimit);
+}
@@ -0,0 +1,183 @@
+#version 450
+
+// push constants
+// (the first part is shared with shader.vert and shader.frag)
+layout(push_constant) uniform pushConstants {
+	layout(offset=0) vec4 juliaCoords;
+	layout(offset=16) int viewPlane;
+	layout(offset=24) vec2 constantParameter;
+	layout(offset=32) vec2 referencePixel;  // position of the view center in framebuffer coordinates
+	layout(offset=40) float gradientMantissa;  // pixel size is gradientMantissa * 2^gradientExponent
+	layout(offset=44) int gradientExponent;
+	layout(offset=52) int maxIter;  // iteration limit growing with the zoom
+	layout(offset=56) vec2 centerHi;  // view center as sum of centerHi and centerLo
+	layout(offset=64) vec2 centerLo;
+};
+
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop; coloringMode selects the palette)
+layout(constant_id = 0) const int specializedMaxIter = 0;
+layout(constant_id = 1) const int coloringMode = 0;  // 0 - hue gradient, 1 - hue bands, 2 - grayscale
+
+// output
+layout(location = 0) out vec4 outColor;
+
+
+// hsvToRgb - convert color given in HSV (Hue Saturation Value) into color given in RGB (Red Green Blue)
+vec3 hsvToRgb(vec3 hsv)
+{
+	vec3 c = clamp(abs(fract(vec3(hsv.x + 1, hsv.x + 2./3., hsv.x + 1./3.)) * 6 - 3) - 1, 0, 1);
+	return hsv.z * mix(vec3(1,1,1), c, hsv.y);
+}
+
+
+// iterationColor - color of the pixel of the given iteration count
+vec4 iterationColor(int i, int iterLimit)
+{
+	if(i == iterLimit)
+		return vec4(0,0,0,1);
+	if(coloringMode == 1)
+		return vec4(hsvToRgb(vec3(2./3. - float(i % 32) / 32., 1, 1)), 1);
+	// (fixed scale of 255 iterations, so the colors do not depend on iterLimit;
+	// the hue repeats every 255 iterations, the gray level saturates)
+	float l = float(i) / 255.;
+	if(coloringMode == 2)
+		return vec4(vec3(1. - min(l, 1.)), 1);
+	return vec4(hsvToRgb(vec3(2./3. - l, 1, 1)), 1);
+}
+
+
+// double-float arithmetic
+// (each number is stored as unevaluated sum of two floats, hi in x and lo in y,
+// giving about 48 bits of mantissa; precise qualifier prevents the compiler
+// from reassociating the operations that compute rounding errors)
+vec2 quickTwoSum(float a, float b)
+{
+	precise float s = a + b;
+	precise float e = b - (s - a);
+	return vec2(s, e);
+}
+
+vec2 twoSum(float a, float b)
+{
+	precise float s = a + b;
+	precise float v = s - a;
+	precise float e = (a - (s - v)) + (b - v);
+	return vec2(s, e);
+}
+
+// split - splits float into high and low halves of 12 bits each (Veltkamp split)
+vec2 split(float a)
+{
+	precise float t = 4097.0 * a;
+	precise float hi = t - (t - a);
+	precise float lo = a - hi;
+	return vec2(hi, lo);
+}
+
+// twoProd - exact product by Dekker's algorithm
+// (fma() is not guaranteed to be fused by Vulkan, so the error term is not computed by it)
+vec2 twoProd(float a, float b)
+{
+	precise float p = a * b;
+	vec2 as = split(a);
+	vec2 bs = split(b);
+	precise float e = ((as.x*bs.x - p) + as.x*bs.y + as.y*bs.x) + as.y*bs.y;
+	return vec2(p, e);
+}
+
+vec2 dfAdd(vec2 a, vec2 b)
+{
+	vec2 s = twoSum(a.x, b.x);
+	precise float e = s.y + a.y + b.y;
+	return quickTwoSum(s.x, e);
+}
+
+vec2 dfMul(vec2 a, vec2 b)
+{
+	vec2 p = twoProd(a.x, b.x);
+	precise float e = p.y + (a.x*b.y + a.y*b.x);
+	return quickTwoSum(p.x, e);
+}
+
+
+void main()
+{
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
+	// value of the pixel
+	// (the offset from the view center is small, so it is computed in float and added in df64)
+	float pixelSize = ldexp(gradientMantissa, gradientExponent);
+	vec2 offset = (gl_FragCoord.xy - referencePixel) * pixelSize;
+	vec2 vx = dfAdd(vec2(centerHi.x, centerLo.x), vec2(offset.x, 0.0));
+	vec2 vy = dfAdd(vec2(centerHi.y, centerLo.y), vec2(offset.y, 0.0));
+
+	// initialize z and c complex numbers
+	vec2 zx, zy, cx, cy;
+	if(viewPlane == 0) {
+		zx = vec2(constantParameter.x, 0.0);
+		zy = vec2(constantParameter.y, 0.0);
+		cx = vx;
+		cy = vy;
+	}
+	else {
+		zx = vx;
+		zy = vy;
+		cx = vec2(constantParameter.x, 0.0);
+		cy = vec2(constantParameter.y, 0.0);
+	}
+
+	// interior test
+	// (points of the main cardioid and of the period-2 bulb are inside the Mandelbrot set,
+	// so they are not iterated; it applies to the c plane with zero initial z only;
+	// the test is evaluated in df64, as deep zooms happen close to the cardioid boundary)
+	int i = 0;
+	if(viewPlane == 0 && constantParameter == vec2(0.0)) {
+		vec2 x = dfAdd(cx, vec2(-0.25, 0.0));
+		vec2 yy = dfMul(cy, cy);
+		vec2 q = dfAdd(dfMul(x, x), yy);
+		vec2 cardioid = dfAdd(dfMul(q, dfAdd(q, x)), -0.25*yy);
+		vec2 x1 = dfAdd(cx, vec2(1.0, 0.0));
+		vec2 bulb = dfAdd(dfAdd(dfMul(x1, x1), yy), vec2(-0.0625, 0.0));
+		if(cardioid.x <= 0.0 || bulb.x <= 0.0)
+			i = iterLimit;
+	}
+
+	// iterate z = z^2 + c
+	// (the squares of z are computed once and used by both the escape test and the next iteration;
+	// periodicity check: z returning close to the value saved after power-of-two iterations
+	// means attracting cycle, so the point is inside the set)
+	vec2 xx = dfMul(zx, zx);
+	vec2 yy = dfMul(zy, zy);
+	vec2 xy = dfMul(zx, zy);
+	float periodEpsilon = pixelSize * 1e-3;
+	vec2 zxSaved = zx;
+	vec2 zySaved = zy;
+	int periodLength = 8;
+	int periodCounter = 0;
+	for(; i<iterLimit; i++) {
+		zx = dfAdd(dfAdd(xx, -yy), cx);
+		zy = dfAdd(2.*xy, cy);
+		xx = dfMul(zx, zx);
+		yy = dfMul(zy, zy);
+		xy = dfMul(zx, zy);
+		if(xx.x + yy.x >= 4.0)
+			break;
+		if(abs(dfAdd(zx, -zxSaved).x) + abs(dfAdd(zy, -zySaved).x) < periodEpsilon) {
+			i = iterLimit;
+			break;
+		}
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			zxSaved = zx;
+			zySaved = zy;
+		}
+	}
+
+	// assign color
+	outColor = iterationColor(i, iterLimit);
+}
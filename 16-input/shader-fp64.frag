@@ -0,0 +1,108 @@
+#version 450
+
+// push constants
+// (the first part is shared with shader.vert and shader.frag)
+layout(push_constant) uniform pushConstants {
+	layout(offset=0) vec4 juliaCoords;
+	layout(offset=16) int viewPlane;
+	layout(offset=24) vec2 constantParameter;
+	layout(offset=32) vec2 referencePixel;  // position of the view center in framebuffer coordinates
+	layout(offset=40) float gradientMantissa;  // pixel size is gradientMantissa * 2^gradientExponent
+	layout(offset=44) int gradientExponent;
+	layout(offset=52) int maxIter;  // iteration limit growing with the zoom
+	layout(offset=80) dvec2 center;  // view center
+};
+
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop; coloringMode selects the palette)
+layout(constant_id = 0) const int specializedMaxIter = 0;
+layout(constant_id = 1) const int coloringMode = 0;  // 0 - hue gradient, 1 - hue bands, 2 - grayscale
+
+// output
+layout(location = 0) out vec4 outColor;
+
+
+// hsvToRgb - convert color given in HSV (Hue Saturation Value) into color given in RGB (Red Green Blue)
+vec3 hsvToRgb(vec3 hsv)
+{
+	vec3 c = clamp(abs(fract(vec3(hsv.x + 1, hsv.x + 2./3., hsv.x + 1./3.)) * 6 - 3) - 1, 0, 1);
+	return hsv.z * mix(vec3(1,1,1), c, hsv.y);
+}
+
+
+// iterationColor - color of the pixel of the given iteration count
+vec4 iterationColor(int i, int iterLimit)
+{
+	if(i == iterLimit)
+		return vec4(0,0,0,1);
+	if(coloringMode == 1)
+		return vec4(hsvToRgb(vec3(2./3. - float(i % 32) / 32., 1, 1)), 1);
+	// (fixed scale of 255 iterations, so the colors do not depend on iterLimit;
+	// the hue repeats every 255 iterations, the gray level saturates)
+	float l = float(i) / 255.;
+	if(coloringMode == 2)
+		return vec4(vec3(1. - min(l, 1.)), 1);
+	return vec4(hsvToRgb(vec3(2./3. - l, 1, 1)), 1);
+}
+
+
+void main()
+{
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
+	// value of the pixel
+	// (the offset from the view center is small, so it is computed in float)
+	float pixelSize = ldexp(gradientMantissa, gradientExponent);
+	vec2 offset = (gl_FragCoord.xy - referencePixel) * pixelSize;
+	dvec2 v = center + dvec2(offset);
+
+	// initialize z and c complex numbers
+	dvec2 z, c;
+	if(viewPlane == 0) {
+		z = dvec2(constantParameter);
+		c = v;
+	}
+	else {
+		z = v;
+		c = dvec2(constantParameter);
+	}
+
+	// interior test
+	// (points of the main cardioid and of the period-2 bulb are inside the Mandelbrot set,
+	// so they are not iterated; it applies to the c plane with zero initial z only)
+	int i = 0;
+	if(viewPlane == 0 && constantParameter == vec2(0.0)) {
+		double x = c.x - 0.25;
+		double q = x*x + c.y*c.y;
+		if(q*(q + x) <= 0.25*c.y*c.y || (c.x+1.0)*(c.x+1.0) + c.y*c.y <= 0.0625)
+			i = iterLimit;
+	}
+
+	// iterate z = z^2 + c
+	// (periodicity check: z returning close to the value saved after power-of-two iterations
+	// means attracting cycle, so the point is inside the set)
+	double periodEpsilon = double(pixelSize) * 1e-3;
+	dvec2 zSaved = z;
+	int periodLength = 8;
+	int periodCounter = 0;
+	for(; i<iterLimit; i++) {
+		z = dvec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
+		if(z.x*z.x + z.y*z.y >= 4.0)
+			break;
+		if(abs(z.x - zSaved.x) + abs(z.y - zSaved.y) < periodEpsilon) {
+			i = iterLimit;
+			break;
+		}
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			zSaved = z;
+		}
+	}
+
+	// assign color
+	outColor = iterationColor(i, iterLimit);
+}
@@ -5,17 +5,23 @@ layout(push_constant) uniform pushConstants {
 	layout(offset=0) vec4 juliaCoords;
 	layout(offset=16) int viewPlane;
 	layout(offset=24) vec2 constantParameter;
+	layout(offset=40) float gradientMantissa;  // pixel size is gradientMantissa * 2^gradientExponent
+	layout(offset=44) int gradientExponent;
+	layout(offset=52) int maxIter;  // iteration limit growing with the zoom
 };
 
+// specialization constants
+// (non-zero specializedMaxIter replaces maxIter push constant, so the compiler can fold
+// the iteration limit into the loop; coloringMode selects the palette)
+layout(constant_id = 0) const int specializedMaxIter = 0;
+layout(constant_id = 1) const int coloringMode = 0;  // 0 - hue gradient, 1 - hue bands, 2 - grayscale
+
 // input from vertex shader
 layout(location = 0) in vec2 inInitialValue;
 
 // output
 layout(location = 0) out vec4 outColor;
 
-// constants
-const int maxIter = 255;
-
 
 // hsvToRgb - convert color given in HSV (Hue Saturation Value) into color given in RGB (Red Green Blue)
 vec3 hsvToRgb(vec3 hsv)
@@ -25,8 +31,28 @@ vec3 hsvToRgb(vec3 hsv)
 }
 
 
+// iterationColor - color of the pixel of the given iteration count
+vec4 iterationColor(int i, int iterLimit)
+{
+	if(i == iterLimit)
+		return vec4(0,0,0,1);
+	if(coloringMode == 1)
+		return vec4(hsvToRgb(vec3(2./3. - float(i % 32) / 32., 1, 1)), 1);
+	// (fixed scale of 255 iterations, so the colors do not depend on iterLimit;
+	// the hue repeats every 255 iterations, the gray level saturates)
+	float l = float(i) / 255.;
+	if(coloringMode == 2)
+		return vec4(vec3(1. - min(l, 1.)), 1);
+	return vec4(hsvToRgb(vec3(2./3. - l, 1, 1)), 1);
+}
+
+
 void main()
 {
+	// iteration limit
+	// (specialized pipelines get it as a constant)
+	int iterLimit = (specializedMaxIter != 0) ? specializedMaxIter : maxIter;
+
 	// initialize z and c complex numbers
 	vec2 z, c;
 	if(viewPlane == 0) {
@@ -38,20 +64,39 @@ void main()
 		c = constantParameter;
 	}
 
-	// iterate z = z^2 + c
+	// interior test
+	// (points of the main cardioid and of the period-2 bulb are inside the Mandelbrot set,
+	// so they are not iterated; it applies to the c plane with zero initial z only)
 	int i = 0;
-	for(; i<maxIter; i++) {
+	if(viewPlane == 0 && constantParameter == vec2(0.0)) {
+		float x = c.x - 0.25;
+		float q = x*x + c.y*c.y;
+		if(q*(q + x) <= 0.25*c.y*c.y || (c.x+1.0)*(c.x+1.0) + c.y*c.y <= 0.0625)
+			i = iterLimit;
+	}
+
+	// iterate z = z^2 + c
+	// (periodicity check: z returning close to the value saved after power-of-two iterations
+	// means attracting cycle, so the point is inside the set)
+	float periodEpsilon = ldexp(gradientMantissa, gradientExponent) * 1e-3;
+	vec2 zSaved = z;
+	int periodLength = 8;
+	int periodCounter = 0;
+	for(; i<iterLimit; i++) {
 		z = vec2(z.x*z.x - z.y*z.y, 2.*z.x*z.y) + c;
 		if(z.x*z.x + z.y*z.y >= 4.0)
 			break;
+		if(abs(z.x - zSaved.x) + abs(z.y - zSaved.y) < periodEpsilon) {
+			i = iterLimit;
+			break;
+		}
+		if(++periodCounter == periodLength) {
+			periodCounter = 0;
+			periodLength *= 2;
+			zSaved = z;
+		}
 	}
 
 	// assign color
-	float l = float(i) / maxIter;
-	if(l > 0.999)
-		outColor = vec4(0,0,0,1);
-	else {
-		vec3 c = hsvToRgb(vec3(2./3. - l, 1, 1));
-		outColor = vec4(c, 1);
-	}
+	outColor = iterationColor(i, iterLimit);
 }
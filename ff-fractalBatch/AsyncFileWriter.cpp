@@ -0,0 +1,466 @@
+#include "AsyncFileWriter.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#if defined(_WIN32)
+# include <fstream>
+#else
+# include <cerrno>
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+#if defined(ASYNC_WRITER_URING)
+# include <liburing.h>
+#endif
+
+using namespace std;
+
+
+const char* AsyncFileWriter::backendName(Backend backend)
+{
+	switch(backend) {
+	case Backend::Auto:       return "auto";
+	case Backend::IoUring:    return "io_uring";
+	case Backend::ThreadPool: return "threads";
+	}
+	return "unknown";
+}
+
+
+AsyncFileWriter::Backend AsyncFileWriter::backendFromName(const char* name)
+{
+	for(Backend b : { Backend::Auto, Backend::IoUring, Backend::ThreadPool })
+		if(strcmp(name, backendName(b)) == 0)
+			return b;
+	throw invalid_argument(string("Unknown async writer backend: ") + name + ".");
+}
+
+
+bool AsyncFileWriter::isSupported(Backend backend)
+{
+#if defined(ASYNC_WRITER_URING)
+	return true;
+#else
+	return backend != Backend::IoUring;
+#endif
+}
+
+
+void AsyncFileWriter::open(Backend backend, unsigned queueDepth, bool directIO)
+{
+	close();
+
+	// select backend
+	// (io_uring might be compiled in, but not allowed by the kernel; auto falls back to the thread pool then)
+	bool explicitBackend = (backend != Backend::Auto);
+	if(backend == Backend::Auto)
+		backend = isSupported(Backend::IoUring) ? Backend::IoUring : Backend::ThreadPool;
+	if(!isSupported(backend))
+		throw runtime_error(string("Async writer backend ") + backendName(backend) + " is not supported by this build.");
+#if defined(ASYNC_WRITER_URING)
+	if(backend == Backend::IoUring) {
+		io_uring* ring = new io_uring;
+		int r = io_uring_queue_init(queueDepth+1, ring, 0);  // one more entry for the exit request
+		if(r < 0) {
+			delete ring;
+			if(explicitBackend)
+				throw runtime_error(string("Failed to initialize io_uring (") + strerror(-r) + ").");
+			backend = Backend::ThreadPool;
+		}
+		else
+			_ring = ring;
+	}
+#else
+	(void)explicitBackend;
+#endif
+	_backend = backend;
+#if defined(_WIN32) || !defined(O_DIRECT)
+	_directIO = false;
+	(void)directIO;
+#else
+	_directIO = directIO;
+#endif
+	_directIOFallback = false;
+	_ringFailed = false;
+
+	// buffers
+	_queueDepth = queueDepth;
+	_requests.resize(queueDepth);
+	for(auto& r : _requests) {
+		r = make_unique<Request>();
+		_freeRequests.push_back(r.get());
+	}
+
+	// statistics
+	_latencies.clear();
+	_latencies.reserve(1024);
+	_bytesWritten = 0;
+	_maxQueueDepth = 0;
+	_queueDepthSum = 0.;
+	_stallTime = 0.;
+
+	// start threads
+	// (the thread pool uses one thread per buffer, so all the writes of the queue might be in flight)
+	if(_backend == Backend::ThreadPool)
+		for(unsigned i=0; i<queueDepth; i++)
+			_threads.emplace_back(&AsyncFileWriter::threadMain, this);
+	else
+		_completionThread = thread(&AsyncFileWriter::completionThreadMain, this);
+}
+
+
+uint8_t* AsyncFileWriter::acquireBuffer(size_t size)
+{
+	// wait for free buffer
+	auto startTime = chrono::steady_clock::now();
+	unique_lock<mutex> lock(_mutex);
+	_freeCondition.wait(lock, [&]{ return !_freeRequests.empty() || _exception; });
+	_stallTime += chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+	if(_exception) {
+		lock.unlock();
+		rethrowException();
+	}
+	Request* r = _freeRequests.back();
+	_freeRequests.pop_back();
+	_acquiredRequests.push_back(r);
+	lock.unlock();
+
+	// make the buffer big enough
+	// (it is aligned and padded with zeros up to the alignment for direct I/O)
+	size_t paddedSize = (size + alignment - 1) & ~(alignment - 1);
+	if(r->capacity < paddedSize) {
+		r->storage.clear();
+		r->storage.shrink_to_fit();
+		r->storage.resize(paddedSize + alignment);
+		r->buffer = reinterpret_cast<uint8_t*>(
+			(reinterpret_cast<uintptr_t>(r->storage.data()) + alignment - 1) & ~uintptr_t(alignment - 1));
+		r->capacity = paddedSize;
+	}
+	memset(r->buffer + size, 0, paddedSize - size);
+	r->size = size;
+	return r->buffer;
+}
+
+
+void AsyncFileWriter::submit(uint8_t* buffer, const string& fileName)
+{
+	// find the request and update queue statistics
+	Request* r;
+	{
+		lock_guard<mutex> lock(_mutex);
+		auto it = find_if(_acquiredRequests.begin(), _acquiredRequests.end(), [buffer](Request* r){ return r->buffer == buffer; });
+		if(it == _acquiredRequests.end())
+			throw logic_error("AsyncFileWriter::submit() called with buffer not acquired by acquireBuffer().");
+		r = *it;
+		_acquiredRequests.erase(it);
+		size_t depth = _requests.size() - _freeRequests.size() - _acquiredRequests.size();
+		_queueDepthSum += double(depth);
+		_maxQueueDepth = max(_maxQueueDepth, depth);
+	}
+	r->fileName = fileName;
+	r->written = 0;
+	r->submitTime = chrono::steady_clock::now();
+
+	if(_backend == Backend::ThreadPool) {
+
+		// pass the request to the threads
+		{
+			lock_guard<mutex> lock(_mutex);
+			_pendingRequests.push_back(r);
+		}
+		_workCondition.notify_one();
+
+	}
+	else {
+
+		// open the file and submit the write to the ring
+		// (the file is opened synchronously; opening is much cheaper than writing of the image data)
+		try {
+			if(!openFile(r))
+				throw runtime_error("Failed to open \"" + r->fileName + "\".");
+			submitToRing(r);
+		} catch(...) {
+			if(r->fd != -1) {
+#if !defined(_WIN32)
+				::close(r->fd);
+#endif
+				r->fd = -1;
+			}
+			finishRequest(r, current_exception());
+			rethrowException();
+		}
+
+	}
+}
+
+
+bool AsyncFileWriter::openFile(Request* r)
+{
+#if defined(_WIN32)
+	(void)r;
+	return false;
+#else
+	int flags = O_WRONLY | O_CREAT | O_TRUNC;
+# if defined(O_DIRECT)
+	if(_directIO) {
+		r->fd = ::open(r->fileName.c_str(), flags | O_DIRECT, 0644);
+		if(r->fd != -1) {
+			r->direct = true;
+			r->writeSize = (r->size + alignment - 1) & ~(alignment - 1);
+			return true;
+		}
+		if(errno != EINVAL)
+			return false;
+		lock_guard<mutex> lock(_mutex);
+		_directIOFallback = true;  // file system does not support O_DIRECT
+	}
+# endif
+	r->fd = ::open(r->fileName.c_str(), flags, 0644);
+	r->direct = false;
+	r->writeSize = r->size;
+	return r->fd != -1;
+#endif
+}
+
+
+void AsyncFileWriter::closeFile(Request* r)
+{
+#if !defined(_WIN32)
+	// truncate the padding of direct I/O
+	bool failed = false;
+	if(r->direct && r->writeSize != r->size)
+		failed |= ftruncate(r->fd, off_t(r->size)) != 0;
+	failed |= ::close(r->fd) != 0;
+	r->fd = -1;
+	if(failed)
+		throw runtime_error("Failed to write \"" + r->fileName + "\".");
+#else
+	(void)r;
+#endif
+}
+
+
+void AsyncFileWriter::finishRequest(Request* r, exception_ptr e)
+{
+	double latency = chrono::duration<double>(chrono::steady_clock::now() - r->submitTime).count();
+	{
+		lock_guard<mutex> lock(_mutex);
+		_latencies.push_back(latency);
+		if(e) {
+			if(!_exception)
+				_exception = e;
+		}
+		else
+			_bytesWritten += r->size;
+		_freeRequests.push_back(r);
+	}
+	_freeCondition.notify_all();
+}
+
+
+void AsyncFileWriter::threadMain()
+{
+	for(;;) {
+
+		// wait for work
+		// (pending requests are finished before the exit)
+		Request* r;
+		{
+			unique_lock<mutex> lock(_mutex);
+			_workCondition.wait(lock, [&]{ return _exitThreads || !_pendingRequests.empty(); });
+			if(_pendingRequests.empty())
+				return;
+			r = _pendingRequests.front();
+			_pendingRequests.pop_front();
+		}
+
+		// write the file
+		try {
+#if defined(_WIN32)
+			ofstream f(r->fileName, ofstream::out | ofstream::binary | ofstream::trunc);
+			f.write(reinterpret_cast<const char*>(r->buffer), streamsize(r->size));
+			f.close();
+			if(!f)
+				throw runtime_error("Failed to write \"" + r->fileName + "\".");
+#else
+			if(!openFile(r))
+				throw runtime_error("Failed to open \"" + r->fileName + "\".");
+			while(r->written < r->writeSize) {
+				ssize_t n = pwrite(r->fd, r->buffer + r->written, r->writeSize - r->written, off_t(r->written));
+				if(n < 0 && errno == EINTR)
+					continue;
+				if(n <= 0) {
+					::close(r->fd);
+					r->fd = -1;
+					throw runtime_error("Failed to write \"" + r->fileName + "\".");
+				}
+				r->written += size_t(n);
+			}
+			closeFile(r);
+#endif
+		} catch(...) {
+			finishRequest(r, current_exception());
+			continue;
+		}
+		finishRequest(r, nullptr);
+
+	}
+}
+
+
+void AsyncFileWriter::submitToRing(Request* r)
+{
+#if defined(ASYNC_WRITER_URING)
+	// write the remaining part of the file
+	// (a single write is limited to 1 GiB, the rest is written by resubmission)
+	io_uring* ring = reinterpret_cast<io_uring*>(_ring);
+	lock_guard<mutex> lock(_submitMutex);
+	io_uring_sqe* sqe = io_uring_get_sqe(ring);
+	if(sqe == nullptr)
+		throw runtime_error("io_uring submission queue is full.");
+	unsigned size = unsigned(min(r->writeSize - r->written, size_t(1) << 30));
+	io_uring_prep_write(sqe, r->fd, r->buffer + r->written, size, r->written);
+	io_uring_sqe_set_data(sqe, r);
+	int ret = io_uring_submit(ring);
+	if(ret < 0)
+		throw runtime_error(string("io_uring_submit() failed (") + strerror(-ret) + ").");
+#else
+	(void)r;
+	throw logic_error("io_uring is not supported by this build.");
+#endif
+}
+
+
+void AsyncFileWriter::completionThreadMain()
+{
+#if defined(ASYNC_WRITER_URING)
+	io_uring* ring = reinterpret_cast<io_uring*>(_ring);
+	for(;;) {
+
+		// wait for the completion
+		io_uring_cqe* cqe;
+		int ret = io_uring_wait_cqe(ring, &cqe);
+		if(ret == -EINTR)
+			continue;
+		if(ret < 0) {
+			lock_guard<mutex> lock(_mutex);
+			if(!_exception)
+				_exception = make_exception_ptr(runtime_error(string("io_uring_wait_cqe() failed (") + strerror(-ret) + ")."));
+			_ringFailed = true;  // in-flight writes will never complete
+			_freeCondition.notify_all();
+			return;
+		}
+		Request* r = reinterpret_cast<Request*>(io_uring_cqe_get_data(cqe));
+		int res = cqe->res;
+		io_uring_cqe_seen(ring, cqe);
+
+		// exit request has no data
+		if(r == nullptr)
+			return;
+
+		// process the result
+		try {
+			if(res <= 0) {
+				::close(r->fd);
+				r->fd = -1;
+				throw runtime_error("Failed to write \"" + r->fileName + "\"" +
+				                    (res < 0 ? string(" (") + strerror(-res) + ")." : string(".")));
+			}
+			r->written += size_t(res);
+			if(r->written < r->writeSize) {
+				submitToRing(r);  // short write
+				continue;
+			}
+			closeFile(r);
+		} catch(...) {
+			finishRequest(r, current_exception());
+			continue;
+		}
+		finishRequest(r, nullptr);
+
+	}
+#endif
+}
+
+
+void AsyncFileWriter::stop()
+{
+	// stop threads
+	if(!_threads.empty()) {
+		{
+			lock_guard<mutex> lock(_mutex);
+			_exitThreads = true;
+		}
+		_workCondition.notify_all();
+		for(thread& t : _threads)
+			t.join();
+		_threads.clear();
+		_exitThreads = false;
+	}
+
+#if defined(ASYNC_WRITER_URING)
+	// stop the completion thread by the request without data and release the ring
+	if(_ring) {
+		io_uring* ring = reinterpret_cast<io_uring*>(_ring);
+		if(_completionThread.joinable()) {
+			{
+				lock_guard<mutex> lock(_submitMutex);
+				io_uring_sqe* sqe = io_uring_get_sqe(ring);
+				if(sqe) {
+					io_uring_prep_nop(sqe);
+					io_uring_sqe_set_data(sqe, nullptr);
+					io_uring_submit(ring);
+				}
+			}
+			_completionThread.join();
+		}
+		io_uring_queue_exit(ring);
+		delete ring;
+		_ring = nullptr;
+	}
+#endif
+}
+
+
+void AsyncFileWriter::close()
+{
+	if(_requests.empty())
+		return;
+
+	// wait for all the writes
+	// (the buffers acquired but not submitted are not waited for)
+	{
+		unique_lock<mutex> lock(_mutex);
+		_freeCondition.wait(lock,
+			[&]{ return _freeRequests.size() + _acquiredRequests.size() == _requests.size() || _ringFailed; });
+	}
+	stop();
+	_freeRequests.clear();
+	_acquiredRequests.clear();
+	_requests.clear();
+	rethrowException();
+}
+
+
+void AsyncFileWriter::rethrowException()
+{
+	exception_ptr e;
+	{
+		lock_guard<mutex> lock(_mutex);
+		e = _exception;
+		_exception = nullptr;
+	}
+	if(e)
+		rethrow_exception(e);
+}
+
+
+double AsyncFileWriter::latencyPercentile(double p) const
+{
+	if(_latencies.empty())
+		return 0.;
+	vector<double> v(_latencies);
+	size_t i = min(size_t(p/100. * double(v.size()-1) + 0.5), v.size()-1);
+	nth_element(v.begin(), v.begin()+ptrdiff_t(i), v.end());
+	return v[i];
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+/** AsyncFileWriter writes whole files asynchronously, so the caller is not blocked by the file system.
+ *  The caller gets a buffer by acquireBuffer(), fills it with the file content and passes it to submit().
+ *  The number of buffers is equal to the queue depth, so acquireBuffer() blocks when queueDepth writes
+ *  are in flight, applying back-pressure to the caller.
+ *  The writes are performed by io_uring when available (Linux with liburing), otherwise by a pool
+ *  of threads. With direct I/O, the files are opened with O_DIRECT, bypassing the page cache;
+ *  the buffers are aligned, the writes are padded to the alignment and the files are truncated
+ *  to their real size afterwards. File systems not supporting O_DIRECT are written without it. */
+class AsyncFileWriter {
+public:
+
+	enum class Backend { Auto, IoUring, ThreadPool };
+	static constexpr const size_t alignment = 4096;
+
+protected:
+
+	struct Request {
+		std::vector<uint8_t> storage;
+		uint8_t* buffer = nullptr;  // aligned start of the storage
+		size_t capacity = 0;
+		size_t size = 0;
+		size_t writeSize = 0;  // size padded for direct I/O
+		size_t written = 0;
+		std::string fileName;
+		int fd = -1;
+		bool direct = false;
+		std::chrono::steady_clock::time_point submitTime;
+	};
+
+	Backend _backend = Backend::ThreadPool;
+	bool _directIO = false;
+	bool _directIOFallback = false;  // some file was written without O_DIRECT
+	unsigned _queueDepth = 0;
+	std::vector<std::unique_ptr<Request>> _requests;
+	std::vector<Request*> _freeRequests;
+	std::vector<Request*> _acquiredRequests;
+	std::mutex _mutex;
+	std::condition_variable _freeCondition;
+	std::exception_ptr _exception;
+
+	// thread pool backend
+	std::vector<std::thread> _threads;
+	std::condition_variable _workCondition;
+	std::deque<Request*> _pendingRequests;
+	bool _exitThreads = false;
+
+	// io_uring backend
+	// (the ring is submitted to by the caller and by the completion thread that resubmits
+	// short writes, so the submission is guarded by _submitMutex)
+	void* _ring = nullptr;
+	std::thread _completionThread;
+	std::mutex _submitMutex;
+	bool _ringFailed = false;
+
+	// statistics
+	std::vector<double> _latencies;
+	uint64_t _bytesWritten = 0;
+	size_t _maxQueueDepth = 0;
+	double _queueDepthSum = 0.;
+	double _stallTime = 0.;
+
+	void threadMain();
+	void completionThreadMain();
+	void submitToRing(Request* r);
+	void finishRequest(Request* r, std::exception_ptr e);
+	bool openFile(Request* r);
+	void closeFile(Request* r);
+	void rethrowException();
+	void stop();
+
+public:
+
+	AsyncFileWriter() = default;
+	~AsyncFileWriter();
+
+	void open(Backend backend, unsigned queueDepth, bool directIO);
+	uint8_t* acquireBuffer(size_t size);
+	void submit(uint8_t* buffer, const std::string& fileName);
+	void close();  // waits for all the writes
+
+	// getters
+	Backend backend() const;
+	bool directIO() const;  // false if direct I/O was not requested or if it was not supported for some file
+	unsigned queueDepth() const;
+	size_t numWrites() const;
+	uint64_t bytesWritten() const;
+	double averageQueueDepth() const;  // number of writes in flight at the submission, including the submitted one
+	size_t maxQueueDepth() const;
+	double stallTime() const;  // time spent by acquireBuffer() waiting for a free buffer, in seconds
+	double latencyPercentile(double p) const;  // time from submit() to the file close, in seconds
+
+	static bool isSupported(Backend backend);
+	static const char* backendName(Backend backend);
+	static Backend backendFromName(const char* name);
+
+};
+
+
+// inline methods
+inline AsyncFileWriter::~AsyncFileWriter()  { try { close(); } catch(...) {} }
+inline AsyncFileWriter::Backend AsyncFileWriter::backend() const  { return _backend; }
+inline bool AsyncFileWriter::directIO() const  { return _directIO && !_directIOFallback; }
+inline unsigned AsyncFileWriter::queueDepth() const  { return _queueDepth; }
+inline size_t AsyncFileWriter::numWrites() const  { return _latencies.size(); }
+inline uint64_t AsyncFileWriter::bytesWritten() const  { return _bytesWritten; }
+inline double AsyncFileWriter::averageQueueDepth() const  { return _latencies.empty() ? 0. : _queueDepthSum/_latencies.size(); }
+inline size_t AsyncFileWriter::maxQueueDepth() const  { return _maxQueueDepth; }
+inline double AsyncFileWriter::stallTime() const  { return _stallTime; }
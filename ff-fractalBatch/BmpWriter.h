@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+/** BmpWriter writes 32-bit bmp files.
+ *  The image data are given in RGBA byte order, as they are stored in vk::Format::eR8G8B8A8Unorm images,
+ *  and they are converted to BGRA byte order used by bmp files.
+ *  The conversion is performed on whole rows using SIMD instructions when available
+ *  and the converted data are written to the file in large blocks.
+ *  The data given in BGRA byte order, as stored in vk::Format::eB8G8R8A8Unorm images,
+ *  are written without any conversion. */
+class BmpWriter {
+public:
+
+	enum class Method { Auto, PerPixel, Scalar, SSSE3, AVX2 };
+	enum class PixelOrder { RGBA, BGRA };
+
+protected:
+
+	std::fstream _stream;
+	std::string _fileName;
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	Method _method = Method::Auto;
+	PixelOrder _pixelOrder = PixelOrder::RGBA;
+
+	// block buffer
+	// (converted data waiting to be written to the file;
+	// the data are always continuous in the file, starting at _blockFilePos;
+	// rectangles narrower than the image are staged in a band of whole image rows
+	// that is written when all its rectangles are staged)
+	std::vector<uint8_t> _blockStorage;
+	uint8_t* _block = nullptr;
+	size_t _blockCapacity = 0;
+	size_t _blockSize = 0;
+	uint64_t _blockFilePos = 0;
+	uint64_t _filePos = 0;
+	bool _band = false;
+	size_t _bandBytesStaged = 0;
+
+	// statistics
+	uint64_t _bytesWritten = 0;
+	double _writeTime = 0.;
+
+	void reserveBlock(size_t size);
+	void flushBlock();
+
+public:
+
+	static constexpr const uint32_t imageDataOffset = 14+40+2;  // sum of sizeof(BitmapFileHeader), sizeof(BitmapInfoHeader) and 2 (as alignment)
+
+	BmpWriter() = default;
+	~BmpWriter();
+
+	void open(const std::string& fileName, uint32_t width, uint32_t height, Method method = Method::Auto,
+	          PixelOrder pixelOrder = PixelOrder::RGBA);
+	void writeRows(const void* data, size_t rowPitch, uint32_t y, uint32_t numRows);
+	void writeRect(const void* data, size_t rowPitch, uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+	void close();
+
+	// getters
+	Method method() const;
+	PixelOrder pixelOrder() const;
+	const char* conversionName() const;  // method name or "none" if no conversion is performed
+	uint64_t bytesWritten() const;
+	double writeTime() const;  // in seconds
+	double throughput() const;  // in MB/s
+
+	// conversion functions
+	static Method bestMethod();
+	static const char* methodName(Method method);
+	static Method methodFromName(const char* name);
+	static void convertRow(const void* src, void* dst, size_t numPixels, Method method);
+	static void storeHeaders(void* dst, uint32_t width, uint32_t height);  // stores imageDataOffset bytes of bmp headers
+
+};
+
+
+// inline methods
+inline BmpWriter::~BmpWriter()  { if(_stream.is_open()) { try { close(); } catch(...) {} } }
+inline void BmpWriter::writeRows(const void* data, size_t rowPitch, uint32_t y, uint32_t numRows)  { writeRect(data, rowPitch, 0, y, _width, numRows); }
+inline BmpWriter::Method BmpWriter::method() const  { return _method; }
+inline BmpWriter::PixelOrder BmpWriter::pixelOrder() const  { return _pixelOrder; }
+inline const char* BmpWriter::conversionName() const  { return _pixelOrder==PixelOrder::BGRA ? "none" : methodName(_method); }
+inline uint64_t BmpWriter::bytesWritten() const  { return _bytesWritten; }
+inline double BmpWriter::writeTime() const  { return _writeTime; }
+inline double BmpWriter::throughput() const  { return _writeTime>0. ? double(_bytesWritten)/_writeTime*1e-6 : 0.; }
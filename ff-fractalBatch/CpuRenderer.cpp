@@ -0,0 +1,444 @@
+#include "CpuRenderer.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+# define CPU_RENDERER_X86
+# include <immintrin.h>
+# if defined(_MSC_VER)
+#  include <intrin.h>
+# endif
+#endif
+
+// target attributes allow us to use AVX2 and AVX-512 intrinsics
+// without compiling the whole file for these instruction sets
+// (MSVC does not need them; FMA is not enabled, so the results match the scalar code)
+#if defined(__GNUC__) || defined(__clang__)
+# define TARGET_AVX2   __attribute__((target("avx2")))
+# define TARGET_AVX512 __attribute__((target("avx512f")))
+#else
+# define TARGET_AVX2
+# define TARGET_AVX512
+#endif
+
+using namespace std;
+
+
+// pixelValue - value of the pixel center in the fractal coordinates
+// (it is computed in the same order of operations by the scalar and by the SIMD code)
+static inline float pixelValue(float v0, float step, uint32_t pixel)
+{
+	return v0 + (float(pixel) + 0.5f) * step;
+}
+
+
+static void renderSpanScalar(const CpuRenderer::View& view, float stepX, float stepY, uint32_t x, uint32_t y,
+                             uint32_t numPixels, const uint32_t* palette, uint32_t* dst)
+{
+	float vy = pixelValue(view.y0, stepY, y);
+	for(uint32_t k=0; k<numPixels; k++) {
+
+		// initialize z and c complex numbers
+		float vx = pixelValue(view.x0, stepX, x+k);
+		float zx, zy, cx, cy;
+		if(!view.julia) {
+			zx = view.constantX;  zy = view.constantY;
+			cx = vx;  cy = vy;
+		}
+		else {
+			zx = vx;  zy = vy;
+			cx = view.constantX;  cy = view.constantY;
+		}
+
+		// iterate z = z^2 + c
+		int i = 0;
+		for(; i<CpuRenderer::maxIter; i++) {
+			float t = zx*zx - zy*zy + cx;
+			zy = 2.f*zx*zy + cy;
+			zx = t;
+			if(zx*zx + zy*zy >= 4.f)
+				break;
+		}
+		dst[k] = palette[i];
+	}
+}
+
+
+#if defined(CPU_RENDERER_X86)
+
+TARGET_AVX2 static void renderSpanAVX2(const CpuRenderer::View& view, float stepX, float stepY, uint32_t x, uint32_t y,
+                                       uint32_t numPixels, const uint32_t* palette, uint32_t* dst)
+{
+	// iterate 8 pixels at once
+	// (lanes that escaped keep iterating, but their counters are not incremented;
+	// the loop ends when all the lanes escaped)
+	const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+	const __m256 four = _mm256_set1_ps(4.f);
+	const __m256 two = _mm256_set1_ps(2.f);
+	const __m256 vy = _mm256_set1_ps(pixelValue(view.y0, stepY, y));
+	const __m256 constX = _mm256_set1_ps(view.constantX);
+	const __m256 constY = _mm256_set1_ps(view.constantY);
+	uint32_t k = 0;
+	for(uint32_t e=numPixels&~uint32_t(7); k<e; k+=8) {
+
+		__m256 vx = _mm256_add_ps(_mm256_set1_ps(view.x0),
+			_mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(float(x+k)), offsets), _mm256_set1_ps(stepX)));
+		__m256 zx = view.julia ? vx : constX;
+		__m256 zy = view.julia ? vy : constY;
+		__m256 cx = view.julia ? constX : vx;
+		__m256 cy = view.julia ? constY : vy;
+		__m256 active = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		__m256i count = _mm256_setzero_si256();
+		for(int i=0; i<CpuRenderer::maxIter; i++) {
+			__m256 t = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(zx, zx), _mm256_mul_ps(zy, zy)), cx);
+			zy = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(two, zx), zy), cy);
+			zx = t;
+			__m256 r2 = _mm256_add_ps(_mm256_mul_ps(zx, zx), _mm256_mul_ps(zy, zy));
+			active = _mm256_and_ps(active, _mm256_cmp_ps(r2, four, _CMP_LT_OQ));
+			if(_mm256_movemask_ps(active) == 0)
+				break;
+			count = _mm256_sub_epi32(count, _mm256_castps_si256(active));
+		}
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(dst+k),
+		                    _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), count, 4));
+	}
+	renderSpanScalar(view, stepX, stepY, x+k, y, numPixels-k, palette, dst+k);
+}
+
+
+TARGET_AVX512 static void renderSpanAVX512(const CpuRenderer::View& view, float stepX, float stepY, uint32_t x, uint32_t y,
+                                           uint32_t numPixels, const uint32_t* palette, uint32_t* dst)
+{
+	// iterate 16 pixels at once
+	// (the same as AVX2 variant, but the active lanes are tracked by the mask register)
+	const __m512 offsets = _mm512_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f,
+	                                      8.5f, 9.5f, 10.5f, 11.5f, 12.5f, 13.5f, 14.5f, 15.5f);
+	const __m512 four = _mm512_set1_ps(4.f);
+	const __m512 two = _mm512_set1_ps(2.f);
+	const __m512i one = _mm512_set1_epi32(1);
+	const __m512 vy = _mm512_set1_ps(pixelValue(view.y0, stepY, y));
+	const __m512 constX = _mm512_set1_ps(view.constantX);
+	const __m512 constY = _mm512_set1_ps(view.constantY);
+	uint32_t k = 0;
+	for(uint32_t e=numPixels&~uint32_t(15); k<e; k+=16) {
+
+		__m512 vx = _mm512_add_ps(_mm512_set1_ps(view.x0),
+			_mm512_mul_ps(_mm512_add_ps(_mm512_set1_ps(float(x+k)), offsets), _mm512_set1_ps(stepX)));
+		__m512 zx = view.julia ? vx : constX;
+		__m512 zy = view.julia ? vy : constY;
+		__m512 cx = view.julia ? constX : vx;
+		__m512 cy = view.julia ? constY : vy;
+		__mmask16 active = 0xffff;
+		__m512i count = _mm512_setzero_si512();
+		for(int i=0; i<CpuRenderer::maxIter; i++) {
+			__m512 t = _mm512_add_ps(_mm512_sub_ps(_mm512_mul_ps(zx, zx), _mm512_mul_ps(zy, zy)), cx);
+			zy = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(two, zx), zy), cy);
+			zx = t;
+			__m512 r2 = _mm512_add_ps(_mm512_mul_ps(zx, zx), _mm512_mul_ps(zy, zy));
+			active = _mm512_mask_cmp_ps_mask(active, r2, four, _CMP_LT_OQ);
+			if(active == 0)
+				break;
+			count = _mm512_mask_add_epi32(count, active, count, one);
+		}
+		// (masked gather with zero source, the unmasked one triggers -Wmaybe-uninitialized in GCC)
+		_mm512_storeu_si512(dst+k, _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xffff, count, palette, 4));
+	}
+	renderSpanAVX2(view, stepX, stepY, x+k, y, numPixels-k, palette, dst+k);
+}
+
+
+static bool isAVX2Supported()
+{
+#if defined(_MSC_VER)
+	// AVX2 requires CPU support (CPUID.7.0:EBX.AVX2[bit 5]),
+	// and OS support for saving of ymm registers (OSXSAVE and XCR0 bits 1 and 2)
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7)
+		return false;
+	__cpuid(info, 1);
+	if((info[2] & (1<<27)) == 0 || (info[2] & (1<<28)) == 0)
+		return false;
+	if((_xgetbv(0) & 0x6) != 0x6)
+		return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1<<5)) != 0;
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+
+static bool isAVX512Supported()
+{
+#if defined(_MSC_VER)
+	// AVX-512F requires CPU support (CPUID.7.0:EBX.AVX512F[bit 16]),
+	// and OS support for saving of zmm and mask registers (XCR0 bits 1, 2, 5, 6 and 7)
+	if(!isAVX2Supported())
+		return false;
+	if((_xgetbv(0) & 0xe6) != 0xe6)
+		return false;
+	int info[4];
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1<<16)) != 0;
+#else
+	return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("avx512f");
+#endif
+}
+
+#endif
+
+
+CpuRenderer::Method CpuRenderer::bestMethod()
+{
+#if defined(CPU_RENDERER_X86)
+	static const Method m =
+		isAVX512Supported() ? Method::AVX512 : isAVX2Supported() ? Method::AVX2 : Method::Scalar;
+	return m;
+#else
+	return Method::Scalar;
+#endif
+}
+
+
+const char* CpuRenderer::methodName(Method method)
+{
+	switch(method) {
+	case Method::Auto:   return "auto";
+	case Method::Scalar: return "scalar";
+	case Method::AVX2:   return "avx2";
+	case Method::AVX512: return "avx512";
+	}
+	return "unknown";
+}
+
+
+CpuRenderer::Method CpuRenderer::methodFromName(const char* name)
+{
+	for(Method m : { Method::Auto, Method::Scalar, Method::AVX2, Method::AVX512 })
+		if(strcmp(name, methodName(m)) == 0)
+			return m;
+	throw invalid_argument(string("Unknown cpu renderer method: ") + name + ".");
+}
+
+
+void CpuRenderer::makePalette(uint32_t palette[maxIter+1], BmpWriter::PixelOrder pixelOrder)
+{
+	// colors of all the iteration counts
+	// (hsvToRgb() of shader.frag with saturation and value equal to one, converted to unorm bytes)
+	for(int i=0; i<=maxIter; i++) {
+		float l = float(i) / maxIter;
+		float rgb[3] = { 0.f, 0.f, 0.f };
+		if(!(l > 0.999f)) {
+			float h = 2.f/3.f - l;
+			float hues[3] = { h + 1.f, h + 2.f/3.f, h + 1.f/3.f };
+			for(int j=0; j<3; j++) {
+				float f = hues[j] - floor(hues[j]);
+				rgb[j] = clamp(fabs(f * 6.f - 3.f) - 1.f, 0.f, 1.f);
+			}
+		}
+		uint32_t r = uint32_t(rgb[0] * 255.f + 0.5f);
+		uint32_t g = uint32_t(rgb[1] * 255.f + 0.5f);
+		uint32_t b = uint32_t(rgb[2] * 255.f + 0.5f);
+		palette[i] = (pixelOrder == BmpWriter::PixelOrder::RGBA)
+			? r | (g << 8) | (b << 16) | 0xff000000
+			: b | (g << 8) | (r << 16) | 0xff000000;
+	}
+}
+
+
+void CpuRenderer::renderSpan(const View& view, uint32_t width, uint32_t height, uint32_t x, uint32_t y,
+                             uint32_t numPixels, const uint32_t* palette, uint32_t* dst, Method method)
+{
+	float stepX = (view.x1 - view.x0) / float(width);
+	float stepY = (view.y1 - view.y0) / float(height);
+	switch(method) {
+#if defined(CPU_RENDERER_X86)
+	case Method::AVX512:
+		renderSpanAVX512(view, stepX, stepY, x, y, numPixels, palette, dst);
+		break;
+	case Method::AVX2:
+		renderSpanAVX2(view, stepX, stepY, x, y, numPixels, palette, dst);
+		break;
+#endif
+	default:
+		renderSpanScalar(view, stepX, stepY, x, y, numPixels, palette, dst);
+	}
+}
+
+
+void CpuRenderer::start(Method method, unsigned numThreads)
+{
+	stop();
+
+	// select method
+	if(method == Method::Auto)
+		method = bestMethod();
+#if defined(CPU_RENDERER_X86)
+	if((method == Method::AVX512 && !isAVX512Supported()) || (method == Method::AVX2 && !isAVX2Supported()))
+#else
+	if(method != Method::Scalar)
+#endif
+		throw runtime_error(string("Cpu renderer method ") + methodName(method) + " is not supported on this platform.");
+	_method = method;
+
+	// start threads
+	// (thread 0 is the thread calling render())
+	if(numThreads == 0)
+		numThreads = max(thread::hardware_concurrency(), 1u);
+	_numThreads = numThreads;
+	_ranges = make_unique<TileRange[]>(numThreads);
+	for(unsigned i=0; i<numThreads; i++)
+		_ranges[i].range = 0;
+	_generation = 0;
+	_numBusy = 0;
+	_exitThreads = false;
+	_numSteals = 0;
+	_numPixels = 0;
+	_renderTime = 0.;
+	_threads.reserve(numThreads-1);
+	for(unsigned i=1; i<numThreads; i++)
+		_threads.emplace_back(&CpuRenderer::threadMain, this, i);
+}
+
+
+void CpuRenderer::stop()
+{
+	{
+		lock_guard lock(_mutex);
+		_exitThreads = true;
+	}
+	_workCondition.notify_all();
+	for(thread& t : _threads)
+		t.join();
+	_threads.clear();
+	_numThreads = 0;
+}
+
+
+void CpuRenderer::render(const View& view, uint32_t width, uint32_t height, void* dst, size_t rowPitch,
+                         BmpWriter::PixelOrder pixelOrder)
+{
+	if(_numThreads == 0)
+		start();
+
+	auto t = chrono::steady_clock::now();
+
+	// render parameters
+	_view = view;
+	_width = width;
+	_height = height;
+	_dst = reinterpret_cast<uint8_t*>(dst);
+	_rowPitch = rowPitch;
+	makePalette(_palette, pixelOrder);
+
+	// split tiles into per-thread ranges
+	_numTilesX = (width + tileSize - 1) / tileSize;
+	uint32_t numTiles = _numTilesX * ((height + tileSize - 1) / tileSize);
+	for(unsigned i=0; i<_numThreads; i++) {
+		uint64_t begin = uint64_t(numTiles) * i / _numThreads;
+		uint64_t end = uint64_t(numTiles) * (i+1) / _numThreads;
+		_ranges[i].range.store(begin | (end << 32), memory_order_relaxed);
+	}
+
+	// wake up the threads and work with them
+	{
+		lock_guard lock(_mutex);
+		_generation++;
+		_numBusy = _numThreads;
+	}
+	_workCondition.notify_all();
+	work(0);
+
+	// wait for the other threads
+	unique_lock lock(_mutex);
+	_doneCondition.wait(lock, [this]{ return _numBusy == 0; });
+
+	_numPixels += uint64_t(width) * height;
+	_renderTime += chrono::duration<double>(chrono::steady_clock::now() - t).count();
+}
+
+
+void CpuRenderer::threadMain(unsigned index)
+{
+	uint64_t generation = 0;
+	while(true) {
+
+		// wait for work
+		{
+			unique_lock lock(_mutex);
+			_workCondition.wait(lock, [&]{ return _generation != generation || _exitThreads; });
+			if(_exitThreads)
+				return;
+			generation = _generation;
+		}
+
+		work(index);
+	}
+}
+
+
+void CpuRenderer::work(unsigned index)
+{
+	uint32_t tile;
+	while(takeTile(index, tile))
+		renderTile(tile);
+
+	// report finished work
+	bool last;
+	{
+		lock_guard lock(_mutex);
+		last = (--_numBusy == 0);
+	}
+	if(last)
+		_doneCondition.notify_all();
+}
+
+
+bool CpuRenderer::takeTile(unsigned index, uint32_t& tile)
+{
+	// take the first tile of the own range
+	atomic<uint64_t>& own = _ranges[index].range;
+	uint64_t r = own.load(memory_order_relaxed);
+	while(uint32_t(r) < uint32_t(r >> 32))
+		if(own.compare_exchange_weak(r, r+1, memory_order_relaxed)) {
+			tile = uint32_t(r);
+			return true;
+		}
+
+	// steal the upper half of the remaining range of another thread
+	// (the own range is empty, so nobody steals from it while it is replaced by the stolen tiles;
+	// the stolen tiles are processed by this thread, so the work is finished when all the ranges are empty)
+	for(unsigned k=1; k<_numThreads; k++) {
+		atomic<uint64_t>& victim = _ranges[(index + k) % _numThreads].range;
+		uint64_t v = victim.load(memory_order_relaxed);
+		while(true) {
+			uint32_t begin = uint32_t(v);
+			uint32_t end = uint32_t(v >> 32);
+			if(begin >= end)
+				break;
+			uint32_t mid = end - (end - begin + 1) / 2;
+			if(victim.compare_exchange_weak(v, begin | (uint64_t(mid) << 32), memory_order_relaxed)) {
+				own.store((mid+1) | (uint64_t(end) << 32), memory_order_relaxed);
+				_numSteals.fetch_add(1, memory_order_relaxed);
+				tile = mid;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+
+void CpuRenderer::renderTile(uint32_t tile)
+{
+	uint32_t x = (tile % _numTilesX) * tileSize;
+	uint32_t y = (tile / _numTilesX) * tileSize;
+	uint32_t w = min(tileSize, _width - x);
+	uint32_t h = min(tileSize, _height - y);
+	for(uint32_t j=0; j<h; j++)
+		renderSpan(_view, _width, _height, x, y+j, w, _palette,
+		           reinterpret_cast<uint32_t*>(_dst + (y+j)*_rowPitch) + x, _method);
+}
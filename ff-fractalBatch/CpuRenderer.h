@@ -0,0 +1,113 @@
+#pragma once
+
+#include "BmpWriter.h"
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/** CpuRenderer renders the fractal on CPU using the same math as shader.frag,
+ *  so it can validate the GPU output and it can replace the GPU when no Vulkan device is available.
+ *  The pixels are iterated in float precision by 16 (AVX-512) or 8 (AVX2) pixels at once,
+ *  or one by one by the scalar code when SIMD is not available.
+ *  The image is split into tiles processed by a pool of threads. Each thread starts with its own
+ *  range of tiles; when the range is exhausted, the thread steals half of the remaining range
+ *  of another thread. The calling thread works as one of the pool threads.
+ *  The output is in RGBA or BGRA byte order, as stored in vk::Format::eR8G8B8A8Unorm
+ *  or vk::Format::eB8G8R8A8Unorm images. */
+class CpuRenderer {
+public:
+
+	enum class Method { Auto, Scalar, AVX2, AVX512 };
+
+	// view of the fractal
+	// (x0, y0, x1 and y1 are coordinates of the image edges, as juliaCoords of the shaders)
+	struct View {
+		float x0, y0, x1, y1;
+		bool julia;
+		float constantX, constantY;  // initial z for Mandelbrot set, c for Julia set
+	};
+
+	static constexpr const uint32_t tileSize = 64;
+	static constexpr const int maxIter = 255;
+
+protected:
+
+	// per-thread range of tiles
+	// (begin in the low and end in the high 32 bits, so the range is taken and stolen by a single CAS;
+	// each range has its own cache line)
+	struct alignas(64) TileRange {
+		std::atomic<uint64_t> range;
+	};
+
+	Method _method = Method::Scalar;
+	std::vector<std::thread> _threads;
+	std::unique_ptr<TileRange[]> _ranges;
+	unsigned _numThreads = 0;
+	std::mutex _mutex;
+	std::condition_variable _workCondition;
+	std::condition_variable _doneCondition;
+	uint64_t _generation = 0;
+	unsigned _numBusy = 0;
+	bool _exitThreads = false;
+
+	// current render
+	View _view;
+	uint32_t _width = 0;
+	uint32_t _height = 0;
+	uint32_t _numTilesX = 0;
+	uint8_t* _dst = nullptr;
+	size_t _rowPitch = 0;
+	uint32_t _palette[maxIter+1];
+
+	// statistics
+	std::atomic<uint64_t> _numSteals = 0;
+	uint64_t _numPixels = 0;
+	double _renderTime = 0.;
+
+	void threadMain(unsigned index);
+	void work(unsigned index);
+	bool takeTile(unsigned index, uint32_t& tile);
+	void renderTile(uint32_t tile);
+
+public:
+
+	CpuRenderer() = default;
+	~CpuRenderer();
+
+	void start(Method method = Method::Auto, unsigned numThreads = 0);  // zero means the number of CPU threads
+	void render(const View& view, uint32_t width, uint32_t height, void* dst, size_t rowPitch,
+	            BmpWriter::PixelOrder pixelOrder);
+	void stop();
+
+	// getters
+	Method method() const;
+	unsigned numThreads() const;
+	uint64_t numSteals() const;
+	uint64_t numPixels() const;  // rendered since start()
+	double renderTime() const;  // in seconds
+	double throughput() const;  // in Mpix/s
+
+	// rendering functions
+	static Method bestMethod();
+	static const char* methodName(Method method);
+	static Method methodFromName(const char* name);
+	static void makePalette(uint32_t palette[maxIter+1], BmpWriter::PixelOrder pixelOrder);
+	static void renderSpan(const View& view, uint32_t width, uint32_t height, uint32_t x, uint32_t y,
+	                       uint32_t numPixels, const uint32_t* palette, uint32_t* dst, Method method);
+
+};
+
+
+// inline methods
+inline CpuRenderer::~CpuRenderer()  { stop(); }
+inline CpuRenderer::Method CpuRenderer::method() const  { return _method; }
+inline unsigned CpuRenderer::numThreads() const  { return _numThreads; }
+inline uint64_t CpuRenderer::numSteals() const  { return _numSteals; }
+inline uint64_t CpuRenderer::numPixels() const  { return _numPixels; }
+inline double CpuRenderer::renderTime() const  { return _renderTime; }
+inline double CpuRenderer::throughput() const  { return _renderTime>0. ? double(_numPixels)/_renderTime*1e-6 : 0.; }
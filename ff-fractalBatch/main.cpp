@@ -0,0 +1,1167 @@
+#include "AsyncFileWriter.h"
+#include "BmpWriter.h"
+#include "CpuRenderer.h"
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+using namespace std;
+
+// constants
+constexpr const char* appName = "ff-fractalBatch";
+constexpr const size_t numBatchSlots = 2;
+
+// command-line parameters
+static string jobFileName;
+static string outputPrefix = "image-";
+static size_t batchSize = 8;
+static BmpWriter::Method writerMethod = BmpWriter::Method::Auto;
+static string requestedDevice;  // part of the device name, empty for the first compatible device
+
+// asynchronous writing
+// (when enabled, the images are converted into bmp files in the memory and the files are written
+// by AsyncFileWriter, so the render thread does not wait for the file system;
+// it only waits when writeQueueDepth writes are in flight)
+static bool asyncWrites = false;
+static AsyncFileWriter::Backend asyncBackend = AsyncFileWriter::Backend::Auto;
+static unsigned writeQueueDepth = 16;
+static bool directIO = false;
+
+// cpu renderer
+// (it renders the jobs when requested or when no Vulkan device is available;
+// with validation, it renders the reference image of each GPU job, compares them
+// and measures the CPU time for the comparison with the GPU, for example with lavapipe)
+static bool useCpuRenderer = false;
+static bool validate = false;
+static CpuRenderer::Method cpuMethod = CpuRenderer::Method::Auto;
+static unsigned cpuThreads = 0;
+
+// framebuffer format
+// (B8G8R8A8 format is used when supported, so the rendered data are already
+// in bmp byte order and no swizzle is needed on the host)
+static vk::Format framebufferFormat = vk::Format::eR8G8B8A8Unorm;
+static BmpWriter::PixelOrder pixelOrder = BmpWriter::PixelOrder::RGBA;
+
+// job description
+// (scale is the height of the view in the complex plane;
+// Julia set is rendered when julia is true, Mandelbrot set otherwise)
+struct Job {
+	double centerX, centerY;
+	double scale;
+	bool julia;
+	float juliaX, juliaY;
+	vk::Extent2D extent;
+};
+static vector<Job> jobList;
+
+// view of the job
+// (coordinates of the image edges, as juliaCoords of the shaders)
+static CpuRenderer::View jobView(const Job& job)
+{
+	double halfHeight = job.scale / 2.;
+	double halfWidth = halfHeight * job.extent.width / job.extent.height;
+	return {
+		float(job.centerX - halfWidth), float(job.centerY - halfHeight),
+		float(job.centerX + halfWidth), float(job.centerY + halfHeight),
+		job.julia,
+		job.juliaX, job.juliaY,
+	};
+}
+
+
+// Vulkan instance
+// (it must be destructed as the last one)
+static vk::UniqueInstance instance;
+
+// Vulkan handles and objects
+// (they need to be placed in particular (not arbitrary) order
+// because they are destructed from the last one to the first one)
+static vk::PhysicalDevice physicalDevice;
+static uint32_t graphicsQueueFamily;
+static vk::UniqueDevice device;
+static vk::Queue graphicsQueue;
+static vk::UniqueRenderPass renderPass;
+static vk::UniqueShaderModule vsModule;
+static vk::UniqueShaderModule fsModule;
+static vk::UniquePipelineLayout pipelineLayout;
+static vk::UniquePipeline pipeline;
+static vk::UniqueCommandPool commandPool;
+static vk::UniqueQueryPool timestampPool;
+
+// resources of a single batch
+// (each job of the batch has its own framebuffer and its own part of the readback buffer;
+// while one batch is rendered, the other one is written into the files)
+struct BatchSlot {
+	vector<vk::UniqueImage> framebufferImages;
+	vector<vk::UniqueDeviceMemory> framebufferImageMemory;
+	vector<vk::UniqueImageView> frameImageViews;
+	vector<vk::UniqueFramebuffer> framebuffers;
+	vk::UniqueBuffer readbackBuffer;
+	vk::UniqueDeviceMemory readbackBufferMemory;
+	vk::UniqueCommandBuffer commandBuffer;
+	vk::UniqueFence renderingFinishedFence;
+	const char* mappedMemory = nullptr;
+	size_t firstJob = 0;
+	size_t numJobs = 0;
+};
+static array<BatchSlot, numBatchSlots> batchSlots;
+
+// shader code in SPIR-V binary
+static const uint32_t vsSpirv[] = {
+#include "shader.vert.spv"
+};
+static const uint32_t fsSpirv[] = {
+#include "shader.frag.spv"
+};
+
+
+// parse job file
+// (each non-empty line not starting by # contains one job:
+//    mandelbrot <centerX> <centerY> <scale> <width> <height>
+//    julia <centerX> <centerY> <scale> <juliaX> <juliaY> <width> <height>)
+static void loadJobs(const string& fileName)
+{
+	ifstream f(fileName);
+	if(!f)
+		throw runtime_error("Cannot open job file \"" + fileName + "\".");
+
+	string line;
+	for(size_t lineNumber=1; getline(f, line); lineNumber++) {
+
+		istringstream ss(line);
+		string type;
+		if(!(ss >> type) || type[0] == '#')
+			continue;
+
+		Job job;
+		if(type == "mandelbrot") {
+			job.julia = false;
+			job.juliaX = 0.f;
+			job.juliaY = 0.f;
+			ss >> job.centerX >> job.centerY >> job.scale >> job.extent.width >> job.extent.height;
+		}
+		else if(type == "julia") {
+			job.julia = true;
+			ss >> job.centerX >> job.centerY >> job.scale >> job.juliaX >> job.juliaY >> job.extent.width >> job.extent.height;
+		}
+		else
+			throw runtime_error("Unknown job type \"" + type + "\" on line " + to_string(lineNumber) + " of the job file.");
+		if(!ss || job.scale <= 0. || job.extent.width == 0 || job.extent.height == 0)
+			throw runtime_error("Invalid job on line " + to_string(lineNumber) + " of the job file.");
+
+		jobList.push_back(job);
+	}
+}
+
+
+// render all jobs by CpuRenderer
+// (the images are rendered in bmp byte order directly into the file content, so no conversion is needed)
+static void renderJobsOnCpu()
+{
+	CpuRenderer renderer;
+	renderer.start(cpuMethod, cpuThreads);
+	cout << "Rendering on CPU (" << CpuRenderer::methodName(renderer.method()) << ", "
+	     << renderer.numThreads() << " threads)." << endl;
+
+	AsyncFileWriter asyncWriter;
+	if(asyncWrites)
+		asyncWriter.open(asyncBackend, writeQueueDepth, directIO);
+
+	double writeTime = 0.;
+	uint64_t bytesWritten = 0;
+	vector<uint8_t> image;
+	auto startTime = chrono::steady_clock::now();
+
+	for(size_t jobIndex=0; jobIndex<jobList.size(); jobIndex++) {
+		const Job& job = jobList[jobIndex];
+		char number[16];
+		snprintf(number, sizeof(number), "%04zu", jobIndex);
+		size_t numJobPixels = size_t(job.extent.width) * job.extent.height;
+		if(asyncWrites) {
+			uint8_t* buffer = asyncWriter.acquireBuffer(BmpWriter::imageDataOffset + numJobPixels*4);
+			BmpWriter::storeHeaders(buffer, job.extent.width, job.extent.height);
+			renderer.render(jobView(job), job.extent.width, job.extent.height, buffer + BmpWriter::imageDataOffset,
+			                size_t(job.extent.width) * 4, BmpWriter::PixelOrder::BGRA);
+			auto t = chrono::steady_clock::now();
+			asyncWriter.submit(buffer, outputPrefix + number + ".bmp");
+			writeTime += chrono::duration<double>(chrono::steady_clock::now() - t).count();
+		}
+		else {
+			image.resize(numJobPixels*4);
+			renderer.render(jobView(job), job.extent.width, job.extent.height, image.data(),
+			                size_t(job.extent.width) * 4, BmpWriter::PixelOrder::BGRA);
+			BmpWriter writer;
+			writer.open(outputPrefix + number + ".bmp", job.extent.width, job.extent.height, writerMethod,
+			            BmpWriter::PixelOrder::BGRA);
+			writer.writeRows(image.data(), size_t(job.extent.width) * 4, 0, job.extent.height);
+			writer.close();
+			writeTime += writer.writeTime();
+			bytesWritten += writer.bytesWritten();
+		}
+	}
+	if(asyncWrites) {
+		auto t = chrono::steady_clock::now();
+		asyncWriter.close();
+		writeTime += chrono::duration<double>(chrono::steady_clock::now() - t).count();
+		bytesWritten = asyncWriter.bytesWritten();
+	}
+	double totalTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+	cout << "Done. Rendered " << jobList.size() << " jobs (" << double(renderer.numPixels())*1e-6 << " Mpix) in "
+	     << totalTime*1000 << " ms (" << double(jobList.size())/totalTime << " jobs/s)." << endl;
+	cout << "   CPU time:  " << renderer.renderTime()*1000 << " ms (" << renderer.throughput() << " Mpix/s, "
+	     << renderer.numSteals() << " steals)" << endl;
+	cout << "   Writing:   " << double(bytesWritten)/(1024*1024) << " MiB in " << writeTime*1000 << " ms ("
+	     << (writeTime>0. ? double(bytesWritten)/writeTime*1e-6 : 0.) << " MB/s)" << endl;
+}
+
+
+/// main function of the application
+int main(int argc, char* argv[])
+{
+	// catch exceptions
+	// (vulkan.hpp functions throw if they fail)
+	try {
+
+		// process command-line arguments
+		for(int i=1; i<argc; i++)
+			if(strcmp(argv[i], "--batch-size") == 0 && i+1 < argc &&
+			   sscanf(argv[i+1], "%zu", &batchSize) == 1 && batchSize != 0)
+				i++;
+			else if(strcmp(argv[i], "--output") == 0 && i+1 < argc) {
+				outputPrefix = argv[i+1];
+				i++;
+			}
+			else if(strcmp(argv[i], "--writer") == 0 && i+1 < argc) {
+				writerMethod = BmpWriter::methodFromName(argv[i+1]);
+				i++;
+			}
+			else if(strcmp(argv[i], "--async") == 0 && i+1 < argc) {
+				asyncWrites = (strcmp(argv[i+1], "none") != 0);
+				if(asyncWrites)
+					asyncBackend = AsyncFileWriter::backendFromName(argv[i+1]);
+				i++;
+			}
+			else if(strcmp(argv[i], "--queue-depth") == 0 && i+1 < argc &&
+			        sscanf(argv[i+1], "%u", &writeQueueDepth) == 1 && writeQueueDepth != 0)
+				i++;
+			else if(strcmp(argv[i], "--direct-io") == 0)
+				directIO = true;
+			else if(strcmp(argv[i], "--device") == 0 && i+1 < argc) {
+				requestedDevice = argv[i+1];
+				i++;
+			}
+			else if(strcmp(argv[i], "--renderer") == 0 && i+1 < argc &&
+			        (strcmp(argv[i+1], "gpu") == 0 || strcmp(argv[i+1], "cpu") == 0)) {
+				useCpuRenderer = (strcmp(argv[i+1], "cpu") == 0);
+				i++;
+			}
+			else if(strcmp(argv[i], "--cpu-method") == 0 && i+1 < argc) {
+				cpuMethod = CpuRenderer::methodFromName(argv[i+1]);
+				i++;
+			}
+			else if(strcmp(argv[i], "--threads") == 0 && i+1 < argc &&
+			        sscanf(argv[i+1], "%u", &cpuThreads) == 1)
+				i++;
+			else if(strcmp(argv[i], "--validate") == 0)
+				validate = true;
+			else if(argv[i][0] != '-' && jobFileName.empty())
+				jobFileName = argv[i];
+			else {
+				if(strcmp(argv[i], "--help") != 0 && strcmp(argv[i], "-h") != 0)
+					cout << "Unrecognized option: " << argv[i] << endl;
+				cout << appName << " usage:\n"
+				        "   " << appName << " [options] <jobFile>\n"
+				        "   --help or -h:  usage information\n"
+				        "   --batch-size <n>:  number of jobs recorded into single command buffer,\n"
+				        "                      default: 8\n"
+				        "   --output <prefix>:  prefix of the output files, the job number\n"
+				        "                       and .bmp suffix are appended, default: image-\n"
+				        "   --writer <method>:  method used to write the image data,\n"
+				        "                       auto, per-pixel, scalar, ssse3 or avx2,\n"
+				        "                       default: auto\n"
+				        "   --async <backend>:  write the files asynchronously, none, auto,\n"
+				        "                       io_uring or threads, default: none\n"
+				        "   --queue-depth <n>:  maximum number of asynchronous writes in flight,\n"
+				        "                       default: 16\n"
+				        "   --direct-io:  use O_DIRECT for asynchronous writes\n"
+				        "   --device <name>:  use the first compatible device whose name\n"
+				        "                     contains the given text, e.g. llvmpipe\n"
+				        "   --renderer <renderer>:  gpu or cpu, default: gpu, cpu is used\n"
+				        "                           also when no Vulkan device is available\n"
+				        "   --cpu-method <method>:  SIMD method of the cpu renderer,\n"
+				        "                           auto, scalar, avx2 or avx512, default: auto\n"
+				        "   --threads <n>:  number of cpu renderer threads,\n"
+				        "                   default: 0 meaning the number of CPU threads\n"
+				        "   --validate:  render each GPU job by the cpu renderer as well,\n"
+				        "                compare the images and report CPU time\n"
+				        "Job file contains one job per line:\n"
+				        "   mandelbrot <centerX> <centerY> <scale> <width> <height>\n"
+				        "   julia <centerX> <centerY> <scale> <juliaX> <juliaY> <width> <height>\n"
+				        "   (scale is the height of the view; lines starting by # are ignored)\n" << endl;
+				exit(99);
+			}
+		if(jobFileName.empty()) {
+			cout << "No job file given. Use --help for usage information." << endl;
+			exit(99);
+		}
+
+		// load jobs
+		loadJobs(jobFileName);
+		if(jobList.empty()) {
+			cout << "No jobs in \"" << jobFileName << "\"." << endl;
+			return 0;
+		}
+		batchSize = min(batchSize, jobList.size());
+		vk::Extent2D maxExtent(0, 0);
+		for(const Job& job : jobList) {
+			maxExtent.width = max(maxExtent.width, job.extent.width);
+			maxExtent.height = max(maxExtent.height, job.extent.height);
+		}
+		cout << "Loaded " << jobList.size() << " jobs, maximum resolution " << maxExtent.width << "x" << maxExtent.height
+		     << ", batch size " << batchSize << "." << endl;
+
+		// cpu renderer
+		if(useCpuRenderer) {
+			renderJobsOnCpu();
+			return 0;
+		}
+
+		// Vulkan instance
+		// (missing Vulkan driver falls back to the cpu renderer)
+		try {
+			instance =
+				vk::createInstanceUnique(
+					vk::InstanceCreateInfo{
+						vk::InstanceCreateFlags(),  // flags
+						&(const vk::ApplicationInfo&)vk::ApplicationInfo{
+							appName,                 // application name
+							VK_MAKE_VERSION(0,0,0),  // application version
+							nullptr,                 // engine name
+							VK_MAKE_VERSION(0,0,0),  // engine version
+							VK_API_VERSION_1_0,      // api version
+						},
+						0, nullptr,  // no layers
+						0, nullptr,  // no extensions
+					});
+		} catch(vk::Error& e) {
+			cout << "Vulkan instance cannot be created (" << e.what() << "). Falling back to the cpu renderer." << endl;
+			renderJobsOnCpu();
+			return 0;
+		}
+
+		// find compatible devices
+		// (the device must have a queue supporting graphics operations)
+		vector<vk::PhysicalDevice> deviceList = instance->enumeratePhysicalDevices();
+		vector<tuple<vk::PhysicalDevice, uint32_t>> compatibleDevices;
+		for(vk::PhysicalDevice pd : deviceList) {
+
+			// select queue for graphics rendering
+			vector<vk::QueueFamilyProperties> queueFamilyList = pd.getQueueFamilyProperties();
+			for(uint32_t i=0, c=uint32_t(queueFamilyList.size()); i<c; i++) {
+				if(queueFamilyList[i].queueFlags & vk::QueueFlagBits::eGraphics) {
+					if(requestedDevice.empty() || strstr(pd.getProperties().deviceName, requestedDevice.c_str()))
+						compatibleDevices.emplace_back(pd, i);
+					break;
+				}
+			}
+		}
+
+		// print devices
+		cout << "Vulkan devices:" << endl;
+		for(vk::PhysicalDevice pd : deviceList)
+			cout << "   " << pd.getProperties().deviceName << endl;
+		cout << "Compatible devices:" << endl;
+		for(auto& t : compatibleDevices)
+			cout << "   " << get<0>(t).getProperties().deviceName << endl;
+
+		// choose device
+		if(compatibleDevices.empty()) {
+			if(!requestedDevice.empty())
+				throw runtime_error("No compatible device matching \"" + requestedDevice + "\".");
+			cout << "No compatible devices. Falling back to the cpu renderer." << endl;
+			renderJobsOnCpu();
+			return 0;
+		}
+		physicalDevice = get<0>(compatibleDevices.front());
+		graphicsQueueFamily = get<1>(compatibleDevices.front());
+		cout << "Using device:\n"
+		        "   " << physicalDevice.getProperties().deviceName << endl;
+
+		// create device
+		device =
+			physicalDevice.createDeviceUnique(
+				vk::DeviceCreateInfo{
+					vk::DeviceCreateFlags(),  // flags
+					1,                        // queueCreateInfoCount
+					array{                    // pQueueCreateInfos
+						vk::DeviceQueueCreateInfo{
+							vk::DeviceQueueCreateFlags(),  // flags
+							graphicsQueueFamily,  // queueFamilyIndex
+							1,                    // queueCount
+							&(const float&)1.f,   // pQueuePriorities
+						},
+					}.data(),
+					0, nullptr,  // no layers
+					0, nullptr,  // number of enabled extensions, enabled extension names
+					nullptr,     // enabled features
+				}
+			);
+
+		// get queues
+		graphicsQueue = device->getQueue(graphicsQueueFamily, 0);
+
+
+		// check image size
+		vk::PhysicalDeviceLimits limits = physicalDevice.getProperties().limits;
+		if(maxExtent.width > limits.maxImageDimension2D || maxExtent.height > limits.maxImageDimension2D ||
+		   maxExtent.width > limits.maxFramebufferWidth || maxExtent.height > limits.maxFramebufferHeight)
+			throw runtime_error("Job resolution exceeds device limits.");
+
+		// framebuffer format
+		vk::FormatProperties bgraProperties = physicalDevice.getFormatProperties(vk::Format::eB8G8R8A8Unorm);
+		if(bgraProperties.optimalTilingFeatures & vk::FormatFeatureFlagBits::eColorAttachment) {
+			framebufferFormat = vk::Format::eB8G8R8A8Unorm;
+			pixelOrder = BmpWriter::PixelOrder::BGRA;
+		}
+		cout << "Framebuffer format: " << vk::to_string(framebufferFormat) << endl;
+
+		// render pass
+		renderPass =
+			device->createRenderPassUnique(
+				vk::RenderPassCreateInfo(
+					vk::RenderPassCreateFlags(),  // flags
+					1,                            // attachmentCount
+					array{  // pAttachments
+						vk::AttachmentDescription(
+							vk::AttachmentDescriptionFlags(),  // flags
+							framebufferFormat,                 // format
+							vk::SampleCountFlagBits::e1,       // samples
+							vk::AttachmentLoadOp::eDontCare,   // loadOp
+							vk::AttachmentStoreOp::eStore,     // storeOp
+							vk::AttachmentLoadOp::eDontCare,   // stencilLoadOp
+							vk::AttachmentStoreOp::eDontCare,  // stencilStoreOp
+							vk::ImageLayout::eUndefined,       // initialLayout
+							vk::ImageLayout::eTransferSrcOptimal  // finalLayout
+						),
+					}.data(),
+					1,  // subpassCount
+					array{  // pSubpasses
+						vk::SubpassDescription(
+							vk::SubpassDescriptionFlags(),     // flags
+							vk::PipelineBindPoint::eGraphics,  // pipelineBindPoint
+							0,        // inputAttachmentCount
+							nullptr,  // pInputAttachments
+							1,        // colorAttachmentCount
+							array{    // pColorAttachments
+								vk::AttachmentReference(
+									0,  // attachment
+									vk::ImageLayout::eColorAttachmentOptimal  // layout
+								),
+							}.data(),
+							nullptr,  // pResolveAttachments
+							nullptr,  // pDepthStencilAttachment
+							0,        // preserveAttachmentCount
+							nullptr   // pPreserveAttachments
+						),
+					}.data(),
+					1,  // dependencyCount
+					array{  // pDependencies
+						vk::SubpassDependency(
+							0,  // srcSubpass
+							VK_SUBPASS_EXTERNAL,  // dstSubpass
+							vk::PipelineStageFlagBits::eColorAttachmentOutput,  // srcStageMask
+							vk::PipelineStageFlagBits::eTransfer,  // dstStageMask
+							vk::AccessFlagBits::eColorAttachmentWrite,  // srcAccessMask
+							vk::AccessFlagBits::eTransferRead,  // dstAccessMask
+							vk::DependencyFlags()  // dependencyFlags
+						),
+					}.data()
+				)
+			);
+
+
+		// create shader modules
+		vsModule =
+			device->createShaderModuleUnique(
+				vk::ShaderModuleCreateInfo(
+					vk::ShaderModuleCreateFlags(),  // flags
+					sizeof(vsSpirv),  // codeSize
+					vsSpirv  // pCode
+				)
+			);
+		fsModule =
+			device->createShaderModuleUnique(
+				vk::ShaderModuleCreateInfo(
+					vk::ShaderModuleCreateFlags(),  // flags
+					sizeof(fsSpirv),  // codeSize
+					fsSpirv  // pCode
+				)
+			);
+
+		// pipeline layout
+		pipelineLayout =
+			device->createPipelineLayoutUnique(
+				vk::PipelineLayoutCreateInfo{
+					vk::PipelineLayoutCreateFlags(),  // flags
+					0,       // setLayoutCount
+					nullptr, // pSetLayouts
+					1,       // pushConstantRangeCount
+					&(const vk::PushConstantRange&)vk::PushConstantRange{  // pPushConstantRanges
+						vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,  // stageFlags
+						0,  // offset
+						32  // size
+					},
+				}
+			);
+
+		// pipeline
+		// (viewport and scissor are dynamic because the jobs might use different resolutions)
+		tie(ignore, pipeline) =
+			device->createGraphicsPipelineUnique(
+				nullptr,  // pipelineCache
+				vk::GraphicsPipelineCreateInfo(
+					vk::PipelineCreateFlags(),  // flags
+
+					// shader stages
+					2,  // stageCount
+					array{  // pStages
+						vk::PipelineShaderStageCreateInfo{
+							vk::PipelineShaderStageCreateFlags(),  // flags
+							vk::ShaderStageFlagBits::eVertex,      // stage
+							vsModule.get(),  // module
+							"main",  // pName
+							nullptr  // pSpecializationInfo
+						},
+						vk::PipelineShaderStageCreateInfo{
+							vk::PipelineShaderStageCreateFlags(),  // flags
+							vk::ShaderStageFlagBits::eFragment,    // stage
+							fsModule.get(),  // module
+							"main",  // pName
+							nullptr  // pSpecializationInfo
+						},
+					}.data(),
+
+					// vertex input
+					&(const vk::PipelineVertexInputStateCreateInfo&)vk::PipelineVertexInputStateCreateInfo{  // pVertexInputState
+						vk::PipelineVertexInputStateCreateFlags(),  // flags
+						0,        // vertexBindingDescriptionCount
+						nullptr,  // pVertexBindingDescriptions
+						0,        // vertexAttributeDescriptionCount
+						nullptr   // pVertexAttributeDescriptions
+					},
+
+					// input assembly
+					&(const vk::PipelineInputAssemblyStateCreateInfo&)vk::PipelineInputAssemblyStateCreateInfo{  // pInputAssemblyState
+						vk::PipelineInputAssemblyStateCreateFlags(),  // flags
+						vk::PrimitiveTopology::eTriangleStrip,  // topology
+						VK_FALSE  // primitiveRestartEnable
+					},
+
+					// tessellation
+					nullptr, // pTessellationState
+
+					// viewport
+					&(const vk::PipelineViewportStateCreateInfo&)vk::PipelineViewportStateCreateInfo{  // pViewportState
+						vk::PipelineViewportStateCreateFlags(),  // flags
+						1,        // viewportCount
+						nullptr,  // pViewports
+						1,        // scissorCount
+						nullptr   // pScissors
+					},
+
+					// rasterization
+					&(const vk::PipelineRasterizationStateCreateInfo&)vk::PipelineRasterizationStateCreateInfo{  // pRasterizationState
+						vk::PipelineRasterizationStateCreateFlags(),  // flags
+						VK_FALSE,  // depthClampEnable
+						VK_FALSE,  // rasterizerDiscardEnable
+						vk::PolygonMode::eFill,  // polygonMode
+						vk::CullModeFlagBits::eNone,  // cullMode
+						vk::FrontFace::eCounterClockwise,  // frontFace
+						VK_FALSE,  // depthBiasEnable
+						0.f,  // depthBiasConstantFactor
+						0.f,  // depthBiasClamp
+						0.f,  // depthBiasSlopeFactor
+						1.f   // lineWidth
+					},
+
+					// multisampling
+					&(const vk::PipelineMultisampleStateCreateInfo&)vk::PipelineMultisampleStateCreateInfo{  // pMultisampleState
+						vk::PipelineMultisampleStateCreateFlags(),  // flags
+						vk::SampleCountFlagBits::e1,  // rasterizationSamples
+						VK_FALSE,  // sampleShadingEnable
+						0.f,       // minSampleShading
+						nullptr,   // pSampleMask
+						VK_FALSE,  // alphaToCoverageEnable
+						VK_FALSE   // alphaToOneEnable
+					},
+
+					// depth and stencil
+					nullptr,  // pDepthStencilState
+
+					// blending
+					&(const vk::PipelineColorBlendStateCreateInfo&)vk::PipelineColorBlendStateCreateInfo{  // pColorBlendState
+						vk::PipelineColorBlendStateCreateFlags(),  // flags
+						VK_FALSE,  // logicOpEnable
+						vk::LogicOp::eClear,  // logicOp
+						1,  // attachmentCount
+						array{  // pAttachments
+							vk::PipelineColorBlendAttachmentState{
+								VK_FALSE,  // blendEnable
+								vk::BlendFactor::eZero,  // srcColorBlendFactor
+								vk::BlendFactor::eZero,  // dstColorBlendFactor
+								vk::BlendOp::eAdd,       // colorBlendOp
+								vk::BlendFactor::eZero,  // srcAlphaBlendFactor
+								vk::BlendFactor::eZero,  // dstAlphaBlendFactor
+								vk::BlendOp::eAdd,       // alphaBlendOp
+								vk::ColorComponentFlagBits::eR | vk::ColorComponentFlagBits::eG |
+									vk::ColorComponentFlagBits::eB | vk::ColorComponentFlagBits::eA  // colorWriteMask
+							},
+						}.data(),
+						array<float,4>{0.f,0.f,0.f,0.f}  // blendConstants
+					},
+
+					// dynamic state
+					&(const vk::PipelineDynamicStateCreateInfo&)vk::PipelineDynamicStateCreateInfo{  // pDynamicState
+						vk::PipelineDynamicStateCreateFlags(),  // flags
+						2,  // dynamicStateCount
+						array{  // pDynamicStates
+							vk::DynamicState::eViewport,
+							vk::DynamicState::eScissor,
+						}.data()
+					},
+
+					pipelineLayout.get(),  // layout
+					renderPass.get(),  // renderPass
+					0,  // subpass
+					vk::Pipeline(nullptr),  // basePipelineHandle
+					-1 // basePipelineIndex
+				)
+			).asTuple();
+
+
+		// memory allocation functions
+		auto allocateMemory =
+			[](vk::Image image, vk::MemoryPropertyFlags requiredFlags) -> vk::UniqueDeviceMemory{
+				vk::MemoryRequirements memoryRequirements = device->getImageMemoryRequirements(image);
+				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+				for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+					if(memoryRequirements.memoryTypeBits & (1<<i))
+						if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
+							return
+								device->allocateMemoryUnique(
+									vk::MemoryAllocateInfo(
+										memoryRequirements.size,  // allocationSize
+										i                         // memoryTypeIndex
+									)
+								);
+				throw std::runtime_error("No suitable memory type found for image.");
+			};
+		auto allocateBufferMemory =
+			[](vk::Buffer buffer, initializer_list<vk::MemoryPropertyFlags> flagCandidates) -> vk::UniqueDeviceMemory{
+				vk::MemoryRequirements memoryRequirements = device->getBufferMemoryRequirements(buffer);
+				vk::PhysicalDeviceMemoryProperties memoryProperties = physicalDevice.getMemoryProperties();
+				for(vk::MemoryPropertyFlags requiredFlags : flagCandidates)
+					for(uint32_t i=0; i<memoryProperties.memoryTypeCount; i++)
+						if(memoryRequirements.memoryTypeBits & (1<<i))
+							if((memoryProperties.memoryTypes[i].propertyFlags & requiredFlags) == requiredFlags)
+								return
+									device->allocateMemoryUnique(
+										vk::MemoryAllocateInfo(
+											memoryRequirements.size,  // allocationSize
+											i                         // memoryTypeIndex
+										)
+									);
+				throw std::runtime_error("No suitable memory type found for buffer.");
+			};
+
+		// command pool
+		// (command buffers are recorded again for each batch)
+		commandPool =
+			device->createCommandPoolUnique(
+				vk::CommandPoolCreateInfo(
+					vk::CommandPoolCreateFlagBits::eResetCommandBuffer,  // flags
+					graphicsQueueFamily  // queueFamilyIndex
+				)
+			);
+
+		// allocate command buffers
+		vector<vk::UniqueCommandBuffer> commandBuffers =
+			device->allocateCommandBuffersUnique(
+				vk::CommandBufferAllocateInfo(
+					commandPool.get(),                 // commandPool
+					vk::CommandBufferLevel::ePrimary,  // level
+					uint32_t(numBatchSlots)            // commandBufferCount
+				)
+			);
+
+		// create resources of batch slots
+		// (all the framebuffers have the maximum resolution of the jobs;
+		// each job uses just the part given by its resolution)
+		const vk::DeviceSize jobDataSize = vk::DeviceSize(maxExtent.width) * maxExtent.height * 4;
+		for(size_t slotIndex=0; slotIndex<numBatchSlots; slotIndex++) {
+
+			BatchSlot& slot = batchSlots[slotIndex];
+
+			for(size_t i=0; i<batchSize; i++) {
+
+				// framebuffer image
+				vk::UniqueImage& image = slot.framebufferImages.emplace_back(
+					device->createImageUnique(
+						vk::ImageCreateInfo(
+							vk::ImageCreateFlags(),       // flags
+							vk::ImageType::e2D,           // imageType
+							framebufferFormat,            // format
+							vk::Extent3D(maxExtent.width, maxExtent.height, 1),  // extent
+							1,                            // mipLevels
+							1,                            // arrayLayers
+							vk::SampleCountFlagBits::e1,  // samples
+							vk::ImageTiling::eOptimal,    // tiling
+							vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc,  // usage
+							vk::SharingMode::eExclusive,  // sharingMode
+							0,                            // queueFamilyIndexCount
+							nullptr,                      // pQueueFamilyIndices
+							vk::ImageLayout::eUndefined   // initialLayout
+						)
+					)
+				);
+				vk::UniqueDeviceMemory& memory = slot.framebufferImageMemory.emplace_back(
+					allocateMemory(image.get(), vk::MemoryPropertyFlagBits::eDeviceLocal));
+				device->bindImageMemory(
+					image.get(),   // image
+					memory.get(),  // memory
+					0              // memoryOffset
+				);
+
+				// image view
+				vk::UniqueImageView& imageView = slot.frameImageViews.emplace_back(
+					device->createImageViewUnique(
+						vk::ImageViewCreateInfo(
+							vk::ImageViewCreateFlags(),  // flags
+							image.get(),                 // image
+							vk::ImageViewType::e2D,      // viewType
+							framebufferFormat,           // format
+							vk::ComponentMapping(),      // components
+							vk::ImageSubresourceRange(   // subresourceRange
+								vk::ImageAspectFlagBits::eColor,  // aspectMask
+								0,  // baseMipLevel
+								1,  // levelCount
+								0,  // baseArrayLayer
+								1   // layerCount
+							)
+						)
+					)
+				);
+
+				// framebuffer
+				slot.framebuffers.emplace_back(
+					device->createFramebufferUnique(
+						vk::FramebufferCreateInfo(
+							vk::FramebufferCreateFlags(),  // flags
+							renderPass.get(),              // renderPass
+							1, &imageView.get(),           // attachmentCount, pAttachments
+							maxExtent.width,               // width
+							maxExtent.height,              // height
+							1  // layers
+						)
+					)
+				);
+			}
+
+			// readback buffer
+			// (each job of the batch uses jobDataSize bytes with tightly packed rows;
+			// host cached memory is preferred as the host reads the data)
+			slot.readbackBuffer =
+				device->createBufferUnique(
+					vk::BufferCreateInfo(
+						vk::BufferCreateFlags(),  // flags
+						jobDataSize * batchSize,  // size
+						vk::BufferUsageFlagBits::eTransferDst,  // usage
+						vk::SharingMode::eExclusive,  // sharingMode
+						0,        // queueFamilyIndexCount
+						nullptr   // pQueueFamilyIndices
+					)
+				);
+			slot.readbackBufferMemory =
+				allocateBufferMemory(
+					slot.readbackBuffer.get(),
+					{ vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCached,
+					  vk::MemoryPropertyFlagBits::eHostVisible }
+				);
+			device->bindBufferMemory(
+				slot.readbackBuffer.get(),        // buffer
+				slot.readbackBufferMemory.get(),  // memory
+				0                                 // memoryOffset
+			);
+
+			// map memory
+			// (the memory stays mapped until it is freed)
+			slot.mappedMemory = reinterpret_cast<const char*>(
+				device->mapMemory(slot.readbackBufferMemory.get(), 0, VK_WHOLE_SIZE, vk::MemoryMapFlags()));
+
+			// command buffer
+			slot.commandBuffer = std::move(commandBuffers[slotIndex]);
+
+			// fence
+			slot.renderingFinishedFence =
+				device->createFenceUnique(
+					vk::FenceCreateInfo{
+						vk::FenceCreateFlags()  // flags
+					}
+				);
+		}
+
+		// timestamp pool
+		// (two timestamps per batch slot are used to measure the GPU time of each batch)
+		uint32_t timestampValidBits = physicalDevice.getQueueFamilyProperties()[graphicsQueueFamily].timestampValidBits;
+		uint64_t timestampMask = timestampValidBits>=64 ? ~uint64_t(0) : (uint64_t(1) << timestampValidBits) - 1;
+		float timestampPeriod_ns = limits.timestampPeriod;
+		if(timestampValidBits != 0)
+			timestampPool =
+				device->createQueryPoolUnique(
+					vk::QueryPoolCreateInfo(
+						vk::QueryPoolCreateFlags(),  // flags
+						vk::QueryType::eTimestamp,  // queryType
+						uint32_t(numBatchSlots*2),  // queryCount
+						vk::QueryPipelineStatisticFlags()  // pipelineStatistics
+					)
+				);
+
+
+		// asynchronous writer
+		AsyncFileWriter asyncWriter;
+		if(asyncWrites)
+			asyncWriter.open(asyncBackend, writeQueueDepth, directIO);
+
+		// validation
+		// (the reference images are rendered in the byte order of the framebuffer)
+		CpuRenderer cpuRenderer;
+		vector<uint8_t> referenceImage;
+		uint64_t numMismatchedPixels = 0;
+		unsigned maxChannelDifference = 0;
+		if(validate)
+			cpuRenderer.start(cpuMethod, cpuThreads);
+
+		// statistics
+		double gpuTime = 0.;
+		double writeTime = 0.;
+		uint64_t numPixels = 0;
+		uint64_t bytesWritten = 0;
+		const char* usedConversion = "";
+		auto startTime = chrono::steady_clock::now();
+
+		// function to record and submit all the jobs of the batch
+		auto renderBatch =
+			[&](BatchSlot& slot, size_t firstJob, size_t numJobs) {
+
+				// begin command buffer
+				slot.commandBuffer->begin(
+					vk::CommandBufferBeginInfo(
+						vk::CommandBufferUsageFlagBits::eOneTimeSubmit,  // flags
+						nullptr  // pInheritanceInfo
+					)
+				);
+
+				// timestamp at the beginning of the batch
+				uint32_t queryIndex = uint32_t(&slot - batchSlots.data()) * 2;
+				if(timestampPool) {
+					slot.commandBuffer->resetQueryPool(timestampPool.get(), queryIndex, 2);
+					slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, timestampPool.get(), queryIndex);
+				}
+
+				// bind pipeline
+				// (it stays bound for all the render passes of the command buffer)
+				slot.commandBuffer->bindPipeline(vk::PipelineBindPoint::eGraphics, pipeline.get());
+
+				for(size_t i=0; i<numJobs; i++) {
+
+					const Job& job = jobList[firstJob+i];
+
+					// begin render pass
+					slot.commandBuffer->beginRenderPass(
+						vk::RenderPassBeginInfo(
+							renderPass.get(),           // renderPass
+							slot.framebuffers[i].get(), // framebuffer
+							vk::Rect2D(vk::Offset2D(0,0), job.extent),  // renderArea
+							0,       // clearValueCount
+							nullptr  // pClearValues
+						),
+						vk::SubpassContents::eInline
+					);
+
+					// viewport and scissor
+					slot.commandBuffer->setViewport(
+						0,  // firstViewport
+						vk::Viewport(0.f, 0.f, float(job.extent.width), float(job.extent.height), 0.f, 1.f)  // viewports
+					);
+					slot.commandBuffer->setScissor(
+						0,  // firstScissor
+						vk::Rect2D(vk::Offset2D(0,0), job.extent)  // scissors
+					);
+
+					// push constants
+					// (the view is given by its corners, computed from the center and scale of the job)
+					struct PushData {
+						float juliaCoords[4];
+						int viewPlane;
+						int dummy;
+						float constantParameters[2];
+					};
+					CpuRenderer::View view = jobView(job);
+					slot.commandBuffer->pushConstants(
+						pipelineLayout.get(),  // layout
+						vk::ShaderStageFlagBits::eVertex | vk::ShaderStageFlagBits::eFragment,  // stageFlags
+						0,  // offset
+						32,  // size
+						&(const PushData&)PushData{  // pValues
+							view.x0, view.y0, view.x1, view.y1,
+							job.julia ? 1 : 0,
+							0,
+							job.juliaX, job.juliaY,
+						}
+					);
+
+					// draw the view
+					slot.commandBuffer->draw(4, 1, 0, 0);
+
+					// end render pass
+					slot.commandBuffer->endRenderPass();
+
+					// copy framebuffer image to the job's part of the readback buffer
+					slot.commandBuffer->copyImageToBuffer(
+						slot.framebufferImages[i].get(), vk::ImageLayout::eTransferSrcOptimal,  // srcImage, srcImageLayout
+						slot.readbackBuffer.get(),  // dstBuffer
+						vk::BufferImageCopy(  // regions
+							jobDataSize * i,  // bufferOffset
+							0,  // bufferRowLength
+							0,  // bufferImageHeight
+							vk::ImageSubresourceLayers(  // imageSubresource
+								vk::ImageAspectFlagBits::eColor,  // aspectMask
+								0,  // mipLevel
+								0,  // baseArrayLayer
+								1   // layerCount
+							),
+							vk::Offset3D(0,0,0),  // imageOffset
+							vk::Extent3D(job.extent.width, job.extent.height, 1)  // imageExtent
+						)
+					);
+				}
+
+				// make the copied data available to the host
+				slot.commandBuffer->pipelineBarrier(
+					vk::PipelineStageFlagBits::eTransfer,  // srcStageMask
+					vk::PipelineStageFlagBits::eHost,      // dstStageMask
+					vk::DependencyFlags(),  // dependencyFlags
+					vk::MemoryBarrier(  // memoryBarriers
+						vk::AccessFlagBits::eTransferWrite,  // srcAccessMask
+						vk::AccessFlagBits::eHostRead        // dstAccessMask
+					),
+					nullptr,  // bufferMemoryBarriers
+					nullptr   // imageMemoryBarriers
+				);
+
+				// timestamp at the end of the batch
+				if(timestampPool)
+					slot.commandBuffer->writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, timestampPool.get(), queryIndex+1);
+
+				// end command buffer
+				slot.commandBuffer->end();
+
+				// submit work
+				graphicsQueue.submit(
+					vk::SubmitInfo(  // submits
+						0, nullptr, nullptr,            // waitSemaphoreCount, pWaitSemaphores, pWaitDstStageMask
+						1, &slot.commandBuffer.get(),   // commandBufferCount, pCommandBuffers
+						0, nullptr                      // signalSemaphoreCount, pSignalSemaphores
+					),
+					slot.renderingFinishedFence.get()  // fence
+				);
+				slot.firstJob = firstJob;
+				slot.numJobs = numJobs;
+			};
+
+		// function to wait for the batch and to write its images
+		auto writeBatch =
+			[&](BatchSlot& slot) {
+
+				// wait for the work
+				vk::Result r = device->waitForFences(
+					slot.renderingFinishedFence.get(),  // fences (vk::ArrayProxy)
+					VK_TRUE,       // waitAll
+					uint64_t(3e9)  // timeout (3s)
+				);
+				if(r == vk::Result::eTimeout)
+					throw std::runtime_error("GPU timeout. Task is probably hanging.");
+				device->resetFences(slot.renderingFinishedFence.get());
+
+				// read timestamps
+				if(timestampPool) {
+					array<uint64_t,2> timestamps;
+					vk::Result r = device->getQueryPoolResults(
+						timestampPool.get(),  // queryPool
+						uint32_t(&slot - batchSlots.data()) * 2,  // firstQuery
+						2,  // queryCount
+						sizeof(timestamps),  // dataSize
+						timestamps.data(),  // pData
+						sizeof(uint64_t),  // stride
+						vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait  // flags
+					);
+					if(r != vk::Result::eSuccess)
+						throw std::runtime_error("vkGetQueryPoolResults() did not finish with VK_SUCCESS result.");
+					gpuTime += double((timestamps[1] - timestamps[0]) & timestampMask) * timestampPeriod_ns * 1e-9;
+				}
+
+				// invalidate caches to fetch a new content
+				// (this is required as we might be using non-coherent memory, see vk::MemoryPropertyFlagBits::eHostCoherent)
+				device->invalidateMappedMemoryRanges(
+					vk::MappedMemoryRange(
+						slot.readbackBufferMemory.get(),  // memory
+						0,  // offset
+						VK_WHOLE_SIZE  // size
+					)
+				);
+
+				// write images
+				for(size_t i=0; i<slot.numJobs; i++) {
+					size_t jobIndex = slot.firstJob + i;
+					const Job& job = jobList[jobIndex];
+					char number[16];
+					snprintf(number, sizeof(number), "%04zu", jobIndex);
+					size_t numJobPixels = size_t(job.extent.width) * job.extent.height;
+					if(validate) {
+						referenceImage.resize(numJobPixels*4);
+						cpuRenderer.render(jobView(job), job.extent.width, job.extent.height, referenceImage.data(),
+						                   size_t(job.extent.width) * 4, pixelOrder);
+						const uint8_t* gpuImage = reinterpret_cast<const uint8_t*>(slot.mappedMemory + jobDataSize*i);
+						for(size_t p=0; p<numJobPixels; p++) {
+							unsigned d = 0;
+							for(size_t c=0; c<4; c++)
+								d = max(d, unsigned(abs(int(gpuImage[p*4+c]) - int(referenceImage[p*4+c]))));
+							if(d != 0) {
+								numMismatchedPixels++;
+								maxChannelDifference = max(maxChannelDifference, d);
+							}
+						}
+					}
+					if(asyncWrites) {
+
+						// build the bmp file in the memory and pass it to the async writer
+						// (acquireBuffer() blocks when the write queue is full)
+						auto t = chrono::steady_clock::now();
+						uint8_t* buffer = asyncWriter.acquireBuffer(BmpWriter::imageDataOffset + numJobPixels*4);
+						BmpWriter::storeHeaders(buffer, job.extent.width, job.extent.height);
+						if(pixelOrder == BmpWriter::PixelOrder::BGRA) {
+							memcpy(buffer + BmpWriter::imageDataOffset, slot.mappedMemory + jobDataSize*i, numJobPixels*4);
+							usedConversion = "none";
+						}
+						else {
+							BmpWriter::Method m = (writerMethod == BmpWriter::Method::Auto) ? BmpWriter::bestMethod() : writerMethod;
+							BmpWriter::convertRow(slot.mappedMemory + jobDataSize*i, buffer + BmpWriter::imageDataOffset, numJobPixels, m);
+							usedConversion = BmpWriter::methodName(m);
+						}
+						asyncWriter.submit(buffer, outputPrefix + number + ".bmp");
+						writeTime += chrono::duration<double>(chrono::steady_clock::now() - t).count();
+
+					}
+					else {
+
+						// write the file synchronously
+						BmpWriter writer;
+						writer.open(outputPrefix + number + ".bmp", job.extent.width, job.extent.height, writerMethod, pixelOrder);
+						writer.writeRows(
+							slot.mappedMemory + jobDataSize*i,  // data
+							size_t(job.extent.width) * 4,  // rowPitch
+							0,  // y
+							job.extent.height  // numRows
+						);
+						writer.close();
+						writeTime += writer.writeTime();
+						bytesWritten += writer.bytesWritten();
+						usedConversion = writer.conversionName();
+
+					}
+					numPixels += numJobPixels;
+				}
+				slot.numJobs = 0;
+			};
+
+		// process all the batches
+		// (while one batch is rendered, the previous one is written into the files)
+		size_t batchIndex = 0;
+		for(size_t firstJob=0; firstJob<jobList.size(); firstJob+=batchSize, batchIndex++) {
+			BatchSlot& slot = batchSlots[batchIndex % numBatchSlots];
+			if(slot.numJobs != 0)
+				writeBatch(slot);
+			renderBatch(slot, firstJob, min(batchSize, jobList.size() - firstJob));
+		}
+
+		// write the remaining batches in the order of their submission
+		for(size_t i=0; i<numBatchSlots; i++) {
+			BatchSlot& slot = batchSlots[(batchIndex + i) % numBatchSlots];
+			if(slot.numJobs != 0)
+				writeBatch(slot);
+		}
+		if(asyncWrites) {
+			auto t = chrono::steady_clock::now();
+			asyncWriter.close();
+			writeTime += chrono::duration<double>(chrono::steady_clock::now() - t).count();
+			bytesWritten = asyncWriter.bytesWritten();
+		}
+		double totalTime = chrono::duration<double>(chrono::steady_clock::now() - startTime).count();
+
+		// print statistics
+		cout << "Done. Rendered " << jobList.size() << " jobs (" << double(numPixels)*1e-6 << " Mpix) in "
+		     << totalTime*1000 << " ms (" << double(jobList.size())/totalTime << " jobs/s)." << endl;
+		if(timestampPool) {
+			cout << "   GPU time:  " << gpuTime*1000 << " ms (";
+			if(gpuTime > 0.)
+				cout << double(numPixels)/gpuTime*1e-6;
+			else
+				cout << "-";
+			cout << " Mpix/s)" << endl;
+		}
+		else
+			cout << "   GPU time:  timestamps not supported" << endl;
+		if(validate) {
+			cout << "   CPU time:  " << cpuRenderer.renderTime()*1000 << " ms (" << cpuRenderer.throughput() << " Mpix/s, "
+			     << CpuRenderer::methodName(cpuRenderer.method()) << ", " << cpuRenderer.numThreads() << " threads)" << endl;
+			cout << "   Validation:  " << numMismatchedPixels << " of " << numPixels << " pixels differ from the cpu renderer ("
+			     << double(numMismatchedPixels)/numPixels*100 << "%, max channel difference " << maxChannelDifference << ")" << endl;
+		}
+		cout << "   Writing:   " << double(bytesWritten)/(1024*1024) << " MiB in " << writeTime*1000 << " ms ("
+		     << (writeTime>0. ? double(bytesWritten)/writeTime*1e-6 : 0.) << " MB/s, "
+		     << usedConversion << " writer)" << endl;
+		if(asyncWrites) {
+			cout << "   Async writes:  " << asyncWriter.numWrites() << " files by " << AsyncFileWriter::backendName(asyncWriter.backend())
+			     << (asyncWriter.directIO() ? " with direct I/O" : "") << ", render thread stalled for "
+			     << asyncWriter.stallTime()*1000 << " ms" << endl;
+			cout << "   Queue depth:   " << asyncWriter.averageQueueDepth() << " average, "
+			     << asyncWriter.maxQueueDepth() << " max, " << asyncWriter.queueDepth() << " limit" << endl;
+			cout << "   Write latency: " << asyncWriter.latencyPercentile(50)*1000 << " ms p50, "
+			     << asyncWriter.latencyPercentile(90)*1000 << " ms p90, "
+			     << asyncWriter.latencyPercentile(99)*1000 << " ms p99, "
+			     << asyncWriter.latencyPercentile(100)*1000 << " ms max" << endl;
+		}
+
+	// catch exceptions
+	} catch(vk::Error& e) {
+		cout << "Failed because of Vulkan exception: " << e.what() << endl;
+	} catch(exception& e) {
+		cout << "Failed because of exception: " << e.what() << endl;
+	} catch(...) {
+		cout << "Failed because of unspecified exception." << endl;
+	}
+
+	// wait device idle
+	// this is important if there was an exception and device is still busy
+	// (device need to be idle before destruction of buffers and other stuff)
+	if(device)
+		device->waitIdle();
+
+	return 0;
+}
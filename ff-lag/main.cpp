@@ -1,4 +1,5 @@
 #include "VulkanWindow.h"
+#include "PipelineCache.h"
 #include "Timestamps.h"
 #include <algorithm>
 #include <chrono>
@@ -37,6 +38,7 @@ static vk::PhysicalDevice physicalDevice;
 static uint32_t graphicsQueueFamily;
 static uint32_t presentationQueueFamily;
 static vk::UniqueDevice device;
+static PipelineCache pipelineCache;
 static vk::Queue graphicsQueue;
 static vk::Queue presentationQueue;
 static vk::SurfaceFormatKHR surfaceFormat;
@@ -336,6 +338,10 @@ int main(int argc, char** argv)
 		graphicsQueue = device->getQueue(graphicsQueueFamily, 0);
 		presentationQueue = device->getQueue(presentationQueueFamily, 0);
 
+		// pipeline cache
+		// (loaded from the previous run, if any)
+		pipelineCache.init(physicalDevice, device.get(), appName);
+
 		// function pointers
 		vkFuncs.vkWaitForPresentKHR = PFN_vkWaitForPresentKHR(device->getProcAddr("vkWaitForPresentKHR"));
 		//vkFuncs.vkAcquireFullScreenExclusiveModeEXT = PFN_vkAcquireFullScreenExclusiveModeEXT(device->getProcAddr("vkAcquireFullScreenExclusiveModeEXT"));
@@ -530,8 +536,7 @@ int main(int argc, char** argv)
 
 				// pipeline
 				pipeline =
-					device->createGraphicsPipelineUnique(
-						nullptr,  // pipelineCache
+					pipelineCache.createGraphicsPipelineUnique(
 						vk::GraphicsPipelineCreateInfo(
 							vk::PipelineCreateFlags(),  // flags
 
@@ -644,7 +649,7 @@ int main(int argc, char** argv)
 							vk::Pipeline(nullptr),  // basePipelineHandle
 							-1 // basePipelineIndex
 						)
-					).value;
+					);
 
 			});
 
@@ -1011,6 +1016,10 @@ int main(int argc, char** argv)
 		// run main loop
 		window.mainLoop();
 
+		// save pipeline cache for the next run
+		pipelineCache.printStats();
+		pipelineCache.save();
+
 	// catch exceptions
 	} catch(vk::Error& e) {
 		cout << "Failed because of Vulkan exception: " << e.what() << endl;
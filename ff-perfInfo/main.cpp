@@ -1,3 +1,4 @@
+#include "PipelineCache.h"
 #include <vulkan/vulkan.hpp>
 #include <iostream>
 
@@ -299,6 +300,11 @@ int main(int argc, char* argv[])
 			// get queue
 			vk::Queue computeQueue = device->getQueue(computeQueueFamily, 0);
 
+			// pipeline cache
+			// (loaded from the previous run, if any)
+			PipelineCache pipelineCache;
+			pipelineCache.init(pd, device.get(), appName);
+
 			// shader modules
 			array<vk::UniqueShaderModule, 4> shaders;
 			shaders[0] =
@@ -371,8 +377,7 @@ int main(int argc, char* argv[])
 			for(size_t i=0; i<pipelines.size(); i++)
 				if(shaders[i])
 					pipelines[i] =
-						device->createComputePipelineUnique(
-							nullptr,  // pipelineCache
+						pipelineCache.createComputePipelineUnique(
 							vk::ComputePipelineCreateInfo(
 								{},  // flags
 								vk::PipelineShaderStageCreateInfo(  // stage
@@ -384,7 +389,16 @@ int main(int argc, char* argv[])
 								),
 								pipelineLayout.get()  // layout
 							)
-						).value;
+						);
+
+			// save pipeline cache for the next run
+			// (failure is reported only, as the cache must not abort the measurements)
+			pipelineCache.printStats();
+			try {
+				pipelineCache.save();
+			} catch(exception& e) {
+				cout << "Failed to save pipeline cache: " << e.what() << endl;
+			}
 
 			// buffer
 			vk::UniqueBuffer buffer =